@@ -19,6 +19,20 @@ _DECODER_INPUT_FILE  = _ENCODER_OUTPUT_FILE
 _DECODER_OUTPUT_FILE = os.path.join(_TMP_FILES_DIRECTORY, "live-recorded-decoded.yuv")
 _DECODER_REFERENCE_FILE = _ENCODER_INPUT_FILE
 
+# The recorded video is encoded again skipping frames, the metadata must still match the decoded frames
+_FRAME_SKIP                     = 1
+_FRAME_SKIP_ENCODER_FILE        = os.path.join (os.getcwd(), "encoder-frame-skip.cfg")
+_FRAME_SKIP_DECODER_FILE        = os.path.join (os.getcwd(), "decoder-frame-skip.cfg")
+_FRAME_SKIP_ENCODER_OUTPUT_FILE = os.path.join(_TMP_FILES_DIRECTORY, "live-encoded-frame-skip.h264")
+_FRAME_SKIP_DECODER_OUTPUT_FILE = os.path.join(_TMP_FILES_DIRECTORY, "live-recorded-decoded-frame-skip.yuv")
+
+# The recorded video is encoded again with the biggest QP offset of the objects, the mb_qp_delta must stay decodable
+_QP_OFFSET                     = -26
+_QP_OFFSET_ENCODER_FILE        = os.path.join (os.getcwd(), "encoder-qp-offset.cfg")
+_QP_OFFSET_DECODER_FILE        = os.path.join (os.getcwd(), "decoder-qp-offset.cfg")
+_QP_OFFSET_ENCODER_OUTPUT_FILE = os.path.join(_TMP_FILES_DIRECTORY, "live-encoded-qp-offset.h264")
+_QP_OFFSET_DECODER_OUTPUT_FILE = os.path.join(_TMP_FILES_DIRECTORY, "live-recorded-decoded-qp-offset.yuv")
+
 _OBJECT_DETECTION_ENABLE        = 1
 _OBJECT_DETECTION_MIN_HEIGHT    = 30
 _OBJECT_DETECTION_MIN_WIDTH     = 30
@@ -39,44 +53,47 @@ def get_options ():
 
 
 
-def generate_decoder_configuration ():
+def generate_decoder_configuration (input_file = _DECODER_INPUT_FILE, output_file = _DECODER_OUTPUT_FILE, decoder_file = _DECODER_FILE):
 
     config_template = open (_DECODER_TEMPLATE_FILE, "r")
   
-    config_file_str = config_template.read().format(InputFile = _DECODER_INPUT_FILE,
-                                                    OutputFile = _DECODER_OUTPUT_FILE,
+    config_file_str = config_template.read().format(InputFile = input_file,
+                                                    OutputFile = output_file,
                                                     RefFile = _DECODER_REFERENCE_FILE)
 
     config_template.close()
 
-    config_file = open (_DECODER_FILE, "w")
+    config_file = open (decoder_file, "w")
     config_file.write(config_file_str)
     config_file.close()
 
 
-def generate_encoder_configuration (frames_to_encode, frame_rate, width, height):
+def generate_encoder_configuration (frames_to_encode, frame_rate, width, height,
+                                    frame_skip = 0, qp_offset = 0, output_file = _ENCODER_OUTPUT_FILE, encoder_file = _ENCODER_FILE):
 
 	config_template = open (_ENCODER_TEMPLATE_FILE, "r")
   
 	config_file_str = config_template.read().format(InputFile1 = _ENCODER_INPUT_FILE, 
                                                         InputFile2 = _ENCODER_INPUT_FILE, 
-                                                        FramesToBeEncoded = frames_to_encode, 
+                                                        FramesToBeEncoded = (int(frames_to_encode) + frame_skip) / (frame_skip + 1), 
+                                                        FrameSkip = frame_skip, 
                                                         FrameRate = frame_rate, 
                                                         SourceWidth = width, 
                                                         SourceHeight = height, 
                                                         OutputWidth = width, 
                                                         OutputHeight = height,
-                                                        OutputFile = _ENCODER_OUTPUT_FILE,
+                                                        OutputFile = output_file,
                                                         object_detection_enable = _OBJECT_DETECTION_ENABLE,
                                                         object_detection_min_width = _OBJECT_DETECTION_MIN_WIDTH,
                                                         object_detection_min_height = _OBJECT_DETECTION_MIN_HEIGHT,
                                                         object_detection_search_hysteresis = _OBJECT_DETECTION_SEARCH_HYST,
                                                         object_detection_tracking_hysteresis = _OBJECT_DETECTION_TRACKING_HYST,
-                                                        object_detection_training_file = _OBJECT_DETECTION_TRAINING_FILE)
+                                                        object_detection_training_file = _OBJECT_DETECTION_TRAINING_FILE,
+                                                        object_detection_qp_offset = qp_offset)
 
 	config_template.close()
 
-	config_file = open (_ENCODER_FILE, "w")
+	config_file = open (encoder_file, "w")
 	config_file.write(config_file_str)
 	config_file.close()
 
@@ -209,6 +226,42 @@ subprocess.call (os.path.join("..", "..","lencod.exe") + " -f " + _ENCODER_FILE,
 print("\n=== Decoding video with object detection metadata ===\n")
 subprocess.call (os.path.join("..", "..", "ldecod.exe") + " -f " + _DECODER_FILE, shell=True)
 
+print("\n=== Encoding video with object detection metadata and FrameSkip = {0} ===\n".format(_FRAME_SKIP))
+generate_encoder_configuration (*get_options(), frame_skip = _FRAME_SKIP, output_file = _FRAME_SKIP_ENCODER_OUTPUT_FILE,
+                                encoder_file = _FRAME_SKIP_ENCODER_FILE)
+subprocess.call (os.path.join("..", "..","lencod.exe") + " -f " + _FRAME_SKIP_ENCODER_FILE, shell=True)
+
+print("\n=== Decoding video with object detection metadata and FrameSkip = {0} ===\n".format(_FRAME_SKIP))
+generate_decoder_configuration (_FRAME_SKIP_ENCODER_OUTPUT_FILE, _FRAME_SKIP_DECODER_OUTPUT_FILE, _FRAME_SKIP_DECODER_FILE)
+decoder = subprocess.Popen (os.path.join("..", "..", "ldecod.exe") + " -f " + _FRAME_SKIP_DECODER_FILE, shell=True,
+                            stdout=subprocess.PIPE)
+late_metadata = 0
+
+for line in decoder.stdout:
+    sys.stdout.write(line)
+    late_metadata += ("late metadata" in line)
+
+decoder.wait()
+
+if late_metadata:
+    print("\n=== FrameSkip = {0}: FAILED, [{1}] metadata did not match any decoded frame ===\n".format(_FRAME_SKIP, late_metadata))
+else:
+    print("\n=== FrameSkip = {0}: all the metadata matched the decoded frames ===\n".format(_FRAME_SKIP))
+
+print("\n=== Encoding video with object detection metadata and object_detection_qp_offset = {0} ===\n".format(_QP_OFFSET))
+generate_encoder_configuration (*get_options(), qp_offset = _QP_OFFSET, output_file = _QP_OFFSET_ENCODER_OUTPUT_FILE,
+                                encoder_file = _QP_OFFSET_ENCODER_FILE)
+subprocess.call (os.path.join("..", "..","lencod.exe") + " -f " + _QP_OFFSET_ENCODER_FILE, shell=True)
+
+print("\n=== Decoding video with object detection metadata and object_detection_qp_offset = {0} ===\n".format(_QP_OFFSET))
+generate_decoder_configuration (_QP_OFFSET_ENCODER_OUTPUT_FILE, _QP_OFFSET_DECODER_OUTPUT_FILE, _QP_OFFSET_DECODER_FILE)
+decoder_status = subprocess.call (os.path.join("..", "..", "ldecod.exe") + " -f " + _QP_OFFSET_DECODER_FILE, shell=True)
+
+if decoder_status:
+    print("\n=== object_detection_qp_offset = {0}: FAILED, the decoder exited with [{1}] ===\n".format(_QP_OFFSET, decoder_status))
+else:
+    print("\n=== object_detection_qp_offset = {0}: the video was decoded ===\n".format(_QP_OFFSET))
+
 print("\n=== Playing decoded video with metadata already applied on the video ===\n")
 play_pipeline = build_playback_pipeline(*get_options())
 play_pipeline.set_state (gst.STATE_PLAYING)
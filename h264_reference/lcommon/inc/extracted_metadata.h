@@ -17,6 +17,27 @@ typedef struct _ExtractedYImage ExtractedYImage;
 typedef struct _ExtractedMetadata ExtractedMetadata;
 typedef struct _ExtractedMetadataBuffer ExtractedMetadataBuffer;
 typedef struct _ExtractedObjectBoundingBox ExtractedObjectBoundingBox;
+typedef struct _ExtractedObjectBoundingBoxList ExtractedObjectBoundingBoxList;
+typedef struct _ExtractedMetadataCodec ExtractedMetadataCodec;
+
+/* Max number of metadata objects on one ExtractedMetadataCodec container */
+#define EXTRACTED_METADATA_CODEC_MAX_BATCH 16
+
+/* POC distance of two consecutive metadata frame numbers. The frame number of a picture is its POC over this
+   distance (a frame counts 2, one per field), plus the frame number the last IDR picture restarted from.
+   The encoder and the decoder number the pictures the same way whatever the POC step of the stream is
+   (2 * (1 + FrameSkip) on lencod), the skipped input frames keep their numbers. */
+#define EXTRACTED_METADATA_FRAME_POC_DISTANCE 2
+
+/* Max id of a bounding box, the ExtractedMetadataCodec codes the ids of a list with one flag bit below them */
+#define EXTRACTED_OBJECT_BOUNDING_BOX_MAX_ID 0x7FFFFFFF
+
+/* Size of the uuid_iso_iec_11578 of a user data unregistered SEI message */
+#define EXTRACTED_METADATA_UUID_SIZE 16
+
+/* The uuid_iso_iec_11578 of the user data unregistered SEI messages carrying a serialized ExtractedMetadata,
+   any other SEI message can be skipped without parsing it. */
+extern const unsigned char extracted_metadata_uuid[EXTRACTED_METADATA_UUID_SIZE];
 
 
 /* ExtractedObjectBoundingBox API */
@@ -25,13 +46,13 @@ typedef struct _ExtractedObjectBoundingBox ExtractedObjectBoundingBox;
  *******************************************************************************
  * Creates a new extracted object bounding box.
  *
- * @param id The id of the bounding box object.
+ * @param id The id of the bounding box object, up to EXTRACTED_OBJECT_BOUNDING_BOX_MAX_ID.
  * @param frame_num The frame number this metadata belongs.
  * @param x The x coordinate of the bounding box.
  * @param y The y coordinate of the bounding box.
  * @param width The width of the bounding box.
  * @param height The height of the bounding box.
- * @return The newly allocated ExtractedObjectBoundingBox object.
+ * @return The newly allocated ExtractedObjectBoundingBox object or NULL if the id is too big.
  *
  *******************************************************************************
  */
@@ -78,6 +99,79 @@ void extracted_object_bounding_box_get_data(ExtractedObjectBoundingBox * box,
 ExtractedObjectBoundingBox * extracted_object_bounding_box_from_metadata(ExtractedMetadata * metadata);
 
 
+/* ExtractedObjectBoundingBoxList API */
+
+/*!
+ *******************************************************************************
+ * Creates a new empty list of object bounding boxes, all the objects found
+ * on a frame are sent together on a single metadata.
+ *
+ * @param frame_num The frame number this metadata belongs.
+ * @return The newly allocated ExtractedObjectBoundingBoxList object.
+ *
+ *******************************************************************************
+ */
+ExtractedObjectBoundingBoxList * extracted_object_bounding_box_list_new(unsigned int frame_num);
+
+/*!
+ *******************************************************************************
+ * Adds a bounding box to the list. Boxes with an id bigger than
+ * EXTRACTED_OBJECT_BOUNDING_BOX_MAX_ID or with negative coordinates (or
+ * bigger than UINT16_MAX) are not added.
+ *
+ * @param list The ExtractedObjectBoundingBoxList object.
+ * @param id The id of the bounding box object.
+ * @param x The x coordinate of the bounding box.
+ * @param y The y coordinate of the bounding box.
+ * @param width The width of the bounding box.
+ * @param height The height of the bounding box.
+ *
+ *******************************************************************************
+ */
+void extracted_object_bounding_box_list_add(ExtractedObjectBoundingBoxList * list,
+                                            unsigned int id,
+                                            int x,
+                                            int y,
+                                            int width,
+                                            int height);
+
+/*!
+ *******************************************************************************
+ * Gets the number of bounding boxes on the list.
+ *
+ * @param list The ExtractedObjectBoundingBoxList object.
+ * @return The number of bounding boxes.
+ *
+ *******************************************************************************
+ */
+int extracted_object_bounding_box_list_get_size(ExtractedObjectBoundingBoxList * list);
+
+/*!
+ *******************************************************************************
+ * Gets a bounding box of the list. The box belongs to the list, it must not
+ * be freed and it is valid as long as the list is valid.
+ *
+ * @param list The ExtractedObjectBoundingBoxList object.
+ * @param index The index of the box, from 0 to size - 1.
+ * @return The ExtractedObjectBoundingBox object or NULL if the index is invalid.
+ *
+ *******************************************************************************
+ */
+ExtractedObjectBoundingBox * extracted_object_bounding_box_list_get_box(ExtractedObjectBoundingBoxList * list, int index);
+
+/*!
+ *********************************************************************************
+ * If the given metadata is of the type ExtractedObjectBoundingBoxList,
+ * returns the ExtractedObjectBoundingBoxList object, NULL otherwise.
+ *
+ * @param metadata The metadata object.
+ * @return The ExtractedObjectBoundingBoxList object or NULL if the type is not right.
+ *
+ *********************************************************************************
+ */
+ExtractedObjectBoundingBoxList * extracted_object_bounding_box_list_from_metadata(ExtractedMetadata * metadata);
+
+
 /* ExtractedYImage API */
 
 /*!
@@ -165,6 +259,92 @@ void extracted_metadata_save(ExtractedMetadata * metadata, int fd);
  */
 void extracted_metadata_free(ExtractedMetadata * metadata);
 
+/*!
+ *******************************************************************************
+ * Gets the number of the frame a ExtractedMetadata object belongs.
+ *
+ * @param metadata The metadata object.
+ * @return The frame number.
+ *
+ *******************************************************************************
+ */
+unsigned int extracted_metadata_get_frame_number(ExtractedMetadata * metadata);
+
+
+/* ExtractedMetadataCodec API */
+
+/*!
+ *******************************************************************************
+ * Creates a new ExtractedMetadataCodec object. The codec writes a batch of
+ * metadata objects on a compact container: the frame numbers are coded as
+ * the difference to the previous metadata and the bounding boxes as the
+ * difference to the box with the same id of the previous list, all with
+ * varints. Every few containers the metadata is coded without differences
+ * so a decoder can start on the middle of the stream.
+ * The encoder and the decoder must use one codec for all the containers.
+ *
+ * @return The ExtractedMetadataCodec object, or NULL in case of error.
+ *
+ *******************************************************************************
+ */
+ExtractedMetadataCodec * extracted_metadata_codec_new();
+
+/*!
+ *******************************************************************************
+ * Frees a ExtractedMetadataCodec object.
+ *
+ * @param codec The codec object.
+ *
+ *******************************************************************************
+ */
+void extracted_metadata_codec_free(ExtractedMetadataCodec * codec);
+
+/*!
+ *******************************************************************************
+ * Gets the max size in bytes of the container of the given metadata objects.
+ *
+ * @param metadata The metadata objects.
+ * @param count The number of metadata objects.
+ * @return The max size (in bytes) of the container.
+ *
+ *******************************************************************************
+ */
+int extracted_metadata_codec_get_max_size(ExtractedMetadata ** metadata, int count);
+
+/*!
+ *******************************************************************************
+ * Writes the metadata objects on a container. It is responsability of the
+ * caller to alloc a data pointer with the size given by
+ * extracted_metadata_codec_get_max_size.
+ *
+ * @param codec The codec object.
+ * @param metadata The metadata objects, at most EXTRACTED_METADATA_CODEC_MAX_BATCH.
+ * @param count The number of metadata objects.
+ * @param data Where the container will be stored.
+ * @return The size (in bytes) of the container.
+ *
+ *******************************************************************************
+ */
+int extracted_metadata_codec_encode(ExtractedMetadataCodec * codec, ExtractedMetadata ** metadata, int count, char * data);
+
+/*!
+ *******************************************************************************
+ * Reads the metadata objects of a container. The metadata serialized by
+ * extracted_metadata_serialize is read too. Metadata coded as differences
+ * to metadata the codec has not read are discarded.
+ *
+ * @param codec The codec object.
+ * @param data The container.
+ * @param size Size in bytes of the container.
+ * @param metadata Where the metadata objects will be stored (OUT).
+ * @param max_count Max number of metadata objects stored, the others are freed.
+ * @return The number of metadata objects stored.
+ *
+ *******************************************************************************
+ */
+int extracted_metadata_codec_decode(ExtractedMetadataCodec * codec, const char * data, int size,
+                                    ExtractedMetadata ** metadata, int max_count);
+
 
 /* ExtractedMetadataBuffer API */
 
@@ -180,7 +360,8 @@ ExtractedMetadataBuffer * extracted_metadata_buffer_new();
 
 /*!
  *******************************************************************************
- * Add a metadata do the buffer. 
+ * Add a metadata do the buffer. The buffer grows as needed, the metadata may
+ * come on any frame order and a frame may have many metadata objects.
  *
  * @param buffer The metadata buffer object.
  * @param metadata The metadata object.
@@ -204,7 +385,8 @@ void extracted_metadata_buffer_free(ExtractedMetadataBuffer * buffer);
 /*!
  *******************************************************************************
  * Get a metadata from the buffer for the given frame, all late metadata will
- * be freed, if there is no metadata for this frame return NULL.
+ * be freed, if there is no metadata for this frame return NULL. A frame with
+ * many metadata objects returns one on each call, on the order they were added.
  *
  * @return The metadata object, or NULL if there is no metadata for this frame.
  *
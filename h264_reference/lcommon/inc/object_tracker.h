@@ -0,0 +1,250 @@
+/*!
+ *******************************************************************************
+ *  \file
+ *     object_tracker.h
+ *  \brief
+ *     definitions for the object tracker, shared by the encoder and the decoder.
+ *  \author(s)
+ *      - Tiago Katcipis                             <tiagokatcipis@gmail.com>
+ *
+ * *****************************************************************************
+ */
+
+#ifndef OBJECT_TRACKER_H
+#define OBJECT_TRACKER_H
+
+/* Just like the metadata extractor, nothing from the JM reference software is used here,
+   the motion vectors are described by the MotionVectorField. */
+
+#include "extracted_metadata.h"
+
+#include <stdint.h>
+
+/* Max number of objects tracked at the same time, one bit of the live mask per object */
+#define OBJECT_TRACKER_MAX_OBJECTS 64
+
+typedef struct _ObjectTracker ObjectTracker;
+
+typedef struct _TrackedBoundigBox {
+  unsigned int id;
+
+  /* double x,y is used so we dont lose small movement information */
+  double x;
+  double y;
+  short width;
+  short height;
+
+  /* Display order frame (metadata frame number) the position refers to */
+  unsigned int frame;
+
+  int motion_x;
+  int motion_y;
+  int motion_samples;
+
+  /* Movement (in pixels per frame) of the last motion estimation */
+  double velocity_x;
+  double velocity_y;
+} TrackedBoundigBox;
+
+/* A reference picture and its POC distance to the picture that uses it,
+   positive for past references and negative for future ones. */
+typedef struct _MotionVectorReference {
+  const void * picture;
+  int poc_distance;
+} MotionVectorReference;
+
+/* Describes the motion vectors of a picture without using the JM types, one block per 4x4 block.
+   The block (x, y) is at blocks + y * row_stride + x * block_stride, inside it each list (LIST_0 and LIST_1) has
+   a vector (2 shorts, x and y, in QPEL units) at mv_offset[list], a reference index (signed char, negative if the
+   list is not used) at ref_idx_offset[list] and a reference picture pointer at ref_pic_offset[list]. */
+typedef struct _MotionVectorField {
+  const unsigned char * blocks;
+  int block_stride;
+  int row_stride;
+  int mv_offset[2];
+  int ref_idx_offset[2];
+  int ref_pic_offset[2];
+
+  /* The pictures the reference picture pointers may point to */
+  const MotionVectorReference * references;
+  int reference_count;
+
+  /* POC distance of one frame of velocity, EXTRACTED_METADATA_FRAME_POC_DISTANCE on the encoder and the decoder */
+  int frame_poc_distance;
+
+  /* Size in blocks */
+  int width;
+  int height;
+} MotionVectorField;
+
+
+/*!
+ *********************************************************************************
+ * Creates a new object tracker.
+ *
+ * @param frame_width  Width of the luma plane of the frames, used to allocate the motion samples memory.
+ * @param frame_height Height of the luma plane of the frames, used to allocate the motion samples memory.
+ *
+ * @return A ObjectTracker object or NULL in case of error.
+ *
+ *********************************************************************************
+ */
+ObjectTracker * object_tracker_new(int frame_width, int frame_height);
+
+
+/*!
+ *********************************************************************************
+ * Free a object tracker.
+ *
+ * @param tracker The object tracker to be destroyed.
+ *
+ *********************************************************************************
+ */
+void object_tracker_free(ObjectTracker * tracker);
+
+
+/*!
+ *********************************************************************************
+ * Gets the tracked objects. Bit i of the mask is set if the slot i has an object.
+ *
+ * @param tracker The ObjectTracker object.
+ *
+ * @return The mask of the used slots.
+ *
+ *********************************************************************************
+ */
+uint64_t object_tracker_get_live(ObjectTracker * tracker);
+
+
+/*!
+ *********************************************************************************
+ * Gets the object of a slot. The object belongs to the tracker, it is valid
+ * until the slot is removed.
+ *
+ * @param tracker The ObjectTracker object.
+ * @param slot    The slot, from 0 to OBJECT_TRACKER_MAX_OBJECTS - 1.
+ *
+ * @return The TrackedBoundigBox of the slot.
+ *
+ *********************************************************************************
+ */
+TrackedBoundigBox * object_tracker_get_object(ObjectTracker * tracker, int slot);
+
+
+/*!
+ *********************************************************************************
+ * Starts tracking a new object.
+ *
+ * @param tracker The ObjectTracker object.
+ * @param id      The object id.
+ * @param frame   The frame number of the position.
+ * @param x       The x coordinate of the object.
+ * @param y       The y coordinate of the object.
+ * @param width   The width of the object.
+ * @param height  The height of the object.
+ *
+ * @return The slot of the object or -1 if there is no free slot.
+ *
+ *********************************************************************************
+ */
+int object_tracker_add(ObjectTracker * tracker, unsigned int id, unsigned int frame, int x, int y, int width, int height);
+
+
+/*!
+ *********************************************************************************
+ * Moves a tracked object to where it has been found, discarding the motion
+ * gathered for it. The frame may be older than the one of the other objects,
+ * the next estimation moves the object from there.
+ *
+ * @param tracker The ObjectTracker object.
+ * @param slot    The slot of the object.
+ * @param frame   The frame number of the position.
+ * @param x       The x coordinate of the object.
+ * @param y       The y coordinate of the object.
+ * @param width   The width of the object.
+ * @param height  The height of the object.
+ *
+ *********************************************************************************
+ */
+void object_tracker_update(ObjectTracker * tracker, int slot, unsigned int frame, int x, int y, int width, int height);
+
+
+/*!
+ *********************************************************************************
+ * Stops tracking an object.
+ *
+ * @param tracker The ObjectTracker object.
+ * @param slot    The slot of the object.
+ *
+ *********************************************************************************
+ */
+void object_tracker_remove(ObjectTracker * tracker, int slot);
+
+
+/*!
+ *********************************************************************************
+ * Replaces the tracked objects by the ones of a bounding box metadata
+ * (ExtractedObjectBoundingBox or ExtractedObjectBoundingBoxList). The objects
+ * with the same id are moved, the others are added or removed. The positions
+ * refer to the frame number of the metadata, the tracked objects are moved to
+ * it first (see object_tracker_estimate_motion). Other metadata types are ignored.
+ *
+ * @param tracker  The ObjectTracker object.
+ * @param metadata The bounding box metadata.
+ *
+ *********************************************************************************
+ */
+void object_tracker_sync(ObjectTracker * tracker, ExtractedMetadata * metadata);
+
+
+/*!
+ *********************************************************************************
+ * Gathers the motion of the tracked objects from the motion vectors of a picture.
+ * Only the blocks overlapping the tracked objects are read, the motion of each
+ * object is the mean of its vectors without the smallest and biggest quarter
+ * (interquartile mean), so background blocks inside the box do not skew it.
+ * Each vector is scaled to the distance of one frame using the POC distance of
+ * its reference, bi-predicted blocks use the mean of both scaled vectors and
+ * intra blocks are ignored.
+ *
+ * @param tracker The ObjectTracker object.
+ * @param field   The motion vectors of the picture.
+ *
+ *********************************************************************************
+ */
+void object_tracker_add_motion_vector_field(ObjectTracker * tracker, const MotionVectorField * field);
+
+
+/*!
+ *********************************************************************************
+ * Moves the tracked objects to a frame. The velocity of the objects with motion
+ * samples is the mean of the motion gathered since the last estimation, the
+ * others keep the last one. Each object moves by its velocity times the display
+ * order distance from the frame of its position, so the hierarchical B pictures
+ * (coded out of order) and the skipped frames move it by the right amount.
+ * The moved objects are clipped to the frame, the ones left outside of it are
+ * removed.
+ *
+ * @param tracker The ObjectTracker object.
+ * @param frame   The frame number of the picture, on display order.
+ *
+ *********************************************************************************
+ */
+void object_tracker_estimate_motion(ObjectTracker * tracker, unsigned int frame);
+
+
+/*!
+ *********************************************************************************
+ * Creates a ExtractedObjectBoundingBoxList with all the tracked objects,
+ * clipped to the frame. The objects outside of the frame are left out.
+ *
+ * @param tracker      The ObjectTracker object.
+ * @param frame_number The frame number of the metadata.
+ *
+ * @return The metadata or NULL if no object is tracked.
+ *
+ *********************************************************************************
+ */
+ExtractedMetadata * object_tracker_get_metadata(ObjectTracker * tracker, unsigned int frame_number);
+
+#endif
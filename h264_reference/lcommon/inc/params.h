@@ -58,6 +58,8 @@ struct inp_par_enc
 
   int slice_mode;                       //!< Indicate what algorithm to use for setting slices
   int slice_argument;                   //!< Argument to the specified slice algorithm
+  int SliceThreads;                     //!< Threads of the slice encoder, for slices of a fixed number of MBs (0: disabled)
+  int WavefrontThreads;                 //!< Threads of the wavefront macroblock coding of a picture in one slice (0: disabled)
   int UseConstrainedIntraPred;          //!< 0: Inter MB pixels are allowed for intra prediction 1: Not allowed
   int  SetFirstAsLongTerm;              //!< Support for temporal considerations for CB plus encoding
   int  infile_header;                   //!< If input file has a header set this to the length of the header
@@ -232,6 +234,8 @@ struct inp_par_enc
 
   int RandomIntraMBRefresh;     //!< Number of pseudo-random intra-MBs per picture
 
+  // Luma interpolation and buffering
+  int LumaMCBuffer;                                    //!< Store the 16 luma sub-images of the references (0: interpolate blocks on demand)
   // Chroma interpolation and buffering
   int ChromaMCBuffer;
   Boolean ChromaMEEnable;
@@ -296,6 +300,7 @@ struct inp_par_enc
 
   // Search Algorithm
   SearchType SearchMode;
+  int DistortionSIMD;                                  //!< Kernels of the ME distortion (0: best supported by the CPU, 1: C, 2: SSE2, 3: SSSE3, 4: AVX2)
   
   // UMHEX related parameters
   int UMHexDSR;
@@ -390,7 +395,13 @@ struct inp_par_enc
   int object_detection_min_height;                     //!< Min height of the object that will be detected.
   int object_detection_search_hysteresis;              //!< Search for new object hysteresys (in frames).
   int object_detection_tracking_hysteresis;            //!< Confirm tracked object existence hysteresis (in frames).
+  int object_detection_discovery_hysteresis;           //!< While tracking, search for new objects hysteresis (in frames).
   char object_detection_training_file[FILE_NAME_SIZE]; //!< File containing the training info used on the object detection.
+  int object_detection_async;                          //!< Search for objects on a worker thread.
+  int object_detection_async_queue_size;               //!< Max number of frames waiting for the detection worker.
+  int object_detection_threads;                        //!< Number of threads scanning the search scales.
+  int object_detection_sparse_metadata;                //!< Only send the bounding boxes of the searched frames.
+  int object_detection_qp_offset;                      //!< QP offset of the macroblocks of the tracked objects.
 };
 
 #endif
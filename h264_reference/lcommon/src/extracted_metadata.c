@@ -3,9 +3,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include <arpa/inet.h>
+#include <stdint.h>
 #include <stdio.h>
 
 
+const unsigned char extracted_metadata_uuid[EXTRACTED_METADATA_UUID_SIZE] = {
+  0x72, 0xb9, 0x0c, 0x5c, 0x52, 0x4d, 0x41, 0x48, 0xa3, 0x53, 0x8a, 0xab, 0x99, 0x09, 0x7d, 0x97
+};
+
 /* types/struct definition */
 typedef void (*ExtractedMetadataFreeFunc) (ExtractedMetadata *);
 typedef void (*ExtractedMetadataSerializeFunc) (ExtractedMetadata *, char *);
@@ -14,8 +19,9 @@ typedef int  (*ExtractedMetadataGetSerializedSizeFunc) (ExtractedMetadata *);
 
 typedef enum {
   /* 1 byte only */
-  ExtractedMetadataYImage            = 0x01,
-  ExtractedMetadataObjectBoundingBox = 0x02
+  ExtractedMetadataYImage                = 0x01,
+  ExtractedMetadataObjectBoundingBox     = 0x02,
+  ExtractedMetadataObjectBoundingBoxList = 0x03
 } ExtractedMetadataType;
 
 struct _ExtractedMetadata {
@@ -28,9 +34,11 @@ struct _ExtractedMetadata {
 };
 
 struct _ExtractedMetadataBuffer {
-  ExtractedMetadata ** ringbuffer;
-  short read_index;
-  short write_index;
+  /* Sorted by frame number, the entries before first have been taken */
+  ExtractedMetadata ** entries;
+  int first;
+  int size;
+  int capacity;
 };
 
 struct _ExtractedYImage {
@@ -51,10 +59,18 @@ struct _ExtractedObjectBoundingBox {
   uint16_t height;
 };
 
+struct _ExtractedObjectBoundingBoxList {
+  ExtractedMetadata parent;
+  uint16_t size;
+  uint16_t capacity;
+  ExtractedObjectBoundingBox * boxes;
+};
+
 static const int EXTRACTED_METADATA_TYPE_SIZE = 1;
 
 static ExtractedMetadata * extracted_y_image_deserialize(const char * data, int size);
 static ExtractedMetadata * extracted_object_bounding_box_deserialize(const char * data, int size);
+static ExtractedMetadata * extracted_object_bounding_box_list_deserialize(const char * data, int size);
 
 static int extracted_metadata_header_size()
 {
@@ -72,6 +88,11 @@ void extracted_metadata_free(ExtractedMetadata * metadata)
   metadata->free(metadata);
 }
 
+unsigned int extracted_metadata_get_frame_number(ExtractedMetadata * metadata)
+{
+  return metadata->frame_number;
+}
+
 int extracted_metadata_get_serialized_size(ExtractedMetadata * metadata)
 {
   /* Subclass size + metadata header size */
@@ -123,6 +144,11 @@ ExtractedMetadata * extracted_metadata_deserialize(const char * data, int size)
     case ExtractedMetadataObjectBoundingBox:
       ret = extracted_object_bounding_box_deserialize(data, size);
       break;
+
+    case ExtractedMetadataObjectBoundingBoxList:
+      ret = extracted_object_bounding_box_list_deserialize(data, size);
+      break;
+
     default:
       printf("extracted_metadata_deserialize: cant find the extracted metadata type !!!\n");
   }
@@ -171,10 +197,14 @@ static void extracted_object_bounding_box_serialize (ExtractedMetadata * metadat
 static int extracted_object_bounding_box_get_serialized_size(ExtractedMetadata * metadata);
 static void extracted_object_bounding_box_save(ExtractedMetadata * metadata, int fd);
 
-ExtractedObjectBoundingBox * extracted_object_bounding_box_new(unsigned int id, unsigned int frame_num, int x, int y, int width, int height)
+static void extracted_object_bounding_box_init(ExtractedObjectBoundingBox * bounding_box, 
+                                               unsigned int id, 
+                                               unsigned int frame_num, 
+                                               int x, 
+                                               int y, 
+                                               int width, 
+                                               int height)
 {
-    ExtractedObjectBoundingBox * bounding_box = malloc(sizeof(ExtractedObjectBoundingBox));
-
     bounding_box->id     = id;
     bounding_box->x      = x;
     bounding_box->y      = y;
@@ -188,7 +218,20 @@ ExtractedObjectBoundingBox * extracted_object_bounding_box_new(unsigned int id,
                              extracted_object_bounding_box_save,
                              ExtractedMetadataObjectBoundingBox,
                              frame_num);
+}
+
+ExtractedObjectBoundingBox * extracted_object_bounding_box_new(unsigned int id, unsigned int frame_num, int x, int y, int width, int height)
+{
+    ExtractedObjectBoundingBox * bounding_box = NULL;
 
+    if (id > EXTRACTED_OBJECT_BOUNDING_BOX_MAX_ID) {
+      printf("extracted_object_bounding_box_new: ERROR: id [%u] is bigger than [%u] !!!\n", id, EXTRACTED_OBJECT_BOUNDING_BOX_MAX_ID);
+      return NULL;
+    }
+
+    bounding_box = malloc(sizeof(ExtractedObjectBoundingBox));
+
+    extracted_object_bounding_box_init(bounding_box, id, frame_num, x, y, width, height);
     return bounding_box;
 }
 
@@ -250,7 +293,7 @@ static void extracted_object_bounding_box_serialize (ExtractedMetadata * metadat
 {
     ExtractedObjectBoundingBox * bounding_box = (ExtractedObjectBoundingBox *) metadata;
    
-    *((uint32_t *) data) = htons(bounding_box->id);
+    *((uint32_t *) data) = htonl(bounding_box->id);
     data += sizeof(uint32_t);
 
     *((uint16_t *) data) = htons(bounding_box->x);
@@ -326,6 +369,193 @@ static void extracted_object_bounding_box_save(ExtractedMetadata * metadata, int
 }
 
 
+/*
+ *********************************************
+ * ExtractedObjectBoundingBoxList Public API *
+ *********************************************
+ */
+
+static void extracted_object_bounding_box_list_free(ExtractedMetadata * metadata);
+static void extracted_object_bounding_box_list_serialize (ExtractedMetadata * metadata, char * data);
+static int extracted_object_bounding_box_list_get_serialized_size(ExtractedMetadata * metadata);
+static void extracted_object_bounding_box_list_save(ExtractedMetadata * metadata, int fd);
+
+ExtractedObjectBoundingBoxList * extracted_object_bounding_box_list_new(unsigned int frame_num)
+{
+  ExtractedObjectBoundingBoxList * list = malloc(sizeof(ExtractedObjectBoundingBoxList));
+
+  list->size     = 0;
+  list->capacity = 0;
+  list->boxes    = NULL;
+
+  extracted_metadata_init((ExtractedMetadata *) list,
+                          extracted_object_bounding_box_list_free,
+                          extracted_object_bounding_box_list_serialize,
+                          extracted_object_bounding_box_list_get_serialized_size,
+                          extracted_object_bounding_box_list_save,
+                          ExtractedMetadataObjectBoundingBoxList,
+                          frame_num);
+
+  return list;
+}
+
+void extracted_object_bounding_box_list_add(ExtractedObjectBoundingBoxList * list,
+                                            unsigned int id,
+                                            int x,
+                                            int y,
+                                            int width,
+                                            int height)
+{
+  if (id > EXTRACTED_OBJECT_BOUNDING_BOX_MAX_ID) {
+    printf("extracted_object_bounding_box_list_add: ERROR: id [%u] is bigger than [%u] !!!\n", id, EXTRACTED_OBJECT_BOUNDING_BOX_MAX_ID);
+    return;
+  }
+
+  /* The coordinates are serialized as uint16_t */
+  if ((x < 0) || (y < 0) || (width < 0) || (height < 0) ||
+      (x > UINT16_MAX) || (y > UINT16_MAX) || (width > UINT16_MAX) || (height > UINT16_MAX)) {
+    printf("extracted_object_bounding_box_list_add: ERROR: box [%d, %d, %d, %d] is out of range !!!\n", x, y, width, height);
+    return;
+  }
+
+  if (list->size == list->capacity) {
+    int capacity                       = (list->capacity) ? list->capacity * 2 : 4;
+    ExtractedObjectBoundingBox * boxes = NULL;
+
+    if (capacity > UINT16_MAX) {
+      printf("extracted_object_bounding_box_list_add: ERROR: list is full !!!\n");
+      return;
+    }
+
+    boxes = realloc(list->boxes, sizeof(ExtractedObjectBoundingBox) * capacity);
+
+    if (!boxes) {
+      printf("extracted_object_bounding_box_list_add: ERROR ALLOCATING BOXES !!!\n");
+      return;
+    }
+
+    list->boxes    = boxes;
+    list->capacity = capacity;
+  }
+
+  extracted_object_bounding_box_init(&list->boxes[list->size], id, list->parent.frame_number, x, y, width, height);
+  list->size++;
+}
+
+int extracted_object_bounding_box_list_get_size(ExtractedObjectBoundingBoxList * list)
+{
+  return list->size;
+}
+
+ExtractedObjectBoundingBox * extracted_object_bounding_box_list_get_box(ExtractedObjectBoundingBoxList * list, int index)
+{
+  if ((index < 0) || (index >= list->size)) {
+    return NULL;
+  }
+
+  return &list->boxes[index];
+}
+
+ExtractedObjectBoundingBoxList * extracted_object_bounding_box_list_from_metadata(ExtractedMetadata * metadata)
+{
+  if (metadata->type == ExtractedMetadataObjectBoundingBoxList) {
+    return (ExtractedObjectBoundingBoxList *) metadata;
+  }
+
+  return NULL;
+}
+
+/*
+ ***************************************************
+ * ExtractedObjectBoundingBoxList private functions *
+ ***************************************************
+ */
+
+static void extracted_object_bounding_box_list_free(ExtractedMetadata * metadata)
+{
+  ExtractedObjectBoundingBoxList * list = (ExtractedObjectBoundingBoxList *) metadata;
+
+  /* The boxes are stored on the list, they are not freed one by one */
+  free(list->boxes);
+  free(list);
+}
+
+static void extracted_object_bounding_box_list_serialize (ExtractedMetadata * metadata, char * data)
+{
+  ExtractedObjectBoundingBoxList * list = (ExtractedObjectBoundingBoxList * ) metadata;
+  int box_size                          = extracted_object_bounding_box_get_serialized_size(NULL);
+  int i;
+
+  /* number of boxes (2 bytes) followed by the boxes, serialized just like a single box */
+  *((uint16_t *) data) = htons(list->size);
+  data += sizeof(uint16_t);
+
+  for (i = 0; i < list->size; i++) {
+    extracted_object_bounding_box_serialize((ExtractedMetadata *) &list->boxes[i], data);
+    data += box_size;
+  }
+}
+
+static ExtractedMetadata * extracted_object_bounding_box_list_deserialize(const char * data, int size)
+{
+  ExtractedObjectBoundingBoxList * list = NULL;
+  int box_size                          = extracted_object_bounding_box_get_serialized_size(NULL);
+  uint16_t count;
+  int i;
+
+  if (size < sizeof(uint16_t)) {
+    printf("extracted_object_bounding_box_list_deserialize: invalid serialized ExtractedObjectBoundingBoxList !!!\n");
+    return NULL;
+  }
+
+  count = ntohs(*((uint16_t *) data));
+  data += sizeof(uint16_t);
+  size -= sizeof(uint16_t);
+
+  if (size < count * box_size) {
+    printf("extracted_object_bounding_box_list_deserialize: expected [%d] boxes but there is only [%d] bytes !!!\n", count, size);
+    return NULL;
+  }
+
+  /* real frame number is set on the metadata superclass deserialize method */
+  list = extracted_object_bounding_box_list_new(0);
+
+  for (i = 0; i < count; i++) {
+    ExtractedObjectBoundingBox * box = (ExtractedObjectBoundingBox *) extracted_object_bounding_box_deserialize(data, size);
+
+    if (!box) {
+      extracted_metadata_free((ExtractedMetadata *) list);
+      return NULL;
+    }
+
+    extracted_object_bounding_box_list_add(list, box->id, box->x, box->y, box->width, box->height);
+    extracted_metadata_free((ExtractedMetadata *) box);
+
+    data += box_size;
+    size -= box_size;
+  }
+
+  return (ExtractedMetadata *) list;
+}
+
+static int extracted_object_bounding_box_list_get_serialized_size(ExtractedMetadata * metadata)
+{
+  ExtractedObjectBoundingBoxList * list = (ExtractedObjectBoundingBoxList *) metadata;
+
+  return sizeof(uint16_t) + list->size * extracted_object_bounding_box_get_serialized_size(NULL);
+}
+
+static void extracted_object_bounding_box_list_save(ExtractedMetadata * metadata, int fd)
+{
+  ExtractedObjectBoundingBoxList * list = (ExtractedObjectBoundingBoxList *) metadata;
+  int i;
+
+  for (i = 0; i < list->size; i++) {
+    extracted_object_bounding_box_save((ExtractedMetadata *) &list->boxes[i], fd);
+  }
+}
+
+
 /*
  ********************************
  * ExtractedYImage Public API *
@@ -472,19 +702,742 @@ static void extracted_y_image_save(ExtractedMetadata * metadata, int fd)
   }
 }
 
+/*
+ * ExtractedYImage lossless compression, LOCO-I like: each sample is predicted by the MED predictor
+ * from its left, above and above left neighbours and the residual is coded with Golomb-Rice codes. 
+ * The Rice parameter adapts to the mean residual of a few contexts chosen by the local gradient.
+ */
+
+/* How the plane of a ExtractedYImage is coded */
+enum {
+  Y_IMAGE_RAW        = 0,
+  Y_IMAGE_COMPRESSED = 1
+};
+
+/* Contexts of the Rice parameter, by the quantized local gradient */
+#define Y_IMAGE_CONTEXTS 8
+
+/* Samples seen by a context before its statistics are halved */
+static const int Y_IMAGE_CONTEXT_RESET = 64;
+
+/* Unary prefixes this long are followed by the residual itself (8 bits) */
+static const unsigned int Y_IMAGE_MAX_PREFIX = 24;
+
+typedef struct _YImageContext {
+  unsigned int sum;
+  unsigned int count;
+} YImageContext;
+
+typedef struct _YImageBits {
+  unsigned char * data;
+  int size;
+  int len;
+  uint32_t acc;
+  int bits;
+  int error;
+} YImageBits;
+
+static void y_image_bits_put(YImageBits * bits, uint32_t value, int count)
+{
+  while (count > 0) {
+    int n = (count > 16) ? 16 : count;
+
+    count      -= n;
+    bits->acc   = (bits->acc << n) | ((value >> count) & ((1u << n) - 1));
+    bits->bits += n;
+
+    while (bits->bits >= 8) {
+      bits->bits -= 8;
+
+      if (bits->len == bits->size) {
+        bits->error = 1;
+        return;
+      }
+
+      bits->data[bits->len++] = (unsigned char) (bits->acc >> bits->bits);
+    }
+  }
+}
+
+static uint32_t y_image_bits_get(YImageBits * bits, int count)
+{
+  while (bits->bits < count) {
+    if (bits->len == bits->size) {
+      bits->error = 1;
+      return 0;
+    }
+
+    bits->acc   = (bits->acc << 8) | bits->data[bits->len++];
+    bits->bits += 8;
+  }
+
+  bits->bits -= count;
+  return (bits->acc >> bits->bits) & ((1u << count) - 1);
+}
+
+static int y_image_predict(unsigned char ** y, int row, int col, int * context)
+{
+  int a, b, c;
+  int gradient;
+
+  if (row == 0) {
+    *context = 0;
+    return (col == 0) ? 128 : y[0][col - 1];
+  }
+
+  if (col == 0) {
+    *context = 0;
+    return y[row - 1][0];
+  }
+
+  a = y[row][col - 1];
+  b = y[row - 1][col];
+  c = y[row - 1][col - 1];
+
+  gradient = abs(a - c) + abs(b - c);
+
+  for (*context = 0; (gradient > 0) && (*context < Y_IMAGE_CONTEXTS - 1); (*context)++) {
+    gradient >>= 1;
+  }
+
+  if (c >= ((a > b) ? a : b)) {
+    return (a < b) ? a : b;
+  }
+
+  if (c <= ((a < b) ? a : b)) {
+    return (a > b) ? a : b;
+  }
+
+  return a + b - c;
+}
+
+static int y_image_rice_parameter(YImageContext * context)
+{
+  int k;
+
+  for (k = 0; ((context->count << k) < context->sum) && (k < 7); k++);
+
+  return k;
+}
+
+static void y_image_update_context(YImageContext * context, unsigned int value)
+{
+  context->sum += value;
+  context->count++;
+
+  if (context->count == Y_IMAGE_CONTEXT_RESET) {
+    context->sum   >>= 1;
+    context->count >>= 1;
+  }
+}
+
+static void y_image_init_contexts(YImageContext * contexts)
+{
+  int i;
+
+  for (i = 0; i < Y_IMAGE_CONTEXTS; i++) {
+    contexts[i].sum   = 4;
+    contexts[i].count = 1;
+  }
+}
+
+/* Compresses the image on data, returns the compressed size or 0 if it does not fit on size bytes */
+static int extracted_y_image_compress(ExtractedYImage * img, unsigned char * data, int size)
+{
+  YImageContext contexts[Y_IMAGE_CONTEXTS];
+  YImageBits bits = { data, size, 0, 0, 0, 0 };
+  int row, col;
+
+  y_image_init_contexts(contexts);
+
+  for (row = 0; row < img->height; row++) {
+    for (col = 0; col < img->width; col++) {
+      int context;
+      int residual = (signed char) (img->y[row][col] - y_image_predict(img->y, row, col, &context));
+      /* zigzag, the residual modulo 256 goes from -128 to 127 */
+      unsigned int value = (residual >= 0) ? (residual << 1) : ((-residual << 1) - 1);
+      int k              = y_image_rice_parameter(&contexts[context]);
+      unsigned int q     = value >> k;
+
+      if (q < Y_IMAGE_MAX_PREFIX) {
+        y_image_bits_put(&bits, 1, q + 1);
+        y_image_bits_put(&bits, value, k);
+      } else {
+        y_image_bits_put(&bits, 0, Y_IMAGE_MAX_PREFIX);
+        y_image_bits_put(&bits, value, 8);
+      }
+
+      if (bits.error) {
+        return 0;
+      }
+
+      y_image_update_context(&contexts[context], value);
+    }
+  }
+
+  /* Byte align */
+  y_image_bits_put(&bits, 0, (8 - bits.bits) & 7);
+
+  return bits.error ? 0 : bits.len;
+}
+
+/* Decompresses the image from data, returns the compressed size or 0 in case of error */
+static int extracted_y_image_decompress(ExtractedYImage * img, const unsigned char * data, int size)
+{
+  YImageContext contexts[Y_IMAGE_CONTEXTS];
+  YImageBits bits = { (unsigned char *) data, size, 0, 0, 0, 0 };
+  int row, col;
+
+  y_image_init_contexts(contexts);
+
+  for (row = 0; row < img->height; row++) {
+    for (col = 0; col < img->width; col++) {
+      int context;
+      int prediction     = y_image_predict(img->y, row, col, &context);
+      int k              = y_image_rice_parameter(&contexts[context]);
+      unsigned int q     = 0;
+      unsigned int value;
+
+      while ((q < Y_IMAGE_MAX_PREFIX) && !bits.error && !y_image_bits_get(&bits, 1)) {
+        q++;
+      }
+
+      value = (q < Y_IMAGE_MAX_PREFIX) ? ((q << k) | y_image_bits_get(&bits, k)) : y_image_bits_get(&bits, 8);
+
+      if (bits.error || (value > 255)) {
+        return 0;
+      }
+
+      img->y[row][col] = (unsigned char) (prediction + ((value & 1) ? -(int) ((value + 1) >> 1) : (int) (value >> 1)));
+      y_image_update_context(&contexts[context], value);
+    }
+  }
+
+  return bits.len;
+}
+
+/*
+ ******************************
+ * ExtractedMetadataCodec API *
+ ******************************
+ */
+
+/* First byte of the container, the serialized metadata starts with the type (< 0x80) */
+static const unsigned char EXTRACTED_METADATA_CODEC_VERSION = 0xC1;
+
+/* Set on the record type when the record is coded as differences to the previous records */
+static const unsigned char EXTRACTED_METADATA_CODEC_DELTA = 0x80;
+
+/* Records between two records without differences */
+static const int EXTRACTED_METADATA_CODEC_KEY_INTERVAL = 32;
+
+/* Max size of a 32 bits varint */
+#define VARINT_MAX_SIZE 5
+
+/* Max size of a 16 bits value (or the zigzag of a difference of them) coded as varint */
+#define VARINT_16_MAX_SIZE 3
+
+struct _ExtractedMetadataCodec {
+  /* Frame number of the last record */
+  int has_frame;
+  uint32_t frame_number;
+
+  /* Boxes of the last bounding box list, the boxes of the next list are coded against them */
+  int has_boxes;
+  ExtractedObjectBoundingBox * boxes;
+  int boxes_size;
+  int boxes_capacity;
+
+  /* Records since the last key record */
+  int records;
+};
+
+typedef struct _ExtractedMetadataReader {
+  const unsigned char * data;
+  int size;
+  int error;
+} ExtractedMetadataReader;
+
+static int extracted_metadata_write_varint(unsigned char * data, uint32_t value)
+{
+  int len = 0;
+
+  while (value > 0x7F) {
+    data[len++] = (unsigned char) (value & 0x7F) | 0x80;
+    value     >>= 7;
+  }
+
+  data[len++] = (unsigned char) value;
+  return len;
+}
+
+static int extracted_metadata_write_signed_varint(unsigned char * data, int32_t value)
+{
+  /* zigzag, small negative values get small codes too */
+  return extracted_metadata_write_varint(data, ((uint32_t) value << 1) ^ (uint32_t) (value >> 31));
+}
+
+static uint32_t extracted_metadata_read_varint(ExtractedMetadataReader * reader)
+{
+  uint32_t value = 0;
+  int shift      = 0;
+
+  while (!reader->error) {
+    unsigned char byte;
+
+    if ((reader->size == 0) || (shift >= 7 * VARINT_MAX_SIZE)) {
+      reader->error = 1;
+      break;
+    }
+
+    byte = *reader->data++;
+    reader->size--;
+
+    value |= (uint32_t) (byte & 0x7F) << shift;
+    shift += 7;
+
+    if (!(byte & 0x80)) {
+      return value;
+    }
+  }
+
+  return 0;
+}
+
+static int32_t extracted_metadata_read_signed_varint(ExtractedMetadataReader * reader)
+{
+  uint32_t value = extracted_metadata_read_varint(reader);
+
+  return (int32_t) (value >> 1) ^ -(int32_t) (value & 1);
+}
+
+static ExtractedObjectBoundingBox * extracted_metadata_codec_find_box(ExtractedMetadataCodec * codec, uint32_t id)
+{
+  int i;
+
+  if (!codec->has_boxes) {
+    return NULL;
+  }
+
+  for (i = 0; i < codec->boxes_size; i++) {
+    if (codec->boxes[i].id == id) {
+      return &codec->boxes[i];
+    }
+  }
+
+  return NULL;
+}
+
+static void extracted_metadata_codec_set_boxes(ExtractedMetadataCodec * codec, ExtractedObjectBoundingBoxList * list)
+{
+  if (list->size > codec->boxes_capacity) {
+    ExtractedObjectBoundingBox * boxes = realloc(codec->boxes, sizeof(ExtractedObjectBoundingBox) * list->size);
+
+    if (!boxes) {
+      printf("extracted_metadata_codec_set_boxes: ERROR ALLOCATING BOXES !!!\n");
+      codec->has_boxes = 0;
+      return;
+    }
+
+    codec->boxes          = boxes;
+    codec->boxes_capacity = list->size;
+  }
+
+  if (list->size) {
+    memcpy(codec->boxes, list->boxes, sizeof(ExtractedObjectBoundingBox) * list->size);
+  }
+
+  codec->boxes_size = list->size;
+  codec->has_boxes  = 1;
+}
+
+ExtractedMetadataCodec * extracted_metadata_codec_new()
+{
+  ExtractedMetadataCodec * codec = calloc(1, sizeof(ExtractedMetadataCodec));
+
+  if (!codec) {
+    printf("extracted_metadata_codec_new: ERROR ALLOCATING CODEC !!!\n");
+  }
+
+  return codec;
+}
+
+void extracted_metadata_codec_free(ExtractedMetadataCodec * codec)
+{
+  if (!codec) {
+    return;
+  }
+
+  free(codec->boxes);
+  free(codec);
+}
+
+int extracted_metadata_codec_get_max_size(ExtractedMetadata ** metadata, int count)
+{
+  int size = sizeof(EXTRACTED_METADATA_CODEC_VERSION);
+  int i;
+
+  for (i = 0; i < count; i++) {
+    /* type + frame number */
+    size += 1 + VARINT_MAX_SIZE;
+
+    switch (metadata[i]->type)
+    {
+      case ExtractedMetadataYImage:
+      {
+        ExtractedYImage * img = (ExtractedYImage *) metadata[i];
+        /* size + compression mode, it is never bigger than the plane */
+        size += VARINT_16_MAX_SIZE * 2 + 1 + img->width * img->height;
+        break;
+      }
+
+      case ExtractedMetadataObjectBoundingBox:
+        size += VARINT_MAX_SIZE + VARINT_16_MAX_SIZE * 4;
+        break;
+
+      case ExtractedMetadataObjectBoundingBoxList:
+        size += VARINT_16_MAX_SIZE + ((ExtractedObjectBoundingBoxList *) metadata[i])->size * (VARINT_MAX_SIZE + VARINT_16_MAX_SIZE * 4);
+        break;
+    }
+  }
+
+  return size;
+}
+
+int extracted_metadata_codec_encode(ExtractedMetadataCodec * codec, ExtractedMetadata ** metadata, int count, char * data)
+{
+  unsigned char * out = (unsigned char *) data;
+  int len             = 0;
+  int i;
+
+  out[len++] = EXTRACTED_METADATA_CODEC_VERSION;
+
+  for (i = 0; i < count; i++) {
+    ExtractedMetadata * record = metadata[i];
+    int delta                  = codec->has_frame && (codec->records < EXTRACTED_METADATA_CODEC_KEY_INTERVAL);
+
+    if (!delta) {
+      codec->records   = 0;
+      codec->has_boxes = 0;
+    }
+
+    out[len++] = (unsigned char) record->type | (delta ? EXTRACTED_METADATA_CODEC_DELTA : 0);
+
+    if (delta) {
+      len += extracted_metadata_write_signed_varint(out + len, (int32_t) (record->frame_number - codec->frame_number));
+    } else {
+      len += extracted_metadata_write_varint(out + len, record->frame_number);
+    }
+
+    switch (record->type)
+    {
+      case ExtractedMetadataYImage:
+      {
+        ExtractedYImage * img = (ExtractedYImage *) record;
+        int plane_size        = img->width * img->height;
+        int compressed_size;
+
+        len += extracted_metadata_write_varint(out + len, img->width);
+        len += extracted_metadata_write_varint(out + len, img->height);
+
+        /* The plane goes compressed unless it does not get smaller (noise) */
+        compressed_size = extracted_y_image_compress(img, out + len + 1, plane_size);
+
+        if (compressed_size) {
+          out[len++] = Y_IMAGE_COMPRESSED;
+          len       += compressed_size;
+        } else {
+          out[len++] = Y_IMAGE_RAW;
+          memcpy(out + len, img->y[0], plane_size);
+          len       += plane_size;
+        }
+        break;
+      }
+
+      case ExtractedMetadataObjectBoundingBox:
+      {
+        ExtractedObjectBoundingBox * box = (ExtractedObjectBoundingBox *) record;
+
+        len += extracted_metadata_write_varint(out + len, box->id);
+        len += extracted_metadata_write_varint(out + len, box->x);
+        len += extracted_metadata_write_varint(out + len, box->y);
+        len += extracted_metadata_write_varint(out + len, box->width);
+        len += extracted_metadata_write_varint(out + len, box->height);
+        break;
+      }
+
+      case ExtractedMetadataObjectBoundingBoxList:
+      {
+        ExtractedObjectBoundingBoxList * list = (ExtractedObjectBoundingBoxList *) record;
+        int j;
+
+        len += extracted_metadata_write_varint(out + len, list->size);
+
+        for (j = 0; j < list->size; j++) {
+          ExtractedObjectBoundingBox * box  = &list->boxes[j];
+          ExtractedObjectBoundingBox * prev = extracted_metadata_codec_find_box(codec, box->id);
+
+          /* The lowest bit tells if the box is coded as the difference to the previous one.
+             The ids of a list fit on 31 bits (see extracted_object_bounding_box_list_add). */
+          len += extracted_metadata_write_varint(out + len, ((uint32_t) box->id << 1) | (prev != NULL));
+
+          if (prev) {
+            len += extracted_metadata_write_signed_varint(out + len, box->x - prev->x);
+            len += extracted_metadata_write_signed_varint(out + len, box->y - prev->y);
+            len += extracted_metadata_write_signed_varint(out + len, box->width - prev->width);
+            len += extracted_metadata_write_signed_varint(out + len, box->height - prev->height);
+          } else {
+            len += extracted_metadata_write_varint(out + len, box->x);
+            len += extracted_metadata_write_varint(out + len, box->y);
+            len += extracted_metadata_write_varint(out + len, box->width);
+            len += extracted_metadata_write_varint(out + len, box->height);
+          }
+        }
+
+        extracted_metadata_codec_set_boxes(codec, list);
+        break;
+      }
+    }
+
+    codec->has_frame    = 1;
+    codec->frame_number = record->frame_number;
+    codec->records++;
+  }
+
+  return len;
+}
+
+/* Reads a record, returns NULL if it can not be read. *valid is 0 if it is coded as differences to records not read */
+static ExtractedMetadata * extracted_metadata_codec_read_record(ExtractedMetadataCodec * codec, 
+                                                                ExtractedMetadataReader * reader, 
+                                                                unsigned char type,
+                                                                int * valid)
+{
+  int delta               = (type & EXTRACTED_METADATA_CODEC_DELTA) != 0;
+  ExtractedMetadata * ret = NULL;
+  uint32_t frame_number;
+
+  if (delta) {
+    *valid       = codec->has_frame;
+    frame_number = codec->frame_number + (uint32_t) extracted_metadata_read_signed_varint(reader);
+  } else {
+    *valid           = 1;
+    codec->has_boxes = 0;
+    frame_number     = extracted_metadata_read_varint(reader);
+  }
+
+  switch (type & ~EXTRACTED_METADATA_CODEC_DELTA)
+  {
+    case ExtractedMetadataYImage:
+    {
+      uint32_t width  = extracted_metadata_read_varint(reader);
+      uint32_t height = extracted_metadata_read_varint(reader);
+      ExtractedYImage * img;
+      int used;
+
+      if (reader->error || (width > UINT16_MAX) || (height > UINT16_MAX) || (reader->size < 1)) {
+        reader->error = 1;
+        break;
+      }
+
+      img = extracted_y_image_new(frame_number, width, height);
+      reader->size--;
+
+      if (*reader->data++ == Y_IMAGE_COMPRESSED) {
+        used = extracted_y_image_decompress(img, reader->data, reader->size);
+      } else if (reader->size >= (int) (width * height)) {
+        used = width * height;
+        memcpy(img->y[0], reader->data, used);
+      } else {
+        used = 0;
+      }
+
+      if (!used && (width * height != 0)) {
+        extracted_metadata_free((ExtractedMetadata *) img);
+        reader->error = 1;
+        break;
+      }
+
+      reader->data += used;
+      reader->size -= used;
+      ret = (ExtractedMetadata *) img;
+      break;
+    }
+
+    case ExtractedMetadataObjectBoundingBox:
+    {
+      uint32_t id     = extracted_metadata_read_varint(reader);
+      uint32_t x      = extracted_metadata_read_varint(reader);
+      uint32_t y      = extracted_metadata_read_varint(reader);
+      uint32_t width  = extracted_metadata_read_varint(reader);
+      uint32_t height = extracted_metadata_read_varint(reader);
+
+      if (!reader->error) {
+        ret           = (ExtractedMetadata *) extracted_object_bounding_box_new(id, frame_number, x, y, width, height);
+        reader->error = (ret == NULL);
+      }
+      break;
+    }
+
+    case ExtractedMetadataObjectBoundingBoxList:
+    {
+      uint32_t count                        = extracted_metadata_read_varint(reader);
+      ExtractedObjectBoundingBoxList * list = NULL;
+      uint32_t j;
+
+      if (reader->error || (count > UINT16_MAX)) {
+        reader->error = 1;
+        break;
+      }
+
+      list = extracted_object_bounding_box_list_new(frame_number);
+
+      for (j = 0; (j < count) && !reader->error; j++) {
+        uint32_t code = extracted_metadata_read_varint(reader);
+        uint32_t id   = code >> 1;
+
+        if (code & 1) {
+          ExtractedObjectBoundingBox * prev = extracted_metadata_codec_find_box(codec, id);
+          int32_t dx                        = extracted_metadata_read_signed_varint(reader);
+          int32_t dy                        = extracted_metadata_read_signed_varint(reader);
+          int32_t dw                        = extracted_metadata_read_signed_varint(reader);
+          int32_t dh                        = extracted_metadata_read_signed_varint(reader);
+
+          if (!prev) {
+            *valid = 0;
+            continue;
+          }
+
+          extracted_object_bounding_box_list_add(list, id, prev->x + dx, prev->y + dy, prev->width + dw, prev->height + dh);
+        } else {
+          uint32_t x      = extracted_metadata_read_varint(reader);
+          uint32_t y      = extracted_metadata_read_varint(reader);
+          uint32_t width  = extracted_metadata_read_varint(reader);
+          uint32_t height = extracted_metadata_read_varint(reader);
+
+          extracted_object_bounding_box_list_add(list, id, x, y, width, height);
+        }
+      }
+
+      if (reader->error) {
+        extracted_metadata_free((ExtractedMetadata *) list);
+        break;
+      }
+
+      /* A list with missing boxes can not be the reference of the next one */
+      if (*valid) {
+        extracted_metadata_codec_set_boxes(codec, list);
+      } else {
+        codec->has_boxes = 0;
+      }
+
+      ret = (ExtractedMetadata *) list;
+      break;
+    }
+
+    default:
+      printf("extracted_metadata_codec_read_record: cant find the extracted metadata type !!!\n");
+      reader->error = 1;
+  }
+
+  if (reader->error) {
+    return NULL;
+  }
+
+  /* The frame numbers of the next records are only known if this one is */
+  codec->has_frame    = *valid;
+  codec->frame_number = frame_number;
+
+  return ret;
+}
+
+int extracted_metadata_codec_decode(ExtractedMetadataCodec * codec, const char * data, int size,
+                                    ExtractedMetadata ** metadata, int max_count)
+{
+  ExtractedMetadataReader reader;
+  int count = 0;
+
+  if ((size < 1) || ((unsigned char) data[0] != EXTRACTED_METADATA_CODEC_VERSION)) {
+    /* Not a container, it is a single serialized metadata */
+    ExtractedMetadata * ret = extracted_metadata_deserialize(data, size);
+
+    if (!ret) {
+      return 0;
+    }
+
+    if (max_count < 1) {
+      extracted_metadata_free(ret);
+      return 0;
+    }
+
+    metadata[0] = ret;
+    return 1;
+  }
+
+  reader.data  = (const unsigned char *) data + 1;
+  reader.size  = size - 1;
+  reader.error = 0;
+
+  /* A 0 type (or the end of the data) ends the container */
+  while ((reader.size > 0) && (*reader.data != 0)) {
+    unsigned char type  = *reader.data++;
+    ExtractedMetadata * record;
+    int valid;
+
+    reader.size--;
+    record = extracted_metadata_codec_read_record(codec, &reader, type, &valid);
+
+    if (!record) {
+      printf("extracted_metadata_codec_decode: invalid container !!!\n");
+      codec->has_frame = 0;
+      codec->has_boxes = 0;
+      break;
+    }
+
+    if (!valid) {
+      printf("extracted_metadata_codec_decode: discarding metadata coded on missing metadata !!!\n");
+      extracted_metadata_free(record);
+      continue;
+    }
+
+    if (count == max_count) {
+      extracted_metadata_free(record);
+      continue;
+    }
+
+    metadata[count++] = record;
+  }
+
+  return count;
+}
+
 /*
  *******************************
  * ExtractedMetadataBuffer API *
  *******************************
  */
 
-/* */
-static const short METADATA_BUFFER_MAX_INDEX  = 255; /* 2 ^ 8 = 0 <-> 255 = 0x000000FF */
+/* Initial number of entries, the buffer doubles when it is full */
+static const int METADATA_BUFFER_INITIAL_CAPACITY = 64;
 
-/* Lets use a always empty slot technique to implement the ringbuffer */
-static short extracted_metadata_buffer_get_next_index(short index)
+/* Index of the first entry (from first to size) with a frame number bigger (or equal if equal is set) than the given one */
+static int extracted_metadata_buffer_search(ExtractedMetadataBuffer * buffer, unsigned int frame_number, int equal)
 {
-  return (index + 1) & METADATA_BUFFER_MAX_INDEX;
+  int low  = buffer->first;
+  int high = buffer->size;
+
+  while (low < high) {
+    int middle       = (low + high) >> 1;
+    unsigned int key = buffer->entries[middle]->frame_number;
+
+    if ((key < frame_number) || (!equal && (key == frame_number))) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  return low;
 }
 
 
@@ -492,9 +1445,21 @@ ExtractedMetadataBuffer * extracted_metadata_buffer_new()
 {
   ExtractedMetadataBuffer * buffer = malloc(sizeof(ExtractedMetadataBuffer));
 
-  buffer->ringbuffer  = malloc(sizeof(ExtractedMetadata *) * (METADATA_BUFFER_MAX_INDEX + 1));
-  buffer->read_index  = 0;
-  buffer->write_index = 0;
+  if (!buffer) {
+    printf("extracted_metadata_buffer_new: ERROR ALLOCATING BUFFER !!!\n");
+    return NULL;
+  }
+
+  buffer->entries  = malloc(sizeof(ExtractedMetadata *) * METADATA_BUFFER_INITIAL_CAPACITY);
+  buffer->capacity = METADATA_BUFFER_INITIAL_CAPACITY;
+  buffer->first    = 0;
+  buffer->size     = 0;
+
+  if (!buffer->entries) {
+    printf("extracted_metadata_buffer_new: ERROR ALLOCATING ENTRIES !!!\n");
+    free(buffer);
+    return NULL;
+  }
 
   return buffer;
 }
@@ -502,57 +1467,71 @@ ExtractedMetadataBuffer * extracted_metadata_buffer_new()
 
 void extracted_metadata_buffer_add(ExtractedMetadataBuffer * buffer, ExtractedMetadata * obj)
 {
-  short new_write_index = extracted_metadata_buffer_get_next_index(buffer->write_index);
+  int index;
 
   if (!buffer || !obj) {
     printf("extracted_metadata_buffer_add: ERROR: NULL parameters given !!!\n");
     return;
   }
 
-  if (new_write_index == buffer->read_index) {
-    printf("extracted_metadata_buffer_add: ERROR: BUFFER OVERFLOW !!!\n");
-    return;
+  if (buffer->size == buffer->capacity) {
+    if (buffer->first > 0) {
+      /* The entries already taken leave room on the begin */
+      memmove(buffer->entries, buffer->entries + buffer->first, sizeof(ExtractedMetadata *) * (buffer->size - buffer->first));
+      buffer->size -= buffer->first;
+      buffer->first = 0;
+    } else {
+      ExtractedMetadata ** entries = realloc(buffer->entries, sizeof(ExtractedMetadata *) * buffer->capacity * 2);
+
+      if (!entries) {
+        printf("extracted_metadata_buffer_add: ERROR ALLOCATING ENTRIES, metadata frame_number[%u] lost !!!\n", obj->frame_number);
+        extracted_metadata_free(obj);
+        return;
+      }
+
+      buffer->entries   = entries;
+      buffer->capacity *= 2;
+    }
+  }
+
+  /* The entries are sorted by frame number, the metadata of the same frame stays on the order it came.
+     It comes almost always on the frame order, the search is only for the B frames. */
+  if ((buffer->size == buffer->first) || (buffer->entries[buffer->size - 1]->frame_number <= obj->frame_number)) {
+    index = buffer->size;
+  } else {
+    index = extracted_metadata_buffer_search(buffer, obj->frame_number, 0);
+    memmove(buffer->entries + index + 1, buffer->entries + index, sizeof(ExtractedMetadata *) * (buffer->size - index));
   }
 
-  buffer->ringbuffer[buffer->write_index] = obj;
-  buffer->write_index                     = new_write_index;
+  buffer->entries[index] = obj;
+  buffer->size++;
 }
 
 ExtractedMetadata * extracted_metadata_buffer_get(ExtractedMetadataBuffer * buffer, unsigned int frame_number)
 {
-  ExtractedMetadata * obj = NULL;
-
-  while (buffer->write_index != buffer->read_index) {
-
-    obj = buffer->ringbuffer[buffer->read_index];
+  int index = extracted_metadata_buffer_search(buffer, frame_number, 1);
 
-    if (frame_number < obj->frame_number) {
-      /* We have some metadata for the next frames, but no for this one */
-      return NULL;
-    }
- 
-    /* We are going to get or discard this metadata */
-    buffer->read_index = extracted_metadata_buffer_get_next_index(buffer->read_index);
+  /* The frames before this one have been written already, their metadata will never be used */
+  while (buffer->first < index) {
+    ExtractedMetadata * obj = buffer->entries[buffer->first++];
 
-    if (frame_number == obj->frame_number) {
-      return obj;
-    }
-
-    printf("extracted_metadata_buffer_get: discarding late metadata frame_number[%d]\n", obj->frame_number);    
+    printf("extracted_metadata_buffer_get: discarding late metadata frame_number[%d]\n", obj->frame_number);
     extracted_metadata_free(obj);
   }
 
+  if ((buffer->first < buffer->size) && (buffer->entries[buffer->first]->frame_number == frame_number)) {
+    return buffer->entries[buffer->first++];
+  }
+
   return NULL;
 }
 
 void extracted_metadata_buffer_free(ExtractedMetadataBuffer * buffer)
 {
-  while (buffer->write_index != buffer->read_index) {
-    extracted_metadata_free(buffer->ringbuffer[buffer->read_index]);
-    buffer->read_index = extracted_metadata_buffer_get_next_index(buffer->read_index);
+  while (buffer->first < buffer->size) {
+    extracted_metadata_free(buffer->entries[buffer->first++]);
   }
 
-  free(buffer->ringbuffer);
+  free(buffer->entries);
   free(buffer);
 }
-
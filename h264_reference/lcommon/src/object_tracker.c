@@ -0,0 +1,522 @@
+#include "object_tracker.h"
+
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define OBJECT_TRACKER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+
+/***********************
+ * Module private data *
+ ***********************/
+
+struct _ObjectTracker {
+  TrackedBoundigBox objects[OBJECT_TRACKER_MAX_OBJECTS];
+
+  /* Bit i is set if objects[i] is being tracked */
+  uint64_t live;
+
+  /* Size of the luma plane, the boxes are clipped to it */
+  int frame_width;
+  int frame_height;
+
+  /* Motion vectors of the blocks of one object, gathered to compute its robust motion estimate */
+  short * samples_x;
+  short * samples_y;
+  int samples_capacity;
+};
+
+
+/* Fraction of the motion vectors discarded on each side (smallest/biggest) when estimating the object motion.
+   The vectors of the background blocks inside the box and the bad ME matches do not skew the estimate. */
+static const int MOTION_TRIM_DIVISOR = 4;
+
+/* The motion vectors are on QPEL units (Quarter Pel refinement). To get the block real movement we must divide by 4 */
+static const double QPEL_UNIT = 4.0f;
+
+/* The vectors scaled to one frame distance keep this many fractions of QPEL (1/16 pel) */
+static const int MOTION_SAMPLE_SCALE = 4;
+
+/* Block size is 4x4. (see lencod/inc/defines.h) */
+static const int BLOCK_SIZE = 4;
+
+
+/*!
+ *************************************************************************************
+ * \brief
+ *    Function body for the object tracker new.
+ *
+ *
+ *************************************************************************************
+ */
+ObjectTracker * object_tracker_new(int frame_width, int frame_height)
+{
+  ObjectTracker * tracker = calloc(1, sizeof(ObjectTracker));
+
+  if (!tracker) {
+    printf("object_tracker_new: Error allocating ObjectTracker !!!\n");
+    return NULL;
+  }
+
+  tracker->frame_width  = frame_width;
+  tracker->frame_height = frame_height;
+
+  /* An object may cover the whole frame */
+  tracker->samples_capacity = ((frame_width + BLOCK_SIZE - 1) / BLOCK_SIZE + 1) *
+                              ((frame_height + BLOCK_SIZE - 1) / BLOCK_SIZE + 1);
+  tracker->samples_x        = malloc(sizeof(short) * tracker->samples_capacity);
+  tracker->samples_y        = malloc(sizeof(short) * tracker->samples_capacity);
+
+  if (!tracker->samples_x || !tracker->samples_y) {
+    printf("object_tracker_new: Error allocating the motion samples !!!\n");
+    object_tracker_free(tracker);
+    return NULL;
+  }
+
+  return tracker;
+}
+
+void object_tracker_free(ObjectTracker * tracker)
+{
+  free(tracker->samples_x);
+  free(tracker->samples_y);
+  free(tracker);
+}
+
+uint64_t object_tracker_get_live(ObjectTracker * tracker)
+{
+  return tracker->live;
+}
+
+TrackedBoundigBox * object_tracker_get_object(ObjectTracker * tracker, int slot)
+{
+  return &tracker->objects[slot];
+}
+
+void object_tracker_update(ObjectTracker * tracker, int slot, unsigned int frame, int x, int y, int width, int height)
+{
+  TrackedBoundigBox * box = &tracker->objects[slot];
+
+  box->frame          = frame;
+  box->x              = x;
+  box->y              = y;
+  box->width          = width;
+  box->height         = height;
+  box->motion_x       = 0;
+  box->motion_y       = 0;
+  box->motion_samples = 0;
+}
+
+int object_tracker_add(ObjectTracker * tracker, unsigned int id, unsigned int frame, int x, int y, int width, int height)
+{
+  TrackedBoundigBox * obj = NULL;
+  int slot;
+
+  if (tracker->live == ~0ULL) {
+    printf("object_tracker_add: can not track more than [%d] objects !!!\n", OBJECT_TRACKER_MAX_OBJECTS);
+    return -1;
+  }
+
+  slot = __builtin_ctzll(~tracker->live);
+  obj  = &tracker->objects[slot];
+
+  obj->id         = id;
+  obj->velocity_x = 0;
+  obj->velocity_y = 0;
+  object_tracker_update(tracker, slot, frame, x, y, width, height);
+
+  tracker->live |= 1ULL << slot;
+  return slot;
+}
+
+void object_tracker_remove(ObjectTracker * tracker, int slot)
+{
+  tracker->live &= ~(1ULL << slot);
+}
+
+/* Moves the object with the id of the box, adding it if it is not tracked. Returns the slot used or -1. */
+static int object_tracker_sync_box(ObjectTracker * tracker, unsigned int frame, ExtractedObjectBoundingBox * box)
+{
+  uint64_t live = tracker->live;
+  unsigned int id;
+  int x, y, width, height;
+
+  extracted_object_bounding_box_get_data(box, &id, &x, &y, &width, &height);
+
+  while (live) {
+    int slot = __builtin_ctzll(live);
+
+    live &= live - 1;
+
+    if (tracker->objects[slot].id == id) {
+      object_tracker_update(tracker, slot, frame, x, y, width, height);
+      return slot;
+    }
+  }
+
+  return object_tracker_add(tracker, id, frame, x, y, width, height);
+}
+
+void object_tracker_sync(ObjectTracker * tracker, ExtractedMetadata * metadata)
+{
+  ExtractedObjectBoundingBox * box      = extracted_object_bounding_box_from_metadata(metadata);
+  ExtractedObjectBoundingBoxList * list = extracted_object_bounding_box_list_from_metadata(metadata);
+  unsigned int frame                    = extracted_metadata_get_frame_number(metadata);
+  uint64_t synced                       = 0;
+  int slot, i;
+
+  if (!box && !list) {
+    return;
+  }
+
+  /* The velocities take the motion gathered so far, the objects not moved by the metadata keep going from there */
+  object_tracker_estimate_motion(tracker, frame);
+
+  if (box) {
+    slot = object_tracker_sync_box(tracker, frame, box);
+    synced |= (slot >= 0) ? 1ULL << slot : 0;
+  } else {
+    for (i = 0; i < extracted_object_bounding_box_list_get_size(list); i++) {
+      slot = object_tracker_sync_box(tracker, frame, extracted_object_bounding_box_list_get_box(list, i));
+      synced |= (slot >= 0) ? 1ULL << slot : 0;
+    }
+  }
+
+  /* The objects that are not on the metadata are gone */
+  tracker->live &= synced;
+}
+
+
+/*****************************
+ * Motion vector facilities *
+ *****************************/
+
+/* Partitions the samples so samples[k] is the value it would have if they were sorted,
+   the smaller values before it and the bigger after it (quickselect) */
+static void motion_vector_select(short * samples, int count, int k)
+{
+  int left  = 0;
+  int right = count - 1;
+
+  while (left < right) {
+    short pivot = samples[(left + right) / 2];
+    int i       = left;
+    int j       = right;
+
+    while (i <= j) {
+      while (samples[i] < pivot) {
+        i++;
+      }
+
+      while (samples[j] > pivot) {
+        j--;
+      }
+
+      if (i <= j) {
+        short tmp  = samples[i];
+        samples[i] = samples[j];
+        samples[j] = tmp;
+        i++;
+        j--;
+      }
+    }
+
+    if (k <= j) {
+      right = j;
+    } else if (k >= i) {
+      left = i;
+    } else {
+      return;
+    }
+  }
+}
+
+static short motion_vector_clip(int value)
+{
+  if (value > SHRT_MAX) {
+    return SHRT_MAX;
+  }
+
+  return (value < SHRT_MIN) ? SHRT_MIN : value;
+}
+
+/* The POC distance of a reference picture, 0 if it is unknown */
+static int motion_vector_field_poc_distance(const MotionVectorField * field, const void * picture)
+{
+  int i;
+
+  for (i = 0; i < field->reference_count; i++) {
+    if (field->references[i].picture == picture) {
+      return field->references[i].poc_distance;
+    }
+  }
+
+  return 0;
+}
+
+/* Gets the motion of the block on one frame distance (in QPEL / MOTION_SAMPLE_SCALE units).
+   Vectors pointing to a future reference are inverted, the bi-predicted blocks use the mean of both lists.
+   Returns 0 if the block has no usable vector (intra blocks). */
+static int motion_vector_field_block_sample(const MotionVectorField * field, const unsigned char * block, short * x, short * y)
+{
+  int sum_x = 0;
+  int sum_y = 0;
+  int lists = 0;
+  int list;
+
+  for (list = 0; list < 2; list++) {
+    const short * mv = (const short *) (block + field->mv_offset[list]);
+    int poc_distance;
+
+    if (*((const signed char *) (block + field->ref_idx_offset[list])) < 0) {
+      continue;
+    }
+
+    poc_distance = motion_vector_field_poc_distance(field, *((const void * const *) (block + field->ref_pic_offset[list])));
+
+    if (!poc_distance) {
+      continue;
+    }
+
+    /* The vector points from the block to where it was on the reference, the distance sign takes care of the direction */
+    sum_x += mv[0] * MOTION_SAMPLE_SCALE * field->frame_poc_distance / poc_distance;
+    sum_y += mv[1] * MOTION_SAMPLE_SCALE * field->frame_poc_distance / poc_distance;
+    lists++;
+  }
+
+  if (!lists) {
+    return 0;
+  }
+
+  *x = motion_vector_clip(sum_x / lists);
+  *y = motion_vector_clip(sum_y / lists);
+  return 1;
+}
+
+static long long motion_vector_sum(const short * samples, int count)
+{
+  long long sum = 0;
+  int i         = 0;
+
+#ifdef OBJECT_TRACKER_SSE2
+  /* 8 vectors per iteration, the 32 bits lanes are flushed before they can overflow */
+  const __m128i ones = _mm_set1_epi16(1);
+
+  while (i + 8 <= count) {
+    __m128i acc = _mm_setzero_si128();
+    int end     = i + 8 * 16384;
+    int lanes[4];
+
+    if (end > count) {
+      end = count;
+    }
+
+    for (; i + 8 <= end; i += 8) {
+      acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_loadu_si128((const __m128i *) (samples + i)), ones));
+    }
+
+    _mm_storeu_si128((__m128i *) lanes, acc);
+    sum += (long long) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  }
+#endif
+
+  for (; i < count; i++) {
+    sum += samples[i];
+  }
+
+  return sum;
+}
+
+/* Sum of the samples without the smallest and biggest ones (the interquartile mean times the returned count).
+   The samples are reordered. */
+static long long motion_vector_trimmed_sum(short * samples, int count, int * used)
+{
+  int trim = count / MOTION_TRIM_DIVISOR;
+
+  if (trim > 0) {
+    motion_vector_select(samples, count, trim);
+    motion_vector_select(samples + trim, count - trim, count - 2 * trim - 1);
+  }
+
+  *used = count - 2 * trim;
+  return motion_vector_sum(samples + trim, *used);
+}
+
+/* Range of blocks of the field overlapping the object, a block belongs to the object if any of its corners is inside
+   the box. Returns 0 if no block of the field overlaps the object. */
+static int tracked_bounding_box_block_range(TrackedBoundigBox * obj, const MotionVectorField * field,
+                                            int * first_x, int * first_y, int * last_x, int * last_y)
+{
+  *first_x = ceil((obj->x - BLOCK_SIZE) / BLOCK_SIZE);
+  *first_y = ceil((obj->y - BLOCK_SIZE) / BLOCK_SIZE);
+  *last_x  = floor((obj->x + obj->width) / BLOCK_SIZE);
+  *last_y  = floor((obj->y + obj->height) / BLOCK_SIZE);
+
+  if (*first_x < 0) {
+    *first_x = 0;
+  }
+
+  if (*first_y < 0) {
+    *first_y = 0;
+  }
+
+  if (*last_x >= field->width) {
+    *last_x = field->width - 1;
+  }
+
+  if (*last_y >= field->height) {
+    *last_y = field->height - 1;
+  }
+
+  return (*first_x <= *last_x) && (*first_y <= *last_y);
+}
+
+void object_tracker_add_motion_vector_field(ObjectTracker * tracker, const MotionVectorField * field)
+{
+  uint64_t live = tracker->live;
+
+  /* Only the blocks overlapping the tracked objects are read. There is no spatial index from the blocks to the
+     objects: each object walks the block range of its own box, so the cost is the number of blocks the boxes cover
+     and does not grow with the blocks of the picture times the number of objects. The index paid off when every
+     block of the picture was routed to its objects, one call per block. */
+  while (live) {
+    TrackedBoundigBox * obj = &tracker->objects[__builtin_ctzll(live)];
+    int first_x, first_y, last_x, last_y;
+    int blk_x, blk_y;
+    int count = 0;
+    int used_x, used_y;
+    long long sum_x, sum_y;
+
+    live &= live - 1;
+
+    if (!tracked_bounding_box_block_range(obj, field, &first_x, &first_y, &last_x, &last_y)) {
+      /* The object left the frame */
+      continue;
+    }
+
+    if ((last_x - first_x + 1) * (last_y - first_y + 1) > tracker->samples_capacity) {
+      printf("object_tracker_add_motion_vector_field: field bigger than the frame !!!\n");
+      continue;
+    }
+
+    for (blk_y = first_y; blk_y <= last_y; blk_y++) {
+      const unsigned char * block = field->blocks + blk_y * field->row_stride + first_x * field->block_stride;
+
+      for (blk_x = first_x; blk_x <= last_x; blk_x++) {
+        count += motion_vector_field_block_sample(field, block, &tracker->samples_x[count], &tracker->samples_y[count]);
+        block += field->block_stride;
+      }
+    }
+
+    if (!count) {
+      /* No motion information about the object (intra coded) */
+      continue;
+    }
+
+    /* One robust vector to the entire object, the estimation is accumulated just like the samples */
+    sum_x = motion_vector_trimmed_sum(tracker->samples_x, count, &used_x);
+    sum_y = motion_vector_trimmed_sum(tracker->samples_y, count, &used_y);
+
+    obj->motion_x       += sum_x;
+    obj->motion_y       += sum_y;
+    obj->motion_samples += used_x;
+  }
+}
+
+/* Clips the object to the frame. Returns 0 if nothing of it is left inside. */
+static int tracked_bounding_box_clip(ObjectTracker * tracker, TrackedBoundigBox * obj)
+{
+  double right  = obj->x + obj->width;
+  double bottom = obj->y + obj->height;
+
+  if (obj->x < 0) {
+    obj->x = 0;
+  }
+
+  if (obj->y < 0) {
+    obj->y = 0;
+  }
+
+  if (right > tracker->frame_width) {
+    right = tracker->frame_width;
+  }
+
+  if (bottom > tracker->frame_height) {
+    bottom = tracker->frame_height;
+  }
+
+  if ((right - obj->x < 1) || (bottom - obj->y < 1)) {
+    return 0;
+  }
+
+  obj->width  = (short) (right - obj->x);
+  obj->height = (short) (bottom - obj->y);
+  return 1;
+}
+
+void object_tracker_estimate_motion(ObjectTracker * tracker, unsigned int frame)
+{
+  uint64_t live = tracker->live;
+
+  while (live) {
+    int slot                = __builtin_ctzll(live);
+    TrackedBoundigBox * obj = &tracker->objects[slot];
+    int frames;
+
+    live &= live - 1;
+
+    if (obj->motion_samples > 0) {
+      /* The mean of the vectors kept by the trimming (see object_tracker_add_motion_vector_field).
+         Dont want to lose precision (accumulated movement) on the integer division */
+      obj->velocity_x = ((double) obj->motion_x / (QPEL_UNIT * MOTION_SAMPLE_SCALE)) / (double) obj->motion_samples;
+      obj->velocity_y = ((double) obj->motion_y / (QPEL_UNIT * MOTION_SAMPLE_SCALE)) / (double) obj->motion_samples;
+
+      obj->motion_x       = 0;
+      obj->motion_y       = 0;
+      obj->motion_samples = 0;
+    }
+
+    /* Signed display order distance, a B picture may be before the frame of the position */
+    frames      = (int) (frame - obj->frame);
+    obj->x     -= obj->velocity_x * frames;
+    obj->y     -= obj->velocity_y * frames;
+    obj->frame  = frame;
+
+    /* The next estimation starts from the clipped box, the velocity is not extrapolated outside of the frame.
+       The objects that left the frame are gone. */
+    if (!tracked_bounding_box_clip(tracker, obj)) {
+      object_tracker_remove(tracker, slot);
+    }
+  }
+}
+
+ExtractedMetadata * object_tracker_get_metadata(ObjectTracker * tracker, unsigned int frame_number)
+{
+  ExtractedObjectBoundingBoxList * list = NULL;
+  uint64_t live                         = tracker->live;
+
+  if (!live) {
+    return NULL;
+  }
+
+  list = extracted_object_bounding_box_list_new(frame_number);
+
+  while (live) {
+    TrackedBoundigBox box = tracker->objects[__builtin_ctzll(live)];
+
+    live &= live - 1;
+
+    /* Only the part of the object inside of the frame is exported */
+    if (tracked_bounding_box_clip(tracker, &box)) {
+      extracted_object_bounding_box_list_add(list, box.id, box.x, box.y, box.width, box.height);
+    }
+  }
+
+  return (ExtractedMetadata *) list;
+}
@@ -47,6 +47,11 @@ Mapping Map[] = {
     {"Silent",                   &cfgparams.silent,                       0,   0.0,                       1,  0.0,              1.0,                             },
     {"IntraProfileDeblocking",   &cfgparams.intra_profile_deblocking,     0,   1.0,                       1,  0.0,              1.0,                             },
     {"DecFrmNum",                &cfgparams.iDecFrmNum,                   0,   0.0,                       2,  0.0,              0.0,                             },
+    {"ObjectTracking",           &cfgparams.object_tracking,              0,   0.0,                       1,  0.0,              1.0,                             },
+    {"OverlayOpacity",           &cfgparams.overlay_opacity,              0,   100.0,                     1,  0.0,              100.0,                           },
+    {"MetadataIndexFile",        &cfgparams.metadata_index_file,          1,   0.0,                       0,  0.0,              0.0,             FILE_NAME_SIZE, },
+    {"MetadataJsonFile",         &cfgparams.metadata_json_file,           1,   0.0,                       0,  0.0,              0.0,             FILE_NAME_SIZE, },
+    {"MetadataOnly",             &cfgparams.metadata_only,                0,   0.0,                       1,  0.0,              2.0,                             },
 #if (MVC_EXTENSION_ENABLE)
     {"DecodeAllLayers",          &cfgparams.DecodeAllLayers,              0,   0.0,                       1,  0.0,              1.0,                             },
 #endif
@@ -836,6 +836,24 @@ typedef struct video_par
 
   /* KATCIPIS - metadata buffer. */
   ExtractedMetadataBuffer * metadata_buffer;
+
+  /* KATCIPIS - dispatches the user data SEI messages by their uuid. */
+  struct _UserDataParser * user_data_parser;
+  ExtractedMetadataCodec * metadata_codec;
+
+  /* KATCIPIS - the metadata frame numbers restart from the next one on each IDR picture. */
+  unsigned int metadata_idr_frame;
+  unsigned int metadata_next_frame;
+  int metadata_idr_field;
+
+  /* KATCIPIS - tracks the objects of the metadata on the pictures without it. */
+  struct object_tracking * object_tracking;
+
+  /* KATCIPIS - draws the bounding boxes on the output. */
+  struct overlay * overlay;
+
+  /* KATCIPIS - exports the metadata of the output pictures. */
+  struct metadata_sidecar * metadata_sidecar;
 } VideoParameters;
 
 // signal to noise ratio parameters
@@ -849,6 +867,13 @@ typedef struct snr_par
   float msse[3];                                //!< Average component SSE 
 } SNRParameters;
 
+/* KATCIPIS - what is done when only the metadata is exported */
+typedef enum {
+  METADATA_ONLY_OFF    = 0,                 //!< the pictures are decoded and written
+  METADATA_ONLY_OUTPUT = 1,                 //!< the pictures are decoded but not written
+  METADATA_ONLY_SCAN   = 2                  //!< only the headers and the SEIs are parsed, the macroblocks are not decoded
+} MetadataOnlyMode;
+
 // input parameters from configuration file
 typedef struct inp_par
 {
@@ -900,6 +925,12 @@ typedef struct inp_par
   int iDecFrmNum;
 
   int bDisplayDecParams;
+
+  int object_tracking;                  //!< KATCIPIS - track the objects of the metadata with the motion vectors
+  int overlay_opacity;                  //!< KATCIPIS - opacity (percent) of the bounding boxes drawn on the output
+  char metadata_index_file[FILE_NAME_SIZE];   //!< KATCIPIS - binary index of the metadata of the output pictures
+  char metadata_json_file[FILE_NAME_SIZE];    //!< KATCIPIS - JSON lines of the metadata of the output pictures
+  int metadata_only;                    //!< KATCIPIS - only the metadata is exported (MetadataOnlyMode)
 } InputParameters;
 
 typedef struct old_slice_par
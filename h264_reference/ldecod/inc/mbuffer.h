@@ -53,6 +53,7 @@ typedef struct storable_picture
   int         frame_poc;
   unsigned int  frame_num;
   unsigned int  recovery_frame;
+  unsigned int  metadata_frame;  //!< KATCIPIS - display order frame number, the frame number of the metadata of the picture
 
   int         pic_num;
   int         long_term_pic_num;
@@ -0,0 +1,76 @@
+/*!
+ ************************************************************************
+ *  \file
+ *     metadata_sidecar.h
+ *  \brief
+ *     definitions for the export of the decoded metadata to sidecar files.
+ *     The bounding boxes of each output picture are written on a binary
+ *     index of fixed size records and, optionally, on a JSON lines file.
+ *
+ *     The index starts with a header: the magic "EMIX", the version and
+ *     the record size, as 32 bits little endian integers. Each record has
+ *     seven 32 bits little endian integers: frame, POC, id, x, y, width
+ *     and height.
+ *  \author(s)
+ *      - Tiago Katcipis                             <tiagokatcipis@gmail.com>
+ *
+ * ************************************************************************
+ */
+
+#ifndef METADATA_SIDECAR_H
+#define METADATA_SIDECAR_H
+
+#include "extracted_metadata.h"
+
+#define METADATA_SIDECAR_VERSION     1
+#define METADATA_SIDECAR_RECORD_SIZE 28
+
+typedef struct metadata_sidecar MetadataSidecar;
+
+/*!
+ *******************************************************************************
+ * Creates a new MetadataSidecar, the files are created (truncated).
+ *
+ * @param index_file The binary index file name, NULL or empty for none.
+ * @param json_file The JSON lines file name, NULL or empty for none.
+ * @return The MetadataSidecar object or NULL in case of error.
+ *
+ *******************************************************************************
+ */
+MetadataSidecar * metadata_sidecar_new(const char * index_file, const char * json_file);
+
+/*!
+ *******************************************************************************
+ * Writes the boxes of a bounding box metadata (a single box or a list), other
+ * metadata types are ignored. The writes are buffered.
+ *
+ * @param sidecar The MetadataSidecar object.
+ * @param metadata The metadata.
+ * @param poc The picture order count of the picture the metadata belongs.
+ *
+ *******************************************************************************
+ */
+void metadata_sidecar_write(MetadataSidecar * sidecar, ExtractedMetadata * metadata, int poc);
+
+/*!
+ *******************************************************************************
+ * Gets the number of boxes written.
+ *
+ * @param sidecar The MetadataSidecar object.
+ * @return The number of boxes.
+ *
+ *******************************************************************************
+ */
+unsigned int metadata_sidecar_get_count(MetadataSidecar * sidecar);
+
+/*!
+ *******************************************************************************
+ * Flushes the buffered records, closes the files and frees a MetadataSidecar.
+ *
+ * @param sidecar The MetadataSidecar object.
+ *
+ *******************************************************************************
+ */
+void metadata_sidecar_free(MetadataSidecar * sidecar);
+
+#endif
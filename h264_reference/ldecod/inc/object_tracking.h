@@ -0,0 +1,76 @@
+/*!
+ ************************************************************************
+ *  \file
+ *     object_tracking.h
+ *  \brief
+ *     definitions for the decoder side object tracking. The bounding boxes
+ *     received on the metadata SEIs are moved with the decoded motion vectors
+ *     on the pictures that do not carry them.
+ *  \author(s)
+ *      - Tiago Katcipis                             <tiagokatcipis@gmail.com>
+ *
+ * ************************************************************************
+ */
+
+#ifndef OBJECT_TRACKING_H
+#define OBJECT_TRACKING_H
+
+#include "global.h"
+#include "mbuffer.h"
+
+typedef struct object_tracking ObjectTracking;
+
+/*!
+ *******************************************************************************
+ * Takes a received bounding box metadata, it replaces the tracked objects when
+ * the next picture starts and then it is added to the metadata buffer. The SEIs
+ * of a picture are parsed before the previous picture is finished, this keeps
+ * the buffer on the picture order.
+ *
+ * @param p_Vid The VideoParameters.
+ * @param metadata The received metadata.
+ * @return 1 if the metadata has been taken, 0 if it is not a bounding box
+ *         metadata or the object tracking is disabled.
+ *
+ *******************************************************************************
+ */
+int object_tracking_receive_metadata(VideoParameters *p_Vid, ExtractedMetadata * metadata);
+
+/*!
+ *******************************************************************************
+ * Starts a new picture, the bounding boxes received since the last picture
+ * (the SEIs of the access unit of the picture) replace the tracked objects
+ * and are added to the metadata buffer.
+ *
+ * @param p_Vid The VideoParameters.
+ *
+ *******************************************************************************
+ */
+void object_tracking_init_picture(VideoParameters *p_Vid);
+
+/*!
+ *******************************************************************************
+ * Moves the tracked objects by the motion of the previous picture and, if the
+ * picture did not carry its bounding boxes, adds them to the metadata buffer.
+ * Then the motion vectors of the picture are gathered for the next one.
+ * Must be called before the picture is stored on the DPB (it may be written
+ * right away).
+ *
+ * @param p_Vid The VideoParameters.
+ * @param p The decoded picture.
+ *
+ *******************************************************************************
+ */
+void object_tracking_exit_picture(VideoParameters *p_Vid, StorablePicture *p);
+
+/*!
+ *******************************************************************************
+ * Frees the object tracking resources.
+ *
+ * @param p_Vid The VideoParameters.
+ *
+ *******************************************************************************
+ */
+void object_tracking_free(VideoParameters *p_Vid);
+
+#endif
@@ -0,0 +1,101 @@
+/*!
+ ************************************************************************
+ *  \file
+ *     overlay.h
+ *  \brief
+ *     definitions for the bounding box overlay of the decoded pictures.
+ *     All the boxes of a picture are gathered and then drawn on each
+ *     output plane at once, only the rows of the borders are touched.
+ *  \author(s)
+ *      - Tiago Katcipis                             <tiagokatcipis@gmail.com>
+ *
+ * ************************************************************************
+ */
+
+#ifndef OVERLAY_H
+#define OVERLAY_H
+
+#include "extracted_metadata.h"
+
+/* Opacity of the overlay when it is not blended */
+#define OVERLAY_OPAQUE 256
+
+typedef struct overlay Overlay;
+
+/*!
+ *******************************************************************************
+ * Creates a new Overlay.
+ *
+ * @param alpha Opacity of the borders, from 0 (invisible) to OVERLAY_OPAQUE.
+ * @return The Overlay object or NULL in case of error.
+ *
+ *******************************************************************************
+ */
+Overlay * overlay_new(int alpha);
+
+/*!
+ *******************************************************************************
+ * Frees a Overlay.
+ *
+ * @param overlay The Overlay object.
+ *
+ *******************************************************************************
+ */
+void overlay_free(Overlay * overlay);
+
+/*!
+ *******************************************************************************
+ * Removes all the boxes, to start a new picture.
+ *
+ * @param overlay The Overlay object.
+ *
+ *******************************************************************************
+ */
+void overlay_clear(Overlay * overlay);
+
+/*!
+ *******************************************************************************
+ * Adds the boxes of a bounding box metadata (a single box or a list), other
+ * metadata types are ignored. The boxes are copied.
+ *
+ * @param overlay The Overlay object.
+ * @param metadata The metadata.
+ *
+ *******************************************************************************
+ */
+void overlay_add_metadata(Overlay * overlay, ExtractedMetadata * metadata);
+
+/*!
+ *******************************************************************************
+ * Gets the number of boxes of the picture.
+ *
+ * @param overlay The Overlay object.
+ * @return The number of boxes.
+ *
+ *******************************************************************************
+ */
+int overlay_get_size(Overlay * overlay);
+
+/*!
+ *******************************************************************************
+ * Draws the boxes on a 8 bits plane, the boxes are clipped to the plane.
+ * When the borders are blended, the samples where boxes overlap are blended
+ * once.
+ *
+ * @param overlay The Overlay object.
+ * @param plane The plane samples.
+ * @param width The width of the plane.
+ * @param height The height of the plane.
+ * @param stride The distance in bytes between two rows.
+ * @param left Columns of the plane cropped on the left.
+ * @param top Rows of the plane cropped on the top.
+ * @param shift_x Horizontal subsampling of the plane (1 for 4:2:0 and 4:2:2 chroma).
+ * @param shift_y Vertical subsampling of the plane (1 for 4:2:0 chroma).
+ * @param component 0 for Y, 1 for U and 2 for V.
+ *
+ *******************************************************************************
+ */
+void overlay_render_plane(Overlay * overlay, unsigned char * plane, int width, int height, int stride,
+                          int left, int top, int shift_x, int shift_y, int component);
+
+#endif
@@ -15,6 +15,15 @@
 
 #include "typedefs.h"
 
+typedef struct _UserDataParser UserDataParser;
+
+/* Receives the data (without the uuid) of a user data unregistered SEI message, the data is not a copy of
+   the payload, it is only valid during the call. */
+typedef void (*UserDataHandler) (byte * data, int size, void * context);
+
+/* Max number of uuids a UserDataParser can handle */
+#define USER_DATA_PARSER_MAX_HANDLERS 8
+
 /*!
  *******************************************************************************
  * Parses a SEI User Data Unregistered message and dumps all its data at stdout.
@@ -42,4 +51,55 @@ void user_data_parser_unregistered_sei_dump(byte* payload, int size);
  */
 void user_data_parser_unregistered_sei_get_data(byte* payload, int size, byte ** outdata, int * outsize);
 
+/*!
+ *******************************************************************************
+ * Creates a new UserDataParser, it dispatches the User Data Unregistered
+ * messages to the handler registered for its uuid_iso_iec_11578.
+ *
+ * @return The UserDataParser object or NULL in case of error.
+ *
+ *******************************************************************************
+ */
+UserDataParser * user_data_parser_new();
+
+/*!
+ *******************************************************************************
+ * Frees a UserDataParser.
+ *
+ * @param parser The UserDataParser object.
+ *
+ *******************************************************************************
+ */
+void user_data_parser_free(UserDataParser * parser);
+
+/*!
+ *******************************************************************************
+ * Registers the handler of the messages with the given uuid_iso_iec_11578.
+ *
+ * @param parser The UserDataParser object.
+ * @param uuid The 16 bytes uuid, it is copied.
+ * @param handler The function that receives the data of the messages.
+ * @param context Passed to the handler.
+ * @return 1 on success, 0 if the uuid is already registered or there is no
+ *         room for another handler.
+ *
+ *******************************************************************************
+ */
+int user_data_parser_register_handler(UserDataParser * parser, const byte * uuid, UserDataHandler handler, void * context);
+
+/*!
+ *******************************************************************************
+ * Hands the data of a SEI User Data Unregistered message to the handler of its
+ * uuid_iso_iec_11578. Messages without a handler (from other muxers) are
+ * skipped, only the uuid is read.
+ *
+ * @param parser The UserDataParser object.
+ * @param payload The payload of the SEI message.
+ * @param size The size of the payload.
+ * @return 1 if the message has been handled, 0 if it has been skipped.
+ *
+ *******************************************************************************
+ */
+int user_data_parser_unregistered_sei_dispatch(UserDataParser * parser, byte* payload, int size);
+
 #endif
@@ -59,6 +59,7 @@
 #include "fast_memory.h"
 
 #include "mc_prediction.h"
+#include "object_tracking.h"
 extern int testEndian(void);
 void reorder_lists(Slice *currSlice);
 
@@ -119,6 +120,10 @@ static void init_picture(VideoParameters *p_Vid, Slice *currSlice, InputParamete
     // this may only happen on slice loss
     exit_picture(p_Vid, &p_Vid->dec_picture);
   }
+
+  /* KATCIPIS - the metadata received since the last picture belongs to this one */
+  object_tracking_init_picture(p_Vid);
+
   if (p_Vid->recovery_point)
     p_Vid->recovery_frame_num = (currSlice->frame_num + p_Vid->recovery_frame_cnt) % p_Vid->MaxFrameNum;
 
@@ -885,12 +890,18 @@ int decode_one_frame(DecoderParams *pDecoder)
 				assert(currSlice->current_slice_nr == iSliceNo);
 		    
 				init_slice(p_Vid, currSlice);
-				decode_slice(currSlice, current_header);
+
+				/* KATCIPIS - the scan only needs the headers and the SEIs, the macroblocks are not decoded */
+				if (p_Inp->metadata_only != METADATA_ONLY_SCAN)
+					decode_slice(currSlice, current_header);
 
 				p_Vid->iNumOfSlicesDecoded++;
 				p_Vid->num_dec_mb += currSlice->num_dec_mb;
 				p_Vid->erc_mvperMB += currSlice->erc_mvperMB;
 			}
+
+			if (p_Inp->metadata_only == METADATA_ONLY_SCAN)
+				p_Vid->num_dec_mb = p_Vid->PicSizeInMbs;
 	  }
 	  exit_picture(p_Vid, &p_Vid->dec_picture);
   p_Vid->previous_frame_num = ppSliceList[0]->frame_num;
@@ -1774,6 +1785,37 @@ void pad_dec_picture(VideoParameters *p_Vid, StorablePicture *dec_picture)
   }
 }
 
+/*!
+ ************************************************************************
+ * \brief
+ *    Sets the display order frame number of the picture, the metadata 
+ *    of the picture has it. The POC restarts on each IDR picture, the
+ *    frame numbers go on from the biggest one so far. The encoder 
+ *    numbers its frames the same way, the POCScale of the decoder 
+ *    does not change them. (KATCIPIS)
+ ************************************************************************
+ */
+static void set_metadata_frame(VideoParameters *p_Vid, StorablePicture *p)
+{
+  /* Both fields of a IDR frame may be IDR, only the first one restarts the frame numbers */
+  int restart = p->idr_flag && !p_Vid->metadata_idr_field;
+
+  if (restart)
+  {
+    p_Vid->metadata_idr_frame = p_Vid->metadata_next_frame;
+  }
+
+  p_Vid->metadata_idr_field = restart && (p->structure != FRAME);
+
+  /* The two fields of a frame have the same frame number */
+  p->metadata_frame = p_Vid->metadata_idr_frame + imax(p->poc, 0) / EXTRACTED_METADATA_FRAME_POC_DISTANCE;
+
+  if (p->metadata_frame >= p_Vid->metadata_next_frame)
+  {
+    p_Vid->metadata_next_frame = p->metadata_frame + 1;
+  }
+}
+
 /*!
  ************************************************************************
  * \brief
@@ -1793,6 +1835,8 @@ void exit_picture(VideoParameters *p_Vid, StorablePicture **dec_picture)
 
   int64 tmp_time;                   // time used by decoding the last frame
   char   yuvFormat[10];
+  /* KATCIPIS - the samples of a scanned picture are not decoded, they are not post processed */
+  int scan = (p_Inp->metadata_only == METADATA_ONLY_SCAN);
 
 
   // return if the last picture has already been finished
@@ -1815,7 +1859,7 @@ void exit_picture(VideoParameters *p_Vid, StorablePicture **dec_picture)
 
   //! mark the start of the first segment
 #if (DISABLE_ERC == 0)
-  if (!(*dec_picture)->mb_aff_frame_flag)
+  if (!scan && !(*dec_picture)->mb_aff_frame_flag)
   {
     int i;
     ercStartSegment(0, ercSegment, 0 , p_Vid->erc_errorVar);
@@ -1856,7 +1900,7 @@ void exit_picture(VideoParameters *p_Vid, StorablePicture **dec_picture)
   }
 #endif
 
-  if(!p_Vid->iDeblockMode && (p_Vid->bDeblockEnable & (1<<(*dec_picture)->used_for_reference)))
+  if(!scan && !p_Vid->iDeblockMode && (p_Vid->bDeblockEnable & (1<<(*dec_picture)->used_for_reference)))
   {
     //deblocking for frame or field
     if( (p_Vid->separate_colour_plane_flag != 0) )
@@ -1885,7 +1929,7 @@ void exit_picture(VideoParameters *p_Vid, StorablePicture **dec_picture)
     }
   }
 
-  if ((*dec_picture)->mb_aff_frame_flag)
+  if (!scan && (*dec_picture)->mb_aff_frame_flag)
     MbAffPostProc(p_Vid);
 
   if (p_Vid->structure == FRAME)         // buffer mgt. for frame mode
@@ -1893,10 +1937,10 @@ void exit_picture(VideoParameters *p_Vid, StorablePicture **dec_picture)
   else
     field_postprocessing(p_Vid);   // reset all interlaced variables
 #if (MVC_EXTENSION_ENABLE)
-  if((*dec_picture)->used_for_reference || ((*dec_picture)->inter_view_flag == 1))
+  if(!scan && ((*dec_picture)->used_for_reference || ((*dec_picture)->inter_view_flag == 1)))
     pad_dec_picture(p_Vid, *dec_picture);
 #else
-  if((*dec_picture)->used_for_reference)
+  if(!scan && (*dec_picture)->used_for_reference)
     pad_dec_picture(p_Vid, *dec_picture);
 #endif
   structure  = (*dec_picture)->structure;
@@ -1911,6 +1955,10 @@ void exit_picture(VideoParameters *p_Vid, StorablePicture **dec_picture)
 
   chroma_format_idc = (*dec_picture)->chroma_format_idc;
 
+  /* KATCIPIS - before storing it, the picture may be written right away */
+  set_metadata_frame(p_Vid, *dec_picture);
+  object_tracking_exit_picture(p_Vid, *dec_picture);
+
   store_picture_in_dpb(p_Vid->p_Dpb, *dec_picture);
   *dec_picture=NULL;
 
@@ -64,6 +64,10 @@
 #include "nalu.h"
 #include "img_io.h"
 #include "loopfilter.h"
+#include "object_tracking.h"
+#include "udata_parser.h"
+#include "overlay.h"
+#include "metadata_sidecar.h"
 
 #include "h264decoder.h"
 
@@ -222,6 +226,15 @@ static void free_img( VideoParameters *p_Vid)
   if (p_Vid != NULL)
   {
     free_annex_b (p_Vid);
+    object_tracking_free (p_Vid);
+    overlay_free (p_Vid->overlay);
+    p_Vid->overlay = NULL;
+    metadata_sidecar_free (p_Vid->metadata_sidecar);
+    p_Vid->metadata_sidecar = NULL;
+    user_data_parser_free (p_Vid->user_data_parser);
+    p_Vid->user_data_parser = NULL;
+    extracted_metadata_codec_free (p_Vid->metadata_codec);
+    p_Vid->metadata_codec = NULL;
 #if (ENABLE_OUTPUT_TONEMAPPING)  
     if (p_Vid->seiToneMapping != NULL)
     {
@@ -1076,6 +1089,7 @@ int OpenDecoder(InputParameters *p_Inp, ExtractedMetadataBuffer * metadata_buffe
   int i;
 #endif
   int iRet;
+  int metadata_sidecar;
   DecoderParams *pDecoder;
 
   iRet = alloc_decoder(&p_Dec);
@@ -1098,15 +1112,31 @@ int OpenDecoder(InputParameters *p_Inp, ExtractedMetadataBuffer * metadata_buffe
   }
 #endif
 
+  /* KATCIPIS - the sidecar files are only created when some of them is given */
+  metadata_sidecar = (strlen(pDecoder->p_Inp->metadata_index_file) && strcmp(pDecoder->p_Inp->metadata_index_file, "\"\"")) ||
+                     (strlen(pDecoder->p_Inp->metadata_json_file) && strcmp(pDecoder->p_Inp->metadata_json_file, "\"\""));
+
+  /* KATCIPIS - MetadataOnly without the sidecar files would decode and write nothing */
+  if (pDecoder->p_Inp->metadata_only && !metadata_sidecar)
+  {
+    error("MetadataOnly needs a MetadataIndexFile or a MetadataJsonFile, nothing would be written",500);
+  }
+
 #if (!MVC_EXTENSION_ENABLE)
-  if ((pDecoder->p_Vid->p_out = open(pDecoder->p_Inp->outfile, OPENFLAGS_WRITE, OPEN_PERMISSIONS))==-1)
+  /* KATCIPIS - nothing is written on the output file when only the metadata is exported */
+  if (pDecoder->p_Inp->metadata_only)
+  {
+    pDecoder->p_Vid->p_out = -1;
+  }
+  else if ((pDecoder->p_Vid->p_out = open(pDecoder->p_Inp->outfile, OPENFLAGS_WRITE, OPEN_PERMISSIONS))==-1)
   {
     snprintf(errortext, ET_SIZE, "Error open file %s ",p_Inp->outfile);
     error(errortext,500);
   }
 #endif
 
-  if(strlen(pDecoder->p_Inp->reffile)>0 && strcmp(pDecoder->p_Inp->reffile, "\"\""))
+  /* KATCIPIS - there is nothing to compare when only the metadata is exported */
+  if(!pDecoder->p_Inp->metadata_only && strlen(pDecoder->p_Inp->reffile)>0 && strcmp(pDecoder->p_Inp->reffile, "\"\""))
   {
    if ((pDecoder->p_Vid->p_ref = open(pDecoder->p_Inp->reffile, OPENFLAGS_READ))==-1)
    {
@@ -1144,6 +1174,14 @@ int OpenDecoder(InputParameters *p_Inp, ExtractedMetadataBuffer * metadata_buffe
 
   pDecoder->p_Vid->metadata_buffer = metadata_buffer;
 
+  if (metadata_sidecar)
+  {
+    if ((pDecoder->p_Vid->metadata_sidecar = metadata_sidecar_new(pDecoder->p_Inp->metadata_index_file, pDecoder->p_Inp->metadata_json_file)) == NULL)
+    {
+      error("Error creating the metadata sidecar files",500);
+    }
+  }
+
   return DEC_OPEN_NOERR;
 }
 
@@ -1224,7 +1262,8 @@ int CloseDecoder()
     }
   }
 #else
-  close(pDecoder->p_Vid->p_out);
+  if (pDecoder->p_Vid->p_out != -1)
+    close(pDecoder->p_Vid->p_out);
 #endif
 
   if (pDecoder->p_Vid->p_ref != -1)
@@ -4090,6 +4090,8 @@ void dpb_split_field(VideoParameters *p_Vid, FrameStore *fs)
     fs_top->poc = frame->top_poc;
     fs_btm->poc = frame->bottom_poc;
 
+    fs_top->metadata_frame = fs_btm->metadata_frame = frame->metadata_frame;
+
 #if (MVC_EXTENSION_ENABLE)
     fs_top->view_id = frame->view_id;
     fs_btm->view_id = frame->view_id;
@@ -4287,6 +4289,8 @@ void dpb_combine_field_yuv(VideoParameters *p_Vid, FrameStore *fs)
 
   fs->poc=fs->frame->poc =fs->frame->frame_poc = imin (fs->top_field->poc, fs->bottom_field->poc);
 
+  fs->frame->metadata_frame = imin (fs->top_field->metadata_frame, fs->bottom_field->metadata_frame);
+
   fs->bottom_field->frame_poc=fs->top_field->frame_poc=fs->frame->poc;
 
   fs->bottom_field->top_poc=fs->frame->top_poc=fs->top_field->poc;
@@ -0,0 +1,181 @@
+#include "metadata_sidecar.h"
+#include "win32.h"
+
+/* Size of the buffer of each file, it is written when full */
+#define METADATA_SIDECAR_BUFFER_SIZE 65536
+
+/* Max size of a JSON line */
+#define METADATA_SIDECAR_MAX_LINE_SIZE 256
+
+static const char METADATA_SIDECAR_MAGIC[4] = { 'E', 'M', 'I', 'X' };
+
+typedef struct _MetadataSidecarFile {
+  int fd;
+  int used;
+  unsigned char * buffer;
+} MetadataSidecarFile;
+
+struct metadata_sidecar {
+  MetadataSidecarFile index;
+  MetadataSidecarFile json;
+  unsigned int count;
+};
+
+
+static int metadata_sidecar_file_open(MetadataSidecarFile * file, const char * name)
+{
+  file->fd = -1;
+
+  if (!name || !strlen(name) || !strcmp(name, "\"\"")) {
+    return 1;
+  }
+
+  file->buffer = malloc(METADATA_SIDECAR_BUFFER_SIZE);
+
+  if (!file->buffer) {
+    printf("metadata_sidecar_file_open: Error allocating buffer !!!\n");
+    return 0;
+  }
+
+  if ((file->fd = open(name, OPENFLAGS_WRITE, OPEN_PERMISSIONS)) == -1) {
+    printf("metadata_sidecar_file_open: Error opening file [%s] !!!\n", name);
+    return 0;
+  }
+
+  return 1;
+}
+
+static void metadata_sidecar_file_flush(MetadataSidecarFile * file)
+{
+  if (file->used && (write(file->fd, file->buffer, file->used) != file->used)) {
+    printf("metadata_sidecar_file_flush: Error writing [%d] bytes !!!\n", file->used);
+  }
+
+  file->used = 0;
+}
+
+/* Gets room for size bytes on the buffer, flushing it if needed */
+static unsigned char * metadata_sidecar_file_reserve(MetadataSidecarFile * file, int size)
+{
+  if (file->used + size > METADATA_SIDECAR_BUFFER_SIZE) {
+    metadata_sidecar_file_flush(file);
+  }
+
+  return file->buffer + file->used;
+}
+
+static void metadata_sidecar_file_close(MetadataSidecarFile * file)
+{
+  if (file->fd != -1) {
+    metadata_sidecar_file_flush(file);
+    close(file->fd);
+  }
+
+  free(file->buffer);
+}
+
+static unsigned char * metadata_sidecar_put_int(unsigned char * data, unsigned int value)
+{
+  data[0] = (unsigned char) value;
+  data[1] = (unsigned char) (value >> 8);
+  data[2] = (unsigned char) (value >> 16);
+  data[3] = (unsigned char) (value >> 24);
+  return data + 4;
+}
+
+MetadataSidecar * metadata_sidecar_new(const char * index_file, const char * json_file)
+{
+  MetadataSidecar * sidecar = calloc(1, sizeof(MetadataSidecar));
+  unsigned char * data;
+
+  if (!sidecar) {
+    printf("metadata_sidecar_new: Error allocating MetadataSidecar !!!\n");
+    return NULL;
+  }
+
+  sidecar->json.fd = -1;
+
+  if (!metadata_sidecar_file_open(&sidecar->index, index_file) ||
+      !metadata_sidecar_file_open(&sidecar->json, json_file)) {
+    metadata_sidecar_free(sidecar);
+    return NULL;
+  }
+
+  if (sidecar->index.fd != -1) {
+    data = metadata_sidecar_file_reserve(&sidecar->index, 12);
+    memcpy(data, METADATA_SIDECAR_MAGIC, 4);
+    data = metadata_sidecar_put_int(data + 4, METADATA_SIDECAR_VERSION);
+    metadata_sidecar_put_int(data, METADATA_SIDECAR_RECORD_SIZE);
+    sidecar->index.used += 12;
+  }
+
+  return sidecar;
+}
+
+static void metadata_sidecar_write_box(MetadataSidecar * sidecar, ExtractedObjectBoundingBox * box,
+                                       unsigned int frame, int poc)
+{
+  unsigned int id;
+  int x, y, width, height;
+  unsigned char * data;
+
+  extracted_object_bounding_box_get_data(box, &id, &x, &y, &width, &height);
+
+  if (sidecar->index.fd != -1) {
+    data = metadata_sidecar_file_reserve(&sidecar->index, METADATA_SIDECAR_RECORD_SIZE);
+    data = metadata_sidecar_put_int(data, frame);
+    data = metadata_sidecar_put_int(data, (unsigned int) poc);
+    data = metadata_sidecar_put_int(data, id);
+    data = metadata_sidecar_put_int(data, (unsigned int) x);
+    data = metadata_sidecar_put_int(data, (unsigned int) y);
+    data = metadata_sidecar_put_int(data, (unsigned int) width);
+    metadata_sidecar_put_int(data, (unsigned int) height);
+    sidecar->index.used += METADATA_SIDECAR_RECORD_SIZE;
+  }
+
+  if (sidecar->json.fd != -1) {
+    data = metadata_sidecar_file_reserve(&sidecar->json, METADATA_SIDECAR_MAX_LINE_SIZE);
+    sidecar->json.used += snprintf((char *) data, METADATA_SIDECAR_MAX_LINE_SIZE,
+                                   "{\"frame\":%u,\"poc\":%d,\"id\":%u,\"x\":%d,\"y\":%d,\"width\":%d,\"height\":%d}\n",
+                                   frame, poc, id, x, y, width, height);
+  }
+
+  sidecar->count++;
+}
+
+void metadata_sidecar_write(MetadataSidecar * sidecar, ExtractedMetadata * metadata, int poc)
+{
+  ExtractedObjectBoundingBox * box      = extracted_object_bounding_box_from_metadata(metadata);
+  ExtractedObjectBoundingBoxList * list = extracted_object_bounding_box_list_from_metadata(metadata);
+  unsigned int frame                    = extracted_metadata_get_frame_number(metadata);
+  int i;
+
+  if (box) {
+    metadata_sidecar_write_box(sidecar, box, frame, poc);
+    return;
+  }
+
+  if (!list) {
+    return;
+  }
+
+  for (i = 0; i < extracted_object_bounding_box_list_get_size(list); i++) {
+    metadata_sidecar_write_box(sidecar, extracted_object_bounding_box_list_get_box(list, i), frame, poc);
+  }
+}
+
+unsigned int metadata_sidecar_get_count(MetadataSidecar * sidecar)
+{
+  return sidecar->count;
+}
+
+void metadata_sidecar_free(MetadataSidecar * sidecar)
+{
+  if (!sidecar) {
+    return;
+  }
+
+  metadata_sidecar_file_close(&sidecar->index);
+  metadata_sidecar_file_close(&sidecar->json);
+  free(sidecar);
+}
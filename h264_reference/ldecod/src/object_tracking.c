@@ -0,0 +1,170 @@
+#include "object_tracking.h"
+#include "object_tracker.h"
+
+#include <stddef.h>
+
+struct object_tracking {
+  ObjectTracker * tracker;
+
+  /* Last bounding box metadata received, applied when the next picture starts */
+  ExtractedMetadata * pending;
+
+  /* Frame number of the bounding boxes applied on the current picture, if any */
+  int synced;
+  unsigned int synced_frame;
+};
+
+
+/* The ObjectTracking of the decoder, it is created when the first metadata is received */
+static ObjectTracking * object_tracking_get(VideoParameters *p_Vid)
+{
+  /* The scan does not decode the motion vectors */
+  if (!p_Vid->p_Inp->object_tracking || (p_Vid->p_Inp->metadata_only == METADATA_ONLY_SCAN)) {
+    return NULL;
+  }
+
+  if (!p_Vid->object_tracking) {
+    p_Vid->object_tracking = calloc(1, sizeof(ObjectTracking));
+
+    if (!p_Vid->object_tracking) {
+      printf("object_tracking_get: Error allocating ObjectTracking !!!\n");
+    }
+  }
+
+  return p_Vid->object_tracking;
+}
+
+int object_tracking_receive_metadata(VideoParameters *p_Vid, ExtractedMetadata * metadata)
+{
+  ObjectTracking * tracking = object_tracking_get(p_Vid);
+
+  if (!tracking || !metadata) {
+    return 0;
+  }
+
+  if (!extracted_object_bounding_box_from_metadata(metadata) && !extracted_object_bounding_box_list_from_metadata(metadata)) {
+    return 0;
+  }
+
+  if (tracking->pending) {
+    /* More than one on the same access unit, the older one is only drawn */
+    extracted_metadata_buffer_add(p_Vid->metadata_buffer, tracking->pending);
+  }
+
+  tracking->pending = metadata;
+  return 1;
+}
+
+void object_tracking_init_picture(VideoParameters *p_Vid)
+{
+  ObjectTracking * tracking = p_Vid->object_tracking;
+
+  if (!tracking) {
+    return;
+  }
+
+  tracking->synced = 0;
+
+  if (!tracking->pending) {
+    return;
+  }
+
+  if (!tracking->tracker) {
+    tracking->tracker = object_tracker_new(p_Vid->width, p_Vid->height);
+  }
+
+  if (tracking->tracker) {
+    object_tracker_sync(tracking->tracker, tracking->pending);
+    tracking->synced       = 1;
+    tracking->synced_frame = extracted_metadata_get_frame_number(tracking->pending);
+  }
+
+  /* The buffer owns it now */
+  extracted_metadata_buffer_add(p_Vid->metadata_buffer, tracking->pending);
+  tracking->pending = NULL;
+}
+
+void object_tracking_exit_picture(VideoParameters *p_Vid, StorablePicture *p)
+{
+  ObjectTracking * tracking = p_Vid->object_tracking;
+  DecodedPictureBuffer *p_Dpb = p_Vid->p_Dpb;
+  MotionVectorReference references[2 * MAX_LIST_SIZE];
+  MotionVectorField field;
+  unsigned int frame;
+  unsigned i;
+
+  /* Field pictures are not tracked */
+  if (!tracking || !tracking->tracker || (p->structure != FRAME)) {
+    return;
+  }
+
+  frame = p->metadata_frame;
+
+  /* Just like on the encoder, the motion of the previous picture (coding order) moves the objects to this frame */
+  object_tracker_estimate_motion(tracking->tracker, frame);
+
+  if (!tracking->synced || (tracking->synced_frame != frame)) {
+    ExtractedMetadata * metadata = object_tracker_get_metadata(tracking->tracker, frame);
+
+    if (metadata) {
+      extracted_metadata_buffer_add(p_Vid->metadata_buffer, metadata);
+    }
+  }
+
+  /* The references of the picture are the frames of the DPB, not stored yet */
+  field.reference_count = 0;
+
+  for (i = 0; i < p_Dpb->ref_frames_in_buffer; i++) {
+    if (p_Dpb->fs_ref[i]->frame) {
+      references[field.reference_count].picture      = p_Dpb->fs_ref[i]->frame;
+      references[field.reference_count].poc_distance = p->frame_poc - p_Dpb->fs_ref[i]->frame->poc;
+      field.reference_count++;
+    }
+  }
+
+  for (i = 0; i < p_Dpb->ltref_frames_in_buffer; i++) {
+    if (p_Dpb->fs_ltref[i]->frame) {
+      references[field.reference_count].picture      = p_Dpb->fs_ltref[i]->frame;
+      references[field.reference_count].poc_distance = p->frame_poc - p_Dpb->fs_ltref[i]->frame->poc;
+      field.reference_count++;
+    }
+  }
+
+  /* mv_info rows are contiguous (get_mem2Dmp), one PicMotionParams per 4x4 block.
+     The velocities are per metadata frame, as on the encoder, whatever the POCScale is */
+  field.blocks             = (const unsigned char *) &p->mv_info[0][0];
+  field.block_stride       = sizeof(PicMotionParams);
+  field.row_stride         = (const unsigned char *) p->mv_info[1] - (const unsigned char *) p->mv_info[0];
+  field.mv_offset[0]       = offsetof(PicMotionParams, mv[LIST_0]);
+  field.mv_offset[1]       = offsetof(PicMotionParams, mv[LIST_1]);
+  field.ref_idx_offset[0]  = offsetof(PicMotionParams, ref_idx[LIST_0]);
+  field.ref_idx_offset[1]  = offsetof(PicMotionParams, ref_idx[LIST_1]);
+  field.ref_pic_offset[0]  = offsetof(PicMotionParams, ref_pic[LIST_0]);
+  field.ref_pic_offset[1]  = offsetof(PicMotionParams, ref_pic[LIST_1]);
+  field.references         = references;
+  field.frame_poc_distance = EXTRACTED_METADATA_FRAME_POC_DISTANCE;
+  field.width              = p->size_x / BLOCK_SIZE;
+  field.height             = p->size_y / BLOCK_SIZE;
+
+  object_tracker_add_motion_vector_field(tracking->tracker, &field);
+}
+
+void object_tracking_free(VideoParameters *p_Vid)
+{
+  ObjectTracking * tracking = p_Vid->object_tracking;
+
+  if (!tracking) {
+    return;
+  }
+
+  if (tracking->tracker) {
+    object_tracker_free(tracking->tracker);
+  }
+
+  if (tracking->pending) {
+    extracted_metadata_free(tracking->pending);
+  }
+
+  free(tracking);
+  p_Vid->object_tracking = NULL;
+}
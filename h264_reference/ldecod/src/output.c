@@ -22,6 +22,8 @@
 #include "input.h"
 #include "fast_memory.h"
 #include "extracted_metadata.h"
+#include "overlay.h"
+#include "metadata_sidecar.h"
 
 static void write_out_picture(VideoParameters *p_Vid, StorablePicture *p, int p_out);
 static void img2buf_byte   (imgpel** imgX, unsigned char* buf, int size_x, int size_y, int symbol_size_in_bytes, int crop_left, int crop_right, int crop_top, int crop_bottom, int iOutStride);
@@ -325,6 +327,7 @@ void write_picture(VideoParameters *p_Vid, StorablePicture *p, int p_out, int re
     p_Vid->pending_output->size_x_cr = p->size_x_cr;
     p_Vid->pending_output->size_y_cr = p->size_y_cr;
     p_Vid->pending_output->chroma_format_idc = p->chroma_format_idc;
+    p_Vid->pending_output->metadata_frame = p->metadata_frame;
 
     p_Vid->pending_output->frame_mbs_only_flag = p->frame_mbs_only_flag;
     p_Vid->pending_output->frame_cropping_flag = p->frame_cropping_flag;
@@ -430,100 +433,42 @@ void write_picture(VideoParameters *p_Vid, StorablePicture *p, int p_out, int re
 #endif
 
 
-/* KATCIPIS - added to do the bounding box drawing */
+/* KATCIPIS - added to do the bounding box drawing and the sidecar export */
 /*!
  ***********************************************************************
  * \brief
- *    Draws a bouding box on the frame.
+ *    Takes the metadata of the frame from the buffer, writing it on the
+ *    sidecar files and gathering the bounding boxes on the overlay of the
+ *    decoder when draw is set. Returns the overlay, NULL if there is
+ *    nothing to draw.
  ***********************************************************************
  */
-static void decoder_draw_bounding_box(ExtractedMetadata * metadata, StorablePicture *p)
+static Overlay * process_frame_metadata(VideoParameters *p_Vid, StorablePicture *p, int draw)
 {
-  static const int BOUNDING_BOX_BORDER_SIZE    = 4;
-  static const unsigned char BOUNDING_BOX_LUMA = 0;
-  static const unsigned char BOUNDING_BOX_U    = 0;
-  static const unsigned char BOUNDING_BOX_V    = 220;   
-
-  ExtractedObjectBoundingBox * bounding_box = extracted_object_bounding_box_from_metadata(metadata);
-  int box_x                                 = 0;
-  int box_y                                 = 0;
-  int box_width                             = 0;
-  int box_height                            = 0;
-  int row                                   = 0;
- 
-  if (!bounding_box) {
-    return;
-  }
-
-  extracted_object_bounding_box_get_data(bounding_box, NULL, &box_x, &box_y, &box_width, &box_height);
-
-  /* printf("decoder_draw_bounding_box: size_x[%d], size_y[%d], size_x_cr[%d], size_y_cr[%d]\n", 
-                                     p->size_x, p->size_y, p->size_x_cr, p->size_y_cr); */
-
-  /* Validate bounding box */
-  if ( (box_x + box_width > p->size_x) ||
-       (box_y + box_height > p->size_y)) {
-      printf("decoder_draw_bounding_box: ERROR: bouding box out of the frame !!!\n");
-      return;
-  }
-
-  /* lets drawn on the luma information */
-
-  /* drawn bounding box top */
-  for (row = box_y; row < box_y + BOUNDING_BOX_BORDER_SIZE; row++) {
-    memset(p->imgY[row] + box_x, BOUNDING_BOX_LUMA, box_width);
-  }
-
-  /* drawn bounding box left and right */
-  for (row = box_y + BOUNDING_BOX_BORDER_SIZE; row <= box_y + box_height - BOUNDING_BOX_BORDER_SIZE; row++) {
-    //printf("KMLO row[%d]\n", row);
-    memset(p->imgY[row] + box_x, BOUNDING_BOX_LUMA, BOUNDING_BOX_BORDER_SIZE); /* left side */
-    memset(p->imgY[row] + box_x + box_width - BOUNDING_BOX_BORDER_SIZE, BOUNDING_BOX_LUMA, BOUNDING_BOX_BORDER_SIZE); /* right side */
-  }
-
-  /* drawn bounding box bottom */
-  for (row = box_y + box_height - 1; row > box_y + box_height - BOUNDING_BOX_BORDER_SIZE; row--) {
-    memset(p->imgY[row] + box_x, BOUNDING_BOX_LUMA, box_width);
-  }
-
-  if (p->imgUV) {
-    /* lets draw on the chroma information */
-    float luma_chroma_x_ratio = p->size_x / p->size_x_cr;
-    float luma_chroma_y_ratio = p->size_y / p->size_y_cr;
-
-    /* drawn bounding box top */
-    for (row = box_y / luma_chroma_y_ratio;
-         row < (box_y + BOUNDING_BOX_BORDER_SIZE) / luma_chroma_y_ratio; row++) {
+  ExtractedMetadata * metadata = NULL;
 
-      memset(p->imgUV[0][row] + (int) (box_x / luma_chroma_x_ratio), BOUNDING_BOX_U, box_width / luma_chroma_x_ratio);
-      memset(p->imgUV[1][row] + (int) (box_x / luma_chroma_x_ratio), BOUNDING_BOX_V, box_width / luma_chroma_x_ratio);
+  if (draw) {
+    if (!p_Vid->overlay && !(p_Vid->overlay = overlay_new(p_Vid->p_Inp->overlay_opacity * OVERLAY_OPAQUE / 100))) {
+      no_mem_exit("process_frame_metadata: overlay");
     }
 
-    int chroma_side_border_size = BOUNDING_BOX_BORDER_SIZE / luma_chroma_x_ratio;
-
-    /* drawn bounding box left and right */
-    for (row = (box_y + BOUNDING_BOX_BORDER_SIZE) / luma_chroma_y_ratio; 
-         row <= (box_y + box_height - BOUNDING_BOX_BORDER_SIZE) / luma_chroma_y_ratio; row++) {
-
-      memset(p->imgUV[0][row] + (int) (box_x / luma_chroma_x_ratio), BOUNDING_BOX_U, chroma_side_border_size); /* left side */
-      memset(p->imgUV[0][row] + (int) ((box_x + box_width - BOUNDING_BOX_BORDER_SIZE) / luma_chroma_x_ratio), 
-                                       BOUNDING_BOX_U, chroma_side_border_size); /* right side */
+    overlay_clear(p_Vid->overlay);
+  }
 
-      memset(p->imgUV[1][row] + (int) (box_x / luma_chroma_x_ratio), BOUNDING_BOX_V, chroma_side_border_size); /* left side */
-      memset(p->imgUV[1][row] + (int) ((box_x + box_width - BOUNDING_BOX_BORDER_SIZE) / luma_chroma_x_ratio), 
-                                       BOUNDING_BOX_V, chroma_side_border_size); /* right side */
+  /* Lets process and free all the metadata relative to the current frame, the picture knows its frame number */
+  while ((metadata = extracted_metadata_buffer_get(p_Vid->metadata_buffer, p->metadata_frame))) {
+    if (p_Vid->metadata_sidecar) {
+      metadata_sidecar_write(p_Vid->metadata_sidecar, metadata, p->frame_poc);
     }
 
-    /* drawn bounding box bottom */
-    for (row = (box_y + box_height - 1) / luma_chroma_y_ratio; 
-         row > (box_y + box_height - BOUNDING_BOX_BORDER_SIZE) / luma_chroma_y_ratio; row--) {
-
-      memset(p->imgUV[0][row] + (int) (box_x / luma_chroma_x_ratio), BOUNDING_BOX_U, box_width / luma_chroma_x_ratio);
-      memset(p->imgUV[1][row] + (int) (box_x / luma_chroma_x_ratio), BOUNDING_BOX_V, box_width / luma_chroma_x_ratio);
+    if (draw) {
+      overlay_add_metadata(p_Vid->overlay, metadata);
     }
 
+    extracted_metadata_free(metadata);
   }
 
+  return (draw && overlay_get_size(p_Vid->overlay)) ? p_Vid->overlay : NULL;
 }
 
 /*!
@@ -562,24 +507,19 @@ static void write_out_picture(VideoParameters *p_Vid, StorablePicture *p, int p_
   int iChromaSizeX, iChromaSizeY;
 
   int ret;
+  Overlay * overlay;
 
   if (p->non_existing)
     return;
 
-  /* KATCIPIS - This seems the best place to do some process on the decoded frame, right before it is written on the file. */
-  static int frameCount        = 0; /* Is this the best way to get the frame number ? */
-  ExtractedMetadata * metadata = extracted_metadata_buffer_get(p_Vid->metadata_buffer, frameCount);
+  /* KATCIPIS - This seems the best place to do some process on the decoded frame, right before it is written on the file. 
+     The boxes are drawn on the output buffer, the picture may still be a reference. */
+  overlay = process_frame_metadata(p_Vid, p, !p_Inp->metadata_only && (symbol_size_in_bytes == 1));
 
-  frameCount++;
-
-  if (metadata) {
-    /* Lets process and free the metadata relative to the current frame */
-   decoder_draw_bounding_box(metadata, p);
-   extracted_metadata_free(metadata);
-   metadata = NULL;
- }
-
- /* KATCIPIS - end of metadata processing on the decoded frame. */
+  /* Only the metadata is exported, the samples are not written */
+  if (p_Inp->metadata_only)
+    return;
+  /* KATCIPIS - end of metadata processing on the decoded frame. */
 
 
 #if (ENABLE_OUTPUT_TONEMAPPING)
@@ -729,6 +669,12 @@ static void write_out_picture(VideoParameters *p_Vid, StorablePicture *p, int p_
 
     p_Vid->img2buf (p->imgY, buf, p->size_x, p->size_y, symbol_size_in_bytes, crop_left, crop_right, crop_top, crop_bottom, pDecPic->iYBufStride);
 
+  if (overlay)
+  {
+    overlay_render_plane(overlay, buf, p->size_x - crop_left - crop_right, p->size_y - crop_top - crop_bottom, 
+                         pDecPic->iYBufStride, crop_left, crop_top, 0, 0, 0);
+  }
+
   if(p_out >=0)
   {
     ret = write(p_out, buf, (p->size_y-crop_bottom-crop_top)*(p->size_x-crop_right-crop_left)*symbol_size_in_bytes);
@@ -747,6 +693,13 @@ static void write_out_picture(VideoParameters *p_Vid, StorablePicture *p, int p_
     buf = (pDecPic->bValid==1)? pDecPic->pU : pDecPic->pU + iChromaSizeX*symbol_size_in_bytes;
 
       p_Vid->img2buf (p->imgUV[0], buf, p->size_x_cr, p->size_y_cr, symbol_size_in_bytes, crop_left, crop_right, crop_top, crop_bottom, pDecPic->iUVBufStride);
+
+    if (overlay)
+    {
+      overlay_render_plane(overlay, buf, p->size_x_cr - crop_left - crop_right, p->size_y_cr - crop_top - crop_bottom, 
+                           pDecPic->iUVBufStride, crop_left, crop_top, 
+                           p->chroma_format_idc != YUV444, p->chroma_format_idc == YUV420, 1);
+    }
     if(p_out >= 0)
     {
       ret = write(p_out, buf, (p->size_y_cr-crop_bottom-crop_top)*(p->size_x_cr-crop_right-crop_left)* symbol_size_in_bytes);
@@ -761,6 +714,13 @@ static void write_out_picture(VideoParameters *p_Vid, StorablePicture *p, int p_
       buf = (pDecPic->bValid==1)? pDecPic->pV : pDecPic->pV + iChromaSizeX*symbol_size_in_bytes;
       p_Vid->img2buf (p->imgUV[1], buf, p->size_x_cr, p->size_y_cr, symbol_size_in_bytes, crop_left, crop_right, crop_top, crop_bottom, pDecPic->iUVBufStride);
 
+      if (overlay)
+      {
+        overlay_render_plane(overlay, buf, p->size_x_cr - crop_left - crop_right, p->size_y_cr - crop_top - crop_bottom, 
+                             pDecPic->iUVBufStride, crop_left, crop_top, 
+                             p->chroma_format_idc != YUV444, p->chroma_format_idc == YUV420, 2);
+      }
+
       if(p_out >= 0)
       {
         ret = write(p_out, buf, (p->size_y_cr-crop_bottom-crop_top)*(p->size_x_cr-crop_right-crop_left)*symbol_size_in_bytes);
@@ -900,6 +860,7 @@ void write_unpaired_field(VideoParameters *p_Vid, FrameStore* fs, int p_out)
     p = fs->top_field;
     fs->bottom_field = alloc_storable_picture(p_Vid, BOTTOM_FIELD, p->size_x, 2*p->size_y, p->size_x_cr, 2*p->size_y_cr);
     fs->bottom_field->chroma_format_idc = p->chroma_format_idc;
+    fs->bottom_field->metadata_frame = p->metadata_frame;
     clear_picture(p_Vid, fs->bottom_field);
     dpb_combine_field_yuv(p_Vid, fs);
 #if (MVC_EXTENSION_ENABLE)
@@ -915,6 +876,7 @@ void write_unpaired_field(VideoParameters *p_Vid, FrameStore* fs, int p_out)
     p = fs->bottom_field;
     fs->top_field = alloc_storable_picture(p_Vid, TOP_FIELD, p->size_x, 2*p->size_y, p->size_x_cr, 2*p->size_y_cr);
     fs->top_field->chroma_format_idc = p->chroma_format_idc;
+    fs->top_field->metadata_frame = p->metadata_frame;
     clear_picture(p_Vid, fs->top_field);
     fs ->top_field->frame_cropping_flag = fs->bottom_field->frame_cropping_flag;
     if(fs ->top_field->frame_cropping_flag)
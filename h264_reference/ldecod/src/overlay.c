@@ -0,0 +1,263 @@
+#include "overlay.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define OVERLAY_SSE2 1
+#include <emmintrin.h>
+#endif
+
+/* Border size in luma samples */
+static const int OVERLAY_BORDER_SIZE = 4;
+
+/* Y, U and V of the borders */
+static const unsigned char OVERLAY_COLOR[3] = { 0, 0, 220 };
+
+typedef struct _OverlayBox {
+  int x;
+  int y;
+  int width;
+  int height;
+} OverlayBox;
+
+struct overlay {
+  OverlayBox * boxes;
+  int size;
+  int capacity;
+  int alpha;
+
+  /* Samples of the row covered by the borders (1) when they are blended, and the covered range */
+  unsigned char * coverage;
+  int coverage_capacity;
+  int covered_start;
+  int covered_end;
+};
+
+
+Overlay * overlay_new(int alpha)
+{
+  Overlay * overlay = calloc(1, sizeof(Overlay));
+
+  if (!overlay) {
+    printf("overlay_new: Error allocating Overlay !!!\n");
+    return NULL;
+  }
+
+  overlay->alpha = (alpha < 0) ? 0 : (alpha > OVERLAY_OPAQUE) ? OVERLAY_OPAQUE : alpha;
+  return overlay;
+}
+
+void overlay_free(Overlay * overlay)
+{
+  if (!overlay) {
+    return;
+  }
+
+  free(overlay->boxes);
+  free(overlay->coverage);
+  free(overlay);
+}
+
+void overlay_clear(Overlay * overlay)
+{
+  overlay->size = 0;
+}
+
+int overlay_get_size(Overlay * overlay)
+{
+  return overlay->size;
+}
+
+static void overlay_add_box(Overlay * overlay, ExtractedObjectBoundingBox * box)
+{
+  OverlayBox * new_box;
+
+  if (overlay->size == overlay->capacity) {
+    int capacity       = (overlay->capacity) ? overlay->capacity * 2 : 8;
+    OverlayBox * boxes = realloc(overlay->boxes, sizeof(OverlayBox) * capacity);
+
+    if (!boxes) {
+      printf("overlay_add_box: Error allocating boxes !!!\n");
+      return;
+    }
+
+    overlay->boxes    = boxes;
+    overlay->capacity = capacity;
+  }
+
+  new_box = &overlay->boxes[overlay->size++];
+  extracted_object_bounding_box_get_data(box, NULL, &new_box->x, &new_box->y, &new_box->width, &new_box->height);
+}
+
+void overlay_add_metadata(Overlay * overlay, ExtractedMetadata * metadata)
+{
+  ExtractedObjectBoundingBox * box      = extracted_object_bounding_box_from_metadata(metadata);
+  ExtractedObjectBoundingBoxList * list = extracted_object_bounding_box_list_from_metadata(metadata);
+  int i;
+
+  if (box) {
+    overlay_add_box(overlay, box);
+    return;
+  }
+
+  if (!list) {
+    return;
+  }
+
+  for (i = 0; i < extracted_object_bounding_box_list_get_size(list); i++) {
+    overlay_add_box(overlay, extracted_object_bounding_box_list_get_box(list, i));
+  }
+}
+
+/* out = (in * (256 - alpha) + color * alpha + 128) >> 8, the same on the SIMD and the C code */
+static void overlay_blend(unsigned char * row, int count, unsigned char color, int alpha)
+{
+  int color_alpha = color * alpha + 128;
+  int i           = 0;
+
+#ifdef OVERLAY_SSE2
+  __m128i zero     = _mm_setzero_si128();
+  __m128i inverse  = _mm_set1_epi16((short) (OVERLAY_OPAQUE - alpha));
+  __m128i addition = _mm_set1_epi16((short) color_alpha);
+
+  for (; i + 16 <= count; i += 16) {
+    __m128i in = _mm_loadu_si128((__m128i *) (row + i));
+    __m128i lo = _mm_unpacklo_epi8(in, zero);
+    __m128i hi = _mm_unpackhi_epi8(in, zero);
+
+    /* The sums are at most 255 * 256 + 128, they fit on 16 bits unsigned */
+    lo = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(lo, inverse), addition), 8);
+    hi = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(hi, inverse), addition), 8);
+
+    _mm_storeu_si128((__m128i *) (row + i), _mm_packus_epi16(lo, hi));
+  }
+#endif
+
+  for (; i < count; i++) {
+    row[i] = (unsigned char) ((row[i] * (OVERLAY_OPAQUE - alpha) + color_alpha) >> 8);
+  }
+}
+
+static void overlay_fill(Overlay * overlay, unsigned char * row, int width, int start, int end, unsigned char color)
+{
+  if (start < 0) {
+    start = 0;
+  }
+
+  if (end > width) {
+    end = width;
+  }
+
+  if (start >= end) {
+    return;
+  }
+
+  if (overlay->alpha == OVERLAY_OPAQUE) {
+    memset(row + start, color, end - start);
+    return;
+  }
+
+  /* The blended borders are only marked, where the boxes overlap a sample must not be blended twice */
+  memset(overlay->coverage + start, 1, end - start);
+
+  overlay->covered_start = (start < overlay->covered_start) ? start : overlay->covered_start;
+  overlay->covered_end   = (end > overlay->covered_end) ? end : overlay->covered_end;
+}
+
+/* Blends each run of covered samples of the row once and clears the coverage for the next row */
+static void overlay_blend_covered(Overlay * overlay, unsigned char * row, unsigned char color)
+{
+  unsigned char * coverage = overlay->coverage;
+  int end                  = overlay->covered_end;
+  int x                    = overlay->covered_start;
+
+  if (x >= end) {
+    return;
+  }
+
+  while (x < end) {
+    int start;
+
+    if (!coverage[x]) {
+      x++;
+      continue;
+    }
+
+    for (start = x; (x < end) && coverage[x]; x++);
+
+    overlay_blend(row + start, x - start, color, overlay->alpha);
+  }
+
+  memset(coverage + overlay->covered_start, 0, end - overlay->covered_start);
+}
+
+void overlay_render_plane(Overlay * overlay, unsigned char * plane, int width, int height, int stride,
+                          int left, int top, int shift_x, int shift_y, int component)
+{
+  unsigned char color = OVERLAY_COLOR[component];
+  int border_x        = OVERLAY_BORDER_SIZE >> shift_x;
+  int border_y        = OVERLAY_BORDER_SIZE >> shift_y;
+  int first_row       = height;
+  int last_row        = 0;
+  int row;
+  int i;
+
+  if (!overlay->size || !overlay->alpha) {
+    return;
+  }
+
+  if ((overlay->alpha != OVERLAY_OPAQUE) && (overlay->coverage_capacity < width)) {
+    free(overlay->coverage);
+    overlay->coverage          = calloc(width, 1);
+    overlay->coverage_capacity = overlay->coverage ? width : 0;
+
+    if (!overlay->coverage) {
+      printf("overlay_render_plane: Error allocating the coverage !!!\n");
+      return;
+    }
+  }
+
+  /* Only the rows with some border are visited, each one once for all the boxes */
+  for (i = 0; i < overlay->size; i++) {
+    int y0 = ((overlay->boxes[i].y) >> shift_y) - top;
+    int y1 = ((overlay->boxes[i].y + overlay->boxes[i].height) >> shift_y) - top;
+
+    first_row = (y0 < first_row) ? y0 : first_row;
+    last_row  = (y1 > last_row) ? y1 : last_row;
+  }
+
+  first_row = (first_row < 0) ? 0 : first_row;
+  last_row  = (last_row > height) ? height : last_row;
+
+  for (row = first_row; row < last_row; row++) {
+    unsigned char * samples = plane + row * stride;
+
+    overlay->covered_start = width;
+    overlay->covered_end   = 0;
+
+    for (i = 0; i < overlay->size; i++) {
+      OverlayBox * box = &overlay->boxes[i];
+      int x0           = (box->x >> shift_x) - left;
+      int x1           = ((box->x + box->width) >> shift_x) - left;
+      int y0           = (box->y >> shift_y) - top;
+      int y1           = ((box->y + box->height) >> shift_y) - top;
+
+      if ((row < y0) || (row >= y1)) {
+        continue;
+      }
+
+      if ((row < y0 + border_y) || (row >= y1 - border_y)) {
+        /* top and bottom */
+        overlay_fill(overlay, samples, width, x0, x1, color);
+      } else {
+        /* left and right sides */
+        overlay_fill(overlay, samples, width, x0, x0 + border_x, color);
+        overlay_fill(overlay, samples, width, x1 - border_x, x1, color);
+      }
+    }
+
+    overlay_blend_covered(overlay, samples, color);
+  }
+}
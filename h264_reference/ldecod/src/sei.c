@@ -25,6 +25,7 @@
 #include "parset.h"
 #include "udata_parser.h"
 #include "extracted_metadata.h"
+#include "object_tracking.h"
 
 // #define PRINT_BUFFERING_PERIOD_INFO    // uncomment to print buffering period SEI info
 // #define PRINT_PCITURE_TIMING_INFO      // uncomment to print picture timing SEI info
@@ -52,6 +53,61 @@
 // #define PRINT_TONE_MAPPING                         // uncomment to print tone-mapping SEI info
 // #define PRINT_POST_FILTER_HINT_INFO                // uncomment to print post-filter hint SEI info
 // #define PRINT_FRAME_PACKING_ARRANGEMENT_INFO       // uncomment to print frame packing arrangement SEI info
+/*!
+ ************************************************************************
+ *  \brief
+ *     Receives the metadata container from a user data unregistered SEI
+ *     message. (KATCIPIS)
+ *
+ ************************************************************************
+ */
+static void interpret_extracted_metadata_info( byte* data, int size, void *context )
+{
+  VideoParameters *p_Vid = (VideoParameters *) context;
+  ExtractedMetadata * metadata[EXTRACTED_METADATA_CODEC_MAX_BATCH];
+  int count;
+  int i;
+
+  /* The metadata is coded against the previous one, the codec lives as long as the decoder */
+  if (!p_Vid->metadata_codec && !(p_Vid->metadata_codec = extracted_metadata_codec_new())) {
+    no_mem_exit("interpret_extracted_metadata_info: metadata_codec");
+  }
+
+  count = extracted_metadata_codec_decode(p_Vid->metadata_codec, (const char *) data, size, 
+                                          metadata, EXTRACTED_METADATA_CODEC_MAX_BATCH);
+
+  for (i = 0; i < count; i++) {
+    /* The bounding boxes go to the buffer with the picture they belong when the objects are tracked */
+    if (!object_tracking_receive_metadata(p_Vid, metadata[i])) {
+      extracted_metadata_buffer_add(p_Vid->metadata_buffer, metadata[i]);
+    }
+  }
+}
+
+/*!
+ ************************************************************************
+ *  \brief
+ *     The user data parser of the decoder, created with the handlers
+ *     of the known uuids on the first user data SEI message. (KATCIPIS)
+ *
+ ************************************************************************
+ */
+static UserDataParser * get_user_data_parser( VideoParameters *p_Vid )
+{
+  if (!p_Vid->user_data_parser) {
+    p_Vid->user_data_parser = user_data_parser_new();
+
+    if (!p_Vid->user_data_parser) {
+      no_mem_exit("get_user_data_parser: user_data_parser");
+    }
+
+    user_data_parser_register_handler(p_Vid->user_data_parser, extracted_metadata_uuid, 
+                                      interpret_extracted_metadata_info, p_Vid);
+  }
+
+  return p_Vid->user_data_parser;
+}
+
 /*!
  ************************************************************************
  *  \brief
@@ -111,19 +167,11 @@ void InterpretSEIMessage(byte* msg, int size, VideoParameters *p_Vid, Slice *pSl
       interpret_user_data_registered_itu_t_t35_info( msg+offset, payload_size, p_Vid );
       break;
     case  SEI_USER_DATA_UNREGISTERED:
-    {
-      /* KATCIPIS - lets receive the serialized metadata */
-      byte * serialized_metadata   = NULL;
-      int serialized_metadata_size = 0;
-
-      user_data_parser_unregistered_sei_get_data(msg+offset, payload_size, 
-                                                 &serialized_metadata, &serialized_metadata_size);
-
-      extracted_metadata_buffer_add(p_Vid->metadata_buffer, extracted_metadata_deserialize((const char *) serialized_metadata, serialized_metadata_size));
-      /* KATCIPIS - ended receiving the serialized metadata */
-
+      /* KATCIPIS - only the messages with a registered uuid (the serialized metadata) are parsed */
+      if (!user_data_parser_unregistered_sei_dispatch(get_user_data_parser(p_Vid), msg+offset, payload_size)) {
+        interpret_user_data_unregistered_info( msg+offset, payload_size, p_Vid );
+      }
       break;
-    }
     case  SEI_RECOVERY_POINT:
       interpret_recovery_point_info( msg+offset, payload_size, p_Vid );
       break;
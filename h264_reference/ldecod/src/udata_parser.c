@@ -1,8 +1,22 @@
 #include "udata_parser.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 /* 16 bytes - 128bits - According to ITU-T REC 03/2010 - Pag 327 */
-static const int UUID_ISO_IEC_OFFSET = 16;
+#define UUID_ISO_IEC_SIZE 16
+static const int UUID_ISO_IEC_OFFSET = UUID_ISO_IEC_SIZE;
+
+typedef struct _UserDataHandlerEntry {
+  byte uuid[UUID_ISO_IEC_SIZE];
+  UserDataHandler handler;
+  void * context;
+} UserDataHandlerEntry;
+
+struct _UserDataParser {
+  UserDataHandlerEntry handlers[USER_DATA_PARSER_MAX_HANDLERS];
+  int handlers_count;
+};
 
 
 void user_data_parser_unregistered_sei_dump( byte* payload, int size)
@@ -39,3 +53,64 @@ void user_data_parser_unregistered_sei_get_data(byte* payload, int size, byte **
   *outdata = payload + UUID_ISO_IEC_OFFSET;
   *outsize = size - UUID_ISO_IEC_OFFSET;
 }
+
+UserDataParser * user_data_parser_new()
+{
+  UserDataParser * parser = calloc(1, sizeof(UserDataParser));
+
+  if (!parser) {
+    printf("user_data_parser_new: Error allocating UserDataParser !!!\n");
+  }
+
+  return parser;
+}
+
+void user_data_parser_free(UserDataParser * parser)
+{
+  free(parser);
+}
+
+int user_data_parser_register_handler(UserDataParser * parser, const byte * uuid, UserDataHandler handler, void * context)
+{
+  int i;
+
+  for (i = 0; i < parser->handlers_count; i++) {
+    if (!memcmp(parser->handlers[i].uuid, uuid, UUID_ISO_IEC_SIZE)) {
+      printf("user_data_parser_register_handler: uuid already registered !!!\n");
+      return 0;
+    }
+  }
+
+  if (parser->handlers_count == USER_DATA_PARSER_MAX_HANDLERS) {
+    printf("user_data_parser_register_handler: too many handlers !!!\n");
+    return 0;
+  }
+
+  memcpy(parser->handlers[parser->handlers_count].uuid, uuid, UUID_ISO_IEC_SIZE);
+  parser->handlers[parser->handlers_count].handler = handler;
+  parser->handlers[parser->handlers_count].context = context;
+  parser->handlers_count++;
+
+  return 1;
+}
+
+int user_data_parser_unregistered_sei_dispatch(UserDataParser * parser, byte* payload, int size)
+{
+  int i;
+
+  if (size < UUID_ISO_IEC_OFFSET) {
+    return 0;
+  }
+
+  /* The first byte rules out almost all the handlers, memcmp only runs on the likely ones */
+  for (i = 0; i < parser->handlers_count; i++) {
+    UserDataHandlerEntry * entry = &parser->handlers[i];
+
+    if ((entry->uuid[0] == payload[0]) && !memcmp(entry->uuid, payload, UUID_ISO_IEC_SIZE)) {
+      entry->handler(payload + UUID_ISO_IEC_OFFSET, size - UUID_ISO_IEC_OFFSET, entry->context);
+      return 1;
+    }
+  }
+
+  return 0;
+}
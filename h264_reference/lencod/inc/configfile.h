@@ -29,6 +29,15 @@
 /* Hysteresis (in frame numbers) to confirm that the tracked object is still there */
 #define OBJECT_DETECTION_TRACKING_HYSTERESIS 60 
 
+/* Hysteresis (in frame numbers) to search the whole frame for new objects while tracking, 0 disables it */
+#define OBJECT_DETECTION_DISCOVERY_HYSTERESIS 120
+
+/* Max number of frames waiting for the detection worker */
+#define OBJECT_DETECTION_ASYNC_QUEUE_SIZE    4
+
+/* Number of threads scanning the search scales (needs OpenMP) */
+#define OBJECT_DETECTION_THREADS             1
+
 InputParameters cfgparams;
 
 
@@ -95,6 +104,8 @@ Mapping Map[] = {
     {"MbLineIntraUpdate",        &cfgparams.intra_upd,                    0,   0.0,                       1,  0.0,              1.0,                             },
     {"SliceMode",                &cfgparams.slice_mode,                   0,   0.0,                       1,  0.0,              3.0,                             },
     {"SliceArgument",            &cfgparams.slice_argument,               0,   1.0,                       2,  1.0,              1.0,                             },
+    {"SliceThreads",             &cfgparams.SliceThreads,                 0,   0.0,                       2,  0.0,              0.0,                             },
+    {"WavefrontThreads",         &cfgparams.WavefrontThreads,             0,   0.0,                       2,  0.0,              0.0,                             },
     {"UseConstrainedIntraPred",  &cfgparams.UseConstrainedIntraPred,      0,   0.0,                       1,  0.0,              1.0,                             },
     {"InputFile1",               &cfgparams.input_file1.fname,            1,   0.0,                       0,  0.0,              0.0,             FILE_NAME_SIZE, },
     {"InputFile",                &cfgparams.input_file1.fname,            1,   0.0,                       0,  0.0,              0.0,             FILE_NAME_SIZE, },
@@ -286,6 +297,7 @@ Mapping Map[] = {
     {"DisplayEncParams",         &cfgparams.DisplayEncParams,             0,   0.0,                       1,  0.0,              1.0,                             },
     {"Verbose",                  &cfgparams.Verbose,                      0,   1.0,                       1,  0.0,              4.0,                             },
     {"SkipGlobalStats",          &cfgparams.skip_gl_stats,                0,   0.0,                       1,  0.0,              1.0,                             },
+    {"LumaMCBuffer",             &cfgparams.LumaMCBuffer,                 0,   1.0,                       1,  0.0,              1.0,                             },
     {"ChromaMCBuffer",           &cfgparams.ChromaMCBuffer,               0,   0.0,                       1,  0.0,              1.0,                             },
     {"ChromaMEEnable",           &cfgparams.ChromaMEEnable,               0,   0.0,                       1,  0.0,              2.0,                             },
     {"ChromaMEWeight",           &cfgparams.ChromaMEWeight,               0,   1.0,                       2,  1.0,              0.0,                             },
@@ -418,6 +430,8 @@ Mapping Map[] = {
     {"SetMVYLimit",              &cfgparams.SetMVYLimit,                  0,   0.0,                       1,  0.0,            512.0,                             },
     // Fast ME enable
     {"SearchMode",               &cfgparams.SearchMode,                   0,   0.0,                       1, -1.0,              3.0,                             },
+    // Distortion kernels
+    {"DistortionSIMD",           &cfgparams.DistortionSIMD,               0,   0.0,                       1,  0.0,              4.0,                             },
     // Parameters for UMHEX control
     {"UMHexDSR",                 &cfgparams.UMHexDSR,                     0,   1.0,                       1,  0.0,              1.0,                             },
     {"UMHexScale",               &cfgparams.UMHexScale,                   0,   1.0,                       0,  0.0,              0.0,                             },
@@ -518,9 +532,15 @@ Mapping Map[] = {
     {"object_detection_enable",                &cfgparams.object_detection_enable,                0,  OBJECT_DETECTION_ACTIVATE,             1,  0.0,              1.0,     },
     {"object_detection_search_hysteresis",     &cfgparams.object_detection_search_hysteresis,     0,  OBJECT_DETECTION_SEARCH_HYSTERESIS,    0,  0.0,              0.0,     },
     {"object_detection_tracking_hysteresis",   &cfgparams.object_detection_tracking_hysteresis,   0,  OBJECT_DETECTION_TRACKING_HYSTERESIS,  0,  0.0,              0.0,     },
+    {"object_detection_discovery_hysteresis",  &cfgparams.object_detection_discovery_hysteresis,  0,  OBJECT_DETECTION_DISCOVERY_HYSTERESIS, 2,  0.0,              0.0,     },
     {"object_detection_min_width",             &cfgparams.object_detection_min_width,             0,  OBJECT_DETECTION_MIN_WIDTH,            0,  0.0,              0.0,     },
     {"object_detection_min_height",            &cfgparams.object_detection_min_height,            0,  OBJECT_DETECTION_MIN_HEIGHT,           0,  0.0,              0.0,     },
     {"object_detection_training_file",         &cfgparams.object_detection_training_file,         1,  0.0,                                   0,  0.0,              0.0,  FILE_NAME_SIZE,},
+    {"object_detection_async",                 &cfgparams.object_detection_async,                 0,  0.0,                                   1,  0.0,              1.0,     },
+    {"object_detection_async_queue_size",      &cfgparams.object_detection_async_queue_size,      0,  OBJECT_DETECTION_ASYNC_QUEUE_SIZE,     2,  1.0,              0.0,     },
+    {"object_detection_threads",               &cfgparams.object_detection_threads,               0,  OBJECT_DETECTION_THREADS,              2,  1.0,              0.0,     },
+    {"object_detection_sparse_metadata",       &cfgparams.object_detection_sparse_metadata,       0,  0.0,                                   1,  0.0,              1.0,     },
+    {"object_detection_qp_offset",             &cfgparams.object_detection_qp_offset,             0,  0.0,                                   1, -26.0,             0.0,     },
 
     {NULL,                       NULL,                                   -1,   0.0,                       0,  0.0,              0.0,                             },
 };
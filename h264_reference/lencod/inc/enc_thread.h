@@ -0,0 +1,38 @@
+/*!
+ ************************************************************************
+ * \file
+ *     enc_thread.h
+ *
+ * \author
+ *    Tiago Katcipis                 <tiagokatcipis@gmail.com>
+ *
+ * \brief
+ *    Headerfile for the copies of the encoder state of the encoder
+ *    threads. A thread codes on its own copy of VideoParameters, with
+ *    its own mode decision and motion search scratch, statistics and
+ *    picture.
+ **************************************************************************
+ */
+
+#ifndef _ENC_THREAD_H_
+#define _ENC_THREAD_H_
+
+//! copy of the encoder state of a thread
+typedef struct enc_thread
+{
+  VideoParameters      p_Vid;        //!< copy of the encoder state for the macroblocks being coded
+  StatParameters       stats;        //!< statistics of the copy, only bit_slice is written
+  StorablePicture      enc_picture;  //!< the picture being coded, with the statistics of the thread
+  // scratch of the copy
+  Block8x8Info        *b8x8info;
+  distblk          ****motion_cost;
+  struct me_full_fast *p_ffast_me;
+  struct subpel_cache *p_subpel;
+} EncThread;
+
+extern void    init_enc_thread   (EncThread *t, VideoParameters *p_Vid, InputParameters *p_Inp);
+extern void    free_enc_thread   (EncThread *t);
+extern VideoParameters *start_enc_thread (EncThread *t, VideoParameters *p_Vid);
+extern void    set_slice_encoder (Slice *currSlice, VideoParameters *p_Vid);
+
+#endif
@@ -30,6 +30,7 @@
 #include "rc_types.h"
 #include "pred_struct_types.h"
 #include "metadata_extractor.h"
+#include "region_qp.h"
 
 typedef struct bit_stream Bitstream;
 
@@ -45,6 +46,10 @@ struct storable_picture;
 struct coding_state;
 struct pic_motion_params_old;
 struct pic_motion_params;
+struct interpolation_kernels;
+struct subpel_cache;
+struct slice_threads;
+struct mb_wavefront;
 
 typedef struct image_structure
 {  
@@ -1331,6 +1336,16 @@ typedef struct video_par
 
   /* KATCIPIS - metadata extractor */
   MetadataExtractor * metadata_extractor;
+  /* The SEI NALU of the metadata is reused by every picture */
+  NALU_t * metadata_sei_nalu;
+  ExtractedMetadataCodec * metadata_codec;
+  /* KATCIPIS - frame number of the metadata of the current frame, the decoder gets it from the POC too */
+  unsigned int metadata_frame;
+  unsigned int metadata_idr_frame;
+  unsigned int metadata_next_frame;
+  /* KATCIPIS - QP offsets of the tracked objects, the base QP of the last macroblock is kept without them */
+  RegionQP * region_qp;
+  int region_base_qp;
 
   int offset_y, offset_cr;
   int wka0, wka1, wka2, wka3, wka4;
@@ -1374,6 +1389,15 @@ typedef struct video_par
   distblk (*computeUniPred[6])   (struct storable_picture *ref1, struct me_block *, distblk , MotionVector * );
   distblk (*computeBiPred1[3])   (struct storable_picture *ref1, struct storable_picture *ref2, struct me_block*, distblk , MotionVector *, MotionVector *);
   distblk (*computeBiPred2[3])   (struct storable_picture *ref1, struct storable_picture *ref2, struct me_block*, distblk , MotionVector *, MotionVector *);
+
+  // Row kernels of the sub-pel interpolation
+  const struct interpolation_kernels *interp_kernels;
+  // On demand sub-pel samples (LumaMCBuffer = 0)
+  struct subpel_cache *p_subpel;
+  // Threads of the slice encoder (SliceThreads)
+  struct slice_threads *p_slice_threads;
+  // Threads of the wavefront macroblock coding (WavefrontThreads)
+  struct mb_wavefront *p_wavefront;
 } VideoParameters;
 
 
@@ -0,0 +1,193 @@
+/*!
+ *******************************************************************************
+ *  \file
+ *     haar_cascade.h
+ *  \brief
+ *     definitions for the Haar cascade object detector.
+ *  \author(s)
+ *      - Tiago Katcipis                             <tiagokatcipis@gmail.com>
+ *
+ * *****************************************************************************
+ */
+
+#ifndef HAAR_CASCADE_H
+#define HAAR_CASCADE_H
+
+/* Just like the metadata extractor this module does not include anything from the JM
+   reference software, it is also used by the haar_test outside the encoder. */
+
+typedef struct _HaarCascade HaarCascade;
+typedef struct _HaarWorkspace HaarWorkspace;
+
+typedef struct _HaarRect {
+  int x;
+  int y;
+  int width;
+  int height;
+} HaarRect;
+
+typedef struct _HaarDetectionParams {
+  /* How big of a jump there is between each scale */
+  double scale_factor;
+
+  /* Min number of overlapping detections to decide an object is present on a location */
+  int min_neighbors;
+
+  /* Object size limits */
+  int min_width;
+  int min_height;
+  int max_width;
+  int max_height;
+
+  /* Search from the biggest scale to the smallest, stopping on the first scale with an object */
+  int find_biggest_object;
+
+  /* Windows with a standard deviation below this are flat, they are rejected without running the cascade */
+  double min_window_stddev;
+
+  /* Number of threads scanning the scales (needs OpenMP, ignored otherwise) */
+  int threads;
+} HaarDetectionParams;
+
+
+/* HaarCascade API */
+
+/*!
+ *******************************************************************************
+ * Loads a cascade from an OpenCV haar classifier XML file
+ * (like haarcascade_frontalface_alt.xml). Tilted features are not supported.
+ *
+ * @param filename The training file.
+ * @return The cascade or NULL in case of error.
+ *
+ *******************************************************************************
+ */
+HaarCascade * haar_cascade_load(const char * filename);
+
+/*!
+ *******************************************************************************
+ * Frees a cascade.
+ *
+ * @param cascade The cascade.
+ *
+ *******************************************************************************
+ */
+void haar_cascade_free(HaarCascade * cascade);
+
+/*!
+ *******************************************************************************
+ * Gets the size of the window the cascade has been trained with.
+ * Any parameter can be ommited (passing NULL).
+ *
+ * @param cascade The cascade.
+ * @param width The window width. (OUT) (Optional)
+ * @param height The window height. (OUT) (Optional)
+ *
+ *******************************************************************************
+ */
+void haar_cascade_get_window_size(HaarCascade * cascade, int * width, int * height);
+
+/*!
+ *******************************************************************************
+ * Fills the detection params with the defaults (the same used by the OpenCV
+ * face detection samples).
+ *
+ * @param params The params.
+ *
+ *******************************************************************************
+ */
+void haar_detection_params_init(HaarDetectionParams * params);
+
+/*!
+ *******************************************************************************
+ * Searches objects on the image whose integral images have been computed on
+ * the workspace with haar_workspace_compute_integral_images. Nothing is
+ * allocated unless the workspace needs to grow.
+ *
+ * The scales are split on bands of rows scanned by params->threads threads,
+ * the result is the same whatever the number of threads.
+ *
+ * @param cascade The cascade.
+ * @param workspace The workspace.
+ * @param params The detection params.
+ * @param results Where the found objects will be stored.
+ * @param max_results Size of the results array.
+ * @return Number of objects stored on results.
+ *
+ *******************************************************************************
+ */
+int haar_cascade_detect(HaarCascade * cascade,
+                        HaarWorkspace * workspace,
+                        const HaarDetectionParams * params,
+                        HaarRect * results,
+                        int max_results);
+
+
+/* HaarWorkspace API */
+
+/*!
+ *******************************************************************************
+ * Creates the memory used by the detection for images up to the given size.
+ *
+ * @param cascade The cascade that will be used with this workspace.
+ * @param max_width Max width of the searched images.
+ * @param max_height Max height of the searched images.
+ * @return The workspace or NULL in case of error.
+ *
+ *******************************************************************************
+ */
+HaarWorkspace * haar_workspace_new(HaarCascade * cascade, int max_width, int max_height);
+
+/*!
+ *******************************************************************************
+ * Frees a workspace.
+ *
+ * @param workspace The workspace.
+ *
+ *******************************************************************************
+ */
+void haar_workspace_free(HaarWorkspace * workspace);
+
+/*!
+ *******************************************************************************
+ * Computes the integral and squared integral images of an 8 bits image, using
+ * SSE2/AVX2 when available. The image can not be bigger than the workspace.
+ *
+ * @param workspace The workspace.
+ * @param y The image, y[row * stride + col].
+ * @param width The image width.
+ * @param height The image height.
+ * @param stride The distance (in bytes) between two rows.
+ *
+ *******************************************************************************
+ */
+void haar_workspace_compute_integral_images(HaarWorkspace * workspace,
+                                            const unsigned char * y,
+                                            int width,
+                                            int height,
+                                            int stride);
+
+
+/* Image helpers */
+
+/*!
+ *******************************************************************************
+ * Spreads out the brightness values of an 8 bits image (histogram equalization).
+ *
+ * @param src The source image, src[row * src_stride + col].
+ * @param src_stride The distance (in bytes) between two rows of src.
+ * @param dst The destination image, can not be the same as src.
+ * @param dst_stride The distance (in bytes) between two rows of dst.
+ * @param width The image width.
+ * @param height The image height.
+ *
+ *******************************************************************************
+ */
+void haar_equalize_histogram(const unsigned char * src,
+                             int src_stride,
+                             unsigned char * dst,
+                             int dst_stride,
+                             int width,
+                             int height);
+
+#endif
@@ -0,0 +1,61 @@
+/*!
+ ***************************************************************************
+ * \file
+ *    img_interp_simd.h
+ *
+ * \author
+ *    Tiago Katcipis                 <tiagokatcipis@gmail.com>
+ *
+ * \brief
+ *    Headerfile for the row kernels of the sub-pel interpolation. The set
+ *    of kernels is chosen like the one of the motion estimation distortion
+ *    (see me_distortion_simd.h) and every kernel builds exactly the same
+ *    samples of the scalar C one.
+ **************************************************************************
+ */
+
+#ifndef _IMG_INTERP_SIMD_H_
+#define _IMG_INTERP_SIMD_H_
+
+#include "me_distortion_simd.h"
+
+/*!
+ ***************************************************************************
+ * \brief
+ *    Row kernels of the interpolation. The edges of the padded pictures
+ *    are left to the callers, the kernels never read outside of the given
+ *    rows.
+ **************************************************************************
+ */
+typedef struct interpolation_kernels
+{
+  const char *name;
+  DistortionSIMD level;
+
+  //! horizontal six-tap filter, dst[i] from src[i-2] ... src[i+3], tmp keeps the unscaled sums
+  void (*sixtap_hor)    (imgpel *dst, int *tmp, imgpel *src, int width, int max_value);
+  //! vertical six-tap filter, src[0] ... src[5] are the rows j-2 ... j+3
+  void (*sixtap_ver)    (imgpel *dst, imgpel **src, int width, int max_value);
+  //! vertical six-tap filter of the unscaled sums of the horizontal one
+  void (*sixtap_ver_tmp)(imgpel *dst, int **src, int width, int max_value);
+  //! bi-linear average, (src1 + src2 + 1) >> 1
+  void (*bilinear)      (imgpel *dst, imgpel *src1, imgpel *src2, int width);
+  //! chroma filters, the weights add up to 64
+  void (*chroma_hor)    (imgpel *dst, imgpel *src, int width, int weight0, int weight1);
+  void (*chroma_ver)    (imgpel *dst, imgpel *src0, imgpel *src1, int width, int weight0, int weight1);
+  void (*chroma_diag)   (imgpel *dst, imgpel *src0, imgpel *src1, int width,
+                         int weight00, int weight01, int weight10, int weight11);
+} InterpolationKernels;
+
+extern const InterpolationKernels interpolation_kernels_c;
+
+/*!
+ ***************************************************************************
+ * \brief
+ *    Gets the kernels of the given set, or of the best set below it that
+ *    the CPU supports (DIST_SIMD_AUTO gets the best one).
+ **************************************************************************
+ */
+extern const InterpolationKernels *get_interpolation_kernels(int level);
+
+#endif
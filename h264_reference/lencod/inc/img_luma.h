@@ -24,8 +24,8 @@ extern void getSubImageInteger_s   ( StorablePicture *s, imgpel **dstImg, imgpel
 extern void getHorSubImageSixTap   ( VideoParameters *p_Vid, StorablePicture *s, imgpel **dst_imgY, imgpel **ref_imgY);
 extern void getVerSubImageSixTap   ( VideoParameters *p_Vid, StorablePicture *s, imgpel **dst_imgY, imgpel **ref_imgY);
 extern void getVerSubImageSixTapTmp( VideoParameters *p_Vid, StorablePicture *s, imgpel **dst_imgY);
-extern void getSubImageBiLinear    ( StorablePicture *s, imgpel **dstImg, imgpel **srcImgL, imgpel **srcImgR);
-extern void getHorSubImageBiLinear ( StorablePicture *s, imgpel **dstImg, imgpel **srcImgL, imgpel **srcImgR);
-extern void getVerSubImageBiLinear ( StorablePicture *s, imgpel **dstImg, imgpel **srcImgT, imgpel **srcImgB);
-extern void getDiagSubImageBiLinear( StorablePicture *s, imgpel **dstImg, imgpel **srcImgT, imgpel **srcImgB);
+extern void getSubImageBiLinear    ( VideoParameters *p_Vid, StorablePicture *s, imgpel **dstImg, imgpel **srcImgL, imgpel **srcImgR);
+extern void getHorSubImageBiLinear ( VideoParameters *p_Vid, StorablePicture *s, imgpel **dstImg, imgpel **srcImgL, imgpel **srcImgR);
+extern void getVerSubImageBiLinear ( VideoParameters *p_Vid, StorablePicture *s, imgpel **dstImg, imgpel **srcImgT, imgpel **srcImgB);
+extern void getDiagSubImageBiLinear( VideoParameters *p_Vid, StorablePicture *s, imgpel **dstImg, imgpel **srcImgT, imgpel **srcImgB);
 #endif // _IMG_LUMA_H_
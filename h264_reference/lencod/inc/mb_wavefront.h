@@ -0,0 +1,27 @@
+/*!
+ ************************************************************************
+ * \file
+ *     mb_wavefront.h
+ *
+ * \author
+ *    Tiago Katcipis                 <tiagokatcipis@gmail.com>
+ *
+ * \brief
+ *    Headerfile for the wavefront macroblock coding (WavefrontThreads).
+ *    The macroblocks of a picture coded as a single slice are decided in
+ *    parallel on rows that follow each other with a two macroblocks lag,
+ *    and their syntax is written afterwards in raster order.
+ **************************************************************************
+ */
+
+#ifndef _MB_WAVEFRONT_H_
+#define _MB_WAVEFRONT_H_
+
+typedef struct mb_wavefront MBWavefront;
+
+extern void    init_mb_wavefront      (VideoParameters *p_Vid, InputParameters *p_Inp);
+extern void    free_mb_wavefront      (VideoParameters *p_Vid);
+extern Boolean mb_wavefront_usable    (Slice *currSlice);
+extern int     encode_slice_wavefront (Slice *currSlice, Macroblock **currMB);
+
+#endif
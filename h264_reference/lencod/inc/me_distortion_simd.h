@@ -0,0 +1,81 @@
+/*!
+ ***************************************************************************
+ * \file
+ *    me_distortion_simd.h
+ *
+ * \author
+ *    Tiago Katcipis                 <tiagokatcipis@gmail.com>
+ *
+ * \brief
+ *    Headerfile for the block kernels of the motion estimation distortion.
+ *    A table of kernels (scalar C, SSE2, SSSE3 or AVX2) is chosen once, at
+ *    startup, by the features of the CPU. Every kernel gives exactly the
+ *    same results of the scalar C one, including the partial costs of the
+ *    early termination.
+ **************************************************************************
+ */
+
+#ifndef _ME_DISTORTION_SIMD_H_
+#define _ME_DISTORTION_SIMD_H_
+
+//! Kernel sets, the higher ones need more CPU features
+typedef enum
+{
+  DIST_SIMD_AUTO  = 0,  //!< best set supported by the CPU
+  DIST_SIMD_C     = 1,
+  DIST_SIMD_SSE2  = 2,
+  DIST_SIMD_SSSE3 = 3,
+  DIST_SIMD_AVX2  = 4
+} DistortionSIMD;
+
+/*!
+ ***************************************************************************
+ * \brief
+ *    Block kernels of the distortion. The source blocks and the predictions
+ *    built by the kernels are contiguous (stride equal to the width), the
+ *    reference blocks have the stride of the padded reference pictures.
+ *    Widths are multiples of 2, up to 16.
+ **************************************************************************
+ */
+typedef struct distortion_kernels
+{
+  const char *name;
+  DistortionSIMD level;
+
+  //! sum of absolute / squared differences, returns after the first row that makes the cost exceed min_cost
+  int  (*sad)        (imgpel *src, int src_stride, imgpel *ref, int ref_stride, int width, int height, int min_cost);
+  int  (*sse)        (imgpel *src, int src_stride, imgpel *ref, int ref_stride, int width, int height, int min_cost);
+
+  //! differences of a 4x4 / 8x8 block, row-major
+  void (*diff4x4)    (short *diff, imgpel *src, int src_stride, imgpel *ref, int ref_stride);
+  void (*diff8x8)    (short *diff, imgpel *src, int src_stride, imgpel *ref, int ref_stride);
+
+  //! bi-predictive average, (ref1 + ref2 + 1) >> 1
+  void (*pred_avg)   (imgpel *dst, imgpel *ref1, imgpel *ref2, int ref_stride, int width, int height);
+  //! weighted prediction, clip(((weight * ref + round) >> denom) + offset)
+  void (*pred_wp)    (imgpel *dst, imgpel *ref, int ref_stride, int width, int height,
+                      int weight, int round, int denom, int offset, int max_value);
+  //! bi-predictive weighted prediction, clip(((weight1 * ref1 + weight2 * ref2 + round) >> denom) + offset)
+  void (*pred_bi_wp) (imgpel *dst, imgpel *ref1, imgpel *ref2, int ref_stride, int width, int height,
+                      int weight1, int weight2, int round, int denom, int offset, int max_value);
+
+  //! Hadamard-Transformed SAD of a 4x4 / 8x8 difference block
+  int  (*hadamard4x4)(short *diff);
+  int  (*hadamard8x8)(short *diff);
+} DistortionKernels;
+
+extern const DistortionKernels distortion_kernels_c;
+
+//! Best kernel set supported by the CPU
+extern DistortionSIMD get_simd_cpu_level(void);
+
+/*!
+ ***************************************************************************
+ * \brief
+ *    Gets the kernels of the given set, or of the best set below it that
+ *    the CPU supports (DIST_SIMD_AUTO gets the best one).
+ **************************************************************************
+ */
+extern const DistortionKernels *get_distortion_kernels(int level);
+
+#endif
@@ -14,11 +14,12 @@
 #define METADATA_EXTRACTOR_H
 
 /* Since JM reference software does a lot of nice good beautifull typedefs like uint64, int64, etc.
-   i cant use anything from the JM reference software here, it clashes with other beautifull typedefs made by 
+   i cant use anything from the JM reference software here, it used to clash with other beautifull typedefs made by 
    OpenCV (including global.h breaks everything). Isnt just great when people do typedefs with GOOD names ? :-)
    yeah, long names seems to be nasty, but at least they dont CLASH with other type names ;-) */
 
 #include "extracted_metadata.h"
+#include "object_tracker.h"
 
 typedef struct _MetadataExtractor MetadataExtractor;
 
@@ -27,10 +28,14 @@ typedef struct _MetadataExtractor MetadataExtractor;
  *********************************************************************************
  * Creates a new metadata extractor.  
  *
+ * @param frame_width           Width of the luma plane of the frames, used to allocate the search memory.
+ * @param frame_height          Height of the luma plane of the frames, used to allocate the search memory.
  * @param min_width             Min width of the object that will be detected.
  * @param min_height            Min height of the object that will be detected.
  * @param search_hysteresis     Search for new object hysteresys (in frames).
- * @param tracking_hysteresis   Confirm tracked object existence hysteresis (in frames).
+ * @param tracking_hysteresis   Confirm tracked objects existence hysteresis (in frames).
+ * @param discovery_hysteresis  While tracking, search the whole frame for new objects
+ *                              hysteresis (in frames). 0 disables it.
  * @param training_file         File containing the training info used on the object detection.
  *
  * @return A MetadataExtractor object.
@@ -38,10 +43,13 @@ typedef struct _MetadataExtractor MetadataExtractor;
  *
  *********************************************************************************
  */
-MetadataExtractor * metadata_extractor_new(int min_width,
+MetadataExtractor * metadata_extractor_new(int frame_width,
+                                           int frame_height,
+                                           int min_width,
                                            int min_height,
                                            int search_hysteresis,
                                            int tracking_hysteresis,
+                                           int discovery_hysteresis,
                                            const char * training_file);
 
 
@@ -59,15 +67,67 @@ void metadata_extractor_free(MetadataExtractor * extractor);
 
 /*!
  *********************************************************************************
- * Extracts the interest object bounding box as a metadata from the Y plane.
+ * Moves the object search to a detection worker thread. The extractor copies the
+ * luma plane of the frames that must be searched to a bounded queue and returns
+ * right away, up to queue_size frames may wait for the worker. The detections
+ * are applied when a later frame is extracted, moved by the motion since the
+ * searched frame, and returned as the boxes of that frame. If the queue is full 
+ * the search is retried on the next frame.
+ *
+ * @param extractor  The metadata extractor object.
+ * @param queue_size Max number of frames waiting for the worker.
+ *
+ * @return 1 on success, 0 in case of error (the search stays synchronous).
+ *
+ *********************************************************************************
+ */
+int metadata_extractor_enable_async_detection(MetadataExtractor * extractor, int queue_size);
+
+/*!
+ *********************************************************************************
+ * Sets how many threads scan the scales of each object search. The scales are
+ * split on bands of rows, the detected objects do not depend on the number of
+ * threads. Without OpenMP the search always uses one thread.
+ *
+ * @param extractor The metadata extractor object.
+ * @param threads   Number of search threads.
+ *
+ *********************************************************************************
+ */
+void metadata_extractor_set_detection_threads(MetadataExtractor * extractor, int threads);
+
+/*!
+ *********************************************************************************
+ * Only returns the bounding boxes of the frames where the objects have been 
+ * searched or confirmed (or where an async search result has been applied), 
+ * the decoder tracks the objects between them with the decoded motion vectors
+ * (see object_tracker.h). If all the objects are lost on 
+ * a search an empty list is returned, so the decoder stops tracking them.
+ *
+ * @param extractor The metadata extractor object.
+ * @param sparse    1 to enable the sparse metadata, 0 to return the boxes of every frame.
+ *
+ *********************************************************************************
+ */
+void metadata_extractor_set_sparse_metadata(MetadataExtractor * extractor, int sparse);
+
+
+/*!
+ *********************************************************************************
+ * Extracts the bounding boxes of all the tracked interest objects as one
+ * ExtractedObjectBoundingBoxList metadata from the Y plane. Each object keeps
+ * its id while it is tracked.
  *
  * @param extractor    The MetadataExtractor object.
  * @param frame_number The frame number.
  * @param y            The luma plane, y[i][j] where i is the row and j the column.
+ *                     The plane must be contiguous, y[i] == y[0] + i * stride.
+ *                     It is searched in place, no copy or color conversion is made.
  * @param width        The luma plane width.
  * @param height       The luma plane height.
+ * @param stride       The distance (in bytes) between two rows of the luma plane.
  *
- * @return The metadata or NULL if the interest object is not foundd on the frame.
+ * @return The metadata or NULL if no interest object is tracked on the frame.
  *
  *********************************************************************************
  */
@@ -75,27 +135,38 @@ ExtractedMetadata * metadata_extractor_extract_object_bounding_box(MetadataExtra
                                                                    unsigned int frame_number,
                                                                    unsigned char ** y,
                                                                    int width,
-                                                                   int height);
+                                                                   int height,
+                                                                   int stride);
+
+/*!
+ *********************************************************************************
+ * Gets the bounding boxes of the objects tracked on the last frame given to
+ * metadata_extractor_extract_object_bounding_box, even when the metadata is 
+ * sparse or the search is asynchronous.
+ *
+ * @param extractor    The MetadataExtractor object.
+ * @param frame_number The frame number.
+ *
+ * @return The metadata (a ExtractedObjectBoundingBoxList) or NULL if no interest
+ *         object is tracked.
+ *
+ *********************************************************************************
+ */
+ExtractedMetadata * metadata_extractor_get_tracked_metadata(MetadataExtractor * extractor, unsigned int frame_number);
 
 /*!
  *********************************************************************************
- * Add usefull info about block motion estimation, allowing the extractor 
- * to do object tracking.Eliminating the need to process every frame 
+ * Add usefull info about the picture motion estimation, allowing the extractor 
+ * to do object tracking. Eliminating the need to process every frame 
  * to know the new position of a previously detected object.
+ * See object_tracker_add_motion_vector_field.
  *
- * @param extractor           The MetadataExtractor object.
- * @param block_x             The block x position.
- * @param block_y             The block y position.
- * @param x_motion_estimation The motion estimation for x (in QPEL units). 
- * @param y_motion_estimation The motion estimation for y (in QPEL units).
+ * @param extractor The MetadataExtractor object.
+ * @param field     The motion vectors of the picture.
  *
  *********************************************************************************
  */
-void metadata_extractor_add_motion_estimation_info(MetadataExtractor * extractor,
-                                                   short block_x, 
-                                                   short block_y,
-                                                   short x_motion_estimation,
-                                                   short y_motion_estimation);
+void metadata_extractor_add_motion_vector_field(MetadataExtractor * extractor, const MotionVectorField * field);
 
 
 /*!
@@ -104,9 +175,10 @@ void metadata_extractor_add_motion_estimation_info(MetadataExtractor * extractor
 *
 * @param extractor The MetadataExtractor object.
 * @param frame_number The frame number.
-* @param y The luma plane, y[i][j] where i is the row and j the column.
+* @param y The luma plane, y[i][j] where i is the row and j the column (contiguous).
 * @param width The luma plane width.
 * @param height The luma plane height.
+* @param stride The distance (in bytes) between two rows of the luma plane.
 *
 * @return The metadata or NULL if the interest object is not foundd on the frame.
 *
@@ -116,5 +188,6 @@ ExtractedMetadata * metadata_extractor_extract_raw_object(MetadataExtractor * ex
                                                           unsigned int frame_number,
                                                           unsigned char ** y,
                                                           int width,
-                                                          int height);
+                                                          int height,
+                                                          int stride);
 #endif
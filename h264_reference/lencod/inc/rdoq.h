@@ -196,6 +196,7 @@ extern void RDOQ_update_mode    (Slice *currSlice, RD_PARAMS *enc_mb);
 extern void copy_rddata_trellis (Macroblock *currMB, RD_DATA *dest, RD_DATA *src);
 extern void updateMV_mp         (Macroblock *currMB, distblk *m_cost, short ref, int list, int h, int v, int blocktype, int block8x8);
 extern void trellis_coding      (Macroblock *currMB);
+extern void trellis_sp_mode_decision (Macroblock *currMB);
 extern void get_dQP_table       (Slice *currSlice);
 
 #endif  // _RDOQ_H_
@@ -11,6 +11,7 @@
 #define _REBUF_H_
 
 #include "mbuffer.h"
+#include "subpel_cache.h"
 
 /*!
  ************************************************************************
@@ -50,6 +51,40 @@ static inline imgpel *FastLine4X (StorablePicture *ref, int y, int x)
   return &(ref->p_curr_img_sub[(y & 0x03)][(x & 0x03)][y >> 2][x >> 2]);
 }
 
+/*!
+ ************************************************************************
+ * \brief
+ *    Yields a pel block _pointer_ from one of the 16 sub-images, the
+ *    sub-images that are not stored (LumaMCBuffer = 0) are interpolated
+ *    on demand. Blocks are up to 16x16, with the stride of the padded
+ *    pictures. Input does not require subpixel image indices
+ ************************************************************************
+ */
+static inline imgpel *UMVBlock4X (SubPelCache *cache, StorablePicture *ref, int y, int x, int width, int height)
+{
+  if (ref->p_curr_img_sub[(y & 0x03)][(x & 0x03)])
+    return UMVLine4X(ref, y, x);
+
+  return get_subpel_block(cache, ref, (y & 0x03), (x & 0x03), iClip3( -IMG_PAD_SIZE_Y, ref->size_y_pad, y >> 2), iClip3(-IMG_PAD_SIZE_X, ref->size_x_pad, x >> 2), width, height);
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *    Yields a pel block _pointer_ from one of the 16 sub-images, the
+ *    sub-images that are not stored (LumaMCBuffer = 0) are interpolated
+ *    on demand. Blocks are up to 16x16, with the stride of the padded
+ *    pictures. Input does not require subpixel image indices
+ ************************************************************************
+ */
+static inline imgpel *FastBlock4X (SubPelCache *cache, StorablePicture *ref, int y, int x, int width, int height)
+{
+  if (ref->p_curr_img_sub[(y & 0x03)][(x & 0x03)])
+    return FastLine4X(ref, y, x);
+
+  return get_subpel_block(cache, ref, (y & 0x03), (x & 0x03), y >> 2, x >> 2, width, height);
+}
+
 /*!
  ************************************************************************
  * \brief
@@ -0,0 +1,91 @@
+/*!
+ *******************************************************************************
+ *  \file
+ *     region_qp.h
+ *  \brief
+ *     definitions for the region QP map. The macroblocks of the tracked objects
+ *     get a QP offset and the rest of the picture compensates it, keeping the
+ *     mean QP of the picture (and so roughly its bitrate) unchanged.
+ *  \author(s)
+ *      - Tiago Katcipis                             <tiagokatcipis@gmail.com>
+ *
+ * *****************************************************************************
+ */
+
+#ifndef REGION_QP_H
+#define REGION_QP_H
+
+/* Just like the metadata extractor, nothing from the JM reference software is used here. */
+
+#include "extracted_metadata.h"
+
+typedef struct _RegionQP RegionQP;
+
+
+/*!
+ *********************************************************************************
+ * Creates a new region QP map.
+ *
+ * @param width_in_mbs  Width of the frames in macroblocks.
+ * @param height_in_mbs Height of the frames in macroblocks.
+ * @param offset        QP offset of the macroblocks of the objects (negative to
+ *                      spend more bits on them).
+ *
+ * @return A RegionQP object or NULL in case of error.
+ *
+ *********************************************************************************
+ */
+RegionQP * region_qp_new(int width_in_mbs, int height_in_mbs, int offset);
+
+/*!
+ *********************************************************************************
+ * Free a region QP map.
+ *
+ * @param region_qp The RegionQP object.
+ *
+ *********************************************************************************
+ */
+void region_qp_free(RegionQP * region_qp);
+
+/*!
+ *********************************************************************************
+ * Builds the map of a frame from its bounding boxes. A macroblock belongs to an
+ * object when its center is inside the box.
+ *
+ * @param region_qp The RegionQP object.
+ * @param metadata  The bounding boxes of the frame (a box or a list), NULL if
+ *                  there is no object on the frame.
+ *
+ *********************************************************************************
+ */
+void region_qp_set_metadata(RegionQP * region_qp, ExtractedMetadata * metadata);
+
+/*!
+ *********************************************************************************
+ * Tells if the map of the current frame has some object.
+ *
+ * @param region_qp The RegionQP object.
+ *
+ * @return 1 if some macroblock has an offset, 0 otherwise.
+ *
+ *********************************************************************************
+ */
+int region_qp_is_active(RegionQP * region_qp);
+
+/*!
+ *********************************************************************************
+ * Gets the QP offset of a macroblock of the current frame.
+ *
+ * @param region_qp The RegionQP object.
+ * @param mb_x      Column of the macroblock.
+ * @param mb_y      Row of the macroblock, on field units if field is set.
+ * @param field     1 if the macroblock belongs to a field picture, it covers
+ *                  two rows of frame macroblocks.
+ *
+ * @return The QP offset.
+ *
+ *********************************************************************************
+ */
+int region_qp_get_offset(RegionQP * region_qp, int mb_x, int mb_y, int field);
+
+#endif
@@ -35,6 +35,9 @@ static const int QP2QUANT[40]=
 
 
 extern int  encode_one_slice       ( VideoParameters *p_Vid, int SliceGroupId, int TotalCodedMBs );
+extern Slice *start_one_slice      ( VideoParameters *p_Vid, int SliceGroupId, StatParameters *cur_stats );
+extern int  encode_slice_macroblocks ( Slice *currSlice, Macroblock **currMB );
+extern void end_one_slice          ( Slice *currSlice, Macroblock *currMB, int lastslice, StatParameters *cur_stats );
 extern int  encode_one_slice_MBAFF ( VideoParameters *p_Vid, int SliceGroupId, int TotalCodedMBs );
 extern void init_slice             ( VideoParameters *p_Vid, Slice **currSlice, int start_mb_addr );
 extern void init_slice_lite        ( VideoParameters *p_Vid, Slice **currSlice, int start_mb_addr );
@@ -45,6 +48,8 @@ extern void CalcMaxLamdaMD(VideoParameters *p_Vid, double *p_lambda_md);
 extern void SetLagrangianMultipliersOn (Slice *currSlice);
 extern void SetLagrangianMultipliersOff(Slice *currSlice);
 extern void  free_slice                (Slice *currSlice);
+extern Slice *clone_slice              (Slice *currSlice, int buffer_size);
+extern void  free_slice_clone          (Slice *clone);
 
 
 #endif
@@ -0,0 +1,27 @@
+/*!
+ ************************************************************************
+ * \file
+ *     slice_threads.h
+ *
+ * \author
+ *    Tiago Katcipis                 <tiagokatcipis@gmail.com>
+ *
+ * \brief
+ *    Headerfile for the threads of the slice encoder (SliceThreads). The
+ *    slices of a fixed number of macroblocks (SliceMode = 1) of a picture
+ *    are coded in parallel, each thread with its own copy of the encoder
+ *    state, and their NAL units are written in order.
+ **************************************************************************
+ */
+
+#ifndef _SLICE_THREADS_H_
+#define _SLICE_THREADS_H_
+
+typedef struct slice_threads SliceThreads;
+
+extern void    init_slice_threads       (VideoParameters *p_Vid, InputParameters *p_Inp);
+extern void    free_slice_threads       (VideoParameters *p_Vid);
+extern Boolean slice_threads_usable     (VideoParameters *p_Vid);
+extern int     encode_slices_in_threads (VideoParameters *p_Vid);
+
+#endif
@@ -0,0 +1,40 @@
+/*!
+ ***************************************************************************
+ * \file
+ *    subpel_cache.h
+ *
+ * \author
+ *    Tiago Katcipis                 <tiagokatcipis@gmail.com>
+ *
+ * \brief
+ *    Headerfile for the on demand quarter-pel luma samples (LumaMCBuffer = 0).
+ *    The reference pictures keep only their integer samples, the blocks of
+ *    the other 15 sub-pel positions are interpolated when the motion search
+ *    or the motion compensation asks for them, through a small cache of
+ *    tiles. The samples are exactly the ones of getSubImagesLuma.
+ **************************************************************************
+ */
+
+#ifndef _SUBPEL_CACHE_H_
+#define _SUBPEL_CACHE_H_
+
+typedef struct subpel_cache SubPelCache;
+
+extern int  init_subpel_cache (VideoParameters *p_Vid);
+extern void free_subpel_cache (VideoParameters *p_Vid);
+extern void reset_subpel_cache(SubPelCache *cache);
+
+/*!
+ ***************************************************************************
+ * \brief
+ *    Gets the block of the sub-pel position (phase_y, phase_x) at the
+ *    integer position (j, i) of the luma plane of ref. Blocks are up to
+ *    16x16 and have the stride of the padded pictures (padded_size_x).
+ *    A block stays valid until the second next call, so the two blocks
+ *    of a bi-predictive pair can be used together.
+ **************************************************************************
+ */
+extern imgpel *get_subpel_block(SubPelCache *cache, StorablePicture *ref, int phase_y, int phase_x,
+                                int j, int i, int width, int height);
+
+#endif
@@ -18,7 +18,8 @@
 
 /*!
  *****************************************************************************************
- * Generates a SEI NALU that with ONE unregistered userdata SEI message.
+ * Generates a SEI NALU that with ONE unregistered userdata SEI message, with
+ * a random uuid_iso_iec_11578.
  *
  * @param data The data to be sent on the SEI unregistered userdata message.
  * @param size The size of the data.
@@ -28,6 +29,23 @@
  */
 NALU_t *user_data_generate_unregistered_sei_nalu(char * data, unsigned int size);
 
+/*!
+ *****************************************************************************************
+ * Writes ONE unregistered userdata SEI message on a SEI NALU. The message is byte
+ * aligned, the data is copied straight to the NALU buffer inserting the emulation
+ * prevention bytes. The NALU buffer is reallocated only if it is too small, so the
+ * same NALU can be used for every message.
+ *
+ * @param nalu The NALU to be filled or NULL to allocate a new one.
+ * @param uuid The 16 bytes uuid_iso_iec_11578 of the message, NULL for a random one.
+ * @param data The data to be sent on the SEI unregistered userdata message.
+ * @param size The size of the data.
+ * @return The SEI NALU containing the SEI message, it must be freed with FreeNALU.
+ *
+ *****************************************************************************************
+ */
+NALU_t *user_data_fill_unregistered_sei_nalu(NALU_t * nalu, const byte * uuid, char * data, unsigned int size);
+
 /*!
  *****************************************************************************************
  * Generates a SEI NALU that with ONE unregistered userdata SEI message.
@@ -1240,6 +1240,43 @@ static void PatchInp (VideoParameters *p_Vid, InputParameters *p_Inp)
     p_Inp->RDOQ_CP_Mode = 0;
   }
 
+  // the slices coded on their own threads have to give the bitstream of the single threaded encoder
+  if (p_Inp->SliceThreads && (p_Inp->slice_mode != FIXED_MB || p_Inp->num_slice_groups_minus1 || p_Inp->MbInterlace
+    || p_Inp->RCEnable || p_Inp->AdaptiveRounding || p_Inp->rdopt == 3 || p_Inp->WPIterMC
+    || p_Inp->separate_colour_plane_flag || p_Inp->redundant_pic_flag
+    || (p_Inp->SearchMode != FULL_SEARCH && p_Inp->SearchMode != FAST_FULL_SEARCH && p_Inp->SearchMode != EPZS)))
+  {
+    printf("SliceThreads is only supported with SliceMode = 1 and Full, Fast Full or EPZS search, without FMO, MBAFF,\n"
+      "rate control, adaptive rounding, error resilient RDO, WPIterMC or redundant pictures. Option disabled.\n");
+    p_Inp->SliceThreads = 0;
+  }
+#if (MVC_EXTENSION_ENABLE)
+  if (p_Inp->SliceThreads && p_Inp->num_of_views != 1)
+  {
+    printf("SliceThreads is not supported with MVC. Option disabled.\n");
+    p_Inp->SliceThreads = 0;
+  }
+#endif
+
+  // the wavefront decides a macroblock with the state its row has, the tools that carry state from a macroblock to the next are left out
+  if (p_Inp->WavefrontThreads && (p_Inp->slice_mode != NO_SLICES || p_Inp->num_slice_groups_minus1 || p_Inp->MbInterlace
+    || p_Inp->RCEnable || p_Inp->AdaptiveRounding || p_Inp->rdopt == 3 || p_Inp->WPIterMC || p_Inp->CtxAdptLagrangeMult
+    || p_Inp->RDOQ_QP_Num > 1 || p_Inp->yuv_format == YUV444 || p_Inp->redundant_pic_flag
+    || (p_Inp->SearchMode != FULL_SEARCH && p_Inp->SearchMode != FAST_FULL_SEARCH)))
+  {
+    printf("WavefrontThreads is only supported with SliceMode = 0 and Full or Fast Full search, without FMO, MBAFF,\n"
+      "rate control, adaptive rounding, error resilient RDO, WPIterMC, context adaptive lambdas, RDOQ with several QPs,\n"
+      "4:4:4 or redundant pictures. Option disabled.\n");
+    p_Inp->WavefrontThreads = 0;
+  }
+#if (MVC_EXTENSION_ENABLE)
+  if (p_Inp->WavefrontThreads && p_Inp->num_of_views != 1)
+  {
+    printf("WavefrontThreads is not supported with MVC. Option disabled.\n");
+    p_Inp->WavefrontThreads = 0;
+  }
+#endif
+
   if(p_Inp->num_slice_groups_minus1 > 0 && (p_Inp->GenerateMultiplePPS ==1 && p_Inp->RDPictureDecision == 1))
   {
     printf("Warning: Weighted Prediction may not function correctly for multiple slices\n"); 
@@ -0,0 +1,128 @@
+/*!
+*************************************************************************************
+* \file enc_thread.c
+*
+* \brief
+*    Copies of the encoder state of the encoder threads. A thread codes on its own
+*    copy of VideoParameters, which keeps its own mode decision and motion search
+*    scratch (b8x8info, motion_cost, the fast full search and the sub-pel cache),
+*    its own statistics and its own copy of the picture being coded. The rest of
+*    the state (the picture buffers, the macroblock data, the reference lists) is
+*    shared with the encoder.
+*
+* \author
+*    Tiago Katcipis                 <tiagokatcipis@gmail.com>
+*
+*************************************************************************************
+*/
+
+// Includes
+#include "contributors.h"
+
+#include "global.h"
+#include "memalloc.h"
+#include "me_epzs_common.h"
+#include "me_fullfast.h"
+#include "subpel_cache.h"
+#include "enc_thread.h"
+
+/*!
+ ***********************************************************************
+ * \brief
+ *    Allocates the scratch of the copy of the encoder state of a thread
+ ***********************************************************************
+ */
+void init_enc_thread (EncThread *t, VideoParameters *p_Vid, InputParameters *p_Inp)
+{
+  // the sizes of the scratch come from the encoder state
+  memcpy (&t->p_Vid, p_Vid, sizeof (VideoParameters));
+
+  if ((t->b8x8info = (Block8x8Info *) calloc (1, sizeof (Block8x8Info))) == NULL)
+    no_mem_exit ("init_enc_thread: t->b8x8info");
+
+  t->motion_cost = NULL;
+  if (p_Vid->motion_cost)
+    get_mem4Ddistblk (&t->motion_cost, 8, 2, p_Vid->max_num_references, 4);
+
+  t->p_Vid.p_ffast_me = NULL;
+  t->p_ffast_me = NULL;
+  if (p_Vid->p_ffast_me)
+  {
+    InitializeFastFullIntegerSearch (&t->p_Vid, p_Inp);
+    t->p_ffast_me = t->p_Vid.p_ffast_me;
+  }
+
+  t->p_Vid.p_subpel = NULL;
+  t->p_subpel = NULL;
+  if (p_Vid->p_subpel)
+  {
+    init_subpel_cache (&t->p_Vid);
+    t->p_subpel = t->p_Vid.p_subpel;
+  }
+}
+
+/*!
+ ***********************************************************************
+ * \brief
+ *    Frees the scratch of the copy of the encoder state of a thread
+ ***********************************************************************
+ */
+void free_enc_thread (EncThread *t)
+{
+  free (t->b8x8info);
+  if (t->motion_cost)
+    free_mem4Ddistblk (t->motion_cost);
+  if (t->p_ffast_me)
+  {
+    t->p_Vid.p_ffast_me = t->p_ffast_me;
+    ClearFastFullIntegerSearch (&t->p_Vid);
+  }
+  t->p_Vid.p_subpel = t->p_subpel;
+  free_subpel_cache (&t->p_Vid);
+}
+
+/*!
+ ***********************************************************************
+ * \brief
+ *    Copies the encoder state to the copy of a thread, which keeps its
+ *    own scratch, statistics and picture (t->stats and t->enc_picture
+ *    have to be set up by the caller)
+ *
+ * \return
+ *    the copy of the encoder state
+ ***********************************************************************
+ */
+VideoParameters *start_enc_thread (EncThread *t, VideoParameters *p_Vid)
+{
+  VideoParameters *p_Vid_t = &t->p_Vid;
+
+  memcpy (p_Vid_t, p_Vid, sizeof (VideoParameters));
+  p_Vid_t->b8x8info    = t->b8x8info;
+  p_Vid_t->motion_cost = t->motion_cost;
+  p_Vid_t->p_ffast_me  = t->p_ffast_me;
+  p_Vid_t->p_subpel    = t->p_subpel;
+  p_Vid_t->p_Stats     = &t->stats;
+  p_Vid_t->enc_picture = &t->enc_picture;
+
+  return p_Vid_t;
+}
+
+/*!
+ ***********************************************************************
+ * \brief
+ *    Points the slice to the encoder state that codes it
+ ***********************************************************************
+ */
+void set_slice_encoder (Slice *currSlice, VideoParameters *p_Vid)
+{
+  int i;
+
+  currSlice->p_Vid = p_Vid;
+  for (i = 0; i < currSlice->max_part_nr; i++)
+  {
+    currSlice->partArr[i].p_Vid = p_Vid;
+    currSlice->partArr[i].ee_cabac.p_Vid = p_Vid;
+  }
+  if (currSlice->p_EPZS)
+    currSlice->p_EPZS->p_Vid = p_Vid;
+}
@@ -0,0 +1,1552 @@
+#include "haar_cascade.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define HAAR_CASCADE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(HAAR_CASCADE_SSE2) && (defined(__x86_64__) || defined(__i386__)) && \
+    ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))
+#define HAAR_CASCADE_AVX2 1
+#include <immintrin.h>
+#endif
+
+
+/***********************
+ * Module private data *
+ ***********************/
+
+/* The features of the OpenCV haar cascades have 2 or 3 rects */
+#define HAAR_MAX_FEATURE_RECTS 3
+
+typedef struct _HaarFeatureRect {
+  int x;
+  int y;
+  int width;
+  int height;
+  float weight;
+} HaarFeatureRect;
+
+typedef struct _HaarNode {
+  HaarFeatureRect rects[HAAR_MAX_FEATURE_RECTS];
+  int rect_count;
+  float threshold;
+
+  /* > 0 is the index of the next node on the tree, <= 0 is -(index of the leaf value) */
+  int left;
+  int right;
+} HaarNode;
+
+typedef struct _HaarTree {
+  int first_node;
+  int first_alpha;
+} HaarTree;
+
+typedef struct _HaarStage {
+  int first_tree;
+  int tree_count;
+  float threshold;
+} HaarStage;
+
+struct _HaarCascade {
+  /* Size of the window the cascade has been trained with */
+  int window_width;
+  int window_height;
+
+  HaarStage * stages;
+  int stage_count;
+  int stage_capacity;
+
+  HaarTree * trees;
+  int tree_count;
+  int tree_capacity;
+
+  HaarNode * nodes;
+  int node_count;
+  int node_capacity;
+
+  /* Leaf values */
+  float * alphas;
+  int alpha_count;
+  int alpha_capacity;
+};
+
+/* A node with its rects already scaled and translated to offsets on the integral image */
+typedef struct _HaarScaledNode {
+  int offsets[HAAR_MAX_FEATURE_RECTS][4];
+  float weights[HAAR_MAX_FEATURE_RECTS];
+  int rect_count;
+  float threshold;
+  int left;
+  int right;
+} HaarScaledNode;
+
+/* A class of similar candidates, formed when grouping the candidates */
+typedef struct _HaarGroup {
+  int x;
+  int y;
+  int width;
+  int height;
+  int neighbors;
+} HaarGroup;
+
+/* A band of window rows of one scale, the unit of work of the search threads */
+typedef struct _HaarScanTask {
+  int scale;
+  int y_begin;
+  int y_end;
+
+  /* Filled by the thread that scanned the band */
+  int thread;
+  int first_candidate;
+  int candidate_count;
+  int failed;
+} HaarScanTask;
+
+/* Memory owned by one search thread */
+typedef struct _HaarThreadContext {
+  /* The cascade nodes scaled to scaled_factor, rescaled only when the thread moves to another scale */
+  HaarScaledNode * scaled_nodes;
+  double scaled_factor;
+
+  /* Area read by the scaled features, rounding may take it 1 pixel beyond the scaled window */
+  int scaled_extent_width;
+  int scaled_extent_height;
+
+  /* Windows accepted by the cascade on the bands scanned by this thread */
+  HaarRect * candidates;
+  int candidate_count;
+  int candidate_capacity;
+} HaarThreadContext;
+
+typedef void (*HaarIntegralRowFunc) (const unsigned char * src, int width,
+                                     const uint32_t * prev_sum, uint32_t * sum,
+                                     const uint64_t * prev_sqsum, uint64_t * sqsum);
+
+struct _HaarWorkspace {
+  int max_width;
+  int max_height;
+
+  /* Size of the image whose integral images have been computed */
+  int width;
+  int height;
+
+  /* Integral images, (max_height + 1) rows of stride elements. The row 0 and the column 0 are zero.
+     The sum wraps around on huge images, but the difference of 4 points (the sum of a window) is still right. */
+  int stride;
+  uint32_t * sum;
+  uint64_t * sqsum;
+  HaarIntegralRowFunc integral_row;
+
+  /* One context per search thread, grows with the threads param */
+  HaarThreadContext * contexts;
+  int context_count;
+  int node_count;
+
+  HaarScanTask * tasks;
+  int task_capacity;
+
+  /* Windows accepted by the cascade (merged on the tasks order), and the memory used to group them */
+  HaarRect * candidates;
+  int candidate_count;
+  int candidate_capacity;
+  int * labels;
+  HaarGroup * groups;
+};
+
+/* Same bias used by OpenCV, it avoids rejecting windows because of float rounding */
+static const double HAAR_STAGE_THRESHOLD_BIAS = 0.0001;
+
+/* Two candidates are similar if their corners are closer than this fraction of their size */
+static const double HAAR_GROUP_EPS = 0.2;
+
+static const double HAAR_DEFAULT_SCALE_FACTOR = 1.1;
+static const int HAAR_DEFAULT_MIN_NEIGHBORS   = 3;
+
+static const int HAAR_INITIAL_CANDIDATES = 1024;
+
+/* Height (in pixels) of the bands of window rows scanned by each task */
+static const int HAAR_BAND_ROWS = 32;
+
+/* The search will never go through more scales than this */
+#define HAAR_MAX_SCALES 256
+
+
+/*
+ **************************
+ * Training file parsing *
+ **************************
+ */
+
+typedef struct _XmlCursor {
+  const char * pos;
+  const char * end;
+} XmlCursor;
+
+#define XML_MAX_TAG_NAME 64
+
+/* Moves to the next tag, skipping text, comments and declarations. Returns 0 at the end of the document.
+   After it the cursor points to the text right after the tag. */
+static int xml_next_tag(XmlCursor * cursor, char * name, int * closing)
+{
+  const char * pos = cursor->pos;
+  int len          = 0;
+
+  while (1) {
+
+    pos = memchr(pos, '<', cursor->end - pos);
+
+    if (!pos) {
+      return 0;
+    }
+
+    if (!strncmp(pos, "<!--", 4)) {
+      pos = strstr(pos, "-->");
+      if (!pos) {
+        return 0;
+      }
+      continue;
+    }
+
+    if (!strncmp(pos, "<?", 2)) {
+      pos = strstr(pos, "?>");
+      if (!pos) {
+        return 0;
+      }
+      continue;
+    }
+
+    break;
+  }
+
+  pos++;
+  *closing = (*pos == '/');
+
+  if (*closing) {
+    pos++;
+  }
+
+  while ((pos < cursor->end) && (*pos != '>') && (*pos != ' ') && (*pos != '/') && (len < XML_MAX_TAG_NAME - 1)) {
+    name[len++] = *pos++;
+  }
+  name[len] = '\0';
+
+  pos = memchr(pos, '>', cursor->end - pos);
+
+  if (!pos) {
+    return 0;
+  }
+
+  cursor->pos = pos + 1;
+  return 1;
+}
+
+/* Moves to the next tag, that must be the given one */
+static int xml_expect_tag(XmlCursor * cursor, const char * expected, int expected_closing)
+{
+  char name[XML_MAX_TAG_NAME];
+  int closing;
+
+  if (!xml_next_tag(cursor, name, &closing)) {
+    return 0;
+  }
+
+  return !strcmp(name, expected) && (closing == expected_closing);
+}
+
+/* Moves to the next opening tag with the given name */
+static int xml_find_tag(XmlCursor * cursor, const char * wanted)
+{
+  char name[XML_MAX_TAG_NAME];
+  int closing;
+
+  while (xml_next_tag(cursor, name, &closing)) {
+    if (!closing && !strcmp(name, wanted)) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/* Reads the number on the text of the current tag and consumes the closing tag */
+static int xml_read_number(XmlCursor * cursor, const char * tag, double * value)
+{
+  char * number_end = NULL;
+
+  *value = strtod(cursor->pos, &number_end);
+
+  if (number_end == cursor->pos) {
+    return 0;
+  }
+
+  cursor->pos = number_end;
+  return xml_expect_tag(cursor, tag, 1);
+}
+
+/* Grows an array of the cascade if it is full */
+static int haar_cascade_reserve(void ** array, int * capacity, int count, size_t element_size)
+{
+  void * grown = NULL;
+  int new_capacity;
+
+  if (count < *capacity) {
+    return 1;
+  }
+
+  new_capacity = (*capacity) ? (*capacity) * 2 : 64;
+  grown        = realloc(*array, new_capacity * element_size);
+
+  if (!grown) {
+    return 0;
+  }
+
+  *array    = grown;
+  *capacity = new_capacity;
+  return 1;
+}
+
+static int haar_cascade_parse_feature(XmlCursor * cursor, HaarNode * node)
+{
+  char name[XML_MAX_TAG_NAME];
+  int closing;
+
+  while (xml_next_tag(cursor, name, &closing)) {
+
+    if (closing && !strcmp(name, "feature")) {
+      return 1;
+    }
+
+    if (!closing && !strcmp(name, "tilted")) {
+      double tilted;
+
+      if (!xml_read_number(cursor, "tilted", &tilted)) {
+        return 0;
+      }
+
+      if (tilted != 0) {
+        printf("haar_cascade_parse_feature: tilted features are not supported !!!\n");
+        return 0;
+      }
+      continue;
+    }
+
+    if (!closing && !strcmp(name, "_")) {
+      /* A rect: x y width height weight */
+      HaarFeatureRect * rect = NULL;
+      char * text            = (char *) cursor->pos;
+
+      if (node->rect_count >= HAAR_MAX_FEATURE_RECTS) {
+        printf("haar_cascade_parse_feature: too many rects on a feature !!!\n");
+        return 0;
+      }
+
+      rect         = &node->rects[node->rect_count];
+      rect->x      = strtol(text, &text, 10);
+      rect->y      = strtol(text, &text, 10);
+      rect->width  = strtol(text, &text, 10);
+      rect->height = strtol(text, &text, 10);
+      rect->weight = strtod(text, &text);
+      cursor->pos  = text;
+      node->rect_count++;
+
+      if (!xml_expect_tag(cursor, "_", 1)) {
+        return 0;
+      }
+    }
+
+    /* <rects> and </rects> are just containers */
+  }
+
+  return 0;
+}
+
+static int haar_cascade_parse_node(HaarCascade * cascade, XmlCursor * cursor, HaarTree * tree)
+{
+  char name[XML_MAX_TAG_NAME];
+  int closing;
+  HaarNode * node = NULL;
+  double value;
+
+  if (!haar_cascade_reserve((void **) &cascade->nodes, &cascade->node_capacity, cascade->node_count, sizeof(HaarNode))) {
+    return 0;
+  }
+
+  node = &cascade->nodes[cascade->node_count];
+  memset(node, 0, sizeof(HaarNode));
+
+  while (xml_next_tag(cursor, name, &closing)) {
+
+    if (closing && !strcmp(name, "_")) {
+      cascade->node_count++;
+      return node->rect_count > 0;
+    }
+
+    if (closing) {
+      return 0;
+    }
+
+    if (!strcmp(name, "feature")) {
+
+      if (!haar_cascade_parse_feature(cursor, node)) {
+        return 0;
+      }
+
+    } else if (!strcmp(name, "threshold")) {
+
+      if (!xml_read_number(cursor, name, &value)) {
+        return 0;
+      }
+      node->threshold = value;
+
+    } else if (!strcmp(name, "left_val") || !strcmp(name, "right_val")) {
+
+      if (!xml_read_number(cursor, name, &value) ||
+          !haar_cascade_reserve((void **) &cascade->alphas, &cascade->alpha_capacity, cascade->alpha_count, sizeof(float))) {
+        return 0;
+      }
+
+      if (name[0] == 'l') {
+        node->left = -(cascade->alpha_count - tree->first_alpha);
+      } else {
+        node->right = -(cascade->alpha_count - tree->first_alpha);
+      }
+      cascade->alphas[cascade->alpha_count++] = value;
+
+    } else if (!strcmp(name, "left_node") || !strcmp(name, "right_node")) {
+
+      if (!xml_read_number(cursor, name, &value)) {
+        return 0;
+      }
+
+      if (name[0] == 'l') {
+        node->left = (int) value;
+      } else {
+        node->right = (int) value;
+      }
+
+    } else {
+      printf("haar_cascade_parse_node: unexpected tag [%s] !!!\n", name);
+      return 0;
+    }
+  }
+
+  return 0;
+}
+
+static int haar_cascade_parse_tree(HaarCascade * cascade, XmlCursor * cursor)
+{
+  char name[XML_MAX_TAG_NAME];
+  int closing;
+  HaarTree * tree = NULL;
+
+  if (!haar_cascade_reserve((void **) &cascade->trees, &cascade->tree_capacity, cascade->tree_count, sizeof(HaarTree))) {
+    return 0;
+  }
+
+  tree              = &cascade->trees[cascade->tree_count];
+  tree->first_node  = cascade->node_count;
+  tree->first_alpha = cascade->alpha_count;
+
+  while (xml_next_tag(cursor, name, &closing)) {
+
+    if (closing && !strcmp(name, "_")) {
+      cascade->tree_count++;
+      return cascade->node_count > tree->first_node;
+    }
+
+    if (closing || strcmp(name, "_")) {
+      return 0;
+    }
+
+    if (!haar_cascade_parse_node(cascade, cursor, tree)) {
+      return 0;
+    }
+  }
+
+  return 0;
+}
+
+static int haar_cascade_parse_stage(HaarCascade * cascade, XmlCursor * cursor)
+{
+  char name[XML_MAX_TAG_NAME];
+  int closing;
+  HaarStage * stage = NULL;
+  double value;
+
+  if (!haar_cascade_reserve((void **) &cascade->stages, &cascade->stage_capacity, cascade->stage_count, sizeof(HaarStage))) {
+    return 0;
+  }
+
+  stage             = &cascade->stages[cascade->stage_count];
+  stage->first_tree = cascade->tree_count;
+  stage->tree_count = 0;
+  stage->threshold  = 0;
+
+  while (xml_next_tag(cursor, name, &closing)) {
+
+    if (closing && !strcmp(name, "_")) {
+      stage->tree_count = cascade->tree_count - stage->first_tree;
+      cascade->stage_count++;
+      return stage->tree_count > 0;
+    }
+
+    if (closing) {
+      /* </trees> */
+      continue;
+    }
+
+    if (!strcmp(name, "trees")) {
+      continue;
+    }
+
+    if (!strcmp(name, "_")) {
+
+      if (!haar_cascade_parse_tree(cascade, cursor)) {
+        return 0;
+      }
+
+    } else if (!strcmp(name, "stage_threshold")) {
+
+      if (!xml_read_number(cursor, name, &value)) {
+        return 0;
+      }
+      stage->threshold = value;
+
+    } else if (!strcmp(name, "parent") || !strcmp(name, "next")) {
+
+      /* The stages are a simple chain on the frontal face cascades */
+      if (!xml_read_number(cursor, name, &value)) {
+        return 0;
+      }
+
+    } else {
+      printf("haar_cascade_parse_stage: unexpected tag [%s] !!!\n", name);
+      return 0;
+    }
+  }
+
+  return 0;
+}
+
+static int haar_cascade_parse(HaarCascade * cascade, XmlCursor * cursor)
+{
+  char name[XML_MAX_TAG_NAME];
+  char * text = NULL;
+  int closing;
+
+  if (!xml_find_tag(cursor, "size")) {
+    printf("haar_cascade_parse: window size not found !!!\n");
+    return 0;
+  }
+
+  text                   = (char *) cursor->pos;
+  cascade->window_width  = strtol(text, &text, 10);
+  cascade->window_height = strtol(text, &text, 10);
+  cursor->pos            = text;
+
+  if ((cascade->window_width <= 2) || (cascade->window_height <= 2)) {
+    printf("haar_cascade_parse: invalid window size !!!\n");
+    return 0;
+  }
+
+  if (!xml_find_tag(cursor, "stages")) {
+    printf("haar_cascade_parse: stages not found !!!\n");
+    return 0;
+  }
+
+  while (xml_next_tag(cursor, name, &closing)) {
+
+    if (closing && !strcmp(name, "stages")) {
+      return cascade->stage_count > 0;
+    }
+
+    if (closing || strcmp(name, "_") || !haar_cascade_parse_stage(cascade, cursor)) {
+      printf("haar_cascade_parse: invalid stage [%d] !!!\n", cascade->stage_count);
+      return 0;
+    }
+  }
+
+  return 0;
+}
+
+
+/*
+ **************************
+ * HaarCascade Public API *
+ **************************
+ */
+
+HaarCascade * haar_cascade_load(const char * filename)
+{
+  HaarCascade * cascade = NULL;
+  FILE * file           = fopen(filename, "rb");
+  char * data           = NULL;
+  long size             = 0;
+  XmlCursor cursor;
+
+  if (!file) {
+    printf("haar_cascade_load: Error opening training file [%s] !!!\n", filename);
+    return NULL;
+  }
+
+  fseek(file, 0, SEEK_END);
+  size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+
+  data = malloc(size + 1);
+
+  if (!data || (fread(data, 1, size, file) != (size_t) size)) {
+    printf("haar_cascade_load: Error reading training file [%s] !!!\n", filename);
+    free(data);
+    fclose(file);
+    return NULL;
+  }
+
+  fclose(file);
+
+  /* strstr/strtod can not go after the end of the document */
+  data[size] = '\0';
+
+  cascade = calloc(1, sizeof(HaarCascade));
+
+  if (!cascade) {
+    free(data);
+    return NULL;
+  }
+
+  cursor.pos = data;
+  cursor.end = data + size;
+
+  if (!haar_cascade_parse(cascade, &cursor)) {
+    printf("haar_cascade_load: [%s] is not a supported haar classifier training file !!!\n", filename);
+    haar_cascade_free(cascade);
+    free(data);
+    return NULL;
+  }
+
+  free(data);
+
+  printf("haar_cascade_load: loaded [%s] window[%d]x[%d] stages[%d] trees[%d] nodes[%d]\n",
+         filename, cascade->window_width, cascade->window_height,
+         cascade->stage_count, cascade->tree_count, cascade->node_count);
+
+  return cascade;
+}
+
+void haar_cascade_free(HaarCascade * cascade)
+{
+  free(cascade->stages);
+  free(cascade->trees);
+  free(cascade->nodes);
+  free(cascade->alphas);
+  free(cascade);
+}
+
+void haar_cascade_get_window_size(HaarCascade * cascade, int * width, int * height)
+{
+  if (width) {
+    *width = cascade->window_width;
+  }
+
+  if (height) {
+    *height = cascade->window_height;
+  }
+}
+
+void haar_detection_params_init(HaarDetectionParams * params)
+{
+  params->scale_factor        = HAAR_DEFAULT_SCALE_FACTOR;
+  params->min_neighbors       = HAAR_DEFAULT_MIN_NEIGHBORS;
+  params->min_width           = 0;
+  params->min_height          = 0;
+  params->max_width           = 0;
+  params->max_height          = 0;
+  params->find_biggest_object = 0;
+  params->min_window_stddev   = 0;
+  params->threads             = 1;
+}
+
+
+/*
+ *******************
+ * Integral images *
+ *******************
+ */
+
+static void haar_integral_row_tail(const unsigned char * src, int width, int x,
+                                   uint32_t row_sum, uint32_t row_sqsum,
+                                   const uint32_t * prev_sum, uint32_t * sum,
+                                   const uint64_t * prev_sqsum, uint64_t * sqsum)
+{
+  /* The squared row sum fits on 32 bits up to 66050 pixels per row */
+  for (; x < width; x++) {
+    row_sum      += src[x];
+    row_sqsum    += src[x] * src[x];
+    sum[x + 1]    = prev_sum[x + 1] + row_sum;
+    sqsum[x + 1]  = prev_sqsum[x + 1] + row_sqsum;
+  }
+}
+
+#ifndef HAAR_CASCADE_SSE2
+static void haar_integral_row_c(const unsigned char * src, int width,
+                                const uint32_t * prev_sum, uint32_t * sum,
+                                const uint64_t * prev_sqsum, uint64_t * sqsum)
+{
+  haar_integral_row_tail(src, width, 0, 0, 0, prev_sum, sum, prev_sqsum, sqsum);
+}
+#endif
+
+#ifdef HAAR_CASCADE_SSE2
+/* 4 pixels at a time, the prefix sum of the row is done inside the register */
+static void haar_integral_row_sse2(const unsigned char * src, int width,
+                                   const uint32_t * prev_sum, uint32_t * sum,
+                                   const uint64_t * prev_sqsum, uint64_t * sqsum)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i carry      = zero;
+  __m128i carry_sq   = zero;
+  int x              = 0;
+
+  for (; x + 4 <= width; x += 4) {
+    int32_t packed;
+    __m128i pixels;
+    __m128i squares;
+
+    memcpy(&packed, src + x, sizeof(packed));
+    pixels  = _mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero);
+
+    /* 255 * 255 fits on 16 bits unsigned */
+    squares = _mm_mullo_epi16(pixels, pixels);
+    pixels  = _mm_unpacklo_epi16(pixels, zero);
+    squares = _mm_unpacklo_epi16(squares, zero);
+
+    pixels  = _mm_add_epi32(pixels, _mm_slli_si128(pixels, 4));
+    pixels  = _mm_add_epi32(pixels, _mm_slli_si128(pixels, 8));
+    pixels  = _mm_add_epi32(pixels, carry);
+    carry   = _mm_shuffle_epi32(pixels, _MM_SHUFFLE(3, 3, 3, 3));
+
+    squares  = _mm_add_epi32(squares, _mm_slli_si128(squares, 4));
+    squares  = _mm_add_epi32(squares, _mm_slli_si128(squares, 8));
+    squares  = _mm_add_epi32(squares, carry_sq);
+    carry_sq = _mm_shuffle_epi32(squares, _MM_SHUFFLE(3, 3, 3, 3));
+
+    _mm_storeu_si128((__m128i *) (sum + x + 1),
+                     _mm_add_epi32(pixels, _mm_loadu_si128((const __m128i *) (prev_sum + x + 1))));
+
+    _mm_storeu_si128((__m128i *) (sqsum + x + 1),
+                     _mm_add_epi64(_mm_unpacklo_epi32(squares, zero), _mm_loadu_si128((const __m128i *) (prev_sqsum + x + 1))));
+
+    _mm_storeu_si128((__m128i *) (sqsum + x + 3),
+                     _mm_add_epi64(_mm_unpackhi_epi32(squares, zero), _mm_loadu_si128((const __m128i *) (prev_sqsum + x + 3))));
+  }
+
+  haar_integral_row_tail(src, width, x, _mm_cvtsi128_si32(carry), _mm_cvtsi128_si32(carry_sq),
+                         prev_sum, sum, prev_sqsum, sqsum);
+}
+#endif
+
+#ifdef HAAR_CASCADE_AVX2
+/* 8 pixels at a time, the prefix is done on each 128 bits lane and then the low lane total is added to the high lane */
+__attribute__((target("avx2")))
+static __m256i haar_prefix_sum_avx2(__m256i values)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i low_total;
+
+  values    = _mm256_add_epi32(values, _mm256_slli_si256(values, 4));
+  values    = _mm256_add_epi32(values, _mm256_slli_si256(values, 8));
+  low_total = _mm256_permutevar8x32_epi32(values, _mm256_setr_epi32(3, 3, 3, 3, 3, 3, 3, 3));
+
+  return _mm256_add_epi32(values, _mm256_blend_epi32(zero, low_total, 0xF0));
+}
+
+__attribute__((target("avx2")))
+static void haar_integral_row_avx2(const unsigned char * src, int width,
+                                   const uint32_t * prev_sum, uint32_t * sum,
+                                   const uint64_t * prev_sqsum, uint64_t * sqsum)
+{
+  const __m256i last = _mm256_set1_epi32(7);
+  __m256i carry      = _mm256_setzero_si256();
+  __m256i carry_sq   = _mm256_setzero_si256();
+  int x              = 0;
+
+  for (; x + 8 <= width; x += 8) {
+    __m256i pixels  = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (src + x)));
+    __m256i squares = _mm256_mullo_epi32(pixels, pixels);
+
+    pixels   = _mm256_add_epi32(haar_prefix_sum_avx2(pixels), carry);
+    carry    = _mm256_permutevar8x32_epi32(pixels, last);
+
+    squares  = _mm256_add_epi32(haar_prefix_sum_avx2(squares), carry_sq);
+    carry_sq = _mm256_permutevar8x32_epi32(squares, last);
+
+    _mm256_storeu_si256((__m256i *) (sum + x + 1),
+                        _mm256_add_epi32(pixels, _mm256_loadu_si256((const __m256i *) (prev_sum + x + 1))));
+
+    _mm256_storeu_si256((__m256i *) (sqsum + x + 1),
+                        _mm256_add_epi64(_mm256_cvtepu32_epi64(_mm256_castsi256_si128(squares)),
+                                         _mm256_loadu_si256((const __m256i *) (prev_sqsum + x + 1))));
+
+    _mm256_storeu_si256((__m256i *) (sqsum + x + 5),
+                        _mm256_add_epi64(_mm256_cvtepu32_epi64(_mm256_extracti128_si256(squares, 1)),
+                                         _mm256_loadu_si256((const __m256i *) (prev_sqsum + x + 5))));
+  }
+
+  haar_integral_row_tail(src, width, x,
+                         _mm_cvtsi128_si32(_mm256_castsi256_si128(carry)),
+                         _mm_cvtsi128_si32(_mm256_castsi256_si128(carry_sq)),
+                         prev_sum, sum, prev_sqsum, sqsum);
+}
+#endif
+
+static HaarIntegralRowFunc haar_select_integral_row()
+{
+#ifdef HAAR_CASCADE_AVX2
+  if (__builtin_cpu_supports("avx2")) {
+    return haar_integral_row_avx2;
+  }
+#endif
+
+#ifdef HAAR_CASCADE_SSE2
+  return haar_integral_row_sse2;
+#else
+  return haar_integral_row_c;
+#endif
+}
+
+
+/*
+ ****************************
+ * HaarWorkspace Public API *
+ ****************************
+ */
+
+static int haar_workspace_reserve_candidates(HaarWorkspace * workspace, int capacity)
+{
+  HaarRect * candidates = NULL;
+  int * labels          = NULL;
+  HaarGroup * groups    = NULL;
+
+  if (capacity <= workspace->candidate_capacity) {
+    return 1;
+  }
+
+  candidates = realloc(workspace->candidates, sizeof(HaarRect) * capacity);
+  if (candidates) {
+    workspace->candidates = candidates;
+  }
+
+  labels = realloc(workspace->labels, sizeof(int) * capacity);
+  if (labels) {
+    workspace->labels = labels;
+  }
+
+  groups = realloc(workspace->groups, sizeof(HaarGroup) * capacity);
+  if (groups) {
+    workspace->groups = groups;
+  }
+
+  if (!candidates || !labels || !groups) {
+    return 0;
+  }
+
+  workspace->candidate_capacity = capacity;
+  return 1;
+}
+
+/* Makes sure there is a context for each search thread */
+static int haar_workspace_reserve_contexts(HaarWorkspace * workspace, int count)
+{
+  HaarThreadContext * contexts = NULL;
+
+  if (count <= workspace->context_count) {
+    return 1;
+  }
+
+  contexts = realloc(workspace->contexts, sizeof(HaarThreadContext) * count);
+
+  if (!contexts) {
+    return 0;
+  }
+
+  workspace->contexts = contexts;
+
+  for (; workspace->context_count < count; workspace->context_count++) {
+    HaarThreadContext * context = &contexts[workspace->context_count];
+
+    context->scaled_nodes       = malloc(sizeof(HaarScaledNode) * workspace->node_count);
+    context->scaled_factor      = 0;
+    context->candidates         = malloc(sizeof(HaarRect) * HAAR_INITIAL_CANDIDATES);
+    context->candidate_count    = 0;
+    context->candidate_capacity = HAAR_INITIAL_CANDIDATES;
+
+    if (!context->scaled_nodes || !context->candidates) {
+      free(context->scaled_nodes);
+      free(context->candidates);
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+static int haar_workspace_reserve_tasks(HaarWorkspace * workspace, int count)
+{
+  HaarScanTask * tasks = NULL;
+
+  if (count <= workspace->task_capacity) {
+    return 1;
+  }
+
+  tasks = realloc(workspace->tasks, sizeof(HaarScanTask) * count);
+
+  if (!tasks) {
+    return 0;
+  }
+
+  workspace->tasks         = tasks;
+  workspace->task_capacity = count;
+  return 1;
+}
+
+HaarWorkspace * haar_workspace_new(HaarCascade * cascade, int max_width, int max_height)
+{
+  HaarWorkspace * workspace = calloc(1, sizeof(HaarWorkspace));
+
+  if (!workspace) {
+    return NULL;
+  }
+
+  workspace->max_width    = max_width;
+  workspace->max_height   = max_height;
+  workspace->stride       = max_width + 1;
+  workspace->sum          = calloc(workspace->stride * (max_height + 1), sizeof(uint32_t));
+  workspace->sqsum        = calloc(workspace->stride * (max_height + 1), sizeof(uint64_t));
+  workspace->node_count   = cascade->node_count;
+  workspace->integral_row = haar_select_integral_row();
+
+  if (!workspace->sum || !workspace->sqsum ||
+      !haar_workspace_reserve_contexts(workspace, 1) ||
+      !haar_workspace_reserve_candidates(workspace, HAAR_INITIAL_CANDIDATES)) {
+    haar_workspace_free(workspace);
+    return NULL;
+  }
+
+  return workspace;
+}
+
+void haar_workspace_free(HaarWorkspace * workspace)
+{
+  int i;
+
+  for (i = 0; i < workspace->context_count; i++) {
+    free(workspace->contexts[i].scaled_nodes);
+    free(workspace->contexts[i].candidates);
+  }
+
+  free(workspace->contexts);
+  free(workspace->tasks);
+  free(workspace->sum);
+  free(workspace->sqsum);
+  free(workspace->candidates);
+  free(workspace->labels);
+  free(workspace->groups);
+  free(workspace);
+}
+
+void haar_workspace_compute_integral_images(HaarWorkspace * workspace,
+                                            const unsigned char * y,
+                                            int width,
+                                            int height,
+                                            int stride)
+{
+  int row;
+
+  if ((width > workspace->max_width) || (height > workspace->max_height)) {
+    printf("haar_workspace_compute_integral_images: image [%d]x[%d] is bigger than the workspace !!!\n", width, height);
+    workspace->width  = 0;
+    workspace->height = 0;
+    return;
+  }
+
+  memset(workspace->sum, 0, sizeof(uint32_t) * (width + 1));
+  memset(workspace->sqsum, 0, sizeof(uint64_t) * (width + 1));
+
+  for (row = 0; row < height; row++) {
+    uint32_t * sum   = workspace->sum + (row + 1) * workspace->stride;
+    uint64_t * sqsum = workspace->sqsum + (row + 1) * workspace->stride;
+
+    sum[0]   = 0;
+    sqsum[0] = 0;
+
+    workspace->integral_row(y + row * stride, width,
+                            sum - workspace->stride, sum,
+                            sqsum - workspace->stride, sqsum);
+  }
+
+  workspace->width  = width;
+  workspace->height = height;
+}
+
+
+/*
+ *************
+ * Detection *
+ *************
+ */
+
+static int haar_round(double value)
+{
+  return (int) floor(value + 0.5);
+}
+
+/* Scales all the nodes to the given scale, storing how far the features reach on the extent.
+   Done once per scale, not per window. */
+static void haar_cascade_scale_nodes(HaarCascade * cascade, HaarScaledNode * scaled_nodes, int stride, double factor, double weight_scale,
+                                     int * extent_width, int * extent_height)
+{
+  int n;
+
+  for (n = 0; n < cascade->node_count; n++) {
+    HaarNode * node         = &cascade->nodes[n];
+    HaarScaledNode * scaled = &scaled_nodes[n];
+    double weighted_area    = 0;
+    int first_area          = 1;
+    int k;
+
+    for (k = 0; k < node->rect_count; k++) {
+      int x      = haar_round(node->rects[k].x * factor);
+      int y      = haar_round(node->rects[k].y * factor);
+      int width  = haar_round(node->rects[k].width * factor);
+      int height = haar_round(node->rects[k].height * factor);
+
+      scaled->offsets[k][0] = y * stride + x;
+      scaled->offsets[k][1] = y * stride + x + width;
+      scaled->offsets[k][2] = (y + height) * stride + x;
+      scaled->offsets[k][3] = (y + height) * stride + x + width;
+      scaled->weights[k]    = node->rects[k].weight * weight_scale;
+
+      if (x + width > *extent_width) {
+        *extent_width = x + width;
+      }
+
+      if (y + height > *extent_height) {
+        *extent_height = y + height;
+      }
+
+      if (k == 0) {
+        first_area = width * height;
+      } else {
+        weighted_area += scaled->weights[k] * width * height;
+      }
+    }
+
+    /* Rounding changes the areas, the first rect weight is adjusted so the feature stays balanced */
+    if (first_area > 0) {
+      scaled->weights[0] = -weighted_area / first_area;
+    }
+
+    scaled->rect_count = node->rect_count;
+    scaled->threshold  = node->threshold;
+    scaled->left       = node->left;
+    scaled->right      = node->right;
+  }
+}
+
+static inline float haar_rect_sum(const uint32_t * window, const int * offsets)
+{
+  /* Unsigned wrap around gives the right sum even when the integral image overflows */
+  return (float) (int32_t) (window[offsets[0]] - window[offsets[1]] - window[offsets[2]] + window[offsets[3]]);
+}
+
+/* Runs the cascade on a window. Returns 1 if the window passed all the stages, 0 if it has been rejected. */
+static int haar_cascade_evaluate_window(HaarCascade * cascade,
+                                        const HaarScaledNode * scaled_nodes,
+                                        const uint32_t * window,
+                                        float variance_norm)
+{
+  int s;
+
+  for (s = 0; s < cascade->stage_count; s++) {
+    const HaarStage * stage = &cascade->stages[s];
+    const HaarTree * tree   = &cascade->trees[stage->first_tree];
+    const HaarTree * last   = tree + stage->tree_count;
+    float stage_sum         = 0;
+
+    for (; tree < last; tree++) {
+      int index = 0;
+
+      do {
+        const HaarScaledNode * node = &scaled_nodes[tree->first_node + index];
+        float value                 = node->weights[0] * haar_rect_sum(window, node->offsets[0]) +
+                                      node->weights[1] * haar_rect_sum(window, node->offsets[1]);
+
+        if (node->rect_count > 2) {
+          value += node->weights[2] * haar_rect_sum(window, node->offsets[2]);
+        }
+
+        index = (value < node->threshold * variance_norm) ? node->left : node->right;
+
+      } while (index > 0);
+
+      stage_sum += cascade->alphas[tree->first_alpha - index];
+    }
+
+    /* Early rejection, most of the windows stop on the first stages */
+    if (stage_sum < stage->threshold - HAAR_STAGE_THRESHOLD_BIAS) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+/* Scans the windows of a band of rows, appending the accepted ones to the thread context candidates */
+static int haar_cascade_scan_band(HaarCascade * cascade,
+                                  HaarWorkspace * workspace,
+                                  HaarThreadContext * context,
+                                  const HaarDetectionParams * params,
+                                  double factor,
+                                  int y_begin,
+                                  int y_end)
+{
+  int window_width  = haar_round(cascade->window_width * factor);
+  int window_height = haar_round(cascade->window_height * factor);
+  int stride        = workspace->stride;
+
+  /* The variance is measured on the window without a 1 pixel border (scaled), just like OpenCV */
+  int equ_x         = haar_round(factor);
+  int equ_y         = haar_round(factor);
+  int equ_width     = haar_round((cascade->window_width - 2) * factor);
+  int equ_height    = haar_round((cascade->window_height - 2) * factor);
+  int equ_tl        = equ_y * stride + equ_x;
+  int equ_tr        = equ_tl + equ_width;
+  int equ_bl        = (equ_y + equ_height) * stride + equ_x;
+  int equ_br        = equ_bl + equ_width;
+  double inv_area   = 1.0 / (equ_width * equ_height);
+  double min_var    = params->min_window_stddev * params->min_window_stddev;
+  int step          = (factor > 2) ? 1 : 2;
+  int x, y;
+
+  if (context->scaled_factor != factor) {
+    context->scaled_extent_width  = window_width;
+    context->scaled_extent_height = window_height;
+    haar_cascade_scale_nodes(cascade, context->scaled_nodes, stride, factor, inv_area,
+                             &context->scaled_extent_width, &context->scaled_extent_height);
+    context->scaled_factor = factor;
+  }
+
+  for (y = y_begin; (y < y_end) && (y + context->scaled_extent_height <= workspace->height); y += step) {
+
+    const uint32_t * sum_row   = workspace->sum + y * stride;
+    const uint64_t * sqsum_row = workspace->sqsum + y * stride;
+
+    for (x = 0; x + context->scaled_extent_width <= workspace->width; x += step) {
+      const uint32_t * window   = sum_row + x;
+      const uint64_t * sqwindow = sqsum_row + x;
+      double mean     = (uint32_t) (window[equ_tl] - window[equ_tr] - window[equ_bl] + window[equ_br]) * inv_area;
+      double variance = (double) (sqwindow[equ_tl] - sqwindow[equ_tr] - sqwindow[equ_bl] + sqwindow[equ_br]) * inv_area - mean * mean;
+
+      if (variance < min_var) {
+        /* A flat window, there is nothing to detect here */
+        continue;
+      }
+
+      if (!haar_cascade_evaluate_window(cascade, context->scaled_nodes, window,
+                                        (variance > 0) ? sqrt(variance) : 1.0f)) {
+        continue;
+      }
+
+      if (context->candidate_count >= context->candidate_capacity) {
+        HaarRect * candidates = realloc(context->candidates, sizeof(HaarRect) * 2 * context->candidate_capacity);
+
+        if (!candidates) {
+          printf("haar_cascade_scan_band: Error allocating candidates !!!\n");
+          return 0;
+        }
+
+        context->candidates          = candidates;
+        context->candidate_capacity *= 2;
+      }
+
+      context->candidates[context->candidate_count].x      = x;
+      context->candidates[context->candidate_count].y      = y;
+      context->candidates[context->candidate_count].width  = window_width;
+      context->candidates[context->candidate_count].height = window_height;
+      context->candidate_count++;
+    }
+  }
+
+  return 1;
+}
+
+/* Scans the given scales, splitting them on bands of rows that are scanned by the search threads.
+   The candidates are merged on the tasks order, so the result does not depend on the threads scheduling. */
+static int haar_cascade_scan_scales(HaarCascade * cascade,
+                                    HaarWorkspace * workspace,
+                                    const HaarDetectionParams * params,
+                                    const double * factors,
+                                    int first_scale,
+                                    int scale_count)
+{
+  HaarScanTask * tasks = NULL;
+  int task_count       = 0;
+  int threads          = 1;
+  int total            = 0;
+  int s, t;
+
+#ifdef _OPENMP
+  threads = (params->threads > 0) ? params->threads : 1;
+#endif
+
+  if (!haar_workspace_reserve_contexts(workspace, threads)) {
+    printf("haar_cascade_scan_scales: Error allocating the thread contexts !!!\n");
+    return 0;
+  }
+
+  for (s = first_scale; s < first_scale + scale_count; s++) {
+    int last_row = workspace->height - haar_round(cascade->window_height * factors[s]);
+    int y;
+
+    for (y = 0; y <= last_row; y += HAAR_BAND_ROWS) {
+
+      if ((task_count >= workspace->task_capacity) &&
+          !haar_workspace_reserve_tasks(workspace, 2 * workspace->task_capacity + HAAR_BAND_ROWS)) {
+        printf("haar_cascade_scan_scales: Error allocating the tasks !!!\n");
+        return 0;
+      }
+
+      workspace->tasks[task_count].scale   = s;
+      workspace->tasks[task_count].y_begin = y;
+      workspace->tasks[task_count].y_end   = y + HAAR_BAND_ROWS;
+      task_count++;
+    }
+  }
+
+  tasks = workspace->tasks;
+
+  for (t = 0; t < threads; t++) {
+    workspace->contexts[t].candidate_count = 0;
+  }
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+#endif
+  for (t = 0; t < task_count; t++) {
+    HaarScanTask * task = &tasks[t];
+    int thread          = 0;
+    HaarThreadContext * context;
+
+#ifdef _OPENMP
+    thread = omp_get_thread_num();
+#endif
+
+    context               = &workspace->contexts[thread];
+    task->thread          = thread;
+    task->first_candidate = context->candidate_count;
+    task->failed          = !haar_cascade_scan_band(cascade, workspace, context, params,
+                                                    factors[task->scale], task->y_begin, task->y_end);
+    task->candidate_count = context->candidate_count - task->first_candidate;
+  }
+
+  for (t = 0; t < task_count; t++) {
+    if (tasks[t].failed) {
+      return 0;
+    }
+    total += tasks[t].candidate_count;
+  }
+
+  if (!haar_workspace_reserve_candidates(workspace, workspace->candidate_count + total)) {
+    printf("haar_cascade_scan_scales: Error allocating candidates !!!\n");
+    return 0;
+  }
+
+  for (t = 0; t < task_count; t++) {
+    memcpy(workspace->candidates + workspace->candidate_count,
+           workspace->contexts[tasks[t].thread].candidates + tasks[t].first_candidate,
+           sizeof(HaarRect) * tasks[t].candidate_count);
+    workspace->candidate_count += tasks[t].candidate_count;
+  }
+
+  return 1;
+}
+
+static int haar_rects_are_similar(const HaarRect * r1, const HaarRect * r2)
+{
+  double delta = HAAR_GROUP_EPS *
+                 (((r1->width < r2->width) ? r1->width : r2->width) +
+                  ((r1->height < r2->height) ? r1->height : r2->height)) * 0.5;
+
+  return (fabs(r1->x - r2->x) <= delta) &&
+         (fabs(r1->y - r2->y) <= delta) &&
+         (fabs(r1->x + r1->width - r2->x - r2->width) <= delta) &&
+         (fabs(r1->y + r1->height - r2->y - r2->height) <= delta);
+}
+
+static int haar_find_root(int * labels, int i)
+{
+  while (labels[i] != i) {
+    labels[i] = labels[labels[i]];
+    i         = labels[i];
+  }
+  return i;
+}
+
+/* Groups similar candidates (same as cvGroupRectangles), the groups with less than min_neighbors
+   candidates and the groups inside a stronger group are discarded. Returns the number of objects. */
+static int haar_group_candidates(HaarWorkspace * workspace, int min_neighbors, HaarRect * results, int max_results)
+{
+  HaarRect * candidates = workspace->candidates;
+  HaarGroup * groups    = workspace->groups;
+  int * labels          = workspace->labels;
+  int count             = workspace->candidate_count;
+  int group_count       = 0;
+  int total             = 0;
+  int i, j;
+
+  for (i = 0; i < count; i++) {
+    labels[i] = i;
+  }
+
+  for (i = 0; i < count; i++) {
+    for (j = i + 1; j < count; j++) {
+
+      if (haar_rects_are_similar(&candidates[i], &candidates[j])) {
+        int root_i = haar_find_root(labels, i);
+        int root_j = haar_find_root(labels, j);
+
+        if (root_i != root_j) {
+          /* The smallest index is the root, this keeps the groups order deterministic */
+          if (root_i < root_j) {
+            labels[root_j] = root_i;
+          } else {
+            labels[root_i] = root_j;
+          }
+        }
+      }
+    }
+  }
+
+  /* Every candidate points straight to its root, the roots are relabeled below */
+  for (i = 0; i < count; i++) {
+    labels[i] = haar_find_root(labels, i);
+  }
+
+  /* Roots are numbered on the order they appear */
+  for (i = 0; i < count; i++) {
+
+    if (labels[i] == i) {
+      memset(&groups[group_count], 0, sizeof(HaarGroup));
+      labels[i] = -(group_count + 1);
+      group_count++;
+    }
+  }
+
+  for (i = 0; i < count; i++) {
+    int root    = i;
+    HaarGroup * group;
+
+    while (labels[root] >= 0) {
+      root = labels[root];
+    }
+
+    group = &groups[-labels[root] - 1];
+    group->x      += candidates[i].x;
+    group->y      += candidates[i].y;
+    group->width  += candidates[i].width;
+    group->height += candidates[i].height;
+    group->neighbors++;
+  }
+
+  for (i = 0; i < group_count; i++) {
+    int n = groups[i].neighbors;
+
+    groups[i].x      = (groups[i].x * 2 + n) / (2 * n);
+    groups[i].y      = (groups[i].y * 2 + n) / (2 * n);
+    groups[i].width  = (groups[i].width * 2 + n) / (2 * n);
+    groups[i].height = (groups[i].height * 2 + n) / (2 * n);
+  }
+
+  for (i = 0; (i < group_count) && (total < max_results); i++) {
+    HaarGroup * g1 = &groups[i];
+
+    if (g1->neighbors < min_neighbors) {
+      continue;
+    }
+
+    for (j = 0; j < group_count; j++) {
+      HaarGroup * g2 = &groups[j];
+      int dx         = haar_round(g2->width * HAAR_GROUP_EPS);
+      int dy         = haar_round(g2->height * HAAR_GROUP_EPS);
+
+      if ((i != j) && (g2->neighbors >= min_neighbors) &&
+          (g1->x >= g2->x - dx) &&
+          (g1->y >= g2->y - dy) &&
+          (g1->x + g1->width <= g2->x + g2->width + dx) &&
+          (g1->y + g1->height <= g2->y + g2->height + dy) &&
+          ((g2->neighbors > ((g1->neighbors > 3) ? g1->neighbors : 3)) || (g1->neighbors < 3))) {
+        /* Inside a stronger group */
+        break;
+      }
+    }
+
+    if (j == group_count) {
+      results[total].x      = g1->x;
+      results[total].y      = g1->y;
+      results[total].width  = g1->width;
+      results[total].height = g1->height;
+      total++;
+    }
+  }
+
+  return total;
+}
+
+int haar_cascade_detect(HaarCascade * cascade,
+                        HaarWorkspace * workspace,
+                        const HaarDetectionParams * params,
+                        HaarRect * results,
+                        int max_results)
+{
+  double factors[HAAR_MAX_SCALES];
+  int scale_count = 0;
+  double factor   = 1;
+  int s;
+
+  /* All the scales that fit on the image and on the size limits */
+  while ((scale_count < HAAR_MAX_SCALES) &&
+         (haar_round(cascade->window_width * factor) <= workspace->width) &&
+         (haar_round(cascade->window_height * factor) <= workspace->height) &&
+         ((params->max_width <= 0) || (haar_round(cascade->window_width * factor) <= params->max_width)) &&
+         ((params->max_height <= 0) || (haar_round(cascade->window_height * factor) <= params->max_height))) {
+
+    if ((haar_round(cascade->window_width * factor) >= params->min_width) &&
+        (haar_round(cascade->window_height * factor) >= params->min_height)) {
+      factors[scale_count++] = factor;
+    }
+
+    factor *= params->scale_factor;
+  }
+
+  workspace->candidate_count = 0;
+
+  if (!params->find_biggest_object) {
+
+    if (!haar_cascade_scan_scales(cascade, workspace, params, factors, 0, scale_count)) {
+      return 0;
+    }
+
+    return haar_group_candidates(workspace, params->min_neighbors, results, max_results);
+  }
+
+  /* Rough search for the biggest object, from the biggest scale down to the first scale with an object */
+  for (s = scale_count - 1; s >= 0; s--) {
+    HaarRect biggest;
+    int found;
+    int i;
+
+    workspace->candidate_count = 0;
+
+    if (!haar_cascade_scan_scales(cascade, workspace, params, factors, s, 1)) {
+      return 0;
+    }
+
+    found = haar_group_candidates(workspace, params->min_neighbors, results, max_results);
+
+    if (found <= 0) {
+      continue;
+    }
+
+    biggest = results[0];
+    for (i = 1; i < found; i++) {
+      if (results[i].width * results[i].height > biggest.width * biggest.height) {
+        biggest = results[i];
+      }
+    }
+
+    if (max_results > 0) {
+      results[0] = biggest;
+      return 1;
+    }
+    return 0;
+  }
+
+  return 0;
+}
+
+
+/*
+ *****************
+ * Image helpers *
+ *****************
+ */
+
+void haar_equalize_histogram(const unsigned char * src,
+                             int src_stride,
+                             unsigned char * dst,
+                             int dst_stride,
+                             int width,
+                             int height)
+{
+  unsigned int histogram[256];
+  unsigned char lut[256];
+  unsigned int total = width * height;
+  unsigned int sum   = 0;
+  int min_value      = 0;
+  float scale;
+  int row, col, i;
+
+  memset(histogram, 0, sizeof(histogram));
+
+  for (row = 0; row < height; row++) {
+    const unsigned char * line = src + row * src_stride;
+
+    for (col = 0; col < width; col++) {
+      histogram[line[col]]++;
+    }
+  }
+
+  while ((min_value < 255) && !histogram[min_value]) {
+    min_value++;
+  }
+
+  if (histogram[min_value] == total) {
+    /* Just one brightness value, nothing to spread */
+    for (row = 0; row < height; row++) {
+      memset(dst + row * dst_stride, min_value, width);
+    }
+    return;
+  }
+
+  scale = 255.0f / (total - histogram[min_value]);
+
+  memset(lut, 0, sizeof(lut));
+
+  for (i = min_value + 1; i < 256; i++) {
+    int value;
+
+    sum  += histogram[i];
+    value = haar_round(sum * scale);
+    lut[i] = (value > 255) ? 255 : value;
+  }
+
+  for (row = 0; row < height; row++) {
+    const unsigned char * line = src + row * src_stride;
+    unsigned char * out        = dst + row * dst_stride;
+
+    for (col = 0; col < width; col++) {
+      out[col] = lut[line[col]];
+    }
+  }
+}
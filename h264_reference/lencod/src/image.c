@@ -29,6 +29,7 @@
 
 #include <math.h>
 #include <time.h>
+#include <stddef.h>
 #include <stdio.h>
 
 #include "global.h"
@@ -66,6 +67,7 @@
 
 #include "md_common.h"
 #include "me_epzs_common.h"
+#include "slice_threads.h"
 #include "metadata_extractor.h"
 #include "udata_gen.h"
 
@@ -171,28 +173,121 @@ void MbAffPostProc(VideoParameters *p_Vid)
 */
 static void get_motion_estimation_information(VideoParameters * p_Vid)
 {
-  int blk_y, blk_x;
-  
-  /* Macroblocks have a 16X16 size. Blocks have 4X4, each Macroblock have 16 blocks. 
-     Here we are going to iterate trough the 4x4 blocks ME info */
-  for (blk_y=0; blk_y  < ceil(p_Vid->height / BLOCK_SIZE); blk_y++)
-  {
+  PicMotionParams ** mv_info = p_Vid->enc_picture->mv_info;
+  DecodedPictureBuffer * p_Dpb = p_Vid->p_Dpb;
+  MotionVectorReference references[2 * MAX_LIST_SIZE];
+  MotionVectorField field;
+  unsigned i;
 
-    for(blk_x = 0 ; blk_x < ceil(p_Vid->width / BLOCK_SIZE); blk_x++) {
+  /* The blocks point to the reference frames of the DPB, the vectors are scaled by their POC distance */
+  field.reference_count = 0;
 
-      PicMotionParams *mv_info_p = &p_Vid->enc_picture->mv_info[blk_y][blk_x];
+  for (i = 0; i < p_Dpb->ref_frames_in_buffer; i++) {
+    if (p_Dpb->fs_ref[i]->frame) {
+      references[field.reference_count].picture      = p_Dpb->fs_ref[i]->frame;
+      references[field.reference_count].poc_distance = p_Vid->enc_picture->poc - p_Dpb->fs_ref[i]->frame->poc;
+      field.reference_count++;
+    }
+  }
 
-      metadata_extractor_add_motion_estimation_info(p_Vid->metadata_extractor,
-                                                    blk_x,
-                                                    blk_y,
-                                                    mv_info_p->mv[LIST_0].mv_x,
-                                                    mv_info_p->mv[LIST_0].mv_y);
+  for (i = 0; i < p_Dpb->ltref_frames_in_buffer; i++) {
+    if (p_Dpb->fs_ltref[i]->frame) {
+      references[field.reference_count].picture      = p_Dpb->fs_ltref[i]->frame;
+      references[field.reference_count].poc_distance = p_Vid->enc_picture->poc - p_Dpb->fs_ltref[i]->frame->poc;
+      field.reference_count++;
     }
+  }
+
+  /* Macroblocks have a 16X16 size. Blocks have 4X4, each Macroblock have 16 blocks. 
+     The extractor reads the 4x4 blocks ME info straight from the picture, mv_info rows are contiguous.
+     The velocities are per metadata frame, the decoder normalizes its vectors the same way */
+  field.blocks             = (const unsigned char *) &mv_info[0][0];
+  field.block_stride       = sizeof(PicMotionParams);
+  field.row_stride         = (const unsigned char *) mv_info[1] - (const unsigned char *) mv_info[0];
+  field.mv_offset[0]       = offsetof(PicMotionParams, mv[LIST_0]);
+  field.mv_offset[1]       = offsetof(PicMotionParams, mv[LIST_1]);
+  field.ref_idx_offset[0]  = offsetof(PicMotionParams, ref_idx[LIST_0]);
+  field.ref_idx_offset[1]  = offsetof(PicMotionParams, ref_idx[LIST_1]);
+  field.ref_pic_offset[0]  = offsetof(PicMotionParams, ref_pic[LIST_0]);
+  field.ref_pic_offset[1]  = offsetof(PicMotionParams, ref_pic[LIST_1]);
+  field.references         = references;
+  field.frame_poc_distance = EXTRACTED_METADATA_FRAME_POC_DISTANCE;
+  field.width              = p_Vid->width / BLOCK_SIZE;
+  field.height             = p_Vid->height / BLOCK_SIZE;
+
+  metadata_extractor_add_motion_vector_field(p_Vid->metadata_extractor, &field);
+}
 
+
+/*!
+************************************************************************
+* \brief
+*    Sets the metadata frame number of the current frame the same way
+*    the decoder does, from the POC: the frame numbers restart from the
+*    next one on each IDR frame. The frame_no would not match it when
+*    the POC does not advance 2 per frame (FrameSkip). (KATCIPIS)
+*
+************************************************************************
+*/
+static void set_metadata_frame(VideoParameters * p_Vid)
+{
+  if (p_Vid->p_curr_frm_struct->idr_flag)
+  {
+    p_Vid->metadata_idr_frame = p_Vid->metadata_next_frame;
   }
 
+  p_Vid->metadata_frame = p_Vid->metadata_idr_frame + imax(p_Vid->framepoc, 0) / EXTRACTED_METADATA_FRAME_POC_DISTANCE;
+
+  if (p_Vid->metadata_frame >= p_Vid->metadata_next_frame)
+  {
+    p_Vid->metadata_next_frame = p_Vid->metadata_frame + 1;
+  }
 }
 
+/*!
+************************************************************************
+* \brief
+*    Writes a batch of metadata on the bitstream as one SEI NALU and 
+*    frees it. (KATCIPIS)
+*
+************************************************************************
+*/
+static void write_extracted_metadata(VideoParameters * p_Vid, ExtractedMetadata ** metadata, int count)
+{
+  int size = 0;
+  char * data;
+  int i;
+
+  if (!count) {
+    return;
+  }
+
+  /* The metadata is coded against the previous one, the codec lives as long as the encoder */
+  if (!p_Vid->metadata_codec && !(p_Vid->metadata_codec = extracted_metadata_codec_new())) {
+    no_mem_exit("write_extracted_metadata: metadata_codec");
+  }
+
+  data = malloc(extracted_metadata_codec_get_max_size(metadata, count));
+
+  if (!data) {
+    no_mem_exit("write_extracted_metadata: data");
+  }
+
+  /* Encode the metadata */
+  size = extracted_metadata_codec_encode(p_Vid->metadata_codec, metadata, count, data);
+
+  /* Insert the serialized metadata on the bitstream as SEI NALU, the NALU grows to the biggest metadata. 
+     The fixed uuid lets the decoder skip the other user data SEI messages. */
+  p_Vid->metadata_sei_nalu = user_data_fill_unregistered_sei_nalu(p_Vid->metadata_sei_nalu, extracted_metadata_uuid, 
+                                                                   data, size);
+  p_Vid->WriteNALU (p_Vid, p_Vid->metadata_sei_nalu);
+
+  free(data);
+
+  for (i = 0; i < count; i++) {
+    extracted_metadata_free(metadata[i]);
+  }
+}
 
 /*!
  ************************************************************************
@@ -232,6 +327,10 @@ static void code_a_plane(VideoParameters *p_Vid, InputParameters *p_Inp)
   reset_pic_bin_count(p_Vid);
   p_Vid->bytes_in_picture = 0;
 
+  // the slices of a fixed number of MBs on their own threads
+  if (slice_threads_usable(p_Vid))
+    NumberOfCodedMBs = encode_slices_in_threads(p_Vid);
+
   while (NumberOfCodedMBs < p_Vid->PicSizeInMbs)       // loop over slices
   {
     // Encode one SLice Group
@@ -253,6 +352,10 @@ static void code_a_plane(VideoParameters *p_Vid, InputParameters *p_Inp)
   }
   FmoEndPicture ();
 
+  /* KATCIPIS - the QP of the last macroblock has its region offset, the picture QP is the base one */
+  if (p_Vid->region_qp && region_qp_is_active(p_Vid->region_qp))
+    p_Vid->qp = p_Vid->region_base_qp;
+
   if ((p_Inp->SkipDeBlockNonRef == 0) || (p_Vid->nal_reference_idc != 0))
   {
     if(p_Inp->RDPictureDeblocking && !p_Vid->TurnDBOff)
@@ -265,12 +368,6 @@ static void code_a_plane(VideoParameters *p_Vid, InputParameters *p_Inp)
     else
       distortion.value[0] = distortion.value[1] = distortion.value[2] = 0;
 
-    /* KATCIPIS - Good place to get ME information */
-    if (p_Inp->object_detection_enable) {
-      get_motion_estimation_information(p_Vid);
-    }
-    /* KATCIPIS - Done */
-
     DeblockFrame (p_Vid, p_Vid->enc_picture->imgY, p_Vid->enc_picture->imgUV); //comment out to disable deblocking filter
 
     if(p_Inp->RDPictureDeblocking && !p_Vid->TurnDBOff)
@@ -1005,6 +1102,13 @@ void store_coded_picture(DecodedPictureBuffer *p_Dpb)
     {      
       if ((p_Inp->redundant_pic_flag != 1) || (p_Vid->key_frame == 0))
       {
+        /* KATCIPIS - Good place to get ME information, only the picture kept by the RD picture decision 
+           (the one the decoder gets) and before it is stored, the references are still on the DPB */
+        if (p_Inp->object_detection_enable) {
+          get_motion_estimation_information(p_Vid);
+        }
+        /* KATCIPIS - Done */
+
         update_global_stats(p_Inp, p_Vid->p_Stats, &p_Vid->enc_picture->stats);
         store_picture_in_dpb (p_Dpb, p_Vid->enc_picture, &p_Inp->output);
         free_pictures(p_Vid, -1);
@@ -1211,28 +1315,36 @@ int encode_one_frame (VideoParameters *p_Vid, InputParameters *p_Inp)
 
   if (p_Inp->object_detection_enable) {
 
-    /*  KATCIPIS - This sounds like a good place to process the raw Y imgData. */
-    ExtractedMetadata * metadata = metadata_extractor_extract_object_bounding_box(p_Vid->metadata_extractor,
-                                                                                  p_Vid->frame_no,
-                                                                                  (unsigned char **) p_Vid->imgData.frm_data[0],
-                                                                                  p_Vid->imgData.format.width[0],
-                                                                                  p_Vid->imgData.format.height[0]);
+    ExtractedMetadata * metadata = NULL;
+    ExtractedMetadata * batch[EXTRACTED_METADATA_CODEC_MAX_BATCH];
+    int count                    = 0;
 
+    set_metadata_frame(p_Vid);
+
+    /*  KATCIPIS - This sounds like a good place to process the raw Y imgData. 
+        frm_data[0] is allocated by get_mem2Dpel, the plane is contiguous and the stride is the width. */
+    metadata = metadata_extractor_extract_object_bounding_box(p_Vid->metadata_extractor,
+                                                              p_Vid->metadata_frame,
+                                                              (unsigned char **) p_Vid->imgData.frm_data[0],
+                                                              p_Vid->imgData.format.width[0],
+                                                              p_Vid->imgData.format.height[0],
+                                                              p_Vid->width * sizeof(imgpel));
+
+    /* KATCIPIS - the searches finished by the detection worker are on it too, moved to this frame */
     if (metadata) {
-      int size                = extracted_metadata_get_serialized_size(metadata);
-      char * data             = malloc(size);
-      NALU_t * nalu           = NULL;
-     
-      /* Serialize the metadata */
-      extracted_metadata_serialize(metadata, data);
-      
-      /* Insert the serialized metadata on the bitstream as SEI NALU. */
-      nalu = user_data_generate_unregistered_sei_nalu(data, size);
-      p_Vid->WriteNALU (p_Vid, nalu);
+      batch[count++] = metadata;
+    }
 
-      FreeNALU (nalu);
-      free(data);
-      extracted_metadata_free(metadata);
+    write_extracted_metadata(p_Vid, batch, count);
+
+    /* KATCIPIS - the objects tracked on this frame get the QP offset, even when their boxes are not sent */
+    if (p_Vid->region_qp) {
+      metadata = metadata_extractor_get_tracked_metadata(p_Vid->metadata_extractor, p_Vid->metadata_frame);
+      region_qp_set_metadata(p_Vid->region_qp, metadata);
+
+      if (metadata) {
+        extracted_metadata_free(metadata);
+      }
     }
     /* KATCIPIS end of metadata extracting */
   }
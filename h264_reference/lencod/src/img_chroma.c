@@ -21,6 +21,7 @@
 #include "global.h"
 #include "image.h"
 #include "img_chroma.h"
+#include "img_interp_simd.h"
 
 
 static void generateChroma00( VideoParameters *p_Vid, int size_x_minus1, int size_y_minus1, imgpel **wImgDst, imgpel **imgUV)
@@ -88,9 +89,9 @@ static void generateChroma01( VideoParameters *p_Vid, int size_x_minus1, int siz
 {
   int i;//, j;
   int jpad = -p_Vid->pad_size_uv_y;
-  int cur_value;
   imgpel *wBufDst;
   imgpel *wBufSrc0;
+  const InterpolationKernels *kernels = p_Vid->interp_kernels;
 
   wBufDst  = wImgDst[jpad++]-p_Vid->pad_size_uv_x;
   wBufSrc0 = imgUV[0];
@@ -100,12 +101,9 @@ static void generateChroma01( VideoParameters *p_Vid, int size_x_minus1, int siz
     *(wBufDst++) = *wBufSrc0;
   }
 
-  for (i = 0; i < size_x_minus1; i++)
-  {
-    cur_value  = weight00 * (*wBufSrc0++);
-    cur_value += weight01 * (*wBufSrc0  );
-    *(wBufDst++) = (imgpel) rshift_rnd_sf(cur_value, 6);
-  }
+  kernels->chroma_hor(wBufDst, wBufSrc0, size_x_minus1, weight00, weight01);
+  wBufDst  += size_x_minus1;
+  wBufSrc0 += size_x_minus1;
 
   for (i = -1; i < p_Vid->pad_size_uv_x; i++)
   {
@@ -117,6 +115,9 @@ static void generateChroma01( VideoParameters *p_Vid, int size_x_minus1, int siz
     memcpy(wImgDst[jpad]-p_Vid->pad_size_uv_x, wImgDst[jpad - 1]-p_Vid->pad_size_uv_x, (2 * p_Vid->pad_size_uv_x + size_x_minus1+1) * sizeof(imgpel));
   }
 
+#ifdef _OPENMP
+#pragma omp parallel for private(i, wBufDst, wBufSrc0)
+#endif
   for (jpad = 1; jpad < size_y_minus1+1; jpad++)
   {
     wBufDst  = wImgDst[jpad]-p_Vid->pad_size_uv_x;
@@ -127,12 +128,9 @@ static void generateChroma01( VideoParameters *p_Vid, int size_x_minus1, int siz
       *(wBufDst++) = *wBufSrc0;
     }
 
-    for (i = 0; i < size_x_minus1; i++)
-    {
-      cur_value  = weight00 * (*wBufSrc0++);
-      cur_value += weight01 * (*wBufSrc0  );
-      *(wBufDst++) = (imgpel) rshift_rnd_sf(cur_value, 6);
-    }
+    kernels->chroma_hor(wBufDst, wBufSrc0, size_x_minus1, weight00, weight01);
+    wBufDst  += size_x_minus1;
+    wBufSrc0 += size_x_minus1;
 
     for (i = -1; i < p_Vid->pad_size_uv_x; i++)
     {
@@ -159,6 +157,7 @@ static void generateChroma10(VideoParameters *p_Vid, int size_x_minus1, int size
   int cur_value;
   imgpel *wBufDst;
   imgpel *wBufSrc0, *wBufSrc1;
+  const InterpolationKernels *kernels = p_Vid->interp_kernels;
 
   wBufDst = wImgDst[jpad++]-p_Vid->pad_size_uv_x;
   wBufSrc0 = imgUV[0];
@@ -183,6 +182,9 @@ static void generateChroma10(VideoParameters *p_Vid, int size_x_minus1, int size
     memcpy(wImgDst[jpad]-p_Vid->pad_size_uv_x, wImgDst[jpad - 1]-p_Vid->pad_size_uv_x, (2 * p_Vid->pad_size_uv_x + size_x_minus1+1) * sizeof(imgpel));
   }
 
+#ifdef _OPENMP
+#pragma omp parallel for private(i, cur_value, wBufDst, wBufSrc0, wBufSrc1)
+#endif
   for (jpad = 0; jpad < size_y_minus1; jpad++)
   {
     wBufDst = wImgDst[jpad]-p_Vid->pad_size_uv_x;
@@ -195,11 +197,10 @@ static void generateChroma10(VideoParameters *p_Vid, int size_x_minus1, int size
       *(wBufDst++) = (imgpel) cur_value;
     }
 
-    for (i = 0; i < size_x_minus1; i++)
-    {
-      cur_value  = weight00 * (*wBufSrc0++) + weight10 * (*wBufSrc1++);
-      *(wBufDst++) = (imgpel) rshift_rnd_sf(cur_value, 6);
-    }
+    kernels->chroma_ver(wBufDst, wBufSrc0, wBufSrc1, size_x_minus1, weight00, weight10);
+    wBufDst  += size_x_minus1;
+    wBufSrc0 += size_x_minus1;
+    wBufSrc1 += size_x_minus1;
 
     cur_value = rshift_rnd_sf(weight00 * (*wBufSrc0) + weight10 * (*wBufSrc1), 6 );
     for (i = -1; i < p_Vid->pad_size_uv_x; i++)
@@ -208,7 +209,7 @@ static void generateChroma10(VideoParameters *p_Vid, int size_x_minus1, int size
     }
   }
 
-  wBufDst = wImgDst[jpad]-p_Vid->pad_size_uv_x;
+  wBufDst = wImgDst[size_y_minus1]-p_Vid->pad_size_uv_x;
   wBufSrc0 = imgUV[size_y_minus1];
 
   for (i = -p_Vid->pad_size_uv_x; i < 0; i++)
@@ -248,6 +249,7 @@ static void generateChromaXX( VideoParameters *p_Vid, int size_x_minus1, int siz
   int weight1011 = weight10 + weight11;
   int weight0010 = weight00 + weight10;
   int weight0111 = weight01 + weight11;
+  const InterpolationKernels *kernels = p_Vid->interp_kernels;
 
   wBufDst = wImgDst[jpad++]-p_Vid->pad_size_uv_x;
   wBufSrc0 = imgUV[0];
@@ -257,12 +259,9 @@ static void generateChromaXX( VideoParameters *p_Vid, int size_x_minus1, int siz
     *(wBufDst++) = *wBufSrc0;
   }
 
-  for (i = 0; i < size_x_minus1; i++)
-  {
-    cur_value  = weight0010 * (*wBufSrc0++);
-    cur_value += weight0111 * (*wBufSrc0  );
-    *(wBufDst++) = (imgpel) rshift_rnd_sf(cur_value, 6);
-  }
+  kernels->chroma_hor(wBufDst, wBufSrc0, size_x_minus1, weight0010, weight0111);
+  wBufDst  += size_x_minus1;
+  wBufSrc0 += size_x_minus1;
 
   for (i = -1; i < p_Vid->pad_size_uv_x; i++)
   {
@@ -274,6 +273,9 @@ static void generateChromaXX( VideoParameters *p_Vid, int size_x_minus1, int siz
     memcpy(wImgDst[jpad]-p_Vid->pad_size_uv_x, wImgDst[jpad - 1]-p_Vid->pad_size_uv_x, (2 * p_Vid->pad_size_uv_x + size_x_minus1+1) * sizeof(imgpel));
   }
 
+#ifdef _OPENMP
+#pragma omp parallel for private(i, cur_value, wBufDst, wBufSrc0, wBufSrc1)
+#endif
   for (jpad = 0; jpad < size_y_minus1; jpad++)
   {
     wBufDst = wImgDst[jpad]-p_Vid->pad_size_uv_x;
@@ -286,12 +288,10 @@ static void generateChromaXX( VideoParameters *p_Vid, int size_x_minus1, int siz
       *(wBufDst++) = (imgpel) cur_value;
     }
 
-    for (i = 0; i < size_x_minus1; i++)
-    {
-      cur_value  = weight00 * (*wBufSrc0++) + weight10 * (*wBufSrc1++);
-      cur_value += weight01 * (*wBufSrc0  ) + weight11 * (*wBufSrc1  );
-      *(wBufDst++) = (imgpel) rshift_rnd_sf(cur_value, 6);
-    }
+    kernels->chroma_diag(wBufDst, wBufSrc0, wBufSrc1, size_x_minus1, weight00, weight01, weight10, weight11);
+    wBufDst  += size_x_minus1;
+    wBufSrc0 += size_x_minus1;
+    wBufSrc1 += size_x_minus1;
 
     cur_value = rshift_rnd_sf(weight0001 * (*wBufSrc0) + weight1011 * (*wBufSrc1), 6 );
     for (i = -1; i < p_Vid->pad_size_uv_x; i++)
@@ -300,7 +300,7 @@ static void generateChromaXX( VideoParameters *p_Vid, int size_x_minus1, int siz
     }
   }
 
-    wBufDst =  wImgDst[jpad]-p_Vid->pad_size_uv_x;
+    wBufDst =  wImgDst[size_y_minus1]-p_Vid->pad_size_uv_x;
     wBufSrc0 = imgUV[size_y_minus1];
 
     for (i = -p_Vid->pad_size_uv_x; i < 0; i++)
@@ -308,12 +308,9 @@ static void generateChromaXX( VideoParameters *p_Vid, int size_x_minus1, int siz
       *(wBufDst++) = *wBufSrc0;
     }
 
-    for (i = 0; i < size_x_minus1; i++)
-    {
-      cur_value  = weight0010 * (*wBufSrc0++);
-      cur_value += weight0111 * (*wBufSrc0  );
-      *(wBufDst++) = (imgpel) rshift_rnd_sf(cur_value, 6);
-    }
+    kernels->chroma_hor(wBufDst, wBufSrc0, size_x_minus1, weight0010, weight0111);
+    wBufDst  += size_x_minus1;
+    wBufSrc0 += size_x_minus1;
 
     for (i = -1; i < p_Vid->pad_size_uv_x; i++)
     {
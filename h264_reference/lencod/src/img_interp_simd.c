@@ -0,0 +1,553 @@
+/*!
+*************************************************************************************
+* \file img_interp_simd.c
+*
+* \brief
+*    Row kernels of the sub-pel interpolation (scalar C, SSE2 and AVX2), chosen at
+*    runtime by the features of the CPU.
+*
+* \author
+*    Main contributors (see contributors.h for copyright, address and affiliation details)
+*      - Tiago Katcipis <tiagokatcipis@gmail.com>
+*
+*************************************************************************************
+*/
+
+#include "contributors.h"
+
+#include "global.h"
+#include "img_interp_simd.h"
+
+// The SIMD kernels work on 8 bit samples, they are built with the GCC target attributes
+#if (IMGTYPE == 0) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define INTERP_SIMD 1
+#include <immintrin.h>
+#else
+#define INTERP_SIMD 0
+#endif
+
+// AVC six-tap filter
+#define SIXTAP(c, b, a, d, e, f) (20 * ((a) + (d)) - 5 * ((b) + (e)) + ((c) + (f)))
+
+/*!
+***********************************************************************
+* \brief
+*    Horizontal six-tap filter of a row, scalar C
+***********************************************************************
+*/
+static void sixtap_hor_c(imgpel *dst, int *tmp, imgpel *src, int width, int max_value)
+{
+  int i, is;
+
+  for (i = 0; i < width; i++)
+  {
+    is = SIXTAP(src[i - 2], src[i - 1], src[i], src[i + 1], src[i + 2], src[i + 3]);
+
+    tmp[i] = is;
+    dst[i] = (imgpel) iClip1(max_value, rshift_rnd_sf(is, 5));
+  }
+}
+
+/*!
+***********************************************************************
+* \brief
+*    Vertical six-tap filter of a row, scalar C
+***********************************************************************
+*/
+static void sixtap_ver_c(imgpel *dst, imgpel **src, int width, int max_value)
+{
+  imgpel *srcC = src[0], *srcB = src[1], *srcA = src[2];
+  imgpel *srcD = src[3], *srcE = src[4], *srcF = src[5];
+  int i, is;
+
+  for (i = 0; i < width; i++)
+  {
+    is = SIXTAP(srcC[i], srcB[i], srcA[i], srcD[i], srcE[i], srcF[i]);
+    dst[i] = (imgpel) iClip1(max_value, rshift_rnd_sf(is, 5));
+  }
+}
+
+/*!
+***********************************************************************
+* \brief
+*    Vertical six-tap filter of a row of horizontal sums, scalar C
+***********************************************************************
+*/
+static void sixtap_ver_tmp_c(imgpel *dst, int **src, int width, int max_value)
+{
+  int *srcC = src[0], *srcB = src[1], *srcA = src[2];
+  int *srcD = src[3], *srcE = src[4], *srcF = src[5];
+  int i, is;
+
+  for (i = 0; i < width; i++)
+  {
+    is = SIXTAP(srcC[i], srcB[i], srcA[i], srcD[i], srcE[i], srcF[i]);
+    dst[i] = (imgpel) iClip1(max_value, rshift_rnd_sf(is, 10));
+  }
+}
+
+/*!
+***********************************************************************
+* \brief
+*    Bi-linear average of two rows, scalar C
+***********************************************************************
+*/
+static void bilinear_c(imgpel *dst, imgpel *src1, imgpel *src2, int width)
+{
+  int i;
+
+  for (i = 0; i < width; i++)
+  {
+    dst[i] = (imgpel) rshift_rnd_sf(src1[i] + src2[i], 1);
+  }
+}
+
+/*!
+***********************************************************************
+* \brief
+*    Horizontal chroma filter of a row, scalar C
+***********************************************************************
+*/
+static void chroma_hor_c(imgpel *dst, imgpel *src, int width, int weight0, int weight1)
+{
+  int i;
+
+  for (i = 0; i < width; i++)
+  {
+    dst[i] = (imgpel) rshift_rnd_sf(weight0 * src[i] + weight1 * src[i + 1], 6);
+  }
+}
+
+/*!
+***********************************************************************
+* \brief
+*    Vertical chroma filter of a row, scalar C
+***********************************************************************
+*/
+static void chroma_ver_c(imgpel *dst, imgpel *src0, imgpel *src1, int width, int weight0, int weight1)
+{
+  int i;
+
+  for (i = 0; i < width; i++)
+  {
+    dst[i] = (imgpel) rshift_rnd_sf(weight0 * src0[i] + weight1 * src1[i], 6);
+  }
+}
+
+/*!
+***********************************************************************
+* \brief
+*    Diagonal chroma filter of a row, scalar C
+***********************************************************************
+*/
+static void chroma_diag_c(imgpel *dst, imgpel *src0, imgpel *src1, int width,
+                          int weight00, int weight01, int weight10, int weight11)
+{
+  int i, cur_value;
+
+  for (i = 0; i < width; i++)
+  {
+    cur_value  = weight00 * src0[i] + weight10 * src1[i];
+    cur_value += weight01 * src0[i + 1] + weight11 * src1[i + 1];
+    dst[i] = (imgpel) rshift_rnd_sf(cur_value, 6);
+  }
+}
+
+const InterpolationKernels interpolation_kernels_c =
+{
+  "C", DIST_SIMD_C,
+  sixtap_hor_c, sixtap_ver_c, sixtap_ver_tmp_c, bilinear_c,
+  chroma_hor_c, chroma_ver_c, chroma_diag_c
+};
+
+#if (INTERP_SIMD)
+
+#define TARGET_SSE2  __attribute__((target("sse2")))
+#define TARGET_AVX2  __attribute__((target("avx2")))
+
+/*
+ * The six-tap sums of 8 bit samples are within [-2550, 10710] and the chroma sums
+ * are below 64 * 256, so both are done on 16 bits. The second pass of the six-tap
+ * filter (on the sums of the first one) is done on 32 bits. The kernels process
+ * the blocks of 16 (32) samples that fit in the row and leave the rest of it to
+ * the C kernels.
+ */
+
+TARGET_SSE2 static inline __m128i sixtap8_sse2(__m128i c, __m128i b, __m128i a, __m128i d, __m128i e, __m128i f)
+{
+  __m128i is = _mm_mullo_epi16(_mm_add_epi16(a, d), _mm_set1_epi16(20));
+
+  is = _mm_sub_epi16(is, _mm_mullo_epi16(_mm_add_epi16(b, e), _mm_set1_epi16(5)));
+  return _mm_add_epi16(is, _mm_add_epi16(c, f));
+}
+
+// 20 * a - 5 * b + c on 32 bits, without the SSE4.1 multiplication
+TARGET_SSE2 static inline __m128i sixtap4_epi32_sse2(__m128i *row)
+{
+  __m128i a = _mm_add_epi32(row[2], row[3]);
+  __m128i b = _mm_add_epi32(row[1], row[4]);
+  __m128i c = _mm_add_epi32(row[0], row[5]);
+
+  a = _mm_add_epi32(_mm_slli_epi32(a, 4), _mm_slli_epi32(a, 2));
+  b = _mm_add_epi32(_mm_slli_epi32(b, 2), b);
+  return _mm_add_epi32(_mm_sub_epi32(a, b), c);
+}
+
+// clip(rshift_rnd_sf(is, 5)) of 8 sums
+TARGET_SSE2 static inline __m128i scale8_sse2(__m128i is, __m128i max_value)
+{
+  is = _mm_srai_epi16(_mm_add_epi16(is, _mm_set1_epi16(16)), 5);
+  return _mm_min_epi16(_mm_max_epi16(is, _mm_setzero_si128()), max_value);
+}
+
+TARGET_SSE2 static void sixtap_hor_sse2(imgpel *dst, int *tmp, imgpel *src, int width, int max_value)
+{
+  __m128i zero = _mm_setzero_si128();
+  __m128i maxv = _mm_set1_epi16((short) max_value);
+  __m128i x[6], lo, hi;
+  int i, k;
+
+  for (i = 0; i + 16 <= width; i += 16)
+  {
+    for (k = 0; k < 6; k++)
+      x[k] = _mm_loadu_si128((__m128i *) &src[i + k - 2]);
+
+    lo = sixtap8_sse2(_mm_unpacklo_epi8(x[0], zero), _mm_unpacklo_epi8(x[1], zero), _mm_unpacklo_epi8(x[2], zero),
+                      _mm_unpacklo_epi8(x[3], zero), _mm_unpacklo_epi8(x[4], zero), _mm_unpacklo_epi8(x[5], zero));
+    hi = sixtap8_sse2(_mm_unpackhi_epi8(x[0], zero), _mm_unpackhi_epi8(x[1], zero), _mm_unpackhi_epi8(x[2], zero),
+                      _mm_unpackhi_epi8(x[3], zero), _mm_unpackhi_epi8(x[4], zero), _mm_unpackhi_epi8(x[5], zero));
+
+    // sign extension of the sums
+    _mm_storeu_si128((__m128i *) &tmp[i     ], _mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16));
+    _mm_storeu_si128((__m128i *) &tmp[i +  4], _mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16));
+    _mm_storeu_si128((__m128i *) &tmp[i +  8], _mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16));
+    _mm_storeu_si128((__m128i *) &tmp[i + 12], _mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 16));
+
+    _mm_storeu_si128((__m128i *) &dst[i], _mm_packus_epi16(scale8_sse2(lo, maxv), scale8_sse2(hi, maxv)));
+  }
+  sixtap_hor_c(&dst[i], &tmp[i], &src[i], width - i, max_value);
+}
+
+TARGET_SSE2 static void sixtap_ver_sse2(imgpel *dst, imgpel **src, int width, int max_value)
+{
+  __m128i zero = _mm_setzero_si128();
+  __m128i maxv = _mm_set1_epi16((short) max_value);
+  __m128i x[6], lo, hi;
+  int i, k;
+
+  for (i = 0; i + 16 <= width; i += 16)
+  {
+    for (k = 0; k < 6; k++)
+      x[k] = _mm_loadu_si128((__m128i *) &src[k][i]);
+
+    lo = sixtap8_sse2(_mm_unpacklo_epi8(x[0], zero), _mm_unpacklo_epi8(x[1], zero), _mm_unpacklo_epi8(x[2], zero),
+                      _mm_unpacklo_epi8(x[3], zero), _mm_unpacklo_epi8(x[4], zero), _mm_unpacklo_epi8(x[5], zero));
+    hi = sixtap8_sse2(_mm_unpackhi_epi8(x[0], zero), _mm_unpackhi_epi8(x[1], zero), _mm_unpackhi_epi8(x[2], zero),
+                      _mm_unpackhi_epi8(x[3], zero), _mm_unpackhi_epi8(x[4], zero), _mm_unpackhi_epi8(x[5], zero));
+
+    _mm_storeu_si128((__m128i *) &dst[i], _mm_packus_epi16(scale8_sse2(lo, maxv), scale8_sse2(hi, maxv)));
+  }
+  if (i < width)
+  {
+    imgpel *rows[6];
+
+    for (k = 0; k < 6; k++)
+      rows[k] = &src[k][i];
+    sixtap_ver_c(&dst[i], rows, width - i, max_value);
+  }
+}
+
+TARGET_SSE2 static void sixtap_ver_tmp_sse2(imgpel *dst, int **src, int width, int max_value)
+{
+  __m128i rnd  = _mm_set1_epi32(512);
+  __m128i maxv = _mm_set1_epi16((short) max_value);
+  __m128i x[6], lo, hi;
+  int i, k;
+
+  for (i = 0; i + 8 <= width; i += 8)
+  {
+    for (k = 0; k < 6; k++)
+      x[k] = _mm_loadu_si128((__m128i *) &src[k][i]);
+    lo = _mm_srai_epi32(_mm_add_epi32(sixtap4_epi32_sse2(x), rnd), 10);
+
+    for (k = 0; k < 6; k++)
+      x[k] = _mm_loadu_si128((__m128i *) &src[k][i + 4]);
+    hi = _mm_srai_epi32(_mm_add_epi32(sixtap4_epi32_sse2(x), rnd), 10);
+
+    lo = _mm_min_epi16(_mm_max_epi16(_mm_packs_epi32(lo, hi), _mm_setzero_si128()), maxv);
+    _mm_storel_epi64((__m128i *) &dst[i], _mm_packus_epi16(lo, lo));
+  }
+  if (i < width)
+  {
+    int *rows[6];
+
+    for (k = 0; k < 6; k++)
+      rows[k] = &src[k][i];
+    sixtap_ver_tmp_c(&dst[i], rows, width - i, max_value);
+  }
+}
+
+TARGET_SSE2 static void bilinear_sse2(imgpel *dst, imgpel *src1, imgpel *src2, int width)
+{
+  int i;
+
+  for (i = 0; i + 16 <= width; i += 16)
+  {
+    _mm_storeu_si128((__m128i *) &dst[i], _mm_avg_epu8(_mm_loadu_si128((__m128i *) &src1[i]), _mm_loadu_si128((__m128i *) &src2[i])));
+  }
+  bilinear_c(&dst[i], &src1[i], &src2[i], width - i);
+}
+
+// rshift_rnd_sf(weight0 * a + weight1 * b, 6) of 8 samples (on 16 bits)
+TARGET_SSE2 static inline __m128i chroma8_sse2(__m128i a, __m128i b, __m128i weight0, __m128i weight1)
+{
+  __m128i cur_value = _mm_add_epi16(_mm_mullo_epi16(a, weight0), _mm_mullo_epi16(b, weight1));
+
+  return _mm_srli_epi16(_mm_add_epi16(cur_value, _mm_set1_epi16(32)), 6);
+}
+
+TARGET_SSE2 static void chroma_ver_sse2(imgpel *dst, imgpel *src0, imgpel *src1, int width, int weight0, int weight1)
+{
+  __m128i zero = _mm_setzero_si128();
+  __m128i w0   = _mm_set1_epi16((short) weight0);
+  __m128i w1   = _mm_set1_epi16((short) weight1);
+  __m128i a, b;
+  int i;
+
+  for (i = 0; i + 16 <= width; i += 16)
+  {
+    a = _mm_loadu_si128((__m128i *) &src0[i]);
+    b = _mm_loadu_si128((__m128i *) &src1[i]);
+    _mm_storeu_si128((__m128i *) &dst[i], _mm_packus_epi16(chroma8_sse2(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), w0, w1),
+                                                           chroma8_sse2(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), w0, w1)));
+  }
+  chroma_ver_c(&dst[i], &src0[i], &src1[i], width - i, weight0, weight1);
+}
+
+// The horizontal filter is the vertical one on the row and the row shifted by one sample
+TARGET_SSE2 static void chroma_hor_sse2(imgpel *dst, imgpel *src, int width, int weight0, int weight1)
+{
+  chroma_ver_sse2(dst, src, src + 1, width, weight0, weight1);
+}
+
+TARGET_SSE2 static void chroma_diag_sse2(imgpel *dst, imgpel *src0, imgpel *src1, int width,
+                                         int weight00, int weight01, int weight10, int weight11)
+{
+  __m128i zero = _mm_setzero_si128();
+  __m128i rnd  = _mm_set1_epi16(32);
+  __m128i w00  = _mm_set1_epi16((short) weight00);
+  __m128i w01  = _mm_set1_epi16((short) weight01);
+  __m128i w10  = _mm_set1_epi16((short) weight10);
+  __m128i w11  = _mm_set1_epi16((short) weight11);
+  __m128i a0, a1, b0, b1, lo, hi;
+  int i;
+
+  for (i = 0; i + 16 <= width; i += 16)
+  {
+    a0 = _mm_loadu_si128((__m128i *) &src0[i]);
+    a1 = _mm_loadu_si128((__m128i *) &src0[i + 1]);
+    b0 = _mm_loadu_si128((__m128i *) &src1[i]);
+    b1 = _mm_loadu_si128((__m128i *) &src1[i + 1]);
+
+    lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a0, zero), w00), _mm_mullo_epi16(_mm_unpacklo_epi8(b0, zero), w10));
+    lo = _mm_add_epi16(lo, _mm_mullo_epi16(_mm_unpacklo_epi8(a1, zero), w01));
+    lo = _mm_add_epi16(lo, _mm_mullo_epi16(_mm_unpacklo_epi8(b1, zero), w11));
+    hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a0, zero), w00), _mm_mullo_epi16(_mm_unpackhi_epi8(b0, zero), w10));
+    hi = _mm_add_epi16(hi, _mm_mullo_epi16(_mm_unpackhi_epi8(a1, zero), w01));
+    hi = _mm_add_epi16(hi, _mm_mullo_epi16(_mm_unpackhi_epi8(b1, zero), w11));
+
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, rnd), 6);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, rnd), 6);
+    _mm_storeu_si128((__m128i *) &dst[i], _mm_packus_epi16(lo, hi));
+  }
+  chroma_diag_c(&dst[i], &src0[i], &src1[i], width - i, weight00, weight01, weight10, weight11);
+}
+
+TARGET_AVX2 static inline __m256i load16_avx2(imgpel *p)
+{
+  return _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) p));
+}
+
+// Packs 16 samples on 16 bits (already within [0, 255]) to 8 bits
+TARGET_AVX2 static inline void store16_avx2(imgpel *p, __m256i v)
+{
+  _mm_storeu_si128((__m128i *) p, _mm_packus_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+}
+
+TARGET_AVX2 static inline __m256i sixtap16_avx2(__m256i c, __m256i b, __m256i a, __m256i d, __m256i e, __m256i f)
+{
+  __m256i is = _mm256_mullo_epi16(_mm256_add_epi16(a, d), _mm256_set1_epi16(20));
+
+  is = _mm256_sub_epi16(is, _mm256_mullo_epi16(_mm256_add_epi16(b, e), _mm256_set1_epi16(5)));
+  return _mm256_add_epi16(is, _mm256_add_epi16(c, f));
+}
+
+TARGET_AVX2 static inline __m256i scale16_avx2(__m256i is, __m256i max_value)
+{
+  is = _mm256_srai_epi16(_mm256_add_epi16(is, _mm256_set1_epi16(16)), 5);
+  return _mm256_min_epi16(_mm256_max_epi16(is, _mm256_setzero_si256()), max_value);
+}
+
+TARGET_AVX2 static void sixtap_hor_avx2(imgpel *dst, int *tmp, imgpel *src, int width, int max_value)
+{
+  __m256i maxv = _mm256_set1_epi16((short) max_value);
+  __m256i is;
+  int i;
+
+  for (i = 0; i + 16 <= width; i += 16)
+  {
+    is = sixtap16_avx2(load16_avx2(&src[i - 2]), load16_avx2(&src[i - 1]), load16_avx2(&src[i    ]),
+                       load16_avx2(&src[i + 1]), load16_avx2(&src[i + 2]), load16_avx2(&src[i + 3]));
+
+    _mm256_storeu_si256((__m256i *) &tmp[i    ], _mm256_cvtepi16_epi32(_mm256_castsi256_si128(is)));
+    _mm256_storeu_si256((__m256i *) &tmp[i + 8], _mm256_cvtepi16_epi32(_mm256_extracti128_si256(is, 1)));
+    store16_avx2(&dst[i], scale16_avx2(is, maxv));
+  }
+  sixtap_hor_c(&dst[i], &tmp[i], &src[i], width - i, max_value);
+}
+
+TARGET_AVX2 static void sixtap_ver_avx2(imgpel *dst, imgpel **src, int width, int max_value)
+{
+  __m256i maxv = _mm256_set1_epi16((short) max_value);
+  __m256i is;
+  int i, k;
+
+  for (i = 0; i + 16 <= width; i += 16)
+  {
+    is = sixtap16_avx2(load16_avx2(&src[0][i]), load16_avx2(&src[1][i]), load16_avx2(&src[2][i]),
+                       load16_avx2(&src[3][i]), load16_avx2(&src[4][i]), load16_avx2(&src[5][i]));
+    store16_avx2(&dst[i], scale16_avx2(is, maxv));
+  }
+  if (i < width)
+  {
+    imgpel *rows[6];
+
+    for (k = 0; k < 6; k++)
+      rows[k] = &src[k][i];
+    sixtap_ver_c(&dst[i], rows, width - i, max_value);
+  }
+}
+
+TARGET_AVX2 static inline __m256i sixtap8_epi32_avx2(int **src, int i)
+{
+  __m256i a = _mm256_add_epi32(_mm256_loadu_si256((__m256i *) &src[2][i]), _mm256_loadu_si256((__m256i *) &src[3][i]));
+  __m256i b = _mm256_add_epi32(_mm256_loadu_si256((__m256i *) &src[1][i]), _mm256_loadu_si256((__m256i *) &src[4][i]));
+  __m256i c = _mm256_add_epi32(_mm256_loadu_si256((__m256i *) &src[0][i]), _mm256_loadu_si256((__m256i *) &src[5][i]));
+
+  a = _mm256_mullo_epi32(a, _mm256_set1_epi32(20));
+  b = _mm256_mullo_epi32(b, _mm256_set1_epi32(5));
+  return _mm256_srai_epi32(_mm256_add_epi32(_mm256_add_epi32(_mm256_sub_epi32(a, b), c), _mm256_set1_epi32(512)), 10);
+}
+
+TARGET_AVX2 static void sixtap_ver_tmp_avx2(imgpel *dst, int **src, int width, int max_value)
+{
+  __m256i maxv = _mm256_set1_epi16((short) max_value);
+  __m256i is;
+  int i, k;
+
+  for (i = 0; i + 16 <= width; i += 16)
+  {
+    // packs works within the 128 bit lanes, the permutation restores the order
+    is = _mm256_packs_epi32(sixtap8_epi32_avx2(src, i), sixtap8_epi32_avx2(src, i + 8));
+    is = _mm256_permute4x64_epi64(is, 0xD8);
+    store16_avx2(&dst[i], _mm256_min_epi16(_mm256_max_epi16(is, _mm256_setzero_si256()), maxv));
+  }
+  if (i < width)
+  {
+    int *rows[6];
+
+    for (k = 0; k < 6; k++)
+      rows[k] = &src[k][i];
+    sixtap_ver_tmp_c(&dst[i], rows, width - i, max_value);
+  }
+}
+
+TARGET_AVX2 static void bilinear_avx2(imgpel *dst, imgpel *src1, imgpel *src2, int width)
+{
+  int i;
+
+  for (i = 0; i + 32 <= width; i += 32)
+  {
+    _mm256_storeu_si256((__m256i *) &dst[i], _mm256_avg_epu8(_mm256_loadu_si256((__m256i *) &src1[i]), _mm256_loadu_si256((__m256i *) &src2[i])));
+  }
+  bilinear_sse2(&dst[i], &src1[i], &src2[i], width - i);
+}
+
+TARGET_AVX2 static void chroma_ver_avx2(imgpel *dst, imgpel *src0, imgpel *src1, int width, int weight0, int weight1)
+{
+  __m256i w0  = _mm256_set1_epi16((short) weight0);
+  __m256i w1  = _mm256_set1_epi16((short) weight1);
+  __m256i rnd = _mm256_set1_epi16(32);
+  __m256i cur_value;
+  int i;
+
+  for (i = 0; i + 16 <= width; i += 16)
+  {
+    cur_value = _mm256_add_epi16(_mm256_mullo_epi16(load16_avx2(&src0[i]), w0), _mm256_mullo_epi16(load16_avx2(&src1[i]), w1));
+    store16_avx2(&dst[i], _mm256_srli_epi16(_mm256_add_epi16(cur_value, rnd), 6));
+  }
+  chroma_ver_c(&dst[i], &src0[i], &src1[i], width - i, weight0, weight1);
+}
+
+TARGET_AVX2 static void chroma_hor_avx2(imgpel *dst, imgpel *src, int width, int weight0, int weight1)
+{
+  chroma_ver_avx2(dst, src, src + 1, width, weight0, weight1);
+}
+
+TARGET_AVX2 static void chroma_diag_avx2(imgpel *dst, imgpel *src0, imgpel *src1, int width,
+                                         int weight00, int weight01, int weight10, int weight11)
+{
+  __m256i w00 = _mm256_set1_epi16((short) weight00);
+  __m256i w01 = _mm256_set1_epi16((short) weight01);
+  __m256i w10 = _mm256_set1_epi16((short) weight10);
+  __m256i w11 = _mm256_set1_epi16((short) weight11);
+  __m256i rnd = _mm256_set1_epi16(32);
+  __m256i cur_value;
+  int i;
+
+  for (i = 0; i + 16 <= width; i += 16)
+  {
+    cur_value = _mm256_add_epi16(_mm256_mullo_epi16(load16_avx2(&src0[i]), w00), _mm256_mullo_epi16(load16_avx2(&src1[i]), w10));
+    cur_value = _mm256_add_epi16(cur_value, _mm256_mullo_epi16(load16_avx2(&src0[i + 1]), w01));
+    cur_value = _mm256_add_epi16(cur_value, _mm256_mullo_epi16(load16_avx2(&src1[i + 1]), w11));
+    store16_avx2(&dst[i], _mm256_srli_epi16(_mm256_add_epi16(cur_value, rnd), 6));
+  }
+  chroma_diag_c(&dst[i], &src0[i], &src1[i], width - i, weight00, weight01, weight10, weight11);
+}
+
+static const InterpolationKernels interpolation_kernels_sse2 =
+{
+  "SSE2", DIST_SIMD_SSE2,
+  sixtap_hor_sse2, sixtap_ver_sse2, sixtap_ver_tmp_sse2, bilinear_sse2,
+  chroma_hor_sse2, chroma_ver_sse2, chroma_diag_sse2
+};
+
+static const InterpolationKernels interpolation_kernels_avx2 =
+{
+  "AVX2", DIST_SIMD_AVX2,
+  sixtap_hor_avx2, sixtap_ver_avx2, sixtap_ver_tmp_avx2, bilinear_avx2,
+  chroma_hor_avx2, chroma_ver_avx2, chroma_diag_avx2
+};
+
+#endif
+
+const InterpolationKernels *get_interpolation_kernels(int level)
+{
+  DistortionSIMD cpu_level = get_simd_cpu_level();
+
+  if (level == DIST_SIMD_AUTO || level > (int) cpu_level)
+    level = cpu_level;
+
+  switch (level)
+  {
+#if (INTERP_SIMD)
+  case DIST_SIMD_AVX2:
+    return &interpolation_kernels_avx2;
+  case DIST_SIMD_SSSE3: // nothing of SSSE3 helps the interpolation
+  case DIST_SIMD_SSE2:
+    return &interpolation_kernels_sse2;
+#endif
+  default:
+    return &interpolation_kernels_c;
+  }
+}
@@ -20,6 +20,7 @@
 #include "global.h"
 #include "image.h"
 #include "img_luma.h"
+#include "img_interp_simd.h"
 #include "memalloc.h"
 
 
@@ -57,6 +58,10 @@ void getSubImagesLuma( VideoParameters *p_Vid, StorablePicture *s )
   // simply copy the integer pels
   getSubImageInteger_s( s, cImgSub[0][0], s->p_curr_img);
 
+  // only the integer pels are stored, the others are interpolated on demand (see subpel_cache.c)
+  if (cImgSub[0][2] == NULL)
+    return;
+
   //// HALF-PEL POSITIONS: SIX-TAP FILTER ////
 
   // sub-image 2 [0][2]
@@ -74,32 +79,32 @@ void getSubImagesLuma( VideoParameters *p_Vid, StorablePicture *s )
   //// QUARTER-PEL POSITIONS: BI-LINEAR INTERPOLATION ////
 
   // sub-image 1 [0][1]
-  getSubImageBiLinear    ( s, cImgSub[0][1], cImgSub[0][0], cImgSub[0][2]);
+  getSubImageBiLinear    ( p_Vid, s, cImgSub[0][1], cImgSub[0][0], cImgSub[0][2]);
   // sub-image 4 [1][0]
-  getSubImageBiLinear    ( s, cImgSub[1][0], cImgSub[0][0], cImgSub[2][0]);
+  getSubImageBiLinear    ( p_Vid, s, cImgSub[1][0], cImgSub[0][0], cImgSub[2][0]);
   // sub-image 5 [1][1]
-  getSubImageBiLinear    ( s, cImgSub[1][1], cImgSub[0][2], cImgSub[2][0]);
+  getSubImageBiLinear    ( p_Vid, s, cImgSub[1][1], cImgSub[0][2], cImgSub[2][0]);
   // sub-image 6 [1][2]
-  getSubImageBiLinear    ( s, cImgSub[1][2], cImgSub[0][2], cImgSub[2][2]);
+  getSubImageBiLinear    ( p_Vid, s, cImgSub[1][2], cImgSub[0][2], cImgSub[2][2]);
   // sub-image 9 [2][1]
-  getSubImageBiLinear    ( s, cImgSub[2][1], cImgSub[2][0], cImgSub[2][2]);
+  getSubImageBiLinear    ( p_Vid, s, cImgSub[2][1], cImgSub[2][0], cImgSub[2][2]);
 
   // sub-image 3  [0][3]
-  getHorSubImageBiLinear ( s, cImgSub[0][3], cImgSub[0][2], cImgSub[0][0]);
+  getHorSubImageBiLinear ( p_Vid, s, cImgSub[0][3], cImgSub[0][2], cImgSub[0][0]);
   // sub-image 7  [1][3]
-  getHorSubImageBiLinear ( s, cImgSub[1][3], cImgSub[0][2], cImgSub[2][0]);
+  getHorSubImageBiLinear ( p_Vid, s, cImgSub[1][3], cImgSub[0][2], cImgSub[2][0]);
   // sub-image 11 [2][3]
-  getHorSubImageBiLinear ( s, cImgSub[2][3], cImgSub[2][2], cImgSub[2][0]);
+  getHorSubImageBiLinear ( p_Vid, s, cImgSub[2][3], cImgSub[2][2], cImgSub[2][0]);
 
   // sub-image 12 [3][0]
-  getVerSubImageBiLinear ( s, cImgSub[3][0], cImgSub[2][0], cImgSub[0][0]);
+  getVerSubImageBiLinear ( p_Vid, s, cImgSub[3][0], cImgSub[2][0], cImgSub[0][0]);
   // sub-image 13 [3][1]
-  getVerSubImageBiLinear ( s, cImgSub[3][1], cImgSub[2][0], cImgSub[0][2]);
+  getVerSubImageBiLinear ( p_Vid, s, cImgSub[3][1], cImgSub[2][0], cImgSub[0][2]);
   // sub-image 14 [3][2]
-  getVerSubImageBiLinear ( s, cImgSub[3][2], cImgSub[2][2], cImgSub[0][2]);
+  getVerSubImageBiLinear ( p_Vid, s, cImgSub[3][2], cImgSub[2][2], cImgSub[0][2]);
 
   // sub-image 15 [3][3]
-  getDiagSubImageBiLinear( s, cImgSub[3][3], cImgSub[0][2], cImgSub[2][0]);
+  getDiagSubImageBiLinear( p_Vid, s, cImgSub[3][3], cImgSub[0][2], cImgSub[2][0]);
 }
 
 
@@ -229,92 +234,40 @@ void getSubImageInteger_s( StorablePicture *s, imgpel **dstImg, imgpel **srcImg)
  */
 void getHorSubImageSixTap( VideoParameters *p_Vid, StorablePicture *s, imgpel **dstImg, imgpel **srcImg)
 {
-  int is, jpad, ipad;
+  int jpad;
   int ypadded_size = s->size_y_padded;
   int xpadded_size = s->size_x_padded;
+  int max_imgpel_value = p_Vid->max_imgpel_value;
+  const InterpolationKernels *kernels = p_Vid->interp_kernels;
 
-  imgpel *wBufSrc, *wBufDst;
-  imgpel *srcImgA, *srcImgB, *srcImgC, *srcImgD, *srcImgE, *srcImgF;
-  int *iBufDst;
-  const int tap0 = ONE_FOURTH_TAP[0][0];
-  const int tap1 = ONE_FOURTH_TAP[0][1];
-  const int tap2 = ONE_FOURTH_TAP[0][2];
-
+  // rows are independent, bands of them go to different threads
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
   for (jpad = -IMG_PAD_SIZE_Y; jpad < ypadded_size-IMG_PAD_SIZE_Y; jpad++)
   {
-    wBufSrc = srcImg[jpad]-IMG_PAD_SIZE_X;     // 4:4:4 independent mode
-    wBufDst = dstImg[jpad]-IMG_PAD_SIZE_X;     // 4:4:4 independent mode
-    iBufDst = p_Vid->imgY_sub_tmp[jpad]-IMG_PAD_SIZE_X;
-
-    srcImgA = &wBufSrc[0];
-    srcImgB = &wBufSrc[0];      
-    srcImgC = &wBufSrc[0];
-    srcImgD = &wBufSrc[1];
-    srcImgE = &wBufSrc[2];
-    srcImgF = &wBufSrc[3];
-
-    // left padded area
-    is =
-      (tap0 * (*srcImgA++ + *srcImgD++) +
-      tap1 *  (*srcImgB   + *srcImgE++) +
-      tap2 *  (*srcImgC   + *srcImgF++));
-
-    *iBufDst++ =  is;
-    *wBufDst++ = (imgpel) iClip1 ( p_Vid->max_imgpel_value, rshift_rnd_sf( is, 5 ) );      
-
-    is =
-      (tap0 * (*srcImgA++ + *srcImgD++) +
-      tap1 *  (*srcImgB++ + *srcImgE++) +
-      tap2 *  (*srcImgC   + *srcImgF++));
-
-    *iBufDst++ =  is;
-    *wBufDst++ = (imgpel) iClip1 ( p_Vid->max_imgpel_value, rshift_rnd_sf( is, 5 ) );      
+    imgpel *wBufSrc = srcImg[jpad]-IMG_PAD_SIZE_X;     // 4:4:4 independent mode
+    imgpel *wBufDst = dstImg[jpad]-IMG_PAD_SIZE_X;     // 4:4:4 independent mode
+    int    *iBufDst = p_Vid->imgY_sub_tmp[jpad]-IMG_PAD_SIZE_X;
+    int is, ipad;
 
     // center
-    for (ipad = 2; ipad < xpadded_size - 4; ipad++)
+    kernels->sixtap_hor(&wBufDst[2], &iBufDst[2], &wBufSrc[2], xpadded_size - 6, max_imgpel_value);
+
+    // left and right padded areas, the taps outside of the row take the edge samples
+    for (ipad = 0; ipad < xpadded_size; ipad++)
     {
+      if (ipad == 2)
+        ipad = xpadded_size - 4;
+
       is =
-        (tap0 * (*srcImgA++ + *srcImgD++) +
-        tap1 *  (*srcImgB++ + *srcImgE++) +
-        tap2 *  (*srcImgC++ + *srcImgF++));
+        (ONE_FOURTH_TAP[0][0] * (wBufSrc[ipad] + wBufSrc[imin(ipad + 1, xpadded_size - 1)]) +
+        ONE_FOURTH_TAP[0][1] *  (wBufSrc[imax(ipad - 1, 0)] + wBufSrc[imin(ipad + 2, xpadded_size - 1)]) +
+        ONE_FOURTH_TAP[0][2] *  (wBufSrc[imax(ipad - 2, 0)] + wBufSrc[imin(ipad + 3, xpadded_size - 1)]));
 
-      *iBufDst++ =  is;
-      *wBufDst++ = (imgpel) iClip1 ( p_Vid->max_imgpel_value, rshift_rnd_sf( is, 5 ) );      
+      iBufDst[ipad] = is;
+      wBufDst[ipad] = (imgpel) iClip1 ( max_imgpel_value, rshift_rnd_sf( is, 5 ) );
     }
-
-    is = (
-      tap0 * (*srcImgA++ + *srcImgD++) +
-      tap1 * (*srcImgB++ + *srcImgE++) +
-      tap2 * (*srcImgC++ + *srcImgF  ));
-
-    *iBufDst++ =  is;
-    *wBufDst++ = (imgpel) iClip1 ( p_Vid->max_imgpel_value, rshift_rnd_sf( is, 5 ) );      
-
-    // right padded area
-    is = (
-      tap0 * (*srcImgA++ + *srcImgD++) +
-      tap1 * (*srcImgB++ + *srcImgE) +
-      tap2 * (*srcImgC++ + *srcImgF));
-
-    *iBufDst++ =  is;
-    *wBufDst++ = (imgpel) iClip1 ( p_Vid->max_imgpel_value, rshift_rnd_sf( is, 5 ) );      
-
-    is = (
-      tap0 * (*srcImgA++ + *srcImgD) +
-      tap1 * (*srcImgB++ + *srcImgE) +
-      tap2 * (*srcImgC++ + *srcImgF));
-
-    *iBufDst++ =  is;
-    *wBufDst++ = (imgpel) iClip1 ( p_Vid->max_imgpel_value, rshift_rnd_sf( is, 5 ) );      
-
-    is = (
-      tap0 * (*srcImgA + *srcImgD) +
-      tap1 * (*srcImgB + *srcImgE) +
-      tap2 * (*srcImgC + *srcImgF));
-
-    *iBufDst =  is;
-    *wBufDst = (imgpel) iClip1 ( p_Vid->max_imgpel_value, rshift_rnd_sf( is, 5 ) );      
-
   }
 }
 
@@ -335,78 +288,29 @@ void getHorSubImageSixTap( VideoParameters *p_Vid, StorablePicture *s, imgpel **
  */
 void getVerSubImageSixTap( VideoParameters *p_Vid, StorablePicture *s, imgpel **dstImg, imgpel **srcImg)
 {
-  int is, jpad, ipad;
+  int jpad;
   int ypadded_size = s->size_y_padded;
   int xpadded_size = s->size_x_padded;
   int maxy = ypadded_size - 1-IMG_PAD_SIZE_Y;
+  int max_imgpel_value = p_Vid->max_imgpel_value;
+  const InterpolationKernels *kernels = p_Vid->interp_kernels;
 
-  imgpel *wxLineDst;
-  imgpel *srcImgA, *srcImgB, *srcImgC, *srcImgD, *srcImgE, *srcImgF;
-  const int tap0 = ONE_FOURTH_TAP[0][0];
-  const int tap1 = ONE_FOURTH_TAP[0][1];
-  const int tap2 = ONE_FOURTH_TAP[0][2];
-
-  // branches within the j loop
-  // top
-  for (jpad = -IMG_PAD_SIZE_Y; jpad < 2-IMG_PAD_SIZE_Y; jpad++)
-  {
-    wxLineDst = dstImg[jpad]-IMG_PAD_SIZE_X;
-    srcImgA = srcImg[jpad ]-IMG_PAD_SIZE_X;
-    srcImgB = srcImg[0-IMG_PAD_SIZE_Y]-IMG_PAD_SIZE_X;      
-    srcImgC = srcImg[0-IMG_PAD_SIZE_Y]-IMG_PAD_SIZE_X;
-    srcImgD = srcImg[jpad + 1]-IMG_PAD_SIZE_X;
-    srcImgE = srcImg[jpad + 2]-IMG_PAD_SIZE_X;
-    srcImgF = srcImg[jpad + 3]-IMG_PAD_SIZE_X;
-    for (ipad = 0; ipad < xpadded_size; ipad++)
-    {
-      is =
-        (tap0 * (*srcImgA++ + *srcImgD++) +
-        tap1 *  (*srcImgB++ + *srcImgE++) +
-        tap2 *  (*srcImgC++ + *srcImgF++));
-
-      wxLineDst[ipad] = (imgpel) iClip1 (p_Vid->max_imgpel_value, rshift_rnd_sf( is, 5 ) );
-    }
-  }
-  // center
-  for (jpad = 2-IMG_PAD_SIZE_Y; jpad < ypadded_size - 3-IMG_PAD_SIZE_Y; jpad++)
+  // the rows above the top and below the bottom padded rows take the edge rows
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (jpad = -IMG_PAD_SIZE_Y; jpad < ypadded_size-IMG_PAD_SIZE_Y; jpad++)
   {
-    wxLineDst = dstImg[jpad]-IMG_PAD_SIZE_X;
-    srcImgA = srcImg[jpad ]-IMG_PAD_SIZE_X;
-    srcImgB = srcImg[jpad - 1]-IMG_PAD_SIZE_X;      
-    srcImgC = srcImg[jpad - 2]-IMG_PAD_SIZE_X;
-    srcImgD = srcImg[jpad + 1]-IMG_PAD_SIZE_X;
-    srcImgE = srcImg[jpad + 2]-IMG_PAD_SIZE_X;
-    srcImgF = srcImg[jpad + 3]-IMG_PAD_SIZE_X;
-    for (ipad = 0; ipad < xpadded_size; ipad++)
-    {
-      is =
-        (tap0 * (*srcImgA++ + *srcImgD++) +
-        tap1 *  (*srcImgB++ + *srcImgE++) +
-        tap2 *  (*srcImgC++ + *srcImgF++));
-
-      wxLineDst[ipad] = (imgpel) iClip1 ( p_Vid->max_imgpel_value, rshift_rnd_sf( is, 5 ) );
-    }
-  }
+    imgpel *srcRows[6];
 
-  // bottom
-  for (jpad = ypadded_size - 3-IMG_PAD_SIZE_Y; jpad < ypadded_size-IMG_PAD_SIZE_Y; jpad++)
-  {
-    wxLineDst = dstImg[jpad]-IMG_PAD_SIZE_X;
-    srcImgA = srcImg[jpad ]-IMG_PAD_SIZE_X;
-    srcImgB = srcImg[jpad - 1]-IMG_PAD_SIZE_X;      
-    srcImgC = srcImg[jpad - 2]-IMG_PAD_SIZE_X;
-    srcImgD = srcImg[imin (maxy, jpad + 1)]-IMG_PAD_SIZE_X;
-    srcImgE = srcImg[maxy]-IMG_PAD_SIZE_X;
-    srcImgF = srcImg[maxy]-IMG_PAD_SIZE_X;
-    for (ipad = 0; ipad < xpadded_size; ipad++)
-    {
-      is =
-        (tap0 * (*srcImgA++ + *srcImgD++) +
-        tap1 *  (*srcImgB++ + *srcImgE++) +
-        tap2 *  (*srcImgC++ + *srcImgF++));
+    srcRows[0] = srcImg[imax(jpad - 2, -IMG_PAD_SIZE_Y)]-IMG_PAD_SIZE_X;
+    srcRows[1] = srcImg[imax(jpad - 1, -IMG_PAD_SIZE_Y)]-IMG_PAD_SIZE_X;
+    srcRows[2] = srcImg[jpad]-IMG_PAD_SIZE_X;
+    srcRows[3] = srcImg[imin(jpad + 1, maxy)]-IMG_PAD_SIZE_X;
+    srcRows[4] = srcImg[imin(jpad + 2, maxy)]-IMG_PAD_SIZE_X;
+    srcRows[5] = srcImg[imin(jpad + 3, maxy)]-IMG_PAD_SIZE_X;
 
-      wxLineDst[ipad] = (imgpel) iClip1 ( p_Vid->max_imgpel_value, rshift_rnd_sf( is, 5 ) );
-    }
+    kernels->sixtap_ver(dstImg[jpad]-IMG_PAD_SIZE_X, srcRows, xpadded_size, max_imgpel_value);
   }
 }
 
@@ -425,79 +329,29 @@ void getVerSubImageSixTap( VideoParameters *p_Vid, StorablePicture *s, imgpel **
  */
 void getVerSubImageSixTapTmp( VideoParameters *p_Vid, StorablePicture *s, imgpel **dstImg)
 {
-  int is, jpad, ipad;
+  int jpad;
   int ypadded_size = s->size_y_padded;
   int xpadded_size = s->size_x_padded;
   int maxy = ypadded_size - 1-IMG_PAD_SIZE_Y;
+  int max_imgpel_value = p_Vid->max_imgpel_value;
+  int **srcImg = p_Vid->imgY_sub_tmp;
+  const InterpolationKernels *kernels = p_Vid->interp_kernels;
 
-  imgpel *wxLineDst;
-  int *srcImgA, *srcImgB, *srcImgC, *srcImgD, *srcImgE, *srcImgF;
-  const int tap0 = ONE_FOURTH_TAP[0][0];
-  const int tap1 = ONE_FOURTH_TAP[0][1];
-  const int tap2 = ONE_FOURTH_TAP[0][2];
-
-  // top
-  for (jpad = -IMG_PAD_SIZE_Y; jpad < 2-IMG_PAD_SIZE_Y; jpad++)
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (jpad = -IMG_PAD_SIZE_Y; jpad < ypadded_size-IMG_PAD_SIZE_Y; jpad++)
   {
-    wxLineDst = dstImg[jpad]-IMG_PAD_SIZE_X;
-    srcImgA = p_Vid->imgY_sub_tmp[jpad ]-IMG_PAD_SIZE_X;
-    srcImgB = p_Vid->imgY_sub_tmp[0-IMG_PAD_SIZE_Y]-IMG_PAD_SIZE_X;     
-    srcImgC = p_Vid->imgY_sub_tmp[0-IMG_PAD_SIZE_Y]-IMG_PAD_SIZE_X;
-    srcImgD = p_Vid->imgY_sub_tmp[jpad + 1]-IMG_PAD_SIZE_X;
-    srcImgE = p_Vid->imgY_sub_tmp[jpad + 2]-IMG_PAD_SIZE_X;
-    srcImgF = p_Vid->imgY_sub_tmp[jpad + 3]-IMG_PAD_SIZE_X;
+    int *srcRows[6];
 
-    for (ipad = 0; ipad < xpadded_size; ipad++)
-    {
-      is =
-        (tap0 * (*srcImgA++ + *srcImgD++) +
-        tap1 *  (*srcImgB++ + *srcImgE++) +
-        tap2 *  (*srcImgC++ + *srcImgF++));
+    srcRows[0] = srcImg[imax(jpad - 2, -IMG_PAD_SIZE_Y)]-IMG_PAD_SIZE_X;
+    srcRows[1] = srcImg[imax(jpad - 1, -IMG_PAD_SIZE_Y)]-IMG_PAD_SIZE_X;
+    srcRows[2] = srcImg[jpad]-IMG_PAD_SIZE_X;
+    srcRows[3] = srcImg[imin(jpad + 1, maxy)]-IMG_PAD_SIZE_X;
+    srcRows[4] = srcImg[imin(jpad + 2, maxy)]-IMG_PAD_SIZE_X;
+    srcRows[5] = srcImg[imin(jpad + 3, maxy)]-IMG_PAD_SIZE_X;
 
-      wxLineDst[ipad] = (imgpel) iClip1 ( p_Vid->max_imgpel_value, rshift_rnd_sf( is, 10 ) );
-    }
-  }
-
-  // center
-  for (jpad = 2-IMG_PAD_SIZE_Y; jpad < ypadded_size - 3-IMG_PAD_SIZE_Y; jpad++)
-  {
-    wxLineDst = dstImg[jpad]-IMG_PAD_SIZE_X;
-    srcImgA = p_Vid->imgY_sub_tmp[jpad ]-IMG_PAD_SIZE_X;
-    srcImgB = p_Vid->imgY_sub_tmp[jpad - 1]-IMG_PAD_SIZE_X;     
-    srcImgC = p_Vid->imgY_sub_tmp[jpad - 2]-IMG_PAD_SIZE_X;
-    srcImgD = p_Vid->imgY_sub_tmp[jpad + 1]-IMG_PAD_SIZE_X;
-    srcImgE = p_Vid->imgY_sub_tmp[jpad + 2]-IMG_PAD_SIZE_X;
-    srcImgF = p_Vid->imgY_sub_tmp[jpad + 3]-IMG_PAD_SIZE_X;
-    for (ipad = 0; ipad < xpadded_size; ipad++)
-    {
-      is =
-        (tap0 * (*srcImgA++ + *srcImgD++) +
-        tap1 *  (*srcImgB++ + *srcImgE++) +
-        tap2 *  (*srcImgC++ + *srcImgF++));
-
-      wxLineDst[ipad] = (imgpel) iClip1 ( p_Vid->max_imgpel_value, rshift_rnd_sf( is, 10 ) );
-    }
-  }
-
-  // bottom
-  for (jpad = ypadded_size - 3-IMG_PAD_SIZE_Y; jpad < ypadded_size-IMG_PAD_SIZE_Y; jpad++)
-  {
-    wxLineDst = dstImg[jpad]-IMG_PAD_SIZE_X;
-    srcImgA = p_Vid->imgY_sub_tmp[jpad ]-IMG_PAD_SIZE_X;
-    srcImgB = p_Vid->imgY_sub_tmp[jpad - 1]-IMG_PAD_SIZE_X;      
-    srcImgC = p_Vid->imgY_sub_tmp[jpad - 2]-IMG_PAD_SIZE_X;
-    srcImgD = p_Vid->imgY_sub_tmp[imin (maxy, jpad + 1)]-IMG_PAD_SIZE_X;
-    srcImgE = p_Vid->imgY_sub_tmp[maxy]-IMG_PAD_SIZE_X;
-    srcImgF = p_Vid->imgY_sub_tmp[maxy]-IMG_PAD_SIZE_X;
-    for (ipad = 0; ipad < xpadded_size; ipad++)
-    {
-      is =
-        (tap0 * (*srcImgA++ + *srcImgD++) +
-        tap1 *  (*srcImgB++ + *srcImgE++) +
-        tap2 *  (*srcImgC++ + *srcImgF++));
-
-      wxLineDst[ipad] = (imgpel) iClip1 ( p_Vid->max_imgpel_value, rshift_rnd_sf( is, 10 ) );
-    }
+    kernels->sixtap_ver_tmp(dstImg[jpad]-IMG_PAD_SIZE_X, srcRows, xpadded_size, max_imgpel_value);
   }
 }
 
@@ -506,6 +360,8 @@ void getVerSubImageSixTapTmp( VideoParameters *p_Vid, StorablePicture *s, imgpel
  * \brief
  *    Does _horizontal_ interpolation using the BiLinear filter
  *
+ * \param p_Vid
+ *    pointer to VideoParameters structure
  * \param s
  *    pointer to StorablePicture structure
  * \param dstImg
@@ -516,24 +372,20 @@ void getVerSubImageSixTapTmp( VideoParameters *p_Vid, StorablePicture *s, imgpel
  *    source right image 
  ************************************************************************
  */
-void getSubImageBiLinear( StorablePicture *s, imgpel **dstImg, imgpel **srcImgL, imgpel **srcImgR)
+void getSubImageBiLinear( VideoParameters *p_Vid, StorablePicture *s, imgpel **dstImg, imgpel **srcImgL, imgpel **srcImgR)
 {
-  int jpad, ipad;
+  int jpad;
   int ypadded_size = s->size_y_padded;
   int xpadded_size = s->size_x_padded;
+  const InterpolationKernels *kernels = p_Vid->interp_kernels;
 
-  imgpel *wBufSrcL, *wBufSrcR, *wBufDst;
-
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
   for (jpad = -IMG_PAD_SIZE_Y; jpad < ypadded_size-IMG_PAD_SIZE_Y; jpad++)
   {
-    wBufSrcL = srcImgL[jpad]-IMG_PAD_SIZE_X; // 4:4:4 independent mode
-    wBufSrcR = srcImgR[jpad]-IMG_PAD_SIZE_X; // 4:4:4 independent mode
-    wBufDst  = dstImg[jpad]-IMG_PAD_SIZE_X;  // 4:4:4 independent mode
-
-    for (ipad = 0; ipad < xpadded_size; ipad++)
-    {
-      *wBufDst++ = (imgpel) rshift_rnd_sf( *wBufSrcL++ + *wBufSrcR++, 1 );
-    }
+    // 4:4:4 independent mode
+    kernels->bilinear(dstImg[jpad]-IMG_PAD_SIZE_X, srcImgL[jpad]-IMG_PAD_SIZE_X, srcImgR[jpad]-IMG_PAD_SIZE_X, xpadded_size);
   }
 }
 
@@ -543,6 +395,8 @@ void getSubImageBiLinear( StorablePicture *s, imgpel **dstImg, imgpel **srcImgL,
  * \brief
  *    Does _horizontal_ interpolation using the BiLinear filter
  *
+ * \param p_Vid
+ *    pointer to VideoParameters structure
  * \param s
  *    pointer to StorablePicture structure
  * \param dstImg
@@ -553,27 +407,26 @@ void getSubImageBiLinear( StorablePicture *s, imgpel **dstImg, imgpel **srcImgL,
  *    source right image 
  ************************************************************************
  */
-void getHorSubImageBiLinear( StorablePicture *s, imgpel **dstImg, imgpel **srcImgL, imgpel **srcImgR)
+void getHorSubImageBiLinear( VideoParameters *p_Vid, StorablePicture *s, imgpel **dstImg, imgpel **srcImgL, imgpel **srcImgR)
 {
-  int jpad, ipad;
+  int jpad;
   int ypadded_size = s->size_y_padded;
   int xpadded_size = s->size_x_padded - 1;
+  const InterpolationKernels *kernels = p_Vid->interp_kernels;
 
-  imgpel *wBufSrcL, *wBufSrcR, *wBufDst;
-
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
   for (jpad = -IMG_PAD_SIZE_Y; jpad < ypadded_size-IMG_PAD_SIZE_Y; jpad++)
   {
-    wBufSrcL = srcImgL[jpad]-IMG_PAD_SIZE_X; // 4:4:4 independent mode
-    wBufSrcR = &srcImgR[jpad][1-IMG_PAD_SIZE_X]; // 4:4:4 independent mode
-    wBufDst  = dstImg[jpad]-IMG_PAD_SIZE_X;     // 4:4:4 independent mode
+    imgpel *wBufSrcL = srcImgL[jpad]-IMG_PAD_SIZE_X;     // 4:4:4 independent mode
+    imgpel *wBufSrcR = &srcImgR[jpad][1-IMG_PAD_SIZE_X]; // 4:4:4 independent mode
+    imgpel *wBufDst  = dstImg[jpad]-IMG_PAD_SIZE_X;      // 4:4:4 independent mode
 
     // left padded area + center
-    for (ipad = 0; ipad < xpadded_size; ipad++)
-    {
-      *wBufDst++ = (imgpel) rshift_rnd_sf( *wBufSrcL++ + *wBufSrcR++, 1 );
-    }
+    kernels->bilinear(wBufDst, wBufSrcL, wBufSrcR, xpadded_size);
     // right padded area
-      *wBufDst++ = (imgpel) rshift_rnd_sf( *wBufSrcL++ + wBufSrcR[-1], 1 );
+    wBufDst[xpadded_size] = (imgpel) rshift_rnd_sf( wBufSrcL[xpadded_size] + wBufSrcR[xpadded_size - 1], 1 );
   }
 }
 
@@ -583,6 +436,8 @@ void getHorSubImageBiLinear( StorablePicture *s, imgpel **dstImg, imgpel **srcIm
  * \brief
  *    Does _vertical_ interpolation using the BiLinear filter
  *
+ * \param p_Vid
+ *    pointer to VideoParameters structure
  * \param s
  *    pointer to StorablePicture structure
  * \param dstImg
@@ -593,34 +448,21 @@ void getHorSubImageBiLinear( StorablePicture *s, imgpel **dstImg, imgpel **srcIm
  *    source bottom image 
  ************************************************************************
  */
-void getVerSubImageBiLinear( StorablePicture *s, imgpel **dstImg, imgpel **srcImgT, imgpel **srcImgB)
+void getVerSubImageBiLinear( VideoParameters *p_Vid, StorablePicture *s, imgpel **dstImg, imgpel **srcImgT, imgpel **srcImgB)
 {
-  int jpad, ipad;
-  int ypadded_size = s->size_y_padded - 1;
+  int jpad;
+  int maxy = s->size_y_padded - 1-IMG_PAD_SIZE_Y;
   int xpadded_size = s->size_x_padded;  
+  const InterpolationKernels *kernels = p_Vid->interp_kernels;
 
-  imgpel *wBufSrcT, *wBufSrcB, *wBufDst;
-
-  // top
-  for (jpad = -IMG_PAD_SIZE_Y; jpad < ypadded_size-IMG_PAD_SIZE_Y; jpad++)
-  {
-    wBufSrcT = srcImgT[jpad]-IMG_PAD_SIZE_X;           // 4:4:4 independent mode
-    wBufDst  = dstImg[jpad]-IMG_PAD_SIZE_X;            // 4:4:4 independent mode
-    wBufSrcB = srcImgB[jpad + 1]-IMG_PAD_SIZE_X;  // 4:4:4 independent mode
-
-    for (ipad = 0; ipad < xpadded_size; ipad++)
-    {
-      *wBufDst++ = (imgpel) rshift_rnd_sf(*wBufSrcT++ + *wBufSrcB++, 1);
-    }
-  }
-  // bottom
-  wBufSrcT = srcImgT[ypadded_size-IMG_PAD_SIZE_Y]-IMG_PAD_SIZE_X;           // 4:4:4 independent mode
-  wBufDst  = dstImg[ypadded_size-IMG_PAD_SIZE_Y]-IMG_PAD_SIZE_X;            // 4:4:4 independent mode
-  wBufSrcB = srcImgB[ypadded_size-IMG_PAD_SIZE_Y]-IMG_PAD_SIZE_X;           // 4:4:4 independent mode
-
-  for (ipad = 0; ipad < xpadded_size; ipad++)
+  // the bottom row takes the bottom image of its own row
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (jpad = -IMG_PAD_SIZE_Y; jpad <= maxy; jpad++)
   {
-    *wBufDst++ = (imgpel) rshift_rnd_sf(*wBufSrcT++ + *wBufSrcB++, 1);
+    // 4:4:4 independent mode
+    kernels->bilinear(dstImg[jpad]-IMG_PAD_SIZE_X, srcImgT[jpad]-IMG_PAD_SIZE_X, srcImgB[imin(jpad + 1, maxy)]-IMG_PAD_SIZE_X, xpadded_size);
   }
 }
 
@@ -630,6 +472,8 @@ void getVerSubImageBiLinear( StorablePicture *s, imgpel **dstImg, imgpel **srcIm
  * \brief
  *    Does _diagonal_ interpolation using the BiLinear filter
  *
+ * \param p_Vid
+ *    pointer to VideoParameters structure
  * \param s
  *    pointer to StorablePicture structure
  * \param dstImg
@@ -640,38 +484,26 @@ void getVerSubImageBiLinear( StorablePicture *s, imgpel **dstImg, imgpel **srcIm
  *    source bottom/right image 
  ************************************************************************
  */
-void getDiagSubImageBiLinear( StorablePicture *s, imgpel **dstImg, imgpel **srcImgT, imgpel **srcImgB )
+void getDiagSubImageBiLinear( VideoParameters *p_Vid, StorablePicture *s, imgpel **dstImg, imgpel **srcImgT, imgpel **srcImgB )
 {
-  int jpad, ipad;
-  int maxx = s->size_x_padded - 1-IMG_PAD_SIZE_X;
+  int jpad;
+  int xpadded_size = s->size_x_padded - 1;
   int maxy = s->size_y_padded - 1-IMG_PAD_SIZE_Y;
+  const InterpolationKernels *kernels = p_Vid->interp_kernels;
 
-  imgpel *wBufSrcL, *wBufSrcR, *wBufDst;
-
-  for (jpad = -IMG_PAD_SIZE_Y; jpad < maxy; jpad++)
+  // the bottom row takes the top/left image of its own row
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (jpad = -IMG_PAD_SIZE_Y; jpad <= maxy; jpad++)
   {
-    wBufSrcL = srcImgT[jpad + 1]-IMG_PAD_SIZE_X; // 4:4:4 independent mode
-    wBufSrcR = &srcImgB[jpad][1-IMG_PAD_SIZE_X]; // 4:4:4 independent mode
-    wBufDst  = dstImg[jpad]-IMG_PAD_SIZE_X;      // 4:4:4 independent mode
-
-    for (ipad = -IMG_PAD_SIZE_X; ipad < maxx; ipad++)
-    {
-      *wBufDst++ = (imgpel) rshift_rnd_sf(*wBufSrcL++ + *wBufSrcR++, 1);
-    }
+    imgpel *wBufSrcL = srcImgT[imin(jpad + 1, maxy)]-IMG_PAD_SIZE_X; // 4:4:4 independent mode
+    imgpel *wBufSrcR = &srcImgB[jpad][1-IMG_PAD_SIZE_X];             // 4:4:4 independent mode
+    imgpel *wBufDst  = dstImg[jpad]-IMG_PAD_SIZE_X;                  // 4:4:4 independent mode
 
-    *wBufDst++ = (imgpel) rshift_rnd_sf(*wBufSrcL++ +  wBufSrcR[-1], 1);
+    kernels->bilinear(wBufDst, wBufSrcL, wBufSrcR, xpadded_size);
+    wBufDst[xpadded_size] = (imgpel) rshift_rnd_sf( wBufSrcL[xpadded_size] + wBufSrcR[xpadded_size - 1], 1 );
   }
-
-  wBufSrcL = srcImgT[maxy]-IMG_PAD_SIZE_X;     // 4:4:4 independent mode
-  wBufSrcR = &srcImgB[maxy][1-IMG_PAD_SIZE_X]; // 4:4:4 independent mode
-  wBufDst = dstImg[maxy]-IMG_PAD_SIZE_X;       // 4:4:4 independent mode
-
-  for (ipad = -IMG_PAD_SIZE_X; ipad < maxx; ipad++)
-  {
-    *wBufDst++ = (imgpel) rshift_rnd_sf(*wBufSrcL++ + *wBufSrcR++, 1);
-  }
-
-    *wBufDst++ = (imgpel) rshift_rnd_sf(*wBufSrcL++ + wBufSrcR[-1], 1);
 }
 
 
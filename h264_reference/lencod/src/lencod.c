@@ -82,6 +82,9 @@
 #include "img_process.h"
 #include "q_offsets.h"
 #include "pred_struct.h"
+#include "subpel_cache.h"
+#include "slice_threads.h"
+#include "mb_wavefront.h"
 
 
 static const int mb_width_cr[4] = {0, 8, 8,16};
@@ -222,37 +225,70 @@ int main(int argc, char **argv)
 
   Configure (p_Enc->p_Vid, p_Enc->p_Inp, argc, argv);
 
-  /* KATCIPIS - init metadata extractor */
+  // init encoder
+  init_encoder(p_Enc->p_Vid, p_Enc->p_Inp);
+
+  /* KATCIPIS - init metadata extractor, after the encoder init since it needs the frame size */
   if (p_Enc->p_Inp->object_detection_enable) {
     printf("Enabled object detection \n");
-    p_Enc->p_Vid->metadata_extractor = metadata_extractor_new(p_Enc->p_Inp->object_detection_min_width,
+    p_Enc->p_Vid->metadata_extractor = metadata_extractor_new(p_Enc->p_Vid->width,
+                                                              p_Enc->p_Vid->height,
+                                                              p_Enc->p_Inp->object_detection_min_width,
                                                               p_Enc->p_Inp->object_detection_min_height,
                                                               p_Enc->p_Inp->object_detection_search_hysteresis,
                                                               p_Enc->p_Inp->object_detection_tracking_hysteresis,
+                                                              p_Enc->p_Inp->object_detection_discovery_hysteresis,
                                                               p_Enc->p_Inp->object_detection_training_file);
 
     if (!p_Enc->p_Vid->metadata_extractor) {
       printf("ERROR CREATING METADATA EXTRACTOR !!!!\n");
       return -1;
     }
+
+    metadata_extractor_set_detection_threads(p_Enc->p_Vid->metadata_extractor,
+                                             p_Enc->p_Inp->object_detection_threads);
+
+    metadata_extractor_set_sparse_metadata(p_Enc->p_Vid->metadata_extractor,
+                                           p_Enc->p_Inp->object_detection_sparse_metadata);
+
+    if (p_Enc->p_Inp->object_detection_qp_offset) {
+      p_Enc->p_Vid->region_qp = region_qp_new(p_Enc->p_Vid->PicWidthInMbs,
+                                              p_Enc->p_Vid->FrameHeightInMbs,
+                                              p_Enc->p_Inp->object_detection_qp_offset);
+    }
+
+    if (p_Enc->p_Inp->object_detection_async &&
+        !metadata_extractor_enable_async_detection(p_Enc->p_Vid->metadata_extractor,
+                                                   p_Enc->p_Inp->object_detection_async_queue_size)) {
+      printf("Object detection will be synchronous \n");
+    }
   } else {
     printf("Disabled object detection \n");
     p_Enc->p_Vid->metadata_extractor = NULL;
   }
 
-  // init encoder
-  init_encoder(p_Enc->p_Vid, p_Enc->p_Inp);
-
   // encode sequence
   encode_sequence(p_Enc->p_Vid, p_Enc->p_Inp);
 
-  // terminate sequence
-  free_encoder_memory(p_Enc->p_Vid, p_Enc->p_Inp);
-
+  /* The extractor is stored on p_Vid, it must be freed before the encoder memory */
   if (p_Enc->p_Inp->object_detection_enable && p_Enc->p_Vid->metadata_extractor) {
     metadata_extractor_free(p_Enc->p_Vid->metadata_extractor);
   }
 
+  if (p_Enc->p_Vid->metadata_sei_nalu) {
+    FreeNALU(p_Enc->p_Vid->metadata_sei_nalu);
+    p_Enc->p_Vid->metadata_sei_nalu = NULL;
+  }
+
+  extracted_metadata_codec_free(p_Enc->p_Vid->metadata_codec);
+  p_Enc->p_Vid->metadata_codec = NULL;
+
+  region_qp_free(p_Enc->p_Vid->region_qp);
+  p_Enc->p_Vid->region_qp = NULL;
+
+  // terminate sequence
+  free_encoder_memory(p_Enc->p_Vid, p_Enc->p_Inp);
+
   free_params (p_Enc->p_Inp);  
   free_encoder(p_Enc);
 
@@ -480,6 +516,8 @@ static void init_encoder(VideoParameters *p_Vid, InputParameters *p_Inp)
   }
 
   Init_Motion_Search_Module (p_Vid, p_Inp);
+  init_slice_threads (p_Vid, p_Inp);
+  init_mb_wavefront (p_Vid, p_Inp);
   information_init(p_Vid, p_Inp, p_Vid->p_Stats);
 
   if(p_Inp->DistortionYUVtoRGB)
@@ -767,6 +805,8 @@ void free_encoder_memory(VideoParameters *p_Vid, InputParameters *p_Inp)
   if (p_Enc->p_trace)
     fclose(p_Enc->p_trace);
 
+  free_slice_threads (p_Vid);
+  free_mb_wavefront (p_Vid);
   Clear_Motion_Search_Module (p_Vid, p_Inp);
 
   RandomIntraUninit(p_Vid);
@@ -1436,7 +1476,9 @@ static int init_global_buffers(VideoParameters *p_Vid, InputParameters *p_Inp)
     memory_size += get_mem2Dpel(&p_Vid->imgUV_tmp[1], p_Vid->height_cr, p_Vid->width_cr);
   }
 
-  memory_size += get_mem2DintWithPad (&p_Vid->imgY_sub_tmp, p_Vid->height, p_Vid->width, IMG_PAD_SIZE_Y, IMG_PAD_SIZE_X);
+  // the 4:4:4 color components keep their sub-images, whatever LumaMCBuffer says
+  if ( p_Inp->LumaMCBuffer || p_Inp->yuv_format == YUV444 )
+    memory_size += get_mem2DintWithPad (&p_Vid->imgY_sub_tmp, p_Vid->height, p_Vid->width, IMG_PAD_SIZE_Y, IMG_PAD_SIZE_X);
 
   if ( p_Inp->ChromaMCBuffer )
     chroma_mc_setup(p_Vid);
@@ -1449,6 +1491,9 @@ static int init_global_buffers(VideoParameters *p_Vid, InputParameters *p_Inp)
   p_Vid->cr_padded_size_x4   = (p_Vid->cr_padded_size_x << 2);
   p_Vid->cr_padded_size_x_m8 = (p_Vid->cr_padded_size_x - 8);
 
+  if ( !p_Inp->LumaMCBuffer )
+    memory_size += init_subpel_cache(p_Vid);
+
   // RGB images for distortion calculation
   // Recommended to do this allocation (and de-allocation) in 
   // the appropriate file instead of here.
@@ -1605,6 +1650,8 @@ static void free_global_buffers(VideoParameters *p_Vid, InputParameters *p_Inp)
     p_Vid->imgY_sub_tmp = NULL;
   }
 
+  free_subpel_cache(p_Vid);
+
   // free mem, allocated in init_img()
   // free intra pred mode buffer for blocks
   free_mem2D((byte**)p_Vid->ipredmode);
@@ -249,6 +249,21 @@ void update_qp(Macroblock *currMB)
   select_transform(currMB);
 }
 
+/*!
+************************************************************************
+* \brief
+*    clips a luma QP to the QPs that mb_qp_delta can reach from the
+*    QP of the previous macroblock of the slice
+************************************************************************
+*/
+int clip_mb_qp(Macroblock *currMB, int qp)
+{
+  int max_delta = 25 + (currMB->p_Vid->bitdepth_luma_qp_scale >> 1);
+
+  qp = iClip3(currMB->prev_qp - max_delta - 1, currMB->prev_qp + max_delta, qp);
+  return iClip3(-currMB->p_Vid->bitdepth_luma_qp_scale, 51, qp);
+}
+
 /*!
  ************************************************************************
  * \brief
@@ -419,6 +434,12 @@ void start_macroblock(Slice *currSlice, Macroblock **currMB, int mb_addr, Boolea
     (*currMB)->prev_dqp = 0;
   }
 
+  /* KATCIPIS - p_Vid->qp carries the region offset of the previous macroblock, the base QP goes on without it */
+  if (p_Vid->region_qp && region_qp_is_active(p_Vid->region_qp) && (*currMB)->mbAddrX != 0)
+  {
+    p_Vid->qp = p_Vid->region_base_qp;
+  }
+
   if(p_Inp->RCEnable && (last_coded_mb != *currMB))   //!< avoid decreasing the NumberofbasicUnit for the same MB twice
   {
     mb_qp = rc_handle_mb( *currMB, prev_mb);
@@ -428,12 +449,20 @@ void start_macroblock(Slice *currSlice, Macroblock **currMB, int mb_addr, Boolea
     mb_qp = p_Vid->qp;
 
   }
-  last_coded_mb = *currMB;   // save the address of the last coded MB
+  if (p_Inp->RCEnable)        // only rate control reads it, the encoder threads (no rate control) leave it alone
+    last_coded_mb = *currMB;   // save the address of the last coded MB
   
   if ((*currMB)->mbAddrX == 0)
     p_Vid->BasicUnitQP = mb_qp;
 
-  mb_qp = iClip3(-p_Vid->bitdepth_luma_qp_scale, 51, mb_qp);
+  if (p_Vid->region_qp && region_qp_is_active(p_Vid->region_qp))
+  {
+    p_Vid->region_base_qp = mb_qp;
+    mb_qp += region_qp_get_offset(p_Vid->region_qp, (*currMB)->mb_x, (*currMB)->mb_y, p_Vid->field_picture);
+  }
+
+  /* KATCIPIS - the region offsets can jump further from the previous macroblock than mb_qp_delta codes */
+  mb_qp = clip_mb_qp(*currMB, mb_qp);
   (*currMB)->qp = (short) mb_qp;
   p_Vid->qp = mb_qp;
   
@@ -0,0 +1,481 @@
+/*!
+*************************************************************************************
+* \file mb_wavefront.c
+*
+* \brief
+*    Wavefront macroblock coding (WavefrontThreads). The motion search, the mode
+*    decision and the reconstruction of the macroblocks of a picture coded as a
+*    single slice run in parallel: row y decides macroblock x only after row y-1
+*    decided macroblock x+1, so the left, top, top-left and top-right neighbors
+*    are always there and every anti-diagonal of macroblocks (x + 2y constant)
+*    is decided in parallel. The syntax of the decided macroblocks is written
+*    afterwards in raster order, on the slice itself, so the bitstream follows
+*    the usual order and can be decoded by any decoder.
+*
+*    A macroblock is decided on the copy of VideoParameters of its thread (see
+*    enc_thread.c) and on a copy of the slice for its row, with its own RDO
+*    structure, coding state (CSobj), contexts and scratch bitstream. The row
+*    writes its decided macroblocks to the scratch bitstream, to keep its
+*    contexts and skip run for the rate estimates of the next decisions, and
+*    the decision (the Macroblock, its nz_coeff, cbp and coefficients) is kept
+*    for the raster order pass.
+*
+*    The rate estimates are the only difference with the single threaded
+*    encoder: a row starts with the contexts the row above has after its second
+*    macroblock, and with no pending skip run. They do not depend on the number
+*    of threads.
+*
+* \author
+*    Tiago Katcipis                 <tiagokatcipis@gmail.com>
+*
+*************************************************************************************
+*/
+
+// Includes
+#include "contributors.h"
+
+#include "global.h"
+#include "memalloc.h"
+#include "biariencode.h"
+#include "macroblock.h"
+#include "rdopt.h"
+#include "rdoq.h"
+#include "slice.h"
+#include "subpel_cache.h"
+#include "region_qp.h"
+#include "enc_thread.h"
+#include "mb_wavefront.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+//! decision of a macroblock, written in raster order
+typedef struct wavefront_mb
+{
+  Macroblock mb;                       //!< the macroblock before its syntax is written
+  int       *nz_coeff;                 //!< its nz_coeff
+  int        cmp_cbp[3];
+  int        curr_cbp[2];
+  int64      cur_cbp_blk[MAX_PLANE];
+  short      NoResidueDirect;
+  int       *coeff;                    //!< cofAC and cofDC, each list as its length, levels and runs
+  int        coeff_size;
+} WavefrontMB;
+
+//! a row of macroblocks being decided
+typedef struct wavefront_row
+{
+  Slice     *slice;                    //!< copy of the slice
+  int        cod_counter;              //!< skip run of the row
+} WavefrontRow;
+
+struct mb_wavefront
+{
+  int           threads;
+  EncThread    *thread;                //!< one per thread
+  int64        *me_tot_time;           //!< motion search time of each thread in the picture
+  WavefrontMB  *mb;                    //!< one per macroblock of a frame
+  int           nz_size;               //!< nz_coeff of a macroblock
+  int           rows;                  //!< rows being decided at the same time
+  WavefrontRow *row;
+};
+
+/*!
+ ***********************************************************************
+ * \brief
+ *    Allocates the thread copies and the decisions of the wavefront
+ ***********************************************************************
+ */
+void init_mb_wavefront (VideoParameters *p_Vid, InputParameters *p_Inp)
+{
+  MBWavefront *p_wf = NULL;
+  int i;
+
+  p_Vid->p_wavefront = NULL;
+  if (!p_Inp->WavefrontThreads)
+    return;
+
+  if ((p_wf = calloc (1, sizeof (MBWavefront))) == NULL)
+    no_mem_exit ("init_mb_wavefront: p_Vid->p_wavefront");
+
+#ifdef _OPENMP
+  p_wf->threads = p_Inp->WavefrontThreads;
+#else
+  p_wf->threads = 1;
+#endif
+
+  if ((p_wf->thread = calloc (p_wf->threads, sizeof (EncThread))) == NULL)
+    no_mem_exit ("init_mb_wavefront: p_wf->thread");
+  if ((p_wf->me_tot_time = calloc (p_wf->threads, sizeof (int64))) == NULL)
+    no_mem_exit ("init_mb_wavefront: p_wf->me_tot_time");
+  for (i = 0; i < p_wf->threads; i++)
+    init_enc_thread (&p_wf->thread[i], p_Vid, p_Inp);
+
+  p_wf->nz_size = 4 * (4 + p_Vid->num_blk8x8_uv);
+  if ((p_wf->mb = calloc (p_Vid->FrameSizeInMbs, sizeof (WavefrontMB))) == NULL)
+    no_mem_exit ("init_mb_wavefront: p_wf->mb");
+  for (i = 0; i < (int) p_Vid->FrameSizeInMbs; i++)
+  {
+    if ((p_wf->mb[i].nz_coeff = calloc (p_wf->nz_size, sizeof (int))) == NULL)
+      no_mem_exit ("init_mb_wavefront: p_wf->mb[i].nz_coeff");
+  }
+
+  // a row ends before the row that takes its copy of the slice starts
+  p_wf->rows = imin (p_Vid->FrameHeightInMbs, p_Vid->PicWidthInMbs / 2 + 1);
+  if ((p_wf->row = calloc (p_wf->rows, sizeof (WavefrontRow))) == NULL)
+    no_mem_exit ("init_mb_wavefront: p_wf->row");
+
+  p_Vid->p_wavefront = p_wf;
+}
+
+/*!
+ ***********************************************************************
+ * \brief
+ *    Frees the thread copies and the decisions of the wavefront
+ ***********************************************************************
+ */
+void free_mb_wavefront (VideoParameters *p_Vid)
+{
+  MBWavefront *p_wf = p_Vid->p_wavefront;
+  int i;
+
+  if (p_wf == NULL)
+    return;
+
+  for (i = 0; i < p_wf->threads; i++)
+    free_enc_thread (&p_wf->thread[i]);
+
+  for (i = 0; i < (int) p_Vid->FrameSizeInMbs; i++)
+  {
+    free (p_wf->mb[i].nz_coeff);
+    free (p_wf->mb[i].coeff);
+  }
+
+  free (p_wf->row);
+  free (p_wf->mb);
+  free (p_wf->me_tot_time);
+  free (p_wf->thread);
+  free (p_wf);
+  p_Vid->p_wavefront = NULL;
+}
+
+/*!
+ ***********************************************************************
+ * \brief
+ *    Checks if the macroblocks of a slice can be coded by the wavefront
+ ***********************************************************************
+ */
+Boolean mb_wavefront_usable (Slice *currSlice)
+{
+  VideoParameters *p_Vid = currSlice->p_Vid;
+
+  if (p_Vid->p_wavefront == NULL || currSlice->mb_aff_frame_flag)
+    return FALSE;
+
+  // the SP and SI residual coding is left to the single threaded encoder
+  if (currSlice->slice_type == SP_SLICE || currSlice->slice_type == SI_SLICE)
+    return FALSE;
+
+  // the QP offsets of the tracked objects carry the base QP from a macroblock to the next
+  if (p_Vid->region_qp && region_qp_is_active (p_Vid->region_qp))
+    return FALSE;
+
+  return TRUE;
+}
+
+/*!
+ ***********************************************************************
+ * \brief
+ *    Number of coefficients of a list, which ends at its first zero level
+ ***********************************************************************
+ */
+static int list_length (int *level, int size)
+{
+  int n = 0;
+
+  while (n < size && level[n] != 0)
+    n++;
+
+  return n;
+}
+
+/*!
+ ***********************************************************************
+ * \brief
+ *    Keeps the coefficients of a list
+ ***********************************************************************
+ */
+static int *pack_list (int *coeff, int **list, int size)
+{
+  int n = list_length (list[0], size);
+
+  *coeff++ = n;
+  memcpy (coeff, list[0], n * sizeof (int));
+  memcpy (coeff + n, list[1], n * sizeof (int));
+
+  return coeff + 2 * n;
+}
+
+/*!
+ ***********************************************************************
+ * \brief
+ *    Restores the coefficients of a list kept by pack_list()
+ ***********************************************************************
+ */
+static int *unpack_list (int *coeff, int **list, int size)
+{
+  int n = *coeff++;
+
+  memcpy (list[0], coeff, n * sizeof (int));
+  memcpy (list[1], coeff + n, n * sizeof (int));
+  if (n < size)
+    list[0][n] = list[1][n] = 0;
+
+  return coeff + 2 * n;
+}
+
+/*!
+ ***********************************************************************
+ * \brief
+ *    Keeps the decision of a macroblock, before its syntax is written
+ ***********************************************************************
+ */
+static void store_decision (VideoParameters *p_Vid, Slice *currSlice, Macroblock *currMB, WavefrontMB *rec, int nz_size)
+{
+  int blocks = BLOCK_SIZE + p_Vid->num_blk8x8_uv;
+  int b8, b4, uv, size = 0;
+  int *coeff;
+
+  memcpy (&rec->mb, currMB, sizeof (Macroblock));
+  memcpy (rec->nz_coeff, &p_Vid->nz_coeff[currMB->mbAddrX][0][0], nz_size * sizeof (int));
+  memcpy (rec->cmp_cbp, currSlice->cmp_cbp, 3 * sizeof (int));
+  memcpy (rec->curr_cbp, currSlice->curr_cbp, 2 * sizeof (int));
+  memcpy (rec->cur_cbp_blk, currSlice->cur_cbp_blk, MAX_PLANE * sizeof (int64));
+  rec->NoResidueDirect = currSlice->NoResidueDirect;
+
+  for (b8 = 0; b8 < blocks; b8++)
+    for (b4 = 0; b4 < BLOCK_SIZE; b4++)
+      size += 1 + 2 * list_length (currSlice->cofAC[b8][b4][0], 65);
+  for (uv = 0; uv < 3; uv++)
+    size += 1 + 2 * list_length (currSlice->cofDC[uv][0], 18);
+
+  if (size > rec->coeff_size)
+  {
+    free (rec->coeff);
+    if ((rec->coeff = malloc (size * sizeof (int))) == NULL)
+      no_mem_exit ("store_decision: rec->coeff");
+    rec->coeff_size = size;
+  }
+
+  coeff = rec->coeff;
+  for (b8 = 0; b8 < blocks; b8++)
+    for (b4 = 0; b4 < BLOCK_SIZE; b4++)
+      coeff = pack_list (coeff, currSlice->cofAC[b8][b4], 65);
+  for (uv = 0; uv < 3; uv++)
+    coeff = pack_list (coeff, currSlice->cofDC[uv], 18);
+}
+
+/*!
+ ***********************************************************************
+ * \brief
+ *    Restores the decision of a macroblock kept by store_decision() on
+ *    the slice
+ ***********************************************************************
+ */
+static Macroblock *restore_decision (VideoParameters *p_Vid, Slice *currSlice, WavefrontMB *rec, int mb_nr, int nz_size)
+{
+  Macroblock *currMB = &p_Vid->mb_data[mb_nr];
+  int blocks = BLOCK_SIZE + p_Vid->num_blk8x8_uv;
+  int b8, b4, uv;
+  int *coeff;
+
+  memcpy (currMB, &rec->mb, sizeof (Macroblock));
+  currMB->p_Slice = currSlice;
+  currMB->p_Vid   = p_Vid;
+  currMB->p_Inp   = currSlice->p_Inp;
+
+  memcpy (&p_Vid->nz_coeff[mb_nr][0][0], rec->nz_coeff, nz_size * sizeof (int));
+  memcpy (currSlice->cmp_cbp, rec->cmp_cbp, 3 * sizeof (int));
+  memcpy (currSlice->curr_cbp, rec->curr_cbp, 2 * sizeof (int));
+  memcpy (currSlice->cur_cbp_blk, rec->cur_cbp_blk, MAX_PLANE * sizeof (int64));
+  currSlice->NoResidueDirect = rec->NoResidueDirect;
+
+  coeff = rec->coeff;
+  for (b8 = 0; b8 < blocks; b8++)
+    for (b4 = 0; b4 < BLOCK_SIZE; b4++)
+      coeff = unpack_list (coeff, currSlice->cofAC[b8][b4], 65);
+  for (uv = 0; uv < 3; uv++)
+    coeff = unpack_list (coeff, currSlice->cofDC[uv], 18);
+
+  return currMB;
+}
+
+/*!
+ ***********************************************************************
+ * \brief
+ *    Decides macroblock (x, y) of the picture on a thread, and writes it
+ *    to the scratch bitstream of its row
+ ***********************************************************************
+ */
+static void decide_macroblock (VideoParameters *p_Vid, MBWavefront *p_wf, int tid, int x, int y)
+{
+  EncThread *t = &p_wf->thread[tid];
+  VideoParameters *p_Vid_t = start_enc_thread (t, p_Vid);
+  WavefrontRow *row = &p_wf->row[y % p_wf->rows];
+  Slice *currSlice = row->slice;
+  Macroblock *currMB = NULL;
+  int width = p_Vid->PicWidthInMbs;
+  int mb_nr = y * width + x;
+  int i;
+
+  p_Vid_t->currentSlice = currSlice;
+  if (x == 0)
+  {
+    row->cod_counter = 0;
+    for (i = 0; i < currSlice->max_part_nr; i++)
+    {
+      Bitstream *currStream = currSlice->partArr[i].bitstream;
+
+      currStream->byte_pos   = 0;
+      currStream->bits_to_go = 8;
+      currStream->byte_buf   = 0;
+      if (currSlice->symbol_mode == CABAC)
+      {
+        arienco_start_encoding (&currSlice->partArr[i].ee_cabac, currStream->streamBuffer, &(currStream->byte_pos));
+        arienco_reset_EC (&currSlice->partArr[i].ee_cabac);
+      }
+    }
+  }
+  p_Vid_t->cod_counter = row->cod_counter;
+  set_slice_encoder (currSlice, p_Vid_t);
+
+  if (currSlice->UseRDOQuant)
+    currSlice->rddata = &currSlice->rddata_trellis_curr;
+  else
+    currSlice->rddata = &currSlice->rddata_top_frame_mb;
+
+  start_macroblock (currSlice, &currMB, mb_nr, FALSE);
+
+  if (currSlice->UseRDOQuant)
+  {
+    trellis_sp_mode_decision (currMB);
+  }
+  else
+  {
+    p_Vid_t->masterQP = p_Vid_t->qp;
+
+    currSlice->encode_one_macroblock (currMB);
+    end_encode_one_macroblock (currMB);
+  }
+
+  store_decision (p_Vid_t, currSlice, currMB, &p_wf->mb[mb_nr], p_wf->nz_size);
+
+  // the contexts and the skip run of the row for the next decisions
+  write_macroblock (currMB, 1);
+  row->cod_counter = p_Vid_t->cod_counter;
+
+  // the row below starts with the contexts this row has after its second macroblock
+  if (currSlice->symbol_mode == CABAC && x == imin (1, width - 1) && y + 1 < (int) (p_Vid->PicSizeInMbs / width))
+  {
+    Slice *nextSlice = p_wf->row[(y + 1) % p_wf->rows].slice;
+
+    memcpy (nextSlice->mot_ctx, currSlice->mot_ctx, sizeof (MotionInfoContexts));
+    memcpy (nextSlice->tex_ctx, currSlice->tex_ctx, sizeof (TextureInfoContexts));
+  }
+
+  p_wf->me_tot_time[tid] += p_Vid_t->me_tot_time - p_Vid->me_tot_time;
+}
+
+/*!
+ ***********************************************************************
+ * \brief
+ *    Codes the macroblocks of a slice, which has to cover the whole
+ *    picture, in a wavefront, mb_wavefront_usable() has to be checked
+ *    first
+ *
+ * \return
+ *    the number of coded MBs
+ ***********************************************************************
+ */
+int encode_slice_wavefront (Slice *currSlice, Macroblock **currMB)
+{
+  VideoParameters *p_Vid = currSlice->p_Vid;
+  MBWavefront *p_wf = p_Vid->p_wavefront;
+  int width  = p_Vid->PicWidthInMbs;
+  int height = p_Vid->PicSizeInMbs / width;
+  int rows   = imin (height, p_wf->rows);
+  int buffer_size = 500 + width * ((128 + 256 * p_Vid->bitdepth_luma + 512 * p_Vid->bitdepth_chroma) >> 3);
+  Boolean end_of_slice = FALSE, recode_macroblock = FALSE;
+  int wave, i;
+
+  // a macroblock reads the slice number and the QP of its neighbors, and of the
+  // macroblock before it, which may not be decided yet
+  for (i = 0; i < (int) p_Vid->PicSizeInMbs; i++)
+  {
+    p_Vid->mb_data[i].slice_nr = currSlice->slice_nr;
+    p_Vid->mb_data[i].qp       = (short) p_Vid->qp;
+    p_Vid->mb_data[i].prev_qp  = (short) p_Vid->qp;
+  }
+  p_Vid->BasicUnitQP = p_Vid->qp;
+
+  for (i = 0; i < p_wf->threads; i++)
+  {
+    memcpy (&p_wf->thread[i].stats, p_Vid->p_Stats, sizeof (StatParameters));
+    memcpy (&p_wf->thread[i].enc_picture, p_Vid->enc_picture, sizeof (StorablePicture));
+    if (p_wf->thread[i].p_subpel)
+      reset_subpel_cache (p_wf->thread[i].p_subpel);
+    p_wf->me_tot_time[i] = 0;
+  }
+
+  for (i = 0; i < rows; i++)
+  {
+    p_wf->row[i].slice = clone_slice (currSlice, buffer_size);
+    p_wf->row[i].cod_counter = 0;
+  }
+
+  // wave w decides the macroblocks (w - 2y, y)
+  for (wave = 0; wave < width + 2 * (height - 1); wave++)
+  {
+    int first = (wave >= width) ? (wave - width + 2) / 2 : 0;
+    int last  = imin (height - 1, wave / 2);
+    int y;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1) num_threads(p_wf->threads)
+#endif
+    for (y = first; y <= last; y++)
+    {
+#ifdef _OPENMP
+      decide_macroblock (p_Vid, p_wf, omp_get_thread_num (), wave - 2 * y, y);
+#else
+      decide_macroblock (p_Vid, p_wf, 0, wave - 2 * y, y);
+#endif
+    }
+  }
+
+  // the syntax of the macroblocks, in raster order
+  for (i = 0; i < (int) p_Vid->PicSizeInMbs; i++)
+  {
+    *currMB = restore_decision (p_Vid, currSlice, &p_wf->mb[i], i, p_wf->nz_size);
+    p_Vid->current_mb_nr = i;
+
+    write_macroblock (*currMB, 1);
+    end_macroblock (*currMB, &end_of_slice, &recode_macroblock);
+
+    p_Vid->SumFrameQP += (*currMB)->qp;
+    next_macroblock (*currMB);
+  }
+
+  p_Vid->masterQP = p_Vid->qp;
+  for (i = 0; i < p_wf->threads; i++)
+    p_Vid->me_tot_time += p_wf->me_tot_time[i];
+
+  for (i = 0; i < rows; i++)
+  {
+    free_slice_clone (p_wf->row[i].slice);
+    p_wf->row[i].slice = NULL;
+  }
+
+  return p_Vid->PicSizeInMbs;
+}
@@ -361,6 +361,30 @@ void alloc_pic_motion(VideoParameters *p_Vid, PicMotionParamsOld *motion, int si
   //get_mem2D (&(motion->field_frame), size_y, size_x);
 }
 
+/*!
+ ************************************************************************
+ * \brief
+ *    Allocates the 4x4 luma sub-images of a picture with only the integer
+ *    one [0][0], the others stay NULL and are interpolated on demand
+ *    (LumaMCBuffer = 0). They are freed by free_mem4DpelWithPadSeparately
+ ************************************************************************
+ */
+static void get_mem_luma_sub_image_integer(imgpel *****imgY_sub, int size_y, int size_x)
+{
+  int i;
+
+  if (((*imgY_sub) = (imgpel****) malloc(4 * sizeof(imgpel***))) == NULL)
+    no_mem_exit("get_mem_luma_sub_image_integer: imgY_sub");
+
+  if (((*imgY_sub)[0] = (imgpel***) calloc(16, sizeof(imgpel**))) == NULL)
+    no_mem_exit("get_mem_luma_sub_image_integer: imgY_sub[0]");
+
+  for(i = 1; i < 4; i++)
+    (*imgY_sub)[i] = (*imgY_sub)[i - 1] + 4;
+
+  get_mem2DpelWithPad(&(*imgY_sub)[0][0], size_y, size_x, IMG_PAD_SIZE_Y, IMG_PAD_SIZE_X);
+}
+
 /*!
  ************************************************************************
  * \brief
@@ -416,7 +440,10 @@ StorablePicture* alloc_storable_picture(VideoParameters *p_Vid, PictureStructure
     //if (p_Vid->nal_reference_idc == NALU_PRIORITY_DISPOSABLE)
     //printf("interpolate %d %d %d %d %d \n", p_Vid->active_sps->profile_idc, structure, p_Vid->nal_reference_idc, p_Vid->view_id, p_Vid->inter_view_flag[structure?structure-1: structure]);
     //get_mem4DpelWithPad(&(s->imgY_sub), 4, 4, size_y, size_x, IMG_PAD_SIZE_Y, IMG_PAD_SIZE_X);
-    get_mem4DpelWithPadSeparately(&(s->imgY_sub), 4, 4, size_y, size_x, IMG_PAD_SIZE_Y, IMG_PAD_SIZE_X);
+    if (p_Inp->LumaMCBuffer)
+      get_mem4DpelWithPadSeparately(&(s->imgY_sub), 4, 4, size_y, size_x, IMG_PAD_SIZE_Y, IMG_PAD_SIZE_X);
+    else
+      get_mem_luma_sub_image_integer(&(s->imgY_sub), size_y, size_x);
     s->imgY = s->imgY_sub[0][0];
 
      if ( p_Inp->ChromaMCBuffer || p_Vid->P444_joined || (p_Inp->yuv_format==YUV444 && !p_Vid->P444_joined))
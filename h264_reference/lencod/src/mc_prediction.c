@@ -124,7 +124,7 @@ static inline void OneComponentLumaPrediction ( VideoParameters *p_Vid, //!< vid
                                                )
 {
   int     j;
-  imgpel *ref_line = UMVLine4X (list, pic_pix_y, pic_pix_x);
+  imgpel *ref_line = UMVBlock4X (p_Vid->p_subpel, list, pic_pix_y, pic_pix_x, block_size_x, block_size_y);
 
   for (j = 0; j < block_size_y; j++) 
   {
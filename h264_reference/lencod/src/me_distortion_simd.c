@@ -0,0 +1,1002 @@
+/*!
+*************************************************************************************
+* \file me_distortion_simd.c
+*
+* \brief
+*    Block kernels of the motion estimation distortion (scalar C, SSE2, SSSE3 and
+*    AVX2), chosen at runtime by the features of the CPU.
+*
+* \author
+*    Main contributors (see contributors.h for copyright, address and affiliation details)
+*      - Tiago Katcipis <tiagokatcipis@gmail.com>
+*
+*************************************************************************************
+*/
+
+#include "contributors.h"
+
+#include <string.h>
+
+#include "global.h"
+#include "me_distortion_simd.h"
+
+// The SIMD kernels work on 8 bit samples, they are built with the GCC target attributes
+#if (IMGTYPE == 0) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DIST_SIMD 1
+#include <immintrin.h>
+#else
+#define DIST_SIMD 0
+#endif
+
+/*!
+***********************************************************************
+* \brief
+*    SAD of a block, scalar C
+***********************************************************************
+*/
+static int sad_c(imgpel *src, int src_stride, imgpel *ref, int ref_stride, int width, int height, int min_cost)
+{
+  int mcost = 0;
+  int x, y;
+
+  for (y = 0; y < height; y++)
+  {
+    for (x = 0; x < width; x++)
+    {
+      mcost += iabs(src[x] - ref[x]);
+    }
+    if (mcost > min_cost)
+      return mcost;
+    src += src_stride;
+    ref += ref_stride;
+  }
+  return mcost;
+}
+
+/*!
+***********************************************************************
+* \brief
+*    SSE of a block, scalar C
+***********************************************************************
+*/
+static int sse_c(imgpel *src, int src_stride, imgpel *ref, int ref_stride, int width, int height, int min_cost)
+{
+  int mcost = 0;
+  int x, y;
+
+  for (y = 0; y < height; y++)
+  {
+    for (x = 0; x < width; x++)
+    {
+      mcost += iabs2(src[x] - ref[x]);
+    }
+    if (mcost > min_cost)
+      return mcost;
+    src += src_stride;
+    ref += ref_stride;
+  }
+  return mcost;
+}
+
+static void diff_c(short *diff, imgpel *src, int src_stride, imgpel *ref, int ref_stride, int size)
+{
+  int x, y;
+
+  for (y = 0; y < size; y++)
+  {
+    for (x = 0; x < size; x++)
+    {
+      *diff++ = (short) (src[x] - ref[x]);
+    }
+    src += src_stride;
+    ref += ref_stride;
+  }
+}
+
+static void diff4x4_c(short *diff, imgpel *src, int src_stride, imgpel *ref, int ref_stride)
+{
+  diff_c(diff, src, src_stride, ref, ref_stride, BLOCK_SIZE);
+}
+
+static void diff8x8_c(short *diff, imgpel *src, int src_stride, imgpel *ref, int ref_stride)
+{
+  diff_c(diff, src, src_stride, ref, ref_stride, BLOCK_SIZE_8x8);
+}
+
+static void pred_avg_c(imgpel *dst, imgpel *ref1, imgpel *ref2, int ref_stride, int width, int height)
+{
+  int x, y;
+
+  for (y = 0; y < height; y++)
+  {
+    for (x = 0; x < width; x++)
+    {
+      *dst++ = (imgpel) ((ref1[x] + ref2[x] + 1) >> 1);
+    }
+    ref1 += ref_stride;
+    ref2 += ref_stride;
+  }
+}
+
+static void pred_wp_c(imgpel *dst, imgpel *ref, int ref_stride, int width, int height,
+                      int weight, int round, int denom, int offset, int max_value)
+{
+  int x, y;
+
+  for (y = 0; y < height; y++)
+  {
+    for (x = 0; x < width; x++)
+    {
+      *dst++ = (imgpel) iClip1(max_value, ((weight * ref[x] + round) >> denom) + offset);
+    }
+    ref += ref_stride;
+  }
+}
+
+static void pred_bi_wp_c(imgpel *dst, imgpel *ref1, imgpel *ref2, int ref_stride, int width, int height,
+                         int weight1, int weight2, int round, int denom, int offset, int max_value)
+{
+  int x, y;
+
+  for (y = 0; y < height; y++)
+  {
+    for (x = 0; x < width; x++)
+    {
+      *dst++ = (imgpel) iClip1(max_value, ((weight1 * ref1[x] + weight2 * ref2[x] + round) >> denom) + offset);
+    }
+    ref1 += ref_stride;
+    ref2 += ref_stride;
+  }
+}
+
+/*!
+***********************************************************************
+* \brief
+*    Calculate 4x4 Hadamard-Transformed SAD
+***********************************************************************
+*/
+static int hadamard4x4_c (short* diff)
+{
+  int k, satd = 0;
+  int m[16], d[16];
+
+  /*===== hadamard transform =====*/
+  m[ 0] = diff[ 0] + diff[12];
+  m[ 1] = diff[ 1] + diff[13];
+  m[ 2] = diff[ 2] + diff[14];
+  m[ 3] = diff[ 3] + diff[15];
+  m[ 4] = diff[ 4] + diff[ 8];
+  m[ 5] = diff[ 5] + diff[ 9];
+  m[ 6] = diff[ 6] + diff[10];
+  m[ 7] = diff[ 7] + diff[11];
+  m[ 8] = diff[ 4] - diff[ 8];
+  m[ 9] = diff[ 5] - diff[ 9];
+  m[10] = diff[ 6] - diff[10];
+  m[11] = diff[ 7] - diff[11];
+  m[12] = diff[ 0] - diff[12];
+  m[13] = diff[ 1] - diff[13];
+  m[14] = diff[ 2] - diff[14];
+  m[15] = diff[ 3] - diff[15];
+
+  d[ 0] = m[ 0] + m[ 4];
+  d[ 1] = m[ 1] + m[ 5];
+  d[ 2] = m[ 2] + m[ 6];
+  d[ 3] = m[ 3] + m[ 7];
+  d[ 4] = m[ 8] + m[12];
+  d[ 5] = m[ 9] + m[13];
+  d[ 6] = m[10] + m[14];
+  d[ 7] = m[11] + m[15];
+  d[ 8] = m[ 0] - m[ 4];
+  d[ 9] = m[ 1] - m[ 5];
+  d[10] = m[ 2] - m[ 6];
+  d[11] = m[ 3] - m[ 7];
+  d[12] = m[12] - m[ 8];
+  d[13] = m[13] - m[ 9];
+  d[14] = m[14] - m[10];
+  d[15] = m[15] - m[11];
+
+  m[ 0] = d[ 0] + d[ 3];
+  m[ 1] = d[ 1] + d[ 2];
+  m[ 2] = d[ 1] - d[ 2];
+  m[ 3] = d[ 0] - d[ 3];
+  m[ 4] = d[ 4] + d[ 7];
+  m[ 5] = d[ 5] + d[ 6];
+  m[ 6] = d[ 5] - d[ 6];
+  m[ 7] = d[ 4] - d[ 7];
+  m[ 8] = d[ 8] + d[11];
+  m[ 9] = d[ 9] + d[10];
+  m[10] = d[ 9] - d[10];
+  m[11] = d[ 8] - d[11];
+  m[12] = d[12] + d[15];
+  m[13] = d[13] + d[14];
+  m[14] = d[13] - d[14];
+  m[15] = d[12] - d[15];
+
+  d[ 0] = m[ 0] + m[ 1];
+  d[ 1] = m[ 0] - m[ 1];
+  d[ 2] = m[ 2] + m[ 3];
+  d[ 3] = m[ 3] - m[ 2];
+  d[ 4] = m[ 4] + m[ 5];
+  d[ 5] = m[ 4] - m[ 5];
+  d[ 6] = m[ 6] + m[ 7];
+  d[ 7] = m[ 7] - m[ 6];
+  d[ 8] = m[ 8] + m[ 9];
+  d[ 9] = m[ 8] - m[ 9];
+  d[10] = m[10] + m[11];
+  d[11] = m[11] - m[10];
+  d[12] = m[12] + m[13];
+  d[13] = m[12] - m[13];
+  d[14] = m[14] + m[15];
+  d[15] = m[15] - m[14];
+
+  //===== sum up =====
+  // Table lookup is faster than abs macro
+  for (k=0; k<16; ++k)
+  {
+    satd += iabs(d [k]);
+  }
+
+
+  return ((satd+1)>>1);
+}
+
+/*!
+***********************************************************************
+* \brief
+*    Calculate 8x8 Hadamard-Transformed SAD
+***********************************************************************
+*/
+static int hadamard8x8_c (short* diff)
+{
+  int i, j, jj, sad=0;
+
+  // Hadamard related arrays
+  int m1[8][8], m2[8][8], m3[8][8];
+
+
+  //horizontal
+  for (j=0; j < 8; j++)
+  {
+    jj = j << 3;
+    m2[j][0] = diff[jj  ] + diff[jj+4];
+    m2[j][1] = diff[jj+1] + diff[jj+5];
+    m2[j][2] = diff[jj+2] + diff[jj+6];
+    m2[j][3] = diff[jj+3] + diff[jj+7];
+    m2[j][4] = diff[jj  ] - diff[jj+4];
+    m2[j][5] = diff[jj+1] - diff[jj+5];
+    m2[j][6] = diff[jj+2] - diff[jj+6];
+    m2[j][7] = diff[jj+3] - diff[jj+7];
+
+    m1[j][0] = m2[j][0] + m2[j][2];
+    m1[j][1] = m2[j][1] + m2[j][3];
+    m1[j][2] = m2[j][0] - m2[j][2];
+    m1[j][3] = m2[j][1] - m2[j][3];
+    m1[j][4] = m2[j][4] + m2[j][6];
+    m1[j][5] = m2[j][5] + m2[j][7];
+    m1[j][6] = m2[j][4] - m2[j][6];
+    m1[j][7] = m2[j][5] - m2[j][7];
+
+    m2[j][0] = m1[j][0] + m1[j][1];
+    m2[j][1] = m1[j][0] - m1[j][1];
+    m2[j][2] = m1[j][2] + m1[j][3];
+    m2[j][3] = m1[j][2] - m1[j][3];
+    m2[j][4] = m1[j][4] + m1[j][5];
+    m2[j][5] = m1[j][4] - m1[j][5];
+    m2[j][6] = m1[j][6] + m1[j][7];
+    m2[j][7] = m1[j][6] - m1[j][7];
+  }
+
+  //vertical
+  for (i=0; i < 8; i++)
+  {
+    m3[0][i] = m2[0][i] + m2[4][i];
+    m3[1][i] = m2[1][i] + m2[5][i];
+    m3[2][i] = m2[2][i] + m2[6][i];
+    m3[3][i] = m2[3][i] + m2[7][i];
+    m3[4][i] = m2[0][i] - m2[4][i];
+    m3[5][i] = m2[1][i] - m2[5][i];
+    m3[6][i] = m2[2][i] - m2[6][i];
+    m3[7][i] = m2[3][i] - m2[7][i];
+
+    m1[0][i] = m3[0][i] + m3[2][i];
+    m1[1][i] = m3[1][i] + m3[3][i];
+    m1[2][i] = m3[0][i] - m3[2][i];
+    m1[3][i] = m3[1][i] - m3[3][i];
+    m1[4][i] = m3[4][i] + m3[6][i];
+    m1[5][i] = m3[5][i] + m3[7][i];
+    m1[6][i] = m3[4][i] - m3[6][i];
+    m1[7][i] = m3[5][i] - m3[7][i];
+
+    m2[0][i] = m1[0][i] + m1[1][i];
+    m2[1][i] = m1[0][i] - m1[1][i];
+    m2[2][i] = m1[2][i] + m1[3][i];
+    m2[3][i] = m1[2][i] - m1[3][i];
+    m2[4][i] = m1[4][i] + m1[5][i];
+    m2[5][i] = m1[4][i] - m1[5][i];
+    m2[6][i] = m1[6][i] + m1[7][i];
+    m2[7][i] = m1[6][i] - m1[7][i];
+  }
+  for (j=0; j < 8; j++)
+    for (i=0; i < 8; i++)
+      sad += iabs (m2[j][i]);
+
+  return ((sad+2)>>2);
+}
+
+const DistortionKernels distortion_kernels_c =
+{
+  "C", DIST_SIMD_C,
+  sad_c, sse_c, diff4x4_c, diff8x8_c,
+  pred_avg_c, pred_wp_c, pred_bi_wp_c,
+  hadamard4x4_c, hadamard8x8_c
+};
+
+#if (DIST_SIMD)
+
+#define TARGET_SSE2  __attribute__((target("sse2")))
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_AVX2  __attribute__((target("avx2")))
+
+/*
+ * The sums of the Hadamard kernels are done on 16 bits: the coefficients of a
+ * 8x8 block of 8 bit differences are below 64 * 255. Any ordering of the rows of
+ * the transform gives the same sum of absolute values, so the results match the
+ * C ones exactly.
+ */
+
+TARGET_SSE2 static inline __m128i load4_sse2(imgpel *p)
+{
+  int v;
+  memcpy(&v, p, sizeof(int));
+  return _mm_cvtsi32_si128(v);
+}
+
+TARGET_SSE2 static inline __m128i load8_sse2(imgpel *p)
+{
+  return _mm_loadl_epi64((__m128i *) p);
+}
+
+TARGET_SSE2 static inline void store4_sse2(imgpel *p, __m128i v)
+{
+  int x = _mm_cvtsi128_si32(v);
+  memcpy(p, &x, sizeof(int));
+}
+
+// Loads a row of 4 or 8 samples
+TARGET_SSE2 static inline __m128i load_row_sse2(imgpel *p, int width)
+{
+  return (width == 8) ? load8_sse2(p) : load4_sse2(p);
+}
+
+// Stores a row of 4 or 8 samples
+TARGET_SSE2 static inline void store_row_sse2(imgpel *p, __m128i v, int width)
+{
+  if (width == 8)
+    _mm_storel_epi64((__m128i *) p, v);
+  else
+    store4_sse2(p, v);
+}
+
+TARGET_SSE2 static inline int hsum_epi32_sse2(__m128i v)
+{
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(v);
+}
+
+TARGET_SSE2 static inline int sad_row_sse2(__m128i sad)
+{
+  return _mm_cvtsi128_si32(sad) + _mm_extract_epi16(sad, 4);
+}
+
+TARGET_SSE2 static int sad_sse2(imgpel *src, int src_stride, imgpel *ref, int ref_stride, int width, int height, int min_cost)
+{
+  int mcost = 0;
+  int y;
+
+  switch (width)
+  {
+  case 16:
+    for (y = 0; y < height; y++)
+    {
+      mcost += sad_row_sse2(_mm_sad_epu8(_mm_loadu_si128((__m128i *) src), _mm_loadu_si128((__m128i *) ref)));
+      if (mcost > min_cost)
+        return mcost;
+      src += src_stride;
+      ref += ref_stride;
+    }
+    return mcost;
+  case 8:
+    for (y = 0; y < height; y++)
+    {
+      mcost += _mm_cvtsi128_si32(_mm_sad_epu8(load8_sse2(src), load8_sse2(ref)));
+      if (mcost > min_cost)
+        return mcost;
+      src += src_stride;
+      ref += ref_stride;
+    }
+    return mcost;
+  case 4:
+    for (y = 0; y < height; y++)
+    {
+      mcost += _mm_cvtsi128_si32(_mm_sad_epu8(load4_sse2(src), load4_sse2(ref)));
+      if (mcost > min_cost)
+        return mcost;
+      src += src_stride;
+      ref += ref_stride;
+    }
+    return mcost;
+  default:
+    return sad_c(src, src_stride, ref, ref_stride, width, height, min_cost);
+  }
+}
+
+// Squared differences of 8 samples (on 16 bits), summed in pairs on 4 x 32 bits
+TARGET_SSE2 static inline __m128i sqr_diff_sse2(__m128i src, __m128i ref)
+{
+  __m128i d = _mm_sub_epi16(src, ref);
+  return _mm_madd_epi16(d, d);
+}
+
+TARGET_SSE2 static int sse_sse2(imgpel *src, int src_stride, imgpel *ref, int ref_stride, int width, int height, int min_cost)
+{
+  __m128i zero = _mm_setzero_si128();
+  __m128i s, r, acc;
+  int mcost = 0;
+  int y;
+
+  switch (width)
+  {
+  case 16:
+    for (y = 0; y < height; y++)
+    {
+      s   = _mm_loadu_si128((__m128i *) src);
+      r   = _mm_loadu_si128((__m128i *) ref);
+      acc = _mm_add_epi32(sqr_diff_sse2(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(r, zero)),
+                          sqr_diff_sse2(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(r, zero)));
+      mcost += hsum_epi32_sse2(acc);
+      if (mcost > min_cost)
+        return mcost;
+      src += src_stride;
+      ref += ref_stride;
+    }
+    return mcost;
+  case 8:
+  case 4:
+    for (y = 0; y < height; y++)
+    {
+      acc = sqr_diff_sse2(_mm_unpacklo_epi8(load_row_sse2(src, width), zero), _mm_unpacklo_epi8(load_row_sse2(ref, width), zero));
+      mcost += hsum_epi32_sse2(acc);
+      if (mcost > min_cost)
+        return mcost;
+      src += src_stride;
+      ref += ref_stride;
+    }
+    return mcost;
+  default:
+    return sse_c(src, src_stride, ref, ref_stride, width, height, min_cost);
+  }
+}
+
+TARGET_SSE2 static void diff4x4_sse2(short *diff, imgpel *src, int src_stride, imgpel *ref, int ref_stride)
+{
+  __m128i zero = _mm_setzero_si128();
+  __m128i d0, d1;
+  int y;
+
+  for (y = 0; y < BLOCK_SIZE; y += 2)
+  {
+    d0 = _mm_sub_epi16(_mm_unpacklo_epi8(load4_sse2(src), zero), _mm_unpacklo_epi8(load4_sse2(ref), zero));
+    d1 = _mm_sub_epi16(_mm_unpacklo_epi8(load4_sse2(src + src_stride), zero), _mm_unpacklo_epi8(load4_sse2(ref + ref_stride), zero));
+    _mm_storeu_si128((__m128i *) diff, _mm_unpacklo_epi64(d0, d1));
+    diff += 2 * BLOCK_SIZE;
+    src  += 2 * src_stride;
+    ref  += 2 * ref_stride;
+  }
+}
+
+TARGET_SSE2 static void diff8x8_sse2(short *diff, imgpel *src, int src_stride, imgpel *ref, int ref_stride)
+{
+  __m128i zero = _mm_setzero_si128();
+  int y;
+
+  for (y = 0; y < BLOCK_SIZE_8x8; y++)
+  {
+    _mm_storeu_si128((__m128i *) diff, _mm_sub_epi16(_mm_unpacklo_epi8(load8_sse2(src), zero), _mm_unpacklo_epi8(load8_sse2(ref), zero)));
+    diff += BLOCK_SIZE_8x8;
+    src  += src_stride;
+    ref  += ref_stride;
+  }
+}
+
+TARGET_SSE2 static void pred_avg_sse2(imgpel *dst, imgpel *ref1, imgpel *ref2, int ref_stride, int width, int height)
+{
+  int y;
+
+  switch (width)
+  {
+  case 16:
+    for (y = 0; y < height; y++)
+    {
+      _mm_storeu_si128((__m128i *) dst, _mm_avg_epu8(_mm_loadu_si128((__m128i *) ref1), _mm_loadu_si128((__m128i *) ref2)));
+      dst  += 16;
+      ref1 += ref_stride;
+      ref2 += ref_stride;
+    }
+    break;
+  case 8:
+  case 4:
+    for (y = 0; y < height; y++)
+    {
+      store_row_sse2(dst, _mm_avg_epu8(load_row_sse2(ref1, width), load_row_sse2(ref2, width)), width);
+      dst  += width;
+      ref1 += ref_stride;
+      ref2 += ref_stride;
+    }
+    break;
+  default:
+    pred_avg_c(dst, ref1, ref2, ref_stride, width, height);
+    break;
+  }
+}
+
+// Weighted prediction of 8 samples (on 16 bits), coef holds the (weight, round) pairs
+TARGET_SSE2 static inline __m128i wp8_sse2(__m128i ref, __m128i coef, __m128i denom, __m128i offset, __m128i max_value)
+{
+  __m128i one = _mm_set1_epi16(1);
+  __m128i lo  = _mm_madd_epi16(_mm_unpacklo_epi16(ref, one), coef);
+  __m128i hi  = _mm_madd_epi16(_mm_unpackhi_epi16(ref, one), coef);
+
+  lo = _mm_add_epi32(_mm_sra_epi32(lo, denom), offset);
+  hi = _mm_add_epi32(_mm_sra_epi32(hi, denom), offset);
+  return _mm_min_epi16(_mm_max_epi16(_mm_packs_epi32(lo, hi), _mm_setzero_si128()), max_value);
+}
+
+// Bi-predictive weighted prediction of 8 samples (on 16 bits), coef holds the (weight1, weight2) pairs
+TARGET_SSE2 static inline __m128i bi_wp8_sse2(__m128i ref1, __m128i ref2, __m128i coef, __m128i round,
+                                             __m128i denom, __m128i offset, __m128i max_value)
+{
+  __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(ref1, ref2), coef), round);
+  __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(ref1, ref2), coef), round);
+
+  lo = _mm_add_epi32(_mm_sra_epi32(lo, denom), offset);
+  hi = _mm_add_epi32(_mm_sra_epi32(hi, denom), offset);
+  return _mm_min_epi16(_mm_max_epi16(_mm_packs_epi32(lo, hi), _mm_setzero_si128()), max_value);
+}
+
+TARGET_SSE2 static void pred_wp_sse2(imgpel *dst, imgpel *ref, int ref_stride, int width, int height,
+                                     int weight, int round, int denom, int offset, int max_value)
+{
+  __m128i zero  = _mm_setzero_si128();
+  __m128i coef  = _mm_unpacklo_epi16(_mm_set1_epi16((short) weight), _mm_set1_epi16((short) round));
+  __m128i shift = _mm_cvtsi32_si128(denom);
+  __m128i offs  = _mm_set1_epi32(offset);
+  __m128i maxv  = _mm_set1_epi16((short) max_value);
+  __m128i r;
+  int y;
+
+  if (width != 16 && width != 8 && width != 4)
+  {
+    pred_wp_c(dst, ref, ref_stride, width, height, weight, round, denom, offset, max_value);
+    return;
+  }
+
+  for (y = 0; y < height; y++)
+  {
+    if (width == 16)
+    {
+      r = _mm_loadu_si128((__m128i *) ref);
+      _mm_storeu_si128((__m128i *) dst, _mm_packus_epi16(wp8_sse2(_mm_unpacklo_epi8(r, zero), coef, shift, offs, maxv),
+                                                         wp8_sse2(_mm_unpackhi_epi8(r, zero), coef, shift, offs, maxv)));
+    }
+    else
+    {
+      r = wp8_sse2(_mm_unpacklo_epi8(load_row_sse2(ref, width), zero), coef, shift, offs, maxv);
+      store_row_sse2(dst, _mm_packus_epi16(r, r), width);
+    }
+    dst += width;
+    ref += ref_stride;
+  }
+}
+
+TARGET_SSE2 static void pred_bi_wp_sse2(imgpel *dst, imgpel *ref1, imgpel *ref2, int ref_stride, int width, int height,
+                                        int weight1, int weight2, int round, int denom, int offset, int max_value)
+{
+  __m128i zero  = _mm_setzero_si128();
+  __m128i coef  = _mm_unpacklo_epi16(_mm_set1_epi16((short) weight1), _mm_set1_epi16((short) weight2));
+  __m128i rnd   = _mm_set1_epi32(round);
+  __m128i shift = _mm_cvtsi32_si128(denom);
+  __m128i offs  = _mm_set1_epi32(offset);
+  __m128i maxv  = _mm_set1_epi16((short) max_value);
+  __m128i r1, r2, r;
+  int y;
+
+  if (width != 16 && width != 8 && width != 4)
+  {
+    pred_bi_wp_c(dst, ref1, ref2, ref_stride, width, height, weight1, weight2, round, denom, offset, max_value);
+    return;
+  }
+
+  for (y = 0; y < height; y++)
+  {
+    if (width == 16)
+    {
+      r1 = _mm_loadu_si128((__m128i *) ref1);
+      r2 = _mm_loadu_si128((__m128i *) ref2);
+      _mm_storeu_si128((__m128i *) dst,
+                       _mm_packus_epi16(bi_wp8_sse2(_mm_unpacklo_epi8(r1, zero), _mm_unpacklo_epi8(r2, zero), coef, rnd, shift, offs, maxv),
+                                        bi_wp8_sse2(_mm_unpackhi_epi8(r1, zero), _mm_unpackhi_epi8(r2, zero), coef, rnd, shift, offs, maxv)));
+    }
+    else
+    {
+      r = bi_wp8_sse2(_mm_unpacklo_epi8(load_row_sse2(ref1, width), zero), _mm_unpacklo_epi8(load_row_sse2(ref2, width), zero),
+                      coef, rnd, shift, offs, maxv);
+      store_row_sse2(dst, _mm_packus_epi16(r, r), width);
+    }
+    dst  += width;
+    ref1 += ref_stride;
+    ref2 += ref_stride;
+  }
+}
+
+// 4 point transform of the rows of a 4x4 block, two rows per register
+TARGET_SSE2 static inline void hadamard4_rows_sse2(__m128i *r01, __m128i *r23)
+{
+  __m128i s  = _mm_add_epi16(*r01, *r23);
+  __m128i t  = _mm_sub_epi16(*r01, *r23);
+  __m128i lo = _mm_unpacklo_epi64(s, t);
+  __m128i hi = _mm_unpackhi_epi64(s, t);
+
+  *r01 = _mm_add_epi16(lo, hi);
+  *r23 = _mm_sub_epi16(lo, hi);
+}
+
+TARGET_SSE2 static inline void hadamard4x4_transform_sse2(short *diff, __m128i *c01, __m128i *c23)
+{
+  __m128i r01 = _mm_loadu_si128((__m128i *) diff);
+  __m128i r23 = _mm_loadu_si128((__m128i *) (diff + 8));
+  __m128i a, b;
+
+  hadamard4_rows_sse2(&r01, &r23);
+
+  // transpose
+  a    = _mm_unpacklo_epi16(r01, r23);
+  b    = _mm_unpackhi_epi16(r01, r23);
+  *c01 = _mm_unpacklo_epi16(a, b);
+  *c23 = _mm_unpackhi_epi16(a, b);
+
+  hadamard4_rows_sse2(c01, c23);
+}
+
+// 8 point transform of the rows of a 8x8 block
+TARGET_SSE2 static inline void hadamard8_rows_sse2(__m128i *r)
+{
+  __m128i t[8], u[8];
+
+  t[0] = _mm_add_epi16(r[0], r[4]);
+  t[1] = _mm_add_epi16(r[1], r[5]);
+  t[2] = _mm_add_epi16(r[2], r[6]);
+  t[3] = _mm_add_epi16(r[3], r[7]);
+  t[4] = _mm_sub_epi16(r[0], r[4]);
+  t[5] = _mm_sub_epi16(r[1], r[5]);
+  t[6] = _mm_sub_epi16(r[2], r[6]);
+  t[7] = _mm_sub_epi16(r[3], r[7]);
+
+  u[0] = _mm_add_epi16(t[0], t[2]);
+  u[1] = _mm_add_epi16(t[1], t[3]);
+  u[2] = _mm_sub_epi16(t[0], t[2]);
+  u[3] = _mm_sub_epi16(t[1], t[3]);
+  u[4] = _mm_add_epi16(t[4], t[6]);
+  u[5] = _mm_add_epi16(t[5], t[7]);
+  u[6] = _mm_sub_epi16(t[4], t[6]);
+  u[7] = _mm_sub_epi16(t[5], t[7]);
+
+  r[0] = _mm_add_epi16(u[0], u[1]);
+  r[1] = _mm_sub_epi16(u[0], u[1]);
+  r[2] = _mm_add_epi16(u[2], u[3]);
+  r[3] = _mm_sub_epi16(u[2], u[3]);
+  r[4] = _mm_add_epi16(u[4], u[5]);
+  r[5] = _mm_sub_epi16(u[4], u[5]);
+  r[6] = _mm_add_epi16(u[6], u[7]);
+  r[7] = _mm_sub_epi16(u[6], u[7]);
+}
+
+TARGET_SSE2 static inline void transpose8x8_sse2(__m128i *r)
+{
+  __m128i a[8], b[8];
+
+  a[0] = _mm_unpacklo_epi16(r[0], r[1]);
+  a[1] = _mm_unpackhi_epi16(r[0], r[1]);
+  a[2] = _mm_unpacklo_epi16(r[2], r[3]);
+  a[3] = _mm_unpackhi_epi16(r[2], r[3]);
+  a[4] = _mm_unpacklo_epi16(r[4], r[5]);
+  a[5] = _mm_unpackhi_epi16(r[4], r[5]);
+  a[6] = _mm_unpacklo_epi16(r[6], r[7]);
+  a[7] = _mm_unpackhi_epi16(r[6], r[7]);
+
+  b[0] = _mm_unpacklo_epi32(a[0], a[2]);
+  b[1] = _mm_unpackhi_epi32(a[0], a[2]);
+  b[2] = _mm_unpacklo_epi32(a[1], a[3]);
+  b[3] = _mm_unpackhi_epi32(a[1], a[3]);
+  b[4] = _mm_unpacklo_epi32(a[4], a[6]);
+  b[5] = _mm_unpackhi_epi32(a[4], a[6]);
+  b[6] = _mm_unpacklo_epi32(a[5], a[7]);
+  b[7] = _mm_unpackhi_epi32(a[5], a[7]);
+
+  r[0] = _mm_unpacklo_epi64(b[0], b[4]);
+  r[1] = _mm_unpackhi_epi64(b[0], b[4]);
+  r[2] = _mm_unpacklo_epi64(b[1], b[5]);
+  r[3] = _mm_unpackhi_epi64(b[1], b[5]);
+  r[4] = _mm_unpacklo_epi64(b[2], b[6]);
+  r[5] = _mm_unpackhi_epi64(b[2], b[6]);
+  r[6] = _mm_unpacklo_epi64(b[3], b[7]);
+  r[7] = _mm_unpackhi_epi64(b[3], b[7]);
+}
+
+TARGET_SSE2 static inline void hadamard8x8_transform_sse2(short *diff, __m128i *r)
+{
+  int i;
+
+  for (i = 0; i < 8; i++)
+    r[i] = _mm_loadu_si128((__m128i *) (diff + 8 * i));
+
+  hadamard8_rows_sse2(r);
+  transpose8x8_sse2(r);
+  hadamard8_rows_sse2(r);
+}
+
+TARGET_SSE2 static inline __m128i abs_epi16_sse2(__m128i v)
+{
+  return _mm_max_epi16(v, _mm_sub_epi16(_mm_setzero_si128(), v));
+}
+
+TARGET_SSE2 static int hadamard4x4_sse2(short *diff)
+{
+  __m128i one = _mm_set1_epi16(1);
+  __m128i c01, c23;
+
+  hadamard4x4_transform_sse2(diff, &c01, &c23);
+  return (hsum_epi32_sse2(_mm_madd_epi16(_mm_add_epi16(abs_epi16_sse2(c01), abs_epi16_sse2(c23)), one)) + 1) >> 1;
+}
+
+TARGET_SSE2 static int hadamard8x8_sse2(short *diff)
+{
+  __m128i one = _mm_set1_epi16(1);
+  __m128i r[8], acc;
+  int i;
+
+  hadamard8x8_transform_sse2(diff, r);
+
+  acc = _mm_madd_epi16(abs_epi16_sse2(r[0]), one);
+  for (i = 1; i < 8; i++)
+    acc = _mm_add_epi32(acc, _mm_madd_epi16(abs_epi16_sse2(r[i]), one));
+
+  return (hsum_epi32_sse2(acc) + 2) >> 2;
+}
+
+TARGET_SSSE3 static int hadamard4x4_ssse3(short *diff)
+{
+  __m128i one = _mm_set1_epi16(1);
+  __m128i c01, c23;
+
+  hadamard4x4_transform_sse2(diff, &c01, &c23);
+  return (hsum_epi32_sse2(_mm_madd_epi16(_mm_add_epi16(_mm_abs_epi16(c01), _mm_abs_epi16(c23)), one)) + 1) >> 1;
+}
+
+TARGET_SSSE3 static int hadamard8x8_ssse3(short *diff)
+{
+  __m128i one = _mm_set1_epi16(1);
+  __m128i r[8], acc;
+
+  hadamard8x8_transform_sse2(diff, r);
+
+  // pairs of absolute values fit on 16 bits
+  acc = _mm_madd_epi16(_mm_add_epi16(_mm_abs_epi16(r[0]), _mm_abs_epi16(r[1])), one);
+  acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_add_epi16(_mm_abs_epi16(r[2]), _mm_abs_epi16(r[3])), one));
+  acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_add_epi16(_mm_abs_epi16(r[4]), _mm_abs_epi16(r[5])), one));
+  acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_add_epi16(_mm_abs_epi16(r[6]), _mm_abs_epi16(r[7])), one));
+
+  return (hsum_epi32_sse2(acc) + 2) >> 2;
+}
+
+// Two rows of 16 samples, the first one on the low lane
+TARGET_AVX2 static inline __m256i load2x16_avx2(imgpel *p, int stride)
+{
+  return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((__m128i *) p)), _mm_loadu_si128((__m128i *) (p + stride)), 1);
+}
+
+TARGET_AVX2 static int sad_avx2(imgpel *src, int src_stride, imgpel *ref, int ref_stride, int width, int height, int min_cost)
+{
+  __m256i sad;
+  int mcost = 0;
+  int y;
+
+  if (width != 16 || (height & 1))
+    return sad_sse2(src, src_stride, ref, ref_stride, width, height, min_cost);
+
+  for (y = 0; y < height; y += 2)
+  {
+    sad = _mm256_sad_epu8(load2x16_avx2(src, src_stride), load2x16_avx2(ref, ref_stride));
+    mcost += sad_row_sse2(_mm256_castsi256_si128(sad));
+    if (mcost > min_cost)
+      return mcost;
+    mcost += sad_row_sse2(_mm256_extracti128_si256(sad, 1));
+    if (mcost > min_cost)
+      return mcost;
+    src += 2 * src_stride;
+    ref += 2 * ref_stride;
+  }
+  return mcost;
+}
+
+TARGET_AVX2 static int sse_avx2(imgpel *src, int src_stride, imgpel *ref, int ref_stride, int width, int height, int min_cost)
+{
+  __m256i d;
+  int mcost = 0;
+  int y;
+
+  if (width != 16)
+    return sse_sse2(src, src_stride, ref, ref_stride, width, height, min_cost);
+
+  for (y = 0; y < height; y++)
+  {
+    d = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) src)), _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) ref)));
+    d = _mm256_madd_epi16(d, d);
+    mcost += hsum_epi32_sse2(_mm_add_epi32(_mm256_castsi256_si128(d), _mm256_extracti128_si256(d, 1)));
+    if (mcost > min_cost)
+      return mcost;
+    src += src_stride;
+    ref += ref_stride;
+  }
+  return mcost;
+}
+
+TARGET_AVX2 static void pred_avg_avx2(imgpel *dst, imgpel *ref1, imgpel *ref2, int ref_stride, int width, int height)
+{
+  int y;
+
+  if (width != 16 || (height & 1))
+  {
+    pred_avg_sse2(dst, ref1, ref2, ref_stride, width, height);
+    return;
+  }
+
+  for (y = 0; y < height; y += 2)
+  {
+    _mm256_storeu_si256((__m256i *) dst, _mm256_avg_epu8(load2x16_avx2(ref1, ref_stride), load2x16_avx2(ref2, ref_stride)));
+    dst  += 32;
+    ref1 += 2 * ref_stride;
+    ref2 += 2 * ref_stride;
+  }
+}
+
+// Packs the 16 samples of a row, kept on 16 bits, to 8 bits
+TARGET_AVX2 static inline __m128i pack16_avx2(__m256i v)
+{
+  return _mm_packus_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+}
+
+TARGET_AVX2 static void pred_wp_avx2(imgpel *dst, imgpel *ref, int ref_stride, int width, int height,
+                                     int weight, int round, int denom, int offset, int max_value)
+{
+  __m256i one   = _mm256_set1_epi16(1);
+  __m256i coef  = _mm256_unpacklo_epi16(_mm256_set1_epi16((short) weight), _mm256_set1_epi16((short) round));
+  __m128i shift = _mm_cvtsi32_si128(denom);
+  __m256i offs  = _mm256_set1_epi32(offset);
+  __m256i maxv  = _mm256_set1_epi16((short) max_value);
+  __m256i r, lo, hi;
+  int y;
+
+  if (width != 16)
+  {
+    pred_wp_sse2(dst, ref, ref_stride, width, height, weight, round, denom, offset, max_value);
+    return;
+  }
+
+  for (y = 0; y < height; y++)
+  {
+    r  = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) ref));
+    lo = _mm256_add_epi32(_mm256_sra_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(r, one), coef), shift), offs);
+    hi = _mm256_add_epi32(_mm256_sra_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(r, one), coef), shift), offs);
+    r  = _mm256_min_epi16(_mm256_max_epi16(_mm256_packs_epi32(lo, hi), _mm256_setzero_si256()), maxv);
+    _mm_storeu_si128((__m128i *) dst, pack16_avx2(r));
+    dst += 16;
+    ref += ref_stride;
+  }
+}
+
+TARGET_AVX2 static void pred_bi_wp_avx2(imgpel *dst, imgpel *ref1, imgpel *ref2, int ref_stride, int width, int height,
+                                        int weight1, int weight2, int round, int denom, int offset, int max_value)
+{
+  __m256i coef  = _mm256_unpacklo_epi16(_mm256_set1_epi16((short) weight1), _mm256_set1_epi16((short) weight2));
+  __m256i rnd   = _mm256_set1_epi32(round);
+  __m128i shift = _mm_cvtsi32_si128(denom);
+  __m256i offs  = _mm256_set1_epi32(offset);
+  __m256i maxv  = _mm256_set1_epi16((short) max_value);
+  __m256i r1, r2, lo, hi;
+  int y;
+
+  if (width != 16)
+  {
+    pred_bi_wp_sse2(dst, ref1, ref2, ref_stride, width, height, weight1, weight2, round, denom, offset, max_value);
+    return;
+  }
+
+  for (y = 0; y < height; y++)
+  {
+    r1 = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) ref1));
+    r2 = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) ref2));
+    lo = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(r1, r2), coef), rnd);
+    hi = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(r1, r2), coef), rnd);
+    lo = _mm256_add_epi32(_mm256_sra_epi32(lo, shift), offs);
+    hi = _mm256_add_epi32(_mm256_sra_epi32(hi, shift), offs);
+    r1 = _mm256_min_epi16(_mm256_max_epi16(_mm256_packs_epi32(lo, hi), _mm256_setzero_si256()), maxv);
+    _mm_storeu_si128((__m128i *) dst, pack16_avx2(r1));
+    dst  += 16;
+    ref1 += ref_stride;
+    ref2 += ref_stride;
+  }
+}
+
+static const DistortionKernels distortion_kernels_sse2 =
+{
+  "SSE2", DIST_SIMD_SSE2,
+  sad_sse2, sse_sse2, diff4x4_sse2, diff8x8_sse2,
+  pred_avg_sse2, pred_wp_sse2, pred_bi_wp_sse2,
+  hadamard4x4_sse2, hadamard8x8_sse2
+};
+
+static const DistortionKernels distortion_kernels_ssse3 =
+{
+  "SSSE3", DIST_SIMD_SSSE3,
+  sad_sse2, sse_sse2, diff4x4_sse2, diff8x8_sse2,
+  pred_avg_sse2, pred_wp_sse2, pred_bi_wp_sse2,
+  hadamard4x4_ssse3, hadamard8x8_ssse3
+};
+
+static const DistortionKernels distortion_kernels_avx2 =
+{
+  "AVX2", DIST_SIMD_AVX2,
+  sad_avx2, sse_avx2, diff4x4_sse2, diff8x8_sse2,
+  pred_avg_avx2, pred_wp_avx2, pred_bi_wp_avx2,
+  hadamard4x4_ssse3, hadamard8x8_ssse3
+};
+
+#endif
+
+DistortionSIMD get_simd_cpu_level(void)
+{
+#if (DIST_SIMD)
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx2"))
+    return DIST_SIMD_AVX2;
+  if (__builtin_cpu_supports("ssse3"))
+    return DIST_SIMD_SSSE3;
+  if (__builtin_cpu_supports("sse2"))
+    return DIST_SIMD_SSE2;
+#endif
+  return DIST_SIMD_C;
+}
+
+const DistortionKernels *get_distortion_kernels(int level)
+{
+  DistortionSIMD cpu_level = get_simd_cpu_level();
+
+  if (level == DIST_SIMD_AUTO || level > (int) cpu_level)
+    level = cpu_level;
+
+  switch (level)
+  {
+#if (DIST_SIMD)
+  case DIST_SIMD_AVX2:
+    return &distortion_kernels_avx2;
+  case DIST_SIMD_SSSE3:
+    return &distortion_kernels_ssse3;
+  case DIST_SIMD_SSE2:
+    return &distortion_kernels_sse2;
+#endif
+  default:
+    return &distortion_kernels_c;
+  }
+}
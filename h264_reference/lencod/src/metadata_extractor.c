@@ -1,59 +1,120 @@
 #include "metadata_extractor.h"
 
-#include <cv.h>
-#include <highgui.h>
+#include "haar_cascade.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 
 /*********************** 
  * Module private data * 
  ***********************/
 
+/* A luma snapshot handed to the detection worker, and the result of its search */
+typedef struct _DetectionRequest {
+  unsigned int frame_number;
 
-typedef struct _TrackedBoundigBox {
-  unsigned int id;
-  
-  /* double x,y is used so we dont lose small movement information */
-  double x; 
-  double y;
-  short width;
-  short height;
+  /* Snapshot of the luma plane */
+  unsigned char * y;
+  int width;
+  int height;
+  int stride;
+  int capacity;
 
-  int motion_x;
-  int motion_y;
-  int motion_samples;
-} TrackedBoundigBox;
+  /* The tracked objects being confirmed, the region searched for each one and its expected area.
+     The whole frame is searched if there is nothing to confirm. */
+  int confirmation_count;
+  int slots[OBJECT_TRACKER_MAX_OBJECTS];
+  unsigned int ids[OBJECT_TRACKER_MAX_OBJECTS];
+  HaarRect regions[OBJECT_TRACKER_MAX_OBJECTS];
+  HaarRect expected[OBJECT_TRACKER_MAX_OBJECTS];
 
+  /* Search result, only valid after the request is processed. The areas of the confirmed objects
+     (on the confirmation order) or, if the whole frame has been searched, all the objects found. */
+  int full_search;
+  int area_count;
+  HaarRect areas[OBJECT_TRACKER_MAX_OBJECTS];
+} DetectionRequest;
 
-struct _MetadataExtractor {
 
-  /* Haar feature cascade */
-  CvHaarClassifierCascade * classifier;
+/* Scratch memory of the search. It is allocated for one resolution when the extractor 
+   is created and reused for the whole stream, nothing is allocated per frame. */
+typedef struct _DetectionArena {
+  int width;
+  int height;
+
+  /* Equalized copy of the searched luma plane */
+  unsigned char * equalized;
+
+  /* Integral images and the cascade scratch memory */
+  HaarWorkspace * workspace;
+
+  /* Detection result pool */
+  HaarRect * results;
+  int max_results;
+
+  /* Request of the synchronous search, it points to the encoder luma plane (no snapshot) */
+  DetectionRequest sync_request;
+} DetectionArena;
+
 
-  /* OpenCV “work buffer" */
-  CvMemStorage * storage;
+/* Runs the object search on its own thread, so the encoder never waits for it.
+   The queue is a ring of requests indexed by 3 ever growing counters:
+   submitted >= processed >= collected. */
+typedef struct _DetectionWorker {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t request_available;
 
-  /* How big of a jump there is between each scale */
-  double scale_factor;
+  DetectionRequest * queue;
+  unsigned int queue_size;
 
-  /* only decide a face is present in a location if there are at least three overlapping detections. */
-  int min_neighbors;
+  unsigned int submitted;
+  unsigned int processed;
+  unsigned int collected;
 
-  /* Minimum object size */
-  CvSize min_size;
-  /* Maximum object size */
-  CvSize max_size;
+  int running;
+} DetectionWorker;
 
-  int haar_flags;
 
-  /* Search/Tracking hysteresis */
+struct _MetadataExtractor {
+
+  /* Haar feature cascade */
+  HaarCascade * classifier;
+
+  /* Scale factor, min neighbors, object size limits and the search mode */
+  HaarDetectionParams detection_params;
+
+  /* Search/Tracking/Discovery hysteresis */
   unsigned int search_hysteresis;
   unsigned int tracking_hysteresis;
+  unsigned int discovery_hysteresis;
   
-  /* Last frame that we did a full search */
+  /* Last frame that we did a search (full or confirmation) */
   unsigned int last_searched_frame;
 
-  TrackedBoundigBox * tracked_bounding_box;
+  /* Last frame that we searched the whole frame */
+  unsigned int last_discovery_frame;
+
+  /* The tracked objects, only touched by the encoder thread */
+  ObjectTracker * tracker;
+  unsigned int next_object_id;
+
+  /* Only the search results are returned, the decoder tracks the objects between them */
+  int sparse_metadata;
+
+  /* Scratch memory, reallocated only if the resolution changes */
+  DetectionArena arena;
+
+  /* Serializes the usage of the classifier and the arena */
+  pthread_mutex_t search_lock;
+
+  /* Detection worker, NULL when the search is done synchronously */
+  DetectionWorker * worker;
 };
 
 
@@ -61,17 +122,43 @@ static const double DEFAULT_SCALE_FACTOR = 1.1f;
 
 static const int DEFAULT_MIN_NEIGHBORS   = 3;
 
+/* Windows flatter than this are not searched, replaces the OpenCV canny pruning */
+static const double DEFAULT_MIN_WINDOW_STDDEV = 8.0f;
+
+/* The confirmation region is the tracked box grown by this fraction of its size on each side,
+   plus the distance the object may have moved since the last search */
+static const double CONFIRMATION_BOX_MARGIN = 0.5f;
+
+/* The confirmation searches only objects up to this factor bigger/smaller than the tracked box */
+static const double CONFIRMATION_SCALE_RANGE = 1.25f;
 
-/* The motion vectors are on QPEL units (Quarter Pel refinement). To get the block real movement we must divide by 4 */
-static const double QPEL_UNIT = 4.0f;
+/* A detection is the same object of a tracked box if their intersection covers
+   at least this fraction of the smallest of the two */
+static const double OBJECT_MATCH_MIN_OVERLAP = 0.3f;
+
+/* Max number of detected objects kept from a search */
+static const int DETECTION_RESULT_POOL_SIZE = 256;
 
 
 /* Private TrackedBoundigBox functions */
-static TrackedBoundigBox * tracked_bounding_box_new(CvRect* area);
-static void tracked_bounding_box_update(TrackedBoundigBox * obj, CvRect* area);
-static void tracked_bounding_box_free(TrackedBoundigBox * obj);
-static void tracked_bounding_box_estimate_motion(TrackedBoundigBox * obj);
-static int tracked_bounding_box_point_is_inside(short x, short y, TrackedBoundigBox * obj);
+static void tracked_bounding_box_confirmation_region(TrackedBoundigBox * obj, int frames, int width, int height, 
+                                                     HaarRect * expected, HaarRect * region);
+
+/* Private object tracking functions */
+static void metadata_extractor_match_objects(MetadataExtractor * extractor, unsigned int frame_num, HaarRect * areas, int count);
+static unsigned int metadata_extractor_new_object_id(MetadataExtractor * extractor);
+static int metadata_extractor_frame_distance(unsigned int from, unsigned int to);
+
+/* Private DetectionArena functions */
+static int detection_arena_init(DetectionArena * arena, HaarCascade * classifier, int width, int height);
+static void detection_arena_release(DetectionArena * arena);
+
+/* Private DetectionWorker functions */
+static DetectionWorker * detection_worker_new(MetadataExtractor * extractor, int queue_size);
+static void detection_worker_free(DetectionWorker * worker);
+static DetectionRequest * detection_worker_get_free_request(DetectionWorker * worker);
+static void detection_worker_submit(DetectionWorker * worker, DetectionRequest * request, unsigned char ** y);
+static DetectionRequest * detection_worker_collect(DetectionWorker * worker);
 
 /*!
  *************************************************************************************
@@ -81,13 +168,16 @@ static int tracked_bounding_box_point_is_inside(short x, short y, TrackedBoundig
  *
  *************************************************************************************
  */
-MetadataExtractor * metadata_extractor_new(int min_width,
+MetadataExtractor * metadata_extractor_new(int frame_width,
+                                           int frame_height,
+                                           int min_width,
                                            int min_height,
                                            int search_hysteresis,
                                            int tracking_hysteresis,
+                                           int discovery_hysteresis,
                                            const char * training_file)
 {
-  /* FIXME A new opencv added this is information, i dont have time to configure/parametrize it, sorry :-( */
+  /* FIXME The max object size used to be required by OpenCV, i dont have time to configure/parametrize it, sorry :-( */
   static const int max_detected_object_width  = 640;
   static const int max_detected_object_height = 640;
 
@@ -98,268 +188,830 @@ MetadataExtractor * metadata_extractor_new(int min_width,
     return NULL;
   }
 
-  extractor->classifier            = (CvHaarClassifierCascade*) cvLoad( training_file, 0, 0, 0 );
-  extractor->storage               = cvCreateMemStorage(0);
-  extractor->min_size.width        = min_width; 
-  extractor->min_size.height       = min_height;
-  extractor->max_size.width        = max_detected_object_width; 
-  extractor->max_size.height       = max_detected_object_height;
-  extractor->search_hysteresis     = search_hysteresis;
-  extractor->tracking_hysteresis   = tracking_hysteresis;
+  extractor->classifier = haar_cascade_load(training_file);
+
+  if (!extractor->classifier) {
+    printf("metadata_extractor_new: Error loading the training file [%s] !!!\n", training_file);
+    free(extractor);
+    return NULL;
+  }
+
+  haar_detection_params_init(&extractor->detection_params);
+
+  extractor->detection_params.min_width  = min_width; 
+  extractor->detection_params.min_height = min_height;
+  extractor->detection_params.max_width  = max_detected_object_width; 
+  extractor->detection_params.max_height = max_detected_object_height;
+  extractor->search_hysteresis           = search_hysteresis;
+  extractor->tracking_hysteresis         = tracking_hysteresis;
+  extractor->discovery_hysteresis        = discovery_hysteresis;
+
+  /* default hardcoded stuff, all the objects of the frame are searched */
+  extractor->detection_params.find_biggest_object = 0;
+  extractor->detection_params.min_window_stddev   = DEFAULT_MIN_WINDOW_STDDEV;
+  extractor->detection_params.min_neighbors       = DEFAULT_MIN_NEIGHBORS;
+  extractor->detection_params.scale_factor        = DEFAULT_SCALE_FACTOR;
+  extractor->last_searched_frame                  = 0;
+  extractor->last_discovery_frame                 = 0;
+  extractor->worker                               = NULL;
+
+  if (!detection_arena_init(&extractor->arena, extractor->classifier, frame_width, frame_height)) {
+    printf("metadata_extractor_new: Error allocating the detection arena !!!\n");
+    haar_cascade_free(extractor->classifier);
+    free(extractor);
+    return NULL;
+  }
+
+  extractor->tracker         = object_tracker_new(frame_width, frame_height);
+  extractor->next_object_id  = 0;
+  extractor->sparse_metadata = 0;
+
+  if (!extractor->tracker) {
+    printf("metadata_extractor_new: Error allocating the object tracker !!!\n");
+    detection_arena_release(&extractor->arena);
+    haar_cascade_free(extractor->classifier);
+    free(extractor);
+    return NULL;
+  }
 
-  /* default hardcoded stuff */
-  extractor->haar_flags           = CV_HAAR_FIND_BIGGEST_OBJECT | CV_HAAR_DO_ROUGH_SEARCH | CV_HAAR_DO_CANNY_PRUNING;
-  extractor->min_neighbors        = DEFAULT_MIN_NEIGHBORS;
-  extractor->scale_factor         = DEFAULT_SCALE_FACTOR;
-  extractor->tracked_bounding_box = NULL;
-  extractor->last_searched_frame  = 0;
+  pthread_mutex_init(&extractor->search_lock, NULL);
 
   printf("\nmetadata_extractor_new: configured to search for objects with a min size of [%d] x [%d]\n", 
          min_width, min_height);
 
-  printf("metadata_extractor_new: search_hysteresis[%d] tracking_hysteresis[%d] training file is [%s]\n\n", 
-         search_hysteresis, tracking_hysteresis, training_file);
+  printf("metadata_extractor_new: search_hysteresis[%d] tracking_hysteresis[%d] discovery_hysteresis[%d] training file is [%s]\n\n", 
+         search_hysteresis, tracking_hysteresis, discovery_hysteresis, training_file);
 
   return extractor;
 }
 
 void metadata_extractor_free(MetadataExtractor * extractor)
 {
-  if (extractor->tracked_bounding_box) {
-    tracked_bounding_box_free(extractor->tracked_bounding_box);
+  if (extractor->worker) {
+    detection_worker_free(extractor->worker);
   }
+
+  object_tracker_free(extractor->tracker);
+  detection_arena_release(&extractor->arena);
+  haar_cascade_free(extractor->classifier);
+  pthread_mutex_destroy(&extractor->search_lock);
   free(extractor);
 }
 
-static CvRect* metadata_extractor_search_for_object_of_interest(MetadataExtractor * extractor, 
-                                                                unsigned char ** y, 
-                                                                int width, 
-                                                                int height)
+int metadata_extractor_enable_async_detection(MetadataExtractor * extractor, int queue_size)
 {
-  IplImage * frame = cvCreateImage(cvSize(width, height), IPL_DEPTH_8U, 3);
-  IplImage * gray  = cvCreateImage(cvSize(width, height), IPL_DEPTH_8U, 1);
-  CvSeq* results   = NULL;
+  if (extractor->worker) {
+    return 1;
+  }
 
-  int frame_i = 0;
-  int row     = 0;
-  int col     = 0;
+  if (queue_size <= 0) {
+    printf("metadata_extractor_enable_async_detection: invalid queue size [%d] !!!\n", queue_size);
+    return 0;
+  }
 
-  /* We must write R G B with the same Y sample*/
-  for (row = 0; row < height; row++) {
+  extractor->worker = detection_worker_new(extractor, queue_size);
 
-    for (col = 0; col < width; col++) {
+  if (!extractor->worker) {
+    printf("metadata_extractor_enable_async_detection: Error creating the detection worker !!!\n");
+    return 0;
+  }
 
-      frame->imageData[frame_i]     = y[row][col];
-      frame->imageData[frame_i + 1] = y[row][col];
-      frame->imageData[frame_i + 2] = y[row][col];
-      frame_i += 3;
-    }
+  printf("metadata_extractor_enable_async_detection: detection worker started, queue size [%d]\n", queue_size);
+  return 1;
+}
+
+void metadata_extractor_set_sparse_metadata(MetadataExtractor * extractor, int sparse)
+{
+  extractor->sparse_metadata = sparse;
+
+  printf("metadata_extractor_set_sparse_metadata: sparse metadata [%d]\n", sparse);
+}
+
+void metadata_extractor_set_detection_threads(MetadataExtractor * extractor, int threads)
+{
+  if (threads < 1) {
+    threads = 1;
   }
 
-  cvCvtColor(frame, gray, CV_BGR2GRAY);
+  /* The worker may be searching right now */
+  pthread_mutex_lock(&extractor->search_lock);
+  extractor->detection_params.threads = threads;
+  pthread_mutex_unlock(&extractor->search_lock);
 
-  /* cvEqualizeHist spreads out the brightness values necessary because the integral image 
+  printf("metadata_extractor_set_detection_threads: [%d] search threads\n", threads);
+}
+
+/* Searches the objects on a region of the frame and copies their areas (on frame coordinates) to the given array. 
+   Returns the number of objects found.
+   The luma plane is used in place (no copy), y[row] must be y + row * stride. */
+static int metadata_extractor_search_region(MetadataExtractor * extractor, 
+                                            unsigned char * y, 
+                                            int width, 
+                                            int height,
+                                            int stride,
+                                            const HaarRect * region,
+                                            const HaarDetectionParams * params,
+                                            HaarRect * areas,
+                                            int max_areas)
+{
+  DetectionArena * arena   = &extractor->arena;
+  unsigned char * region_y = y + region->y * stride + region->x;
+  int total                = 0;
+  int i;
+
+  pthread_mutex_lock(&extractor->search_lock);
+
+  if ((arena->width != width) || (arena->height != height)) {
+
+    /* The resolution changed, this should not happen on a stream */
+    detection_arena_release(arena);
+
+    if (!detection_arena_init(arena, extractor->classifier, width, height)) {
+      printf("metadata_extractor_search_region: Error allocating the detection arena !!!\n");
+      pthread_mutex_unlock(&extractor->search_lock);
+      return 0;
+    }
+  }
+
+  /* The luma plane is already a grayscale image, it is read in place.
+     The histogram equalization spreads out the brightness values necessary because the integral image 
      features are based on differences of rectangle regions and, if the histogram is not balanced, 
-     these differences might be skewed by overall lighting or exposure of the test images. */
-  cvEqualizeHist(gray, gray);
-
-  /* prepares memory for the haar_classifier (if it was used before already) */
-  cvClearMemStorage(extractor->storage);
-
-  /* The search is optimized to find only one object */
-  results =  cvHaarDetectObjects (gray,
-                                  extractor->classifier,
-                                  extractor->storage,
-                                  extractor->scale_factor,
-                                  extractor->min_neighbors,
-                                  extractor->haar_flags, 
-                                  extractor->min_size,
-                                  extractor->max_size);
-
-  /* Freeing images */
-  cvReleaseImage(&frame);
-  cvReleaseImage(&gray);
-
-  if (results && (results->total <= 0) ) {
-      return NULL;
+     these differences might be skewed by overall lighting or exposure of the test images. 
+     It can not be done in place, the luma plane belongs to the encoder. */
+  haar_equalize_histogram(region_y, stride, arena->equalized, region->width, region->width, region->height);
+
+  haar_workspace_compute_integral_images(arena->workspace, arena->equalized, region->width, region->height, region->width);
+
+  total = haar_cascade_detect(extractor->classifier,
+                              arena->workspace,
+                              params,
+                              arena->results,
+                              arena->max_results);
+
+  if (total > max_areas) {
+    total = max_areas;
+  }
+
+  for (i = 0; i < total; i++) {
+    areas[i]    = arena->results[i];
+    areas[i].x += region->x;
+    areas[i].y += region->y;
   }
 
-  return (CvRect*)cvGetSeqElem( results, 0);
+  pthread_mutex_unlock(&extractor->search_lock);
+
+  return total;
 }
 
+/* Searches the objects on the whole frame */
+static int metadata_extractor_search_for_objects_of_interest(MetadataExtractor * extractor, 
+                                                             unsigned char * y, 
+                                                             int width, 
+                                                             int height,
+                                                             int stride,
+                                                             HaarRect * areas,
+                                                             int max_areas)
+{
+  HaarRect frame = { 0, 0, width, height };
 
-/******************************** 
- * TrackedBoundigBox facilities * 
- ********************************/
+  return metadata_extractor_search_region(extractor, y, width, height, stride, &frame, &extractor->detection_params, 
+                                          areas, max_areas);
+}
 
-/* Private const data */
-static const int BLOCK_SIZE = 4;
+/* Confirms a tracked object searching only the region around it, on the scales close to the expected size.
+   Other objects may be on the region too, the one closest to the expected area is taken. */
+static int metadata_extractor_confirm_object_of_interest(MetadataExtractor * extractor, 
+                                                         unsigned char * y, 
+                                                         int width, 
+                                                         int height,
+                                                         int stride,
+                                                         const HaarRect * expected,
+                                                         const HaarRect * region,
+                                                         HaarRect * area)
+{
+  HaarDetectionParams params = extractor->detection_params;
+  HaarRect found[OBJECT_TRACKER_MAX_OBJECTS];
+  double best_distance       = -1;
+  int total, i;
 
+  if ((region->width <= 0) || (region->height <= 0)) {
+    return 0;
+  }
 
-/* Private TrackedBoundigBox functions */
-static TrackedBoundigBox * tracked_bounding_box_new(CvRect* area)
+  params.min_width  = expected->width / CONFIRMATION_SCALE_RANGE;
+  params.min_height = expected->height / CONFIRMATION_SCALE_RANGE;
+  params.max_width  = expected->width * CONFIRMATION_SCALE_RANGE;
+  params.max_height = expected->height * CONFIRMATION_SCALE_RANGE;
+
+  if (params.min_width < extractor->detection_params.min_width) {
+    params.min_width = extractor->detection_params.min_width;
+  }
+
+  if (params.min_height < extractor->detection_params.min_height) {
+    params.min_height = extractor->detection_params.min_height;
+  }
+
+  total = metadata_extractor_search_region(extractor, y, width, height, stride, region, &params, found, OBJECT_TRACKER_MAX_OBJECTS);
+
+  for (i = 0; i < total; i++) {
+    double dx       = (found[i].x + found[i].width / 2.0) - (expected->x + expected->width / 2.0);
+    double dy       = (found[i].y + found[i].height / 2.0) - (expected->y + expected->height / 2.0);
+    double distance = dx * dx + dy * dy;
+
+    if ((best_distance < 0) || (distance < best_distance)) {
+      best_distance = distance;
+      *area         = found[i];
+    }
+  }
+
+  return total > 0;
+}
+
+/* Runs the searches of a request, on the worker thread or on the encoder thread (synchronous search) */
+static void metadata_extractor_process_request(MetadataExtractor * extractor, DetectionRequest * request)
+{
+  int i;
+
+  request->full_search = (request->confirmation_count == 0);
+  request->area_count  = 0;
+
+  for (i = 0; (i < request->confirmation_count) && !request->full_search; i++) {
+
+    if (metadata_extractor_confirm_object_of_interest(extractor,
+                                                      request->y,
+                                                      request->width,
+                                                      request->height,
+                                                      request->stride,
+                                                      &request->expected[i],
+                                                      &request->regions[i],
+                                                      &request->areas[i])) {
+      request->area_count++;
+    } else {
+      /* Lost it around the expected position, maybe it moved too fast or left the frame */
+      request->full_search = 1;
+    }
+  }
+
+  if (request->full_search) {
+    request->area_count = metadata_extractor_search_for_objects_of_interest(extractor,
+                                                                           request->y,
+                                                                           request->width,
+                                                                           request->height,
+                                                                           request->stride,
+                                                                           request->areas,
+                                                                           OBJECT_TRACKER_MAX_OBJECTS);
+  }
+}
+
+/* Fills the confirmations of all the tracked objects on the request. Nothing is filled for a full search. */
+static void metadata_extractor_prepare_request(MetadataExtractor * extractor,
+                                               DetectionRequest * request,
+                                               unsigned int frame_num,
+                                               int width,
+                                               int height,
+                                               int full_search)
+{
+  uint64_t live = full_search ? 0 : object_tracker_get_live(extractor->tracker);
+
+  request->frame_number       = frame_num;
+  request->width              = width;
+  request->height             = height;
+  request->confirmation_count = 0;
+
+  while (live) {
+    int slot = __builtin_ctzll(live);
+    int i    = request->confirmation_count;
+
+    live &= live - 1;
+
+    request->slots[i] = slot;
+    request->ids[i]   = object_tracker_get_object(extractor->tracker, slot)->id;
+    tracked_bounding_box_confirmation_region(object_tracker_get_object(extractor->tracker, slot),
+                                             metadata_extractor_frame_distance(extractor->last_searched_frame, frame_num),
+                                             width, height, &request->expected[i], &request->regions[i]);
+    request->confirmation_count++;
+  }
+}
+
+/* Applies the result of a processed request on the tracked objects, on the encoder thread */
+static void metadata_extractor_apply_request(MetadataExtractor * extractor, DetectionRequest * request)
 {
-  static unsigned int tracked_bounding_box_id = 0;
+  ObjectTracker * tracker = extractor->tracker;
+  int i;
+
+  if (request->full_search) {
+    /* The objects not found anymore are gone, the new ones are added */
+    metadata_extractor_match_objects(extractor, request->frame_number, request->areas, request->area_count);
+
+    /* A later full search may have been submitted already */
+    if (metadata_extractor_frame_distance(extractor->last_discovery_frame, request->frame_number) > 0) {
+      extractor->last_discovery_frame = request->frame_number;
+    }
+    return;
+  }
+
+  for (i = 0; i < request->confirmation_count; i++) {
+    int slot        = request->slots[i];
+    HaarRect * area = &request->areas[i];
+
+    /* The object may have been removed after the request has been submitted */
+    if ((object_tracker_get_live(tracker) & (1ULL << slot)) && (object_tracker_get_object(tracker, slot)->id == request->ids[i])) {
+      object_tracker_update(tracker, slot, request->frame_number, area->x, area->y, area->width, area->height);
+    }
+  }
+}
+
+
+/**************************** 
+ * DetectionArena facilities * 
+ ****************************/
 
-  TrackedBoundigBox * obj = malloc(sizeof(TrackedBoundigBox));
+static int detection_arena_init(DetectionArena * arena, HaarCascade * classifier, int width, int height)
+{
+  arena->width       = width;
+  arena->height      = height;
+  arena->max_results = DETECTION_RESULT_POOL_SIZE;
+  arena->equalized   = malloc(width * height);
+  arena->workspace   = haar_workspace_new(classifier, width, height);
+  arena->results     = malloc(sizeof(HaarRect) * arena->max_results);
+
+  if (!arena->equalized || !arena->workspace || !arena->results) {
+    detection_arena_release(arena);
+    return 0;
+  }
+
+  return 1;
+}
+
+static void detection_arena_release(DetectionArena * arena)
+{
+  if (arena->workspace) {
+    haar_workspace_free(arena->workspace);
+  }
+
+  free(arena->equalized);
+  free(arena->results);
+
+  arena->equalized = NULL;
+  arena->workspace = NULL;
+  arena->results   = NULL;
+  arena->width     = 0;
+  arena->height    = 0;
+}
+
+
+/***************************** 
+ * DetectionWorker facilities * 
+ *****************************/
+
+static void * detection_worker_run(void * data)
+{
+  MetadataExtractor * extractor = data;
+  DetectionWorker * worker      = extractor->worker;
 
-  if (!obj) {
+  pthread_mutex_lock(&worker->lock);
+
+  while (worker->running) {
+
+    DetectionRequest * request = NULL;
+
+    if (worker->processed == worker->submitted) {
+      pthread_cond_wait(&worker->request_available, &worker->lock);
+      continue;
+    }
+
+    request = &worker->queue[worker->processed % worker->queue_size];
+
+    /* The encoder does not touch a submitted request until it is processed, no need to hold the lock */
+    pthread_mutex_unlock(&worker->lock);
+
+    metadata_extractor_process_request(extractor, request);
+
+    pthread_mutex_lock(&worker->lock);
+    worker->processed++;
+  }
+
+  pthread_mutex_unlock(&worker->lock);
+  return NULL;
+}
+
+static DetectionWorker * detection_worker_new(MetadataExtractor * extractor, int queue_size)
+{
+  DetectionWorker * worker = malloc(sizeof(DetectionWorker));
+  int i;
+
+  if (!worker) {
     return NULL;
   }
 
-  obj->id = tracked_bounding_box_id;
-  tracked_bounding_box_update(obj, area);
+  worker->queue = calloc(queue_size, sizeof(DetectionRequest));
+
+  if (!worker->queue) {
+    free(worker);
+    return NULL;
+  }
 
-  tracked_bounding_box_id++;
-  return obj;
+  /* Snapshots are allocated for the arena resolution right away */
+  for (i = 0; i < queue_size; i++) {
+    worker->queue[i].capacity = extractor->arena.width * extractor->arena.height;
+    worker->queue[i].y        = malloc(worker->queue[i].capacity);
+  }
+
+  worker->queue_size = queue_size;
+  worker->submitted  = 0;
+  worker->processed  = 0;
+  worker->collected  = 0;
+  worker->running    = 1;
+
+  pthread_mutex_init(&worker->lock, NULL);
+  pthread_cond_init(&worker->request_available, NULL);
+
+  /* The thread uses extractor->worker, it must be ready before the thread starts */
+  extractor->worker = worker;
+
+  if (pthread_create(&worker->thread, NULL, detection_worker_run, extractor) != 0) {
+    extractor->worker = NULL;
+    pthread_cond_destroy(&worker->request_available);
+    pthread_mutex_destroy(&worker->lock);
+
+    for (i = 0; i < queue_size; i++) {
+      free(worker->queue[i].y);
+    }
+    free(worker->queue);
+    free(worker);
+    return NULL;
+  }
+
+  return worker;
 }
 
-static void tracked_bounding_box_update(TrackedBoundigBox * box, CvRect* area)
+static void detection_worker_free(DetectionWorker * worker)
 {
-  box->x              = area->x;
-  box->y              = area->y;
-  box->width          = area->width;
-  box->height         = area->height;
-  box->motion_x       = 0;
-  box->motion_y       = 0;
-  box->motion_samples = 0;
+  unsigned int i;
+
+  /* Pending requests are discarded, the search on progress (if any) is finished before the join */
+  pthread_mutex_lock(&worker->lock);
+  worker->running = 0;
+  pthread_cond_signal(&worker->request_available);
+  pthread_mutex_unlock(&worker->lock);
+
+  pthread_join(worker->thread, NULL);
+
+  for (i = 0; i < worker->queue_size; i++) {
+    free(worker->queue[i].y);
+  }
+
+  pthread_cond_destroy(&worker->request_available);
+  pthread_mutex_destroy(&worker->lock);
+  free(worker->queue);
+  free(worker);
 }
 
-static void tracked_bounding_box_free(TrackedBoundigBox * obj)
+/* Gets the next free request, or NULL (without blocking) if the queue is full.
+   Free requests are only touched by the encoder thread. */
+static DetectionRequest * detection_worker_get_free_request(DetectionWorker * worker)
 {
-  free(obj);
+  DetectionRequest * request = NULL;
+
+  pthread_mutex_lock(&worker->lock);
+
+  if (worker->submitted - worker->collected < worker->queue_size) {
+    request = &worker->queue[worker->submitted % worker->queue_size];
+  }
+
+  pthread_mutex_unlock(&worker->lock);
+  return request;
 }
 
-static void tracked_bounding_box_estimate_motion(TrackedBoundigBox * obj) 
+/* Copies the luma plane to the free request and hands it to the worker.
+   The frame, size and confirmations of the request must be already prepared. */
+static void detection_worker_submit(DetectionWorker * worker, DetectionRequest * request, unsigned char ** y)
 {
-  /* A simple arithmetic mean of all the vectors */
+  int plane_size = request->stride * request->height;
+
+  if (request->capacity < plane_size) {
+    free(request->y);
+    request->y        = malloc(plane_size);
+    request->capacity = plane_size;
+  }
 
-  /* Dont want to lose precision (accumulated movement) on the integer division */
-  obj->x -= ((double) obj->motion_x / QPEL_UNIT) / (double) obj->motion_samples;
-  obj->y -= ((double) obj->motion_y / QPEL_UNIT) / (double) obj->motion_samples;
+  /* The plane is contiguous, one copy is enough */
+  memcpy(request->y, y[0], plane_size);
 
-  obj->motion_x       = 0;
-  obj->motion_y       = 0;
-  obj->motion_samples = 0;
+  pthread_mutex_lock(&worker->lock);
+  worker->submitted++;
+  pthread_cond_signal(&worker->request_available);
+  pthread_mutex_unlock(&worker->lock);
 }
 
-static int tracked_bounding_box_point_is_inside(short x, short y, TrackedBoundigBox * obj)
+/* Gets the oldest processed request, or NULL if the worker has not finished any. 
+   The request is valid until the next submit. */
+static DetectionRequest * detection_worker_collect(DetectionWorker * worker)
 {
+  DetectionRequest * request = NULL;
 
-  if ( (x < obj->x) || (x > obj->x + obj->width)) {
-    /* x is out */
-    return 0;
+  pthread_mutex_lock(&worker->lock);
+
+  if (worker->collected != worker->processed) {
+    request = &worker->queue[worker->collected % worker->queue_size];
+    worker->collected++;
   }
 
-  if ( (y < obj->y) || (y > obj->y + obj->height)) {
-    /* y is out */
+  pthread_mutex_unlock(&worker->lock);
+  return request;
+}
+
+/******************************** 
+ * TrackedBoundigBox facilities * 
+ ********************************/
+
+/* The tracked box grown by a margin proportional to its size and to how much it may have moved
+   on the given number of frames (on any direction of the display order), clipped to the frame */
+static void tracked_bounding_box_confirmation_region(TrackedBoundigBox * obj, int frames, int width, int height, 
+                                                     HaarRect * expected, HaarRect * region)
+{
+  int margin_x = obj->width * CONFIRMATION_BOX_MARGIN + fabs(obj->velocity_x) * abs(frames);
+  int margin_y = obj->height * CONFIRMATION_BOX_MARGIN + fabs(obj->velocity_y) * abs(frames);
+  int right, bottom;
+
+  expected->x      = obj->x;
+  expected->y      = obj->y;
+  expected->width  = obj->width;
+  expected->height = obj->height;
+
+  region->x = (expected->x - margin_x > 0) ? expected->x - margin_x : 0;
+  region->y = (expected->y - margin_y > 0) ? expected->y - margin_y : 0;
+  right     = expected->x + expected->width + margin_x;
+  bottom    = expected->y + expected->height + margin_y;
+
+  region->width  = ((right < width) ? right : width) - region->x;
+  region->height = ((bottom < height) ? bottom : height) - region->y;
+
+  if ((region->width <= 0) || (region->height <= 0)) {
+    /* The box left the frame, the confirmation fails and the whole frame will be searched */
+    memset(region, 0, sizeof(HaarRect));
+  }
+}
+
+/* Fraction of the smallest of the two boxes covered by their intersection */
+static double tracked_bounding_box_overlap(HaarRect * area, TrackedBoundigBox * obj)
+{
+  double left   = (area->x > obj->x) ? area->x : obj->x;
+  double top    = (area->y > obj->y) ? area->y : obj->y;
+  double right  = (area->x + area->width < obj->x + obj->width) ? area->x + area->width : obj->x + obj->width;
+  double bottom = (area->y + area->height < obj->y + obj->height) ? area->y + area->height : obj->y + obj->height;
+  double area_size = area->width * area->height;
+  double obj_size  = obj->width * obj->height;
+  double smallest  = (area_size < obj_size) ? area_size : obj_size;
+
+  if ((right <= left) || (bottom <= top) || (smallest <= 0)) {
     return 0;
   }
-  
-  return 1;
+
+  return (right - left) * (bottom - top) / smallest;
+}
+
+/* Gets the id of a new object. The ids fit on 31 bits (see EXTRACTED_OBJECT_BOUNDING_BOX_MAX_ID), after the
+   biggest one they start from 0 again skipping the ids still tracked. */
+static unsigned int metadata_extractor_new_object_id(MetadataExtractor * extractor)
+{
+  ObjectTracker * tracker = extractor->tracker;
+  uint64_t live           = 0;
+
+  do {
+    unsigned int id = extractor->next_object_id;
+
+    extractor->next_object_id = (id + 1) & EXTRACTED_OBJECT_BOUNDING_BOX_MAX_ID;
+    live                      = object_tracker_get_live(tracker);
+
+    while (live && (object_tracker_get_object(tracker, __builtin_ctzll(live))->id != id)) {
+      live &= live - 1;
+    }
+
+    if (!live) {
+      return id;
+    }
+  } while (1);
 }
 
+/* Matches the areas found on the whole frame with the tracked objects. Matched objects keep their ids,
+   the areas without an object become new objects and the objects without an area are gone. */
+static void metadata_extractor_match_objects(MetadataExtractor * extractor, unsigned int frame_num, HaarRect * areas, int count)
+{
+  ObjectTracker * tracker = extractor->tracker;
+  uint64_t tracked        = object_tracker_get_live(tracker);
+  uint64_t matched = 0;
+  uint64_t gone;
+  int i;
+
+  for (i = 0; i < count; i++) {
+    uint64_t candidates = tracked & ~matched;
+    double best_overlap = OBJECT_MATCH_MIN_OVERLAP;
+    int best_slot       = -1;
+
+    while (candidates) {
+      int slot       = __builtin_ctzll(candidates);
+      double overlap = tracked_bounding_box_overlap(&areas[i], object_tracker_get_object(tracker, slot));
+
+      candidates &= candidates - 1;
+
+      if (overlap >= best_overlap) {
+        best_overlap = overlap;
+        best_slot    = slot;
+      }
+    }
+
+    if (best_slot < 0) {
+      object_tracker_add(tracker, metadata_extractor_new_object_id(extractor), frame_num, 
+                         areas[i].x, areas[i].y, areas[i].width, areas[i].height);
+      continue;
+    }
+
+    object_tracker_update(tracker, best_slot, frame_num, areas[i].x, areas[i].y, areas[i].width, areas[i].height);
+    matched |= 1ULL << best_slot;
+  }
+
+  gone = tracked & ~matched;
+
+  while (gone) {
+    int slot = __builtin_ctzll(gone);
+
+    gone &= gone - 1;
+    object_tracker_remove(tracker, slot);
+  }
+}
+
+
+/* Signed display order distance between two frame numbers. The hierarchical B pictures are coded out of order,
+   a picture may be before the last searched one. */
+static int metadata_extractor_frame_distance(unsigned int from, unsigned int to)
+{
+  return (int) (to - from);
+}
+
+
 /*************
 * Public API *
 **************/
-ExtractedMetadata * metadata_extractor_extract_object_bounding_box(MetadataExtractor * extractor, 
-                                                                   unsigned int frame_num, 
-                                                                   unsigned char ** y,
-                                                                   int width,
-                                                                   int height)
+
+/* All the tracked objects as one metadata of a searched frame. NULL if nothing is tracked, unless the objects
+   tracked before the search are gone and the metadata is sparse: the empty list tells the decoder to drop them. */
+static ExtractedMetadata * metadata_extractor_search_metadata(MetadataExtractor * extractor,
+                                                              unsigned int frame_num,
+                                                              uint64_t tracked_before)
 {
-  CvRect * rect = NULL;
+  ExtractedMetadata * metadata = object_tracker_get_metadata(extractor->tracker, frame_num);
 
-  if (extractor->tracked_bounding_box) {
+  if (!metadata && extractor->sparse_metadata && tracked_before) {
+    metadata = (ExtractedMetadata *) extracted_object_bounding_box_list_new(frame_num);
+  }
 
-    /* We are tracking - lets check our tracking hysteresis and if we have 
-       some motion samples to work with. (means the object left the video area) */
-    if ( ((frame_num - extractor->last_searched_frame) >= extractor->tracking_hysteresis) ||
-         (extractor->tracked_bounding_box->motion_samples == 0) ) {
+  if (metadata && extractor->sparse_metadata) {
+    /* The decoder tracks the objects from the sent boxes (integer positions), the encoder does the same */
+    object_tracker_sync(extractor->tracker, metadata);
+  }
 
-      /* Time to confirm if the object is still present */
-      rect = metadata_extractor_search_for_object_of_interest(extractor, y, width, height);
-      extractor->last_searched_frame = frame_num;
+  return metadata;
+}
 
-      if (!rect) {
-        /* We are tracking something that no longer exists. */
-        tracked_bounding_box_free(extractor->tracked_bounding_box);
-        extractor->tracked_bounding_box = NULL;
-        return NULL;
-      }
+/* Decides if the frame must be searched and how. Without tracked objects the whole frame is searched every
+   search_hysteresis frames. While tracking the whole frame is searched for new objects every discovery_hysteresis
+   frames, and the tracked objects are confirmed every tracking_hysteresis frames or when one of them got no
+   motion samples (means the object left the video area). */
+static int metadata_extractor_search_is_due(MetadataExtractor * extractor, unsigned int frame_num, int * full_search)
+{
+  uint64_t live = object_tracker_get_live(extractor->tracker);
 
-      /* We still have the object. It would be good to have some heuristic to verify if it is the same object */
-      tracked_bounding_box_update(extractor->tracked_bounding_box, rect);
+  *full_search = 1;
 
-    } else {
+  if (!live) {
+    /* We are not tracking */
+    return metadata_extractor_frame_distance(extractor->last_searched_frame, frame_num) >= (int) extractor->search_hysteresis;
+  }
 
-      /* Just use ME information  */
-      tracked_bounding_box_estimate_motion(extractor->tracked_bounding_box);
+  if (extractor->discovery_hysteresis &&
+      (metadata_extractor_frame_distance(extractor->last_discovery_frame, frame_num) >= (int) extractor->discovery_hysteresis)) {
+    return 1;
+  }
 
-    }
+  *full_search = 0;
 
-    return (ExtractedMetadata *) extracted_object_bounding_box_new(extractor->tracked_bounding_box->id, 
-                                                                   frame_num, 
-                                                                   extractor->tracked_bounding_box->x, 
-                                                                   extractor->tracked_bounding_box->y, 
-                                                                   extractor->tracked_bounding_box->width, 
-                                                                   extractor->tracked_bounding_box->height);
+  if (metadata_extractor_frame_distance(extractor->last_searched_frame, frame_num) >= (int) extractor->tracking_hysteresis) {
+    return 1;
   }
 
-  /* We are not tracking */
+  while (live) {
+    int slot = __builtin_ctzll(live);
 
-  if ( (frame_num - extractor->last_searched_frame) < extractor->search_hysteresis) {
-    /* Lets not search this frame */
-    return NULL;
+    live &= live - 1;
+
+    if (object_tracker_get_object(extractor->tracker, slot)->motion_samples == 0) {
+      return 1;
+    }
   }
 
-  rect = metadata_extractor_search_for_object_of_interest(extractor, y, width, height);
-  extractor->last_searched_frame = frame_num;
+  return 0;
+}
 
-  if (!rect) {
-    /* no interest object */
-    return NULL;
+static ExtractedMetadata * metadata_extractor_extract_object_bounding_box_async(MetadataExtractor * extractor,
+                                                                                unsigned int frame_num,
+                                                                                unsigned char ** y,
+                                                                                int width,
+                                                                                int height,
+                                                                                int stride)
+{
+  DetectionRequest * request = NULL;
+  uint64_t tracked_before    = object_tracker_get_live(extractor->tracker);
+  int full_search            = 0;
+  int search_due             = metadata_extractor_search_is_due(extractor, frame_num, &full_search);
+  int applied                = 0;
+
+  object_tracker_estimate_motion(extractor->tracker, frame_num);
+
+  /* Results are collected on the same order the frames have been submitted. The areas are relative to the
+     searched frame, the second estimation moves the objects found from there to this frame. */
+  while ((request = detection_worker_collect(extractor->worker))) {
+    metadata_extractor_apply_request(extractor, request);
+    applied = 1;
   }
 
-  extractor->tracked_bounding_box = tracked_bounding_box_new(rect); 
-  return (ExtractedMetadata *) extracted_object_bounding_box_new(extractor->tracked_bounding_box->id, 
-                                                                 frame_num, 
-                                                                 extractor->tracked_bounding_box->x, 
-                                                                 extractor->tracked_bounding_box->y, 
-                                                                 extractor->tracked_bounding_box->width, 
-                                                                 extractor->tracked_bounding_box->height);
+  object_tracker_estimate_motion(extractor->tracker, frame_num);
+
+  /* The tracking goes on with the ME info while the worker searches, up to queue_size frames wait for it.
+     If the queue is full we try again on the next frame. */
+  if (search_due && (request = detection_worker_get_free_request(extractor->worker))) {
+
+    metadata_extractor_prepare_request(extractor, request, frame_num, width, height, full_search);
+    request->stride = stride;
+    detection_worker_submit(extractor->worker, request, y);
+
+    extractor->last_searched_frame = frame_num;
+
+    if (full_search) {
+      extractor->last_discovery_frame = frame_num;
+    }
+  }
+
+  if (!extractor->sparse_metadata) {
+    return object_tracker_get_metadata(extractor->tracker, frame_num);
+  }
+
+  /* The results of the older frames are sent as the boxes of this frame, the frames already sent are never changed */
+  return applied ? metadata_extractor_search_metadata(extractor, frame_num, tracked_before) : NULL;
 }
 
-void metadata_extractor_add_motion_estimation_info(MetadataExtractor * extractor, 
-                                                   short blk_x, 
-                                                   short blk_y,
-                                                   short x_motion_estimation,
-                                                   short y_motion_estimation)
+ExtractedMetadata * metadata_extractor_extract_object_bounding_box(MetadataExtractor * extractor,
+                                                                   unsigned int frame_num,
+                                                                   unsigned char ** y,
+                                                                   int width,
+                                                                   int height,
+                                                                   int stride)
 {
-  /* Block size is 4x4. (see lencod/inc/defines.h)
-     block_pos * BLOCK_SIZE = real_pos */
-  short x = blk_x * BLOCK_SIZE;
-  short y = blk_y * BLOCK_SIZE;
+  DetectionRequest * request = &extractor->arena.sync_request;
+  uint64_t tracked_before    = object_tracker_get_live(extractor->tracker);
+  int full_search            = 0;
+  int searched               = 0;
 
-  /* first see if we are tracking an object */
-  if (!extractor->tracked_bounding_box) {
-    return;
+  if (extractor->worker) {
+    return metadata_extractor_extract_object_bounding_box_async(extractor, frame_num, y, width, height, stride);
   }
 
-  
-  /* Lets test if any point of this block is inside our object area.  */
-  if (! (tracked_bounding_box_point_is_inside(x, y, extractor->tracked_bounding_box) ||
-         tracked_bounding_box_point_is_inside(x + BLOCK_SIZE, y, extractor->tracked_bounding_box) ||
-         tracked_bounding_box_point_is_inside(x, y + BLOCK_SIZE, extractor->tracked_bounding_box) ||
-         tracked_bounding_box_point_is_inside(x + BLOCK_SIZE, y + BLOCK_SIZE, extractor->tracked_bounding_box))) {
-    /* Ignore this block info */ 
-    return;
+  /* The motion samples tell if an object must be confirmed, the estimation uses them */
+  searched = metadata_extractor_search_is_due(extractor, frame_num, &full_search);
+
+  /* The ME information moves the objects to this frame, the search confirms them around there.
+     The decoder moves its objects the same way before taking the boxes (see object_tracker_sync). */
+  object_tracker_estimate_motion(extractor->tracker, frame_num);
+
+  if (searched) {
+
+    /* The luma plane is searched in place */
+    metadata_extractor_prepare_request(extractor, request, frame_num, width, height, full_search);
+    request->y      = y[0];
+    request->stride = stride;
+
+    metadata_extractor_process_request(extractor, request);
+    metadata_extractor_apply_request(extractor, request);
+
+    extractor->last_searched_frame = frame_num;
+  }
+
+  if (!extractor->sparse_metadata) {
+    return object_tracker_get_metadata(extractor->tracker, frame_num);
   }
 
-  /* Since we are going to accumulate one vector to the entire object, just sum the estimation */
-  extractor->tracked_bounding_box->motion_x += x_motion_estimation;
-  extractor->tracked_bounding_box->motion_y += y_motion_estimation;
-  extractor->tracked_bounding_box->motion_samples++;
+  return searched ? metadata_extractor_search_metadata(extractor, frame_num, tracked_before) : NULL;
+}
+
+ExtractedMetadata * metadata_extractor_get_tracked_metadata(MetadataExtractor * extractor, unsigned int frame_num)
+{
+  return object_tracker_get_metadata(extractor->tracker, frame_num);
+}
+
+void metadata_extractor_add_motion_vector_field(MetadataExtractor * extractor, const MotionVectorField * field)
+{
+  /* Objects without motion information (intra coded) will be confirmed */
+  object_tracker_add_motion_vector_field(extractor->tracker, field);
 }
 
 /*!
@@ -376,20 +1028,27 @@ ExtractedMetadata * metadata_extractor_extract_raw_object(MetadataExtractor * ex
                                                           unsigned int frame_num,
                                                           unsigned char ** y,
                                                           int width,
-                                                          int height)
+                                                          int height,
+                                                          int stride)
 {
-  /* First we must convert the Y luma plane to BGR and them to grayscale.
-On grayscale Y = R = G = B. Pretty simple to convert. */
-
   ExtractedYImage * metadata = NULL;
-  CvRect* res = NULL;
+  HaarRect areas[OBJECT_TRACKER_MAX_OBJECTS];
+  HaarRect* res = &areas[0];
+  int total     = metadata_extractor_search_for_objects_of_interest(extractor, y[0], width, height, stride, 
+                                                                    areas, OBJECT_TRACKER_MAX_OBJECTS);
+  int i;
 
-  res = metadata_extractor_search_for_object_of_interest(extractor, y, width, height);
-
-  if (!res) {
+  if (!total) {
       return NULL;
   }
 
+  /* Only the biggest object is extracted */
+  for (i = 1; i < total; i++) {
+    if (areas[i].width * areas[i].height > res->width * res->height) {
+      res = &areas[i];
+    }
+  }
+
   metadata = extracted_y_image_new(frame_num, res->width, res->height);
 
   unsigned char ** y_plane = extracted_y_image_get_y(metadata);
@@ -30,6 +30,7 @@
 #include "global.h"
 
 #include "image.h"
+#include "img_interp_simd.h"
 #include "mv_search.h"
 #include "refbuf.h"
 #include "memalloc.h"
@@ -444,6 +445,7 @@ void Init_Motion_Search_Module (VideoParameters *p_Vid, InputParameters *p_Inp)
   p_Vid->start_me_refinement_qp = (p_Inp->ChromaMEEnable == 1 || p_Inp->MEErrorMetric[H_PEL] != p_Inp->MEErrorMetric[Q_PEL] ) ? 0 : 1;
 
   select_distortion(p_Vid, p_Inp);
+  p_Vid->interp_kernels = get_interpolation_kernels(p_Inp->DistortionSIMD);
 
   // Setup Distortion Metrics depending on refinement level
   for (i=0; i<3; i++)
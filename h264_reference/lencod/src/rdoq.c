@@ -280,7 +280,7 @@ void trellis_mp(Macroblock *currMB)
     deltaQP = currSlice->deltaQPTable[deltaQPCnt]; 
 #endif
 
-    p_Vid->qp = iClip3(-p_Vid->bitdepth_luma_qp_scale, 51, masterQP + deltaQP);
+    p_Vid->qp = clip_mb_qp(currMB, masterQP + deltaQP);
     deltaQP = p_Vid->qp - masterQP; 
 
 
@@ -326,7 +326,14 @@ void trellis_mp(Macroblock *currMB)
   p_Vid->qp = masterQP;
 }
 
-void trellis_sp(Macroblock *currMB)
+/*!
+****************************************************************************
+* \brief
+*    Mode decision of a macroblock with RDO quantization at the QP of the
+*    macroblock, without writing it
+****************************************************************************
+*/
+void trellis_sp_mode_decision(Macroblock *currMB)
 {
   VideoParameters *p_Vid     = currMB->p_Vid;
   InputParameters *p_Inp     = currMB->p_Inp;
@@ -356,8 +363,11 @@ void trellis_sp(Macroblock *currMB)
 
   currSlice->encode_one_macroblock (currMB);
   end_encode_one_macroblock(currMB);
+}
 
-
+void trellis_sp(Macroblock *currMB)
+{
+  trellis_sp_mode_decision(currMB);
 
   write_macroblock (currMB, 1);    
 }
@@ -0,0 +1,164 @@
+#include "region_qp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REGION_QP_MB_SIZE 16
+
+struct _RegionQP {
+  int width;
+  int height;
+  int offset;
+
+  /* Number of macroblocks of the objects on the current frame */
+  int object_count;
+
+  /* One offset per frame macroblock, raster order */
+  signed char * map;
+};
+
+
+RegionQP * region_qp_new(int width_in_mbs, int height_in_mbs, int offset)
+{
+  RegionQP * region_qp = calloc(1, sizeof(RegionQP));
+
+  if (!region_qp) {
+    printf("region_qp_new: Error allocating RegionQP !!!\n");
+    return NULL;
+  }
+
+  region_qp->map = calloc(width_in_mbs * height_in_mbs, sizeof(signed char));
+
+  if (!region_qp->map) {
+    printf("region_qp_new: Error allocating the map !!!\n");
+    free(region_qp);
+    return NULL;
+  }
+
+  region_qp->width  = width_in_mbs;
+  region_qp->height = height_in_mbs;
+  region_qp->offset = offset;
+  return region_qp;
+}
+
+void region_qp_free(RegionQP * region_qp)
+{
+  if (!region_qp) {
+    return;
+  }
+
+  free(region_qp->map);
+  free(region_qp);
+}
+
+static void region_qp_add_box(RegionQP * region_qp, ExtractedObjectBoundingBox * box)
+{
+  int x, y, width, height;
+  int mb_x, mb_y;
+
+  extracted_object_bounding_box_get_data(box, NULL, &x, &y, &width, &height);
+
+  for (mb_y = 0; mb_y < region_qp->height; mb_y++) {
+    int center_y = mb_y * REGION_QP_MB_SIZE + REGION_QP_MB_SIZE / 2;
+
+    if ((center_y < y) || (center_y >= y + height)) {
+      continue;
+    }
+
+    for (mb_x = 0; mb_x < region_qp->width; mb_x++) {
+      int center_x     = mb_x * REGION_QP_MB_SIZE + REGION_QP_MB_SIZE / 2;
+      signed char * mb = &region_qp->map[mb_y * region_qp->width + mb_x];
+
+      if ((center_x >= x) && (center_x < x + width) && !*mb) {
+        *mb = (signed char) region_qp->offset;
+        region_qp->object_count++;
+      }
+    }
+  }
+}
+
+/* The background macroblocks share the opposite of the offsets of the objects, spread evenly
+   on raster order, so the sum of the offsets of the frame is zero. A jump between an object and
+   the background can be wider than mb_qp_delta codes, start_macroblock() clips it to the previous QP */
+static void region_qp_compensate(RegionQP * region_qp)
+{
+  int size       = region_qp->width * region_qp->height;
+  int background = size - region_qp->object_count;
+  int total      = -region_qp->offset * region_qp->object_count;
+  int given      = 0;
+  int i, n;
+
+  if (!background) {
+    return;
+  }
+
+  /* The background never gets more than the objects give up */
+  if (total > -region_qp->offset * background) {
+    total = -region_qp->offset * background;
+  }
+
+  for (i = 0, n = 0; i < size; i++) {
+    int share;
+
+    if (region_qp->map[i]) {
+      continue;
+    }
+
+    n++;
+    share             = (int) (((long long) total * n) / background) - given;
+    region_qp->map[i] = (signed char) share;
+    given            += share;
+  }
+}
+
+void region_qp_set_metadata(RegionQP * region_qp, ExtractedMetadata * metadata)
+{
+  ExtractedObjectBoundingBox * box      = NULL;
+  ExtractedObjectBoundingBoxList * list = NULL;
+  int i;
+
+  memset(region_qp->map, 0, region_qp->width * region_qp->height);
+  region_qp->object_count = 0;
+
+  if (!metadata || !region_qp->offset) {
+    return;
+  }
+
+  box  = extracted_object_bounding_box_from_metadata(metadata);
+  list = extracted_object_bounding_box_list_from_metadata(metadata);
+
+  if (box) {
+    region_qp_add_box(region_qp, box);
+  }
+
+  if (list) {
+    for (i = 0; i < extracted_object_bounding_box_list_get_size(list); i++) {
+      region_qp_add_box(region_qp, extracted_object_bounding_box_list_get_box(list, i));
+    }
+  }
+
+  if (region_qp->object_count) {
+    region_qp_compensate(region_qp);
+  }
+}
+
+int region_qp_is_active(RegionQP * region_qp)
+{
+  return region_qp->object_count != 0;
+}
+
+int region_qp_get_offset(RegionQP * region_qp, int mb_x, int mb_y, int field)
+{
+  int top, bottom;
+
+  if (!field) {
+    return region_qp->map[mb_y * region_qp->width + mb_x];
+  }
+
+  /* A field macroblock covers two frame macroblocks, the object wins */
+  top    = region_qp->map[(2 * mb_y) * region_qp->width + mb_x];
+  bottom = (2 * mb_y + 1 < region_qp->height) ? region_qp->map[(2 * mb_y + 1) * region_qp->width + mb_x] : top;
+
+  return (top < bottom) ? top : bottom;
+}
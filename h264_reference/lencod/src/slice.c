@@ -49,6 +49,8 @@
 #include "md_common.h"
 #include "mmco.h"
 #include "mv_search.h"
+#include "mb_wavefront.h"
+#include "subpel_cache.h"
 #include "quant4x4.h"
 #include "quant8x8.h"
 #include "quantChroma.h"
@@ -472,21 +474,16 @@ static void init_bipred_enabled(VideoParameters *p_Vid)
 /*!
 ************************************************************************
 * \brief
-*    Encodes one slice
+*    Starts one slice: initializes it and writes its header
 * \par
-*   returns the number of coded MBs in the SLice
+*   returns the new Slice
 ************************************************************************
 */
-int encode_one_slice (VideoParameters *p_Vid, int SliceGroupId, int TotalCodedMBs)
+Slice *start_one_slice (VideoParameters *p_Vid, int SliceGroupId, StatParameters *cur_stats)
 {
   InputParameters *p_Inp = p_Vid->p_Inp;
-  Boolean end_of_slice = FALSE;
-  
   int len;
-  int NumberOfCodedMBs = 0;
-  Macroblock* currMB   = NULL;
   int CurrentMbAddr;
-  StatParameters *cur_stats = &p_Vid->enc_picture->stats;
   Slice *currSlice = NULL;  
 
   if( (p_Inp->separate_colour_plane_flag != 0) )
@@ -532,6 +529,25 @@ int encode_one_slice (VideoParameters *p_Vid, int SliceGroupId, int TotalCodedMB
   if(currSlice->UseRDOQuant == 1 && currSlice->RDOQ_QP_Num > 1)
     get_dQP_table(currSlice);
 
+  return currSlice;
+}
+
+/*!
+************************************************************************
+* \brief
+*    Encodes the macroblocks of a slice started by start_one_slice()
+* \par
+*   returns the number of coded MBs in the SLice
+************************************************************************
+*/
+int encode_slice_macroblocks (Slice *currSlice, Macroblock **currMB)
+{
+  VideoParameters *p_Vid = currSlice->p_Vid;
+  InputParameters *p_Inp = currSlice->p_Inp;
+  Boolean end_of_slice = FALSE;
+  int NumberOfCodedMBs = 0;
+  int CurrentMbAddr = currSlice->start_mb_nr;
+
   while (end_of_slice == FALSE) // loop over macroblocks
   {
     Boolean recode_macroblock = FALSE;
@@ -547,32 +563,32 @@ int encode_one_slice (VideoParameters *p_Vid, int SliceGroupId, int TotalCodedMB
     else
       currSlice->rddata = &currSlice->rddata_top_frame_mb;   // store data in top frame MB
 
-    start_macroblock (currSlice,  &currMB, CurrentMbAddr, FALSE);
+    start_macroblock (currSlice,  currMB, CurrentMbAddr, FALSE);
 
 
     if(currSlice->UseRDOQuant)
     {
-      trellis_coding(currMB);   
+      trellis_coding(*currMB);   
     }
     else
     {
       p_Vid->masterQP = p_Vid->qp;
 
-      currSlice->encode_one_macroblock (currMB);
-      end_encode_one_macroblock(currMB);
+      currSlice->encode_one_macroblock (*currMB);
+      end_encode_one_macroblock(*currMB);
 
-      write_macroblock (currMB, 1);
+      write_macroblock (*currMB, 1);
     }
 
-    end_macroblock (currMB, &end_of_slice, &recode_macroblock);
-    currMB->prev_recode_mb = recode_macroblock;
+    end_macroblock (*currMB, &end_of_slice, &recode_macroblock);
+    (*currMB)->prev_recode_mb = recode_macroblock;
     //       printf ("encode_one_slice: mb %d,  slice %d,   bitbuf bytepos %d EOS %d\n",
     //       p_Vid->current_mb_nr, p_Vid->current_slice_nr,
     //       currSlice->partArr[0].bitstream->byte_pos, end_of_slice);
 
     if (recode_macroblock == FALSE)       // The final processing of the macroblock has been done
     {
-      p_Vid->SumFrameQP += currMB->qp;
+      p_Vid->SumFrameQP += (*currMB)->qp;
       CurrentMbAddr = FmoGetNextMBNr (p_Vid, CurrentMbAddr);
       if (CurrentMbAddr == -1)   // end of slice
       {
@@ -580,7 +596,7 @@ int encode_one_slice (VideoParameters *p_Vid, int SliceGroupId, int TotalCodedMB
         end_of_slice = TRUE;
       }
       NumberOfCodedMBs++;       // only here we are sure that the coded MB is actually included in the slice
-      next_macroblock (currMB);
+      next_macroblock (*currMB);
     }
     else
     {
@@ -596,6 +612,19 @@ int encode_one_slice (VideoParameters *p_Vid, int SliceGroupId, int TotalCodedMB
     }
   }
 
+  return NumberOfCodedMBs;
+}
+
+/*!
+************************************************************************
+* \brief
+*    Ends a slice coded by encode_slice_macroblocks()
+************************************************************************
+*/
+void end_one_slice (Slice *currSlice, Macroblock *currMB, int lastslice, StatParameters *cur_stats)
+{
+  VideoParameters *p_Vid = currSlice->p_Vid;
+  InputParameters *p_Inp = currSlice->p_Inp;
 
   if ((p_Inp->WPIterMC) && (p_Vid->frameOffsetAvail == 0) && p_Vid->nal_reference_idc)
   {
@@ -604,7 +633,30 @@ int encode_one_slice (VideoParameters *p_Vid, int SliceGroupId, int TotalCodedMB
   p_Vid->num_ref_idx_l0_active = currSlice->num_ref_idx_active[LIST_0];
   p_Vid->num_ref_idx_l1_active = currSlice->num_ref_idx_active[LIST_1];
 
-  terminate_slice (currMB, (NumberOfCodedMBs + TotalCodedMBs >= (int)p_Vid->PicSizeInMbs), cur_stats );
+  terminate_slice (currMB, lastslice, cur_stats );
+}
+
+/*!
+************************************************************************
+* \brief
+*    Encodes one slice
+* \par
+*   returns the number of coded MBs in the SLice
+************************************************************************
+*/
+int encode_one_slice (VideoParameters *p_Vid, int SliceGroupId, int TotalCodedMBs)
+{
+  int NumberOfCodedMBs;
+  Macroblock* currMB   = NULL;
+  StatParameters *cur_stats = &p_Vid->enc_picture->stats;
+  Slice *currSlice = start_one_slice (p_Vid, SliceGroupId, cur_stats);
+
+  if (mb_wavefront_usable (currSlice))
+    NumberOfCodedMBs = encode_slice_wavefront (currSlice, &currMB);
+  else
+    NumberOfCodedMBs = encode_slice_macroblocks (currSlice, &currMB);
+
+  end_one_slice (currSlice, currMB, (NumberOfCodedMBs + TotalCodedMBs >= (int)p_Vid->PicSizeInMbs), cur_stats);
   return NumberOfCodedMBs;
 }
 
@@ -1546,6 +1598,10 @@ void init_slice (VideoParameters *p_Vid, Slice **currSlice, int start_mb_addr)
     }
   }
 
+  // the tiles of the on demand sub-pel samples may belong to freed or rewritten pictures
+  if (p_Vid->p_subpel)
+    reset_subpel_cache(p_Vid->p_subpel);
+
   if (p_Inp->UseRDOQuant)
   {
     if (((*currSlice)->estBitsCabac = (estBitsCabacStruct*) calloc(NUM_BLOCK_TYPES, sizeof(estBitsCabacStruct)))==NULL) 
@@ -1890,6 +1946,10 @@ void init_slice_lite (VideoParameters *p_Vid, Slice **currSlice, int start_mb_ad
     }
   }
 
+  // the tiles of the on demand sub-pel samples may belong to freed or rewritten pictures
+  if (p_Vid->p_subpel)
+    reset_subpel_cache(p_Vid->p_subpel);
+
   (*currSlice)->estBitsCabac = NULL;
   nullify_rddata(&((*currSlice)->rddata_trellis_curr));
   nullify_rddata(&((*currSlice)->rddata_trellis_best));
@@ -2366,6 +2426,157 @@ void free_slice_list(Picture *currPic)
   }
 }
 
+/*!
+ ************************************************************************
+ * \brief
+ *    Allocates a copy of a slice for the mode decision of a row of its
+ *    macroblocks (WavefrontThreads). The copy has its own bitstream of
+ *    buffer_size bytes, contexts, RDO structure and macroblock buffers,
+ *    while the reference lists, the weights, the direct mode buffers and
+ *    the reordering arrays stay the ones of the slice. EPZS and RDO
+ *    quantization with several QPs are not supported.
+ * \return
+ *    Pointer to the copy, to be freed with free_slice_clone()
+ ************************************************************************
+ */
+Slice *clone_slice(Slice *currSlice, int buffer_size)
+{
+  VideoParameters *p_Vid = currSlice->p_Vid;
+  InputParameters *p_Inp = currSlice->p_Inp;
+  Slice *clone;
+  DataPartition *dataPart;
+  int i;
+
+  if ((clone = (Slice *) malloc(sizeof(Slice))) == NULL)
+    no_mem_exit ("clone_slice: clone");
+  memcpy(clone, currSlice, sizeof(Slice));
+
+  if ((clone->partArr = (DataPartition *) calloc(clone->max_part_nr, sizeof(DataPartition))) == NULL) 
+    no_mem_exit ("clone_slice: partArr");
+  for (i = 0; i < clone->max_part_nr; i++)
+  {
+    dataPart = &(clone->partArr[i]);
+    memcpy(dataPart, &(currSlice->partArr[i]), sizeof(DataPartition));
+    dataPart->p_Slice  = clone;
+    dataPart->nal_unit = NULL;
+
+    if ((dataPart->bitstream = (Bitstream *) calloc(1, sizeof(Bitstream))) == NULL) 
+      no_mem_exit ("clone_slice: Bitstream");
+    if ((dataPart->bitstream->streamBuffer = (byte *) calloc(buffer_size, sizeof(byte))) == NULL) 
+      no_mem_exit ("clone_slice: StreamBuffer");
+    dataPart->bitstream->buffer_size = buffer_size;
+    dataPart->bitstream->bits_to_go  = 8;
+  }
+
+  if (clone->symbol_mode == CABAC)
+  {
+    clone->mot_ctx = create_contexts_MotionInfo ();
+    clone->tex_ctx = create_contexts_TextureInfo();
+    memcpy(clone->mot_ctx, currSlice->mot_ctx, sizeof(MotionInfoContexts));
+    memcpy(clone->tex_ctx, currSlice->tex_ctx, sizeof(TextureInfoContexts));
+  }
+
+  if ((clone->p_RDO = (RDOPTStructure *) malloc(sizeof(RDOPTStructure))) == NULL) 
+    no_mem_exit("clone_slice: p_RDO");
+  memcpy(clone->p_RDO, currSlice->p_RDO, sizeof(RDOPTStructure));
+  init_rdopt(clone);
+
+  clone->p_EPZS       = NULL;
+  clone->tmp_mv8      = NULL;
+  clone->tmp_mv4      = NULL;
+  clone->motion_cost8 = NULL;
+  clone->motion_cost4 = NULL;
+  clone->all_mv       = NULL;
+  clone->bipred_mv    = NULL;
+
+  if ((clone->slice_type != I_SLICE) && clone->slice_type != SI_SLICE)
+  {
+    get_mem_mv(clone, &clone->all_mv);  
+
+    if (p_Inp->BiPredMotionEstimation && (clone->slice_type == B_SLICE))
+      get_mem_bipred_mv(clone, &clone->bipred_mv);
+  }
+
+  if (clone->UseRDOQuant)
+  {
+    if ((clone->estBitsCabac = (estBitsCabacStruct*) calloc(NUM_BLOCK_TYPES, sizeof(estBitsCabacStruct)))==NULL) 
+      no_mem_exit("clone_slice: clone->estBitsCabac"); 
+
+    alloc_rddata(clone, &clone->rddata_trellis_curr);
+    nullify_rddata(&clone->rddata_trellis_best);
+  }
+
+  get_mem3Dpel(&(clone->mb_pred),   MAX_PLANE, MB_BLOCK_SIZE, MB_BLOCK_SIZE);
+  get_mem3Dint(&(clone->mb_rres),   MAX_PLANE, MB_BLOCK_SIZE, MB_BLOCK_SIZE);
+  get_mem3Dint(&(clone->mb_ores),   MAX_PLANE, MB_BLOCK_SIZE, MB_BLOCK_SIZE);
+  get_mem4Dpel(&(clone->mpr_4x4),   MAX_PLANE, 9, MB_BLOCK_SIZE, MB_BLOCK_SIZE);
+  get_mem4Dpel(&(clone->mpr_8x8),   MAX_PLANE, 9, MB_BLOCK_SIZE, MB_BLOCK_SIZE);
+  get_mem4Dpel(&(clone->mpr_16x16), MAX_PLANE, 5, MB_BLOCK_SIZE, MB_BLOCK_SIZE);
+
+  get_mem_ACcoeff (p_Vid, &(clone->cofAC));
+  get_mem_DCcoeff (&(clone->cofDC));
+
+  allocate_block_mem(clone);
+
+  return clone;
+}
+
+/*!
+ ************************************************************************
+ * \brief
+ *    Memory frees of a copy made by clone_slice(), the data it shares
+ *    with its slice is left alone
+ ************************************************************************
+ */
+void free_slice_clone(Slice *clone)
+{
+  int i;
+
+  if (clone == NULL)
+    return;
+
+  for (i = 0; i < clone->max_part_nr; i++)
+  {
+    free(clone->partArr[i].bitstream->streamBuffer);
+    free(clone->partArr[i].bitstream);
+  }
+  free(clone->partArr);
+
+  if (clone->symbol_mode == CABAC)
+  {
+    delete_contexts_MotionInfo(clone->mot_ctx);
+    delete_contexts_TextureInfo(clone->tex_ctx);
+  }
+
+  clear_rdopt (clone);
+  free (clone->p_RDO);
+
+  if (clone->all_mv)
+    free_mem_mv (clone->all_mv);
+  if (clone->bipred_mv)
+    free_mem_bipred_mv(clone->bipred_mv);
+
+  if (clone->UseRDOQuant)
+  {
+    free(clone->estBitsCabac);
+    free_rddata(clone, &clone->rddata_trellis_curr);
+  }
+
+  free_mem3Dpel(clone->mb_pred  );
+  free_mem3Dint(clone->mb_rres  );
+  free_mem3Dint(clone->mb_ores  );
+  free_mem4Dpel(clone->mpr_4x4  );
+  free_mem4Dpel(clone->mpr_8x8  );
+  free_mem4Dpel(clone->mpr_16x16);
+
+  free_mem_ACcoeff (clone->cofAC);
+  free_mem_DCcoeff (clone->cofDC);
+
+  free_block_mem(clone);
+
+  free(clone);
+}
+
 void UpdateMELambda(Slice *currSlice)
 {  
   InputParameters *p_Inp = currSlice->p_Inp;
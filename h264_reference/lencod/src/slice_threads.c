@@ -0,0 +1,350 @@
+/*!
+*************************************************************************************
+* \file slice_threads.c
+*
+* \brief
+*    Threads of the slice encoder (SliceThreads). The slices of a fixed number of
+*    macroblocks of a picture are started in order, their headers are written and
+*    their contexts, bitstreams and coding state are set up, then their macroblocks
+*    are coded in parallel. A thread codes a slice on its own copy of
+*    VideoParameters (see enc_thread.c), with its own mode decision and motion
+*    search scratch and its own statistics, which are added to the ones of the
+*    picture at the end of the slice. The NAL units of the slices are written in
+*    order with the picture.
+*
+*    The copy starts every slice with the state the slice before it leaves to the
+*    single threaded encoder, so the bitstream does not depend on the number of
+*    threads. The pictures where that state is not known before the slice before
+*    it is coded (adaptive context initialization from a slice of the same
+*    picture, or RDO quantization with the QP offsets of the tracked objects) are
+*    left to the single threaded encoder.
+*
+* \author
+*    Tiago Katcipis                 <tiagokatcipis@gmail.com>
+*
+*************************************************************************************
+*/
+
+// Includes
+#include "contributors.h"
+
+#include "global.h"
+#include "fmo.h"
+#include "nal.h"
+#include "slice.h"
+#include "subpel_cache.h"
+#include "region_qp.h"
+#include "enc_thread.h"
+#include "slice_threads.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+struct slice_threads
+{
+  int          threads;
+  EncThread   *thread;                 //!< one per thread
+  // sums of the slices of the picture
+  int          coded_mbs;
+  int          SumFrameQP;
+  int          NumberofCodedMacroBlocks;
+  int          intras;
+  int64        me_tot_time;
+  int          pic_bin_count;
+  int          bytes_in_picture;
+  // state left by the last slice of the picture
+  int          qp;
+  int          masterQP;
+  int          region_base_qp;
+  int          cod_counter;
+  int          current_mb_nr;
+  int          num_ref_idx_l0_active;
+  int          num_ref_idx_l1_active;
+};
+
+/*!
+ ***********************************************************************
+ * \brief
+ *    Allocates the copies of the encoder state of the slice threads
+ ***********************************************************************
+ */
+void init_slice_threads (VideoParameters *p_Vid, InputParameters *p_Inp)
+{
+  SliceThreads *p_st = NULL;
+  int i;
+
+  p_Vid->p_slice_threads = NULL;
+  if (!p_Inp->SliceThreads)
+    return;
+
+  if ((p_st = calloc (1, sizeof (SliceThreads))) == NULL)
+    no_mem_exit ("init_slice_threads: p_Vid->p_slice_threads");
+
+#ifdef _OPENMP
+  p_st->threads = p_Inp->SliceThreads;
+#else
+  p_st->threads = 1;
+#endif
+
+  if ((p_st->thread = calloc (p_st->threads, sizeof (EncThread))) == NULL)
+    no_mem_exit ("init_slice_threads: p_st->thread");
+
+  for (i = 0; i < p_st->threads; i++)
+    init_enc_thread (&p_st->thread[i], p_Vid, p_Inp);
+
+  p_Vid->p_slice_threads = p_st;
+}
+
+/*!
+ ***********************************************************************
+ * \brief
+ *    Frees the copies of the encoder state of the slice threads
+ ***********************************************************************
+ */
+void free_slice_threads (VideoParameters *p_Vid)
+{
+  SliceThreads *p_st = p_Vid->p_slice_threads;
+  int i;
+
+  if (p_st == NULL)
+    return;
+
+  for (i = 0; i < p_st->threads; i++)
+    free_enc_thread (&p_st->thread[i]);
+
+  free (p_st->thread);
+  free (p_st);
+  p_Vid->p_slice_threads = NULL;
+}
+
+/*!
+ ***********************************************************************
+ * \brief
+ *    Checks if the slices of the current picture can be coded by the
+ *    slice threads
+ ***********************************************************************
+ */
+Boolean slice_threads_usable (VideoParameters *p_Vid)
+{
+  InputParameters *p_Inp = p_Vid->p_Inp;
+  int slices, k;
+
+  if (p_Vid->p_slice_threads == NULL || p_Vid->mb_aff_frame_flag)
+    return FALSE;
+
+  slices = (p_Vid->PicSizeInMbs + p_Inp->slice_argument - 1) / p_Inp->slice_argument;
+  if (slices < 2)
+    return FALSE;
+
+  // with adaptive context initialization, a slice without models of its own takes the ones of the slice before it
+  if (p_Inp->symbol_mode == CABAC && p_Vid->type != I_SLICE && p_Inp->context_init_method != 0)
+  {
+    for (k = 1; k < slices; k++)
+    {
+      if (!p_Vid->initialized[p_Vid->field_picture][p_Vid->type][k])
+        return FALSE;
+    }
+  }
+
+  // the lambdas of RDO quantization take the QP of the last macroblock, with its region offset
+  if (p_Inp->UseRDOQuant && p_Vid->region_qp && region_qp_is_active (p_Vid->region_qp))
+    return FALSE;
+
+  return TRUE;
+}
+
+/*!
+ ***********************************************************************
+ * \brief
+ *    Adds the statistics of a slice to the ones of the picture, the
+ *    ones written by the macroblocks and the end of the slice
+ ***********************************************************************
+ */
+static void add_slice_stats (StatParameters *pic_stats, StatParameters *slice_stats)
+{
+  int i, j, k;
+
+  for (i = 0; i < 4; i++)
+    pic_stats->intra_chroma_mode[i] += slice_stats->intra_chroma_mode[i];
+
+  for (i = 0; i < NUM_SLICE_TYPES; i++)
+  {
+    pic_stats->quant[i]                += slice_stats->quant[i];
+    pic_stats->num_macroblocks[i]      += slice_stats->num_macroblocks[i];
+    pic_stats->bit_use_mb_type[i]      += slice_stats->bit_use_mb_type[i];
+    pic_stats->bit_use_header[i]       += slice_stats->bit_use_header[i];
+    pic_stats->tmp_bit_use_cbp[i]      += slice_stats->tmp_bit_use_cbp[i];
+    pic_stats->bit_use_coeffC[i]       += slice_stats->bit_use_coeffC[i];
+    pic_stats->bit_use_coeff[0][i]     += slice_stats->bit_use_coeff[0][i];
+    pic_stats->bit_use_coeff[1][i]     += slice_stats->bit_use_coeff[1][i];
+    pic_stats->bit_use_coeff[2][i]     += slice_stats->bit_use_coeff[2][i];
+    pic_stats->bit_use_delta_quant[i]  += slice_stats->bit_use_delta_quant[i];
+    pic_stats->bit_use_stuffingBits[i] += slice_stats->bit_use_stuffingBits[i];
+
+    for (k = 0; k < 2; k++)
+      pic_stats->b8_mode_0_use[i][k] += slice_stats->b8_mode_0_use[i][k];
+
+    for (j = 0; j < MAXMODE; j++)
+    {
+      pic_stats->mode_use[i][j]     += slice_stats->mode_use[i][j];
+      pic_stats->bit_use_mode[i][j] += slice_stats->bit_use_mode[i][j];
+      for (k = 0; k < 2; k++)
+        pic_stats->mode_use_transform[i][j][k] += slice_stats->mode_use_transform[i][j][k];
+    }
+  }
+}
+
+/*!
+ ***********************************************************************
+ * \brief
+ *    Codes the macroblocks of a started slice on the copy of the
+ *    encoder state of a thread
+ ***********************************************************************
+ */
+static void code_slice (VideoParameters *p_Vid, SliceThreads *p_st, EncThread *t, Slice *currSlice, Boolean lastslice)
+{
+  VideoParameters *p_Vid_t = start_enc_thread (t, p_Vid);
+  Macroblock *currMB = NULL;
+  int NumberOfCodedMBs, i;
+
+  memset (&t->enc_picture.stats, 0, sizeof (StatParameters));
+  if (p_Vid_t->p_subpel)
+    reset_subpel_cache (p_Vid_t->p_subpel);
+
+  // the state the slice before it leaves, the QP of the picture and no skipped macroblocks
+  p_Vid_t->currentSlice   = currSlice;
+  p_Vid_t->current_mb_nr  = currSlice->start_mb_nr;
+  p_Vid_t->cod_counter    = 0;
+  p_Vid_t->masterQP       = p_Vid->qp;
+  p_Vid_t->region_base_qp = p_Vid->qp;
+
+  p_Vid_t->SumFrameQP               = 0;
+  p_Vid_t->NumberofCodedMacroBlocks = 0;
+  p_Vid_t->intras                   = 0;
+  p_Vid_t->me_tot_time              = 0;
+  p_Vid_t->pic_bin_count            = 0;
+  p_Vid_t->bytes_in_picture         = 0;
+
+  set_slice_encoder (currSlice, p_Vid_t);
+
+  NumberOfCodedMBs = encode_slice_macroblocks (currSlice, &currMB);
+  // the cabac_zero_words of the picture are added after its last slice, by encode_slices_in_threads()
+  end_one_slice (currSlice, currMB, FALSE, &t->enc_picture.stats);
+
+  // the deblocking and the next pictures find the encoder state in the macroblocks
+  set_slice_encoder (currSlice, p_Vid);
+  for (i = currSlice->start_mb_nr; i < currSlice->start_mb_nr + NumberOfCodedMBs; i++)
+    p_Vid->mb_data[i].p_Vid = p_Vid;
+
+#ifdef _OPENMP
+#pragma omp critical (slice_threads)
+#endif
+  {
+    add_slice_stats (&p_Vid->enc_picture->stats, &t->enc_picture.stats);
+    p_st->coded_mbs                += NumberOfCodedMBs;
+    p_st->SumFrameQP               += p_Vid_t->SumFrameQP;
+    p_st->NumberofCodedMacroBlocks += p_Vid_t->NumberofCodedMacroBlocks;
+    p_st->intras                   += p_Vid_t->intras;
+    p_st->me_tot_time              += p_Vid_t->me_tot_time;
+    p_st->pic_bin_count            += p_Vid_t->pic_bin_count;
+    p_st->bytes_in_picture         += p_Vid_t->bytes_in_picture;
+  }
+
+  if (lastslice)
+  {
+    p_st->qp                    = p_Vid_t->qp;
+    p_st->masterQP              = p_Vid_t->masterQP;
+    p_st->region_base_qp        = p_Vid_t->region_base_qp;
+    p_st->cod_counter           = p_Vid_t->cod_counter;
+    p_st->current_mb_nr         = p_Vid_t->current_mb_nr;
+    p_st->num_ref_idx_l0_active = p_Vid_t->num_ref_idx_l0_active;
+    p_st->num_ref_idx_l1_active = p_Vid_t->num_ref_idx_l1_active;
+  }
+}
+
+/*!
+ ***********************************************************************
+ * \brief
+ *    Encodes the slices of the current picture (or plane) on the slice
+ *    threads, slice_threads_usable() has to be checked first
+ *
+ * \return
+ *    the number of coded MBs
+ ***********************************************************************
+ */
+int encode_slices_in_threads (VideoParameters *p_Vid)
+{
+  InputParameters *p_Inp = p_Vid->p_Inp;
+  SliceThreads *p_st = p_Vid->p_slice_threads;
+  StatParameters *cur_stats = &p_Vid->enc_picture->stats;
+  Picture *currPic = p_Vid->currentPicture;
+  int first_slice = currPic->no_slices;
+  int slices = (p_Vid->PicSizeInMbs + p_Inp->slice_argument - 1) / p_Inp->slice_argument;
+  Slice *lastSlice;
+  DataPartition *lastPart;
+  int i, k;
+
+  // the slice numbers of all the macroblocks, the ones of the slices before are never the one of the slice
+  for (i = 0; i < (int) p_Vid->PicSizeInMbs; i++)
+    p_Vid->mb_data[i].slice_nr = p_Vid->current_slice_nr + i / p_Inp->slice_argument;
+
+  // the slice headers, in order
+  for (k = 0; k < slices; k++)
+  {
+    start_one_slice (p_Vid, 0, cur_stats);
+    FmoSetLastMacroblockInSlice (p_Vid, imin ((k + 1) * p_Inp->slice_argument, (int) p_Vid->PicSizeInMbs) - 1);
+    p_Vid->current_slice_nr++;
+    p_Vid->p_Stats->bit_slice = 0;
+  }
+
+  for (i = 0; i < p_st->threads; i++)
+  {
+    memcpy (&p_st->thread[i].stats, p_Vid->p_Stats, sizeof (StatParameters));
+    memcpy (&p_st->thread[i].enc_picture, p_Vid->enc_picture, sizeof (StorablePicture));
+  }
+  p_st->coded_mbs                = 0;
+  p_st->SumFrameQP               = 0;
+  p_st->NumberofCodedMacroBlocks = 0;
+  p_st->intras                   = 0;
+  p_st->me_tot_time              = 0;
+  p_st->pic_bin_count            = 0;
+  p_st->bytes_in_picture         = 0;
+
+  // the macroblocks of the slices
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1) num_threads(p_st->threads)
+#endif
+  for (k = 0; k < slices; k++)
+  {
+#ifdef _OPENMP
+    EncThread *t = &p_st->thread[omp_get_thread_num ()];
+#else
+    EncThread *t = &p_st->thread[0];
+#endif
+    code_slice (p_Vid, p_st, t, currPic->slices[first_slice + k], (Boolean) (k == slices - 1));
+  }
+
+  p_Vid->SumFrameQP               += p_st->SumFrameQP;
+  p_Vid->NumberofCodedMacroBlocks += p_st->NumberofCodedMacroBlocks;
+  p_Vid->intras                   += p_st->intras;
+  p_Vid->me_tot_time              += p_st->me_tot_time;
+  p_Vid->pic_bin_count            += p_st->pic_bin_count;
+  p_Vid->bytes_in_picture         += p_st->bytes_in_picture;
+
+  p_Vid->qp                    = p_st->qp;
+  p_Vid->masterQP              = p_st->masterQP;
+  p_Vid->region_base_qp        = p_st->region_base_qp;
+  p_Vid->cod_counter           = p_st->cod_counter;
+  p_Vid->current_mb_nr         = p_st->current_mb_nr;
+  p_Vid->num_ref_idx_l0_active = p_st->num_ref_idx_l0_active;
+  p_Vid->num_ref_idx_l1_active = p_st->num_ref_idx_l1_active;
+
+  // the minimum size of the picture (Clause 7.4.2.10) is known after its last slice
+  lastSlice = currPic->slices[first_slice + slices - 1];
+  lastPart  = &lastSlice->partArr[lastSlice->max_part_nr - 1];
+  if (lastSlice->symbol_mode == CABAC && lastPart->bitstream->write_flag)
+    addCabacZeroWords (p_Vid, lastPart->nal_unit, cur_stats);
+
+  return p_st->coded_mbs;
+}
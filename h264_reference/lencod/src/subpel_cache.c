@@ -0,0 +1,334 @@
+/*!
+*************************************************************************************
+* \file subpel_cache.c
+*
+* \brief
+*    On demand quarter-pel luma samples. The sub-pel positions are interpolated in
+*    tiles of 16x16 integer positions, all the 15 positions of a tile at once, from
+*    the integer samples of the reference pictures. The tiles are kept in a small
+*    set associative cache, which is reset at every slice so they never outlive
+*    the reference pictures.
+*
+* \author
+*    Main contributors (see contributors.h for copyright, address and affiliation details)
+*      - Tiago Katcipis <tiagokatcipis@gmail.com>
+*
+*************************************************************************************
+*/
+
+#include "contributors.h"
+
+#include "global.h"
+#include "memalloc.h"
+#include "subpel_cache.h"
+
+#define SUBPEL_TILE_BITS    4
+#define SUBPEL_TILE_SIZE    (1 << SUBPEL_TILE_BITS)
+//! the cache is 2-way set associative, the number of sets is a power of 2
+#define SUBPEL_CACHE_SETS   64
+#define SUBPEL_CACHE_WAYS   2
+//! blocks that cross the tiles are copied, the last 2 stay valid
+#define SUBPEL_CACHE_BLOCKS 2
+
+// AVC six-tap filter
+#define SIXTAP(c, b, a, d, e, f) (20 * ((a) + (d)) - 5 * ((b) + (e)) + ((c) + (f)))
+
+typedef struct subpel_tile
+{
+  imgpel **plane;          //!< integer plane of the reference, NULL if the tile is empty
+  int      tile_y;
+  int      tile_x;
+  imgpel  *pel[16];        //!< samples of the 16 positions, with the stride of the padded pictures ([0] unused)
+} SubPelTile;
+
+struct subpel_cache
+{
+  VideoParameters *p_Vid;
+  SubPelTile      *tiles;  //!< SUBPEL_CACHE_WAYS tiles per set
+  byte            *lru;    //!< least recently used way of each set
+  imgpel          *pel;    //!< samples of all the tiles
+  imgpel          *block[SUBPEL_CACHE_BLOCKS];
+  int              next_block;
+  int              stride;
+};
+
+/*!
+ ***********************************************************************
+ * \brief
+ *    Allocates the cache of the on demand sub-pel samples
+ *
+ * \return
+ *    memory size in bytes
+ ***********************************************************************
+ */
+int init_subpel_cache(VideoParameters *p_Vid)
+{
+  SubPelCache *cache;
+  int stride = p_Vid->padded_size_x;
+  int slots_per_row = stride / SUBPEL_TILE_SIZE;
+  int slots = SUBPEL_CACHE_SETS * SUBPEL_CACHE_WAYS * 16;
+  int rows = ((slots + slots_per_row - 1) / slots_per_row) * SUBPEL_TILE_SIZE;
+  int k, memory_size = sizeof(SubPelCache);
+
+  if ((cache = (SubPelCache *) calloc(1, sizeof(SubPelCache))) == NULL)
+    no_mem_exit("init_subpel_cache: cache");
+
+  if ((cache->tiles = (SubPelTile *) calloc(SUBPEL_CACHE_SETS * SUBPEL_CACHE_WAYS, sizeof(SubPelTile))) == NULL)
+    no_mem_exit("init_subpel_cache: cache->tiles");
+  if ((cache->lru = (byte *) calloc(SUBPEL_CACHE_SETS, sizeof(byte))) == NULL)
+    no_mem_exit("init_subpel_cache: cache->lru");
+  // the 16x16 slots of the samples are laid side by side, so their rows have the stride of the padded pictures
+  if ((cache->pel = (imgpel *) calloc(rows * stride, sizeof(imgpel))) == NULL)
+    no_mem_exit("init_subpel_cache: cache->pel");
+  memory_size += SUBPEL_CACHE_SETS * (SUBPEL_CACHE_WAYS * sizeof(SubPelTile) + sizeof(byte)) + rows * stride * sizeof(imgpel);
+
+  for (k = 0; k < slots; k++)
+    cache->tiles[k >> 4].pel[k & 15] = &cache->pel[(k / slots_per_row) * SUBPEL_TILE_SIZE * stride + (k % slots_per_row) * SUBPEL_TILE_SIZE];
+
+  for (k = 0; k < SUBPEL_CACHE_BLOCKS; k++)
+  {
+    if ((cache->block[k] = (imgpel *) calloc(MB_BLOCK_SIZE * stride, sizeof(imgpel))) == NULL)
+      no_mem_exit("init_subpel_cache: cache->block");
+    memory_size += MB_BLOCK_SIZE * stride * sizeof(imgpel);
+  }
+
+  cache->p_Vid  = p_Vid;
+  cache->stride = stride;
+  p_Vid->p_subpel = cache;
+
+  return memory_size;
+}
+
+/*!
+ ***********************************************************************
+ * \brief
+ *    Frees the cache of the on demand sub-pel samples
+ ***********************************************************************
+ */
+void free_subpel_cache(VideoParameters *p_Vid)
+{
+  SubPelCache *cache = p_Vid->p_subpel;
+  int k;
+
+  if (cache == NULL)
+    return;
+
+  for (k = 0; k < SUBPEL_CACHE_BLOCKS; k++)
+    free(cache->block[k]);
+  free(cache->pel);
+  free(cache->lru);
+  free(cache->tiles);
+  free(cache);
+
+  p_Vid->p_subpel = NULL;
+}
+
+/*!
+ ***********************************************************************
+ * \brief
+ *    Empties the cache, the planes of the tiles may be freed or
+ *    written from now on
+ ***********************************************************************
+ */
+void reset_subpel_cache(SubPelCache *cache)
+{
+  int k;
+
+  for (k = 0; k < SUBPEL_CACHE_SETS * SUBPEL_CACHE_WAYS; k++)
+    cache->tiles[k].plane = NULL;
+}
+
+/*!
+ ***********************************************************************
+ * \brief
+ *    Bi-linear average of two rows of a tile
+ ***********************************************************************
+ */
+static inline void average_row(imgpel *dst, imgpel *src1, imgpel *src2)
+{
+  int i;
+
+  for (i = 0; i < SUBPEL_TILE_SIZE; i++)
+    dst[i] = (imgpel) rshift_rnd_sf(src1[i] + src2[i], 1);
+}
+
+/*!
+ ***********************************************************************
+ * \brief
+ *    Interpolates the 15 sub-pel positions of a tile. The rows and the
+ *    columns of the filters are clipped to the padded picture, like the
+ *    ones of getSubImagesLuma, so the samples inside of the padded
+ *    picture are the same of the precomputed sub-images.
+ ***********************************************************************
+ */
+static void fill_tile(VideoParameters *p_Vid, StorablePicture *ref, imgpel **img, SubPelTile *tile, int stride)
+{
+  int max_value = p_Vid->max_imgpel_value;
+  int ymax = ref->size_y_padded - IMG_PAD_SIZE_Y - 1;
+  int xmax = ref->size_x_padded - IMG_PAD_SIZE_X - 1;
+  int j0 = tile->tile_y * SUBPEL_TILE_SIZE;
+  int i0 = tile->tile_x * SUBPEL_TILE_SIZE;
+  // integer samples of the rows / columns j0 - 2 ... j0 + SUBPEL_TILE_SIZE + 3, clipped
+  imgpel src[SUBPEL_TILE_SIZE + 6][SUBPEL_TILE_SIZE + 6];
+  // unscaled horizontal sums of the rows j0 - 2 ... j0 + SUBPEL_TILE_SIZE + 2
+  int tmp[SUBPEL_TILE_SIZE + 5][SUBPEL_TILE_SIZE];
+  // integer, horizontal, vertical and center half-pel samples, with one more row / column
+  imgpel pel_p[SUBPEL_TILE_SIZE + 1][SUBPEL_TILE_SIZE + 1];
+  imgpel pel_h[SUBPEL_TILE_SIZE + 1][SUBPEL_TILE_SIZE];
+  imgpel pel_v[SUBPEL_TILE_SIZE][SUBPEL_TILE_SIZE + 1];
+  imgpel pel_c[SUBPEL_TILE_SIZE][SUBPEL_TILE_SIZE];
+  imgpel **out = tile->pel;
+  int j, i, cols[SUBPEL_TILE_SIZE + 6];
+
+  for (i = 0; i < SUBPEL_TILE_SIZE + 6; i++)
+    cols[i] = iClip3(-IMG_PAD_SIZE_X, xmax, i0 + i - 2);
+
+  for (j = 0; j < SUBPEL_TILE_SIZE + 6; j++)
+  {
+    imgpel *row = img[iClip3(-IMG_PAD_SIZE_Y, ymax, j0 + j - 2)];
+
+    if (cols[0] == i0 - 2 && cols[SUBPEL_TILE_SIZE + 5] == i0 + SUBPEL_TILE_SIZE + 3)
+      memcpy(src[j], &row[i0 - 2], (SUBPEL_TILE_SIZE + 6) * sizeof(imgpel));
+    else
+    {
+      for (i = 0; i < SUBPEL_TILE_SIZE + 6; i++)
+        src[j][i] = row[cols[i]];
+    }
+  }
+
+  for (j = 0; j <= SUBPEL_TILE_SIZE; j++)
+    for (i = 0; i <= SUBPEL_TILE_SIZE; i++)
+      pel_p[j][i] = src[j + 2][i + 2];
+
+  for (j = 0; j < SUBPEL_TILE_SIZE + 5; j++)
+  {
+    imgpel *s = src[j];
+    for (i = 0; i < SUBPEL_TILE_SIZE; i++)
+      tmp[j][i] = SIXTAP(s[i], s[i + 1], s[i + 2], s[i + 3], s[i + 4], s[i + 5]);
+  }
+
+  for (j = 0; j <= SUBPEL_TILE_SIZE; j++)
+    for (i = 0; i < SUBPEL_TILE_SIZE; i++)
+      pel_h[j][i] = (imgpel) iClip1(max_value, rshift_rnd_sf(tmp[j + 2][i], 5));
+
+  for (j = 0; j < SUBPEL_TILE_SIZE; j++)
+  {
+    for (i = 0; i <= SUBPEL_TILE_SIZE; i++)
+      pel_v[j][i] = (imgpel) iClip1(max_value, rshift_rnd_sf(SIXTAP(src[j][i + 2], src[j + 1][i + 2], src[j + 2][i + 2],
+                                                                     src[j + 3][i + 2], src[j + 4][i + 2], src[j + 5][i + 2]), 5));
+    for (i = 0; i < SUBPEL_TILE_SIZE; i++)
+      pel_c[j][i] = (imgpel) iClip1(max_value, rshift_rnd_sf(SIXTAP(tmp[j][i], tmp[j + 1][i], tmp[j + 2][i],
+                                                                     tmp[j + 3][i], tmp[j + 4][i], tmp[j + 5][i]), 10));
+  }
+
+  // the positions, like in getSubImagesLuma
+  for (j = 0; j < SUBPEL_TILE_SIZE; j++)
+  {
+    int line = j * stride;
+
+    memcpy(&out[ 2][line], pel_h[j], SUBPEL_TILE_SIZE * sizeof(imgpel));
+    memcpy(&out[ 8][line], pel_v[j], SUBPEL_TILE_SIZE * sizeof(imgpel));
+    memcpy(&out[10][line], pel_c[j], SUBPEL_TILE_SIZE * sizeof(imgpel));
+
+    average_row(&out[ 1][line], pel_p[j],     pel_h[j]);
+    average_row(&out[ 3][line], pel_h[j],     &pel_p[j][1]);
+    average_row(&out[ 4][line], pel_p[j],     pel_v[j]);
+    average_row(&out[ 5][line], pel_h[j],     pel_v[j]);
+    average_row(&out[ 6][line], pel_h[j],     pel_c[j]);
+    average_row(&out[ 7][line], pel_h[j],     &pel_v[j][1]);
+    average_row(&out[ 9][line], pel_v[j],     pel_c[j]);
+    average_row(&out[11][line], pel_c[j],     &pel_v[j][1]);
+    average_row(&out[12][line], pel_v[j],     pel_p[j + 1]);
+    average_row(&out[13][line], pel_v[j],     pel_h[j + 1]);
+    average_row(&out[14][line], pel_c[j],     pel_h[j + 1]);
+    average_row(&out[15][line], pel_h[j + 1], &pel_v[j][1]);
+  }
+}
+
+/*!
+ ***********************************************************************
+ * \brief
+ *    Gets a tile of the cache, interpolating it in place of the least
+ *    recently used one of its set if it is not there
+ ***********************************************************************
+ */
+static inline SubPelTile *get_tile(SubPelCache *cache, StorablePicture *ref, imgpel **img, int tile_y, int tile_x)
+{
+  // the neighbouring tiles never share a set, the bits of the plane address spread the reference pictures
+  unsigned int plane_bits = (unsigned int) (((size_t) img >> 4) * 2654435761u) >> 26;
+  unsigned int set = (((tile_x & 7) | ((tile_y & 3) << 3)) ^ plane_bits) & (SUBPEL_CACHE_SETS - 1);
+  SubPelTile *tile = &cache->tiles[set * SUBPEL_CACHE_WAYS];
+  int way;
+
+  for (way = 0; way < SUBPEL_CACHE_WAYS; way++)
+  {
+    if (tile[way].plane == img && tile[way].tile_y == tile_y && tile[way].tile_x == tile_x)
+      break;
+  }
+
+  if (way == SUBPEL_CACHE_WAYS)
+  {
+    way = cache->lru[set];
+    tile[way].plane  = img;
+    tile[way].tile_y = tile_y;
+    tile[way].tile_x = tile_x;
+    fill_tile(cache->p_Vid, ref, img, &tile[way], cache->stride);
+  }
+  cache->lru[set] = (byte) (1 - way);
+
+  return &tile[way];
+}
+
+/*!
+ ***********************************************************************
+ * \brief
+ *    Gets a block of a sub-pel position. A block inside of one tile
+ *    points to the tile, the others are copied from the tiles that
+ *    cover them.
+ ***********************************************************************
+ */
+imgpel *get_subpel_block(SubPelCache *cache, StorablePicture *ref, int phase_y, int phase_x,
+                         int j, int i, int width, int height)
+{
+  imgpel **img = ref->p_curr_img_sub[0][0];
+  int phase = (phase_y << 2) + phase_x;
+  int stride = cache->stride;
+  int tile_y0 = j >> SUBPEL_TILE_BITS, tile_y1 = (j + height - 1) >> SUBPEL_TILE_BITS;
+  int tile_x0 = i >> SUBPEL_TILE_BITS, tile_x1 = (i + width - 1) >> SUBPEL_TILE_BITS;
+  int tile_y, tile_x;
+  imgpel *block;
+
+  if (tile_y0 == tile_y1 && tile_x0 == tile_x1)
+  {
+    SubPelTile *tile = get_tile(cache, ref, img, tile_y0, tile_x0);
+    return &tile->pel[phase][(j - tile_y0 * SUBPEL_TILE_SIZE) * stride + i - tile_x0 * SUBPEL_TILE_SIZE];
+  }
+
+  block = cache->block[cache->next_block];
+  cache->next_block = (cache->next_block + 1) % SUBPEL_CACHE_BLOCKS;
+
+  for (tile_y = tile_y0; tile_y <= tile_y1; tile_y++)
+  {
+    int y0 = imax(j, tile_y * SUBPEL_TILE_SIZE);
+    int y1 = imin(j + height, (tile_y + 1) * SUBPEL_TILE_SIZE);
+
+    for (tile_x = tile_x0; tile_x <= tile_x1; tile_x++)
+    {
+      SubPelTile *tile = get_tile(cache, ref, img, tile_y, tile_x);
+      int x0 = imax(i, tile_x * SUBPEL_TILE_SIZE);
+      int x1 = imin(i + width, (tile_x + 1) * SUBPEL_TILE_SIZE);
+      imgpel *src = &tile->pel[phase][(y0 - tile_y * SUBPEL_TILE_SIZE) * stride + x0 - tile_x * SUBPEL_TILE_SIZE];
+      imgpel *dst = &block[(y0 - j) * stride + x0 - i];
+      int y;
+
+      for (y = y0; y < y1; y++)
+      {
+        memcpy(dst, src, (x1 - x0) * sizeof(imgpel));
+        src += stride;
+        dst += stride;
+      }
+    }
+  }
+
+  return block;
+}
@@ -2,10 +2,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "udata_gen.h"
-#include "vlc.h"
-#include "sei.h"
 #include "nalu.h"
 
+#if defined(__GNUC__) && defined(__SSE2__)
+#define UDATA_GEN_SSE2 1
+#include <emmintrin.h>
+#endif
+
 
 static const char* random_message_start_template = "\nRandom message[%d] start\n";
 static const char* random_message_end_template   = "\nRandom message[%d] end!\n";
@@ -22,66 +25,156 @@ static int actual_size                           = 1024;
 static char random_message_start_buffer[MAX_TEMPLATE_MSG_SIZE];
 static char random_message_end_buffer[MAX_TEMPLATE_MSG_SIZE]; 
 
+/* SEI payload type of the user data unregistered message */
+static const byte USER_DATA_UNREGISTERED_PAYLOAD_TYPE = 5;
+
+/* 16 bytes - 128bits - According to ITU-T REC 03/2010 - Pag 327 */
+#define UUID_ISO_IEC_SIZE 16
+
+/* Max size of the SEI message header: payload type, payload size (one 0xFF byte per 255 bytes) and the uuid */
+#define SEI_HEADER_MAX_SIZE(payload_size) (1 + (payload_size) / 255 + 1 + UUID_ISO_IEC_SIZE)
+
+/* The user data is followed by the rbsp_trailing_bits (stop bit + alignment) */
+static const byte USER_DATA_END[] = { 0x80 };
+
+/* Writes the SEI message header of a user data unregistered message with the given user data size and uuid,
+   a random uuid is used if it is NULL. Returns the size of the header. */
+static int user_data_generate_sei_header(byte * header, const byte * uuid, unsigned int size)
+{
+  /* The uuid is part of the payload */
+  unsigned int payload_size = size + UUID_ISO_IEC_SIZE;
+  char uuid_message[9]      = "Random"; // This is supposed to be Random
+  int len                   = 0;
+  TIME_T start_time;
+
+  header[len++] = USER_DATA_UNREGISTERED_PAYLOAD_TYPE;
+
+  while (payload_size > 254) {
+    header[len++] = 0xFF;
+    payload_size -= 255;
+  }
+
+  header[len++] = (byte) payload_size;
+
+  if (uuid) {
+    memcpy(header + len, uuid, UUID_ISO_IEC_SIZE);
+    return len + UUID_ISO_IEC_SIZE;
+  }
+
+  gettime(&start_time);    // start time
+
+  // Lets randomize uuid based on time, big endian just like the bit writer
+  header[len++] = (byte) (start_time.tv_sec >> 24);
+  header[len++] = (byte) (start_time.tv_sec >> 16);
+  header[len++] = (byte) (start_time.tv_sec >> 8);
+  header[len++] = (byte) start_time.tv_sec;
+  header[len++] = (byte) (start_time.tv_usec >> 24);
+  header[len++] = (byte) (start_time.tv_usec >> 16);
+  header[len++] = (byte) (start_time.tv_usec >> 8);
+  header[len++] = (byte) start_time.tv_usec;
+
+  memcpy(header + len, uuid_message, 8);
+  len += 8;
+
+  return len;
+}
+
+/* Copies the RBSP bytes to the NALU inserting the emulation prevention bytes (see RBSPtoEBSP). 
+   zeros is the number of 0 bytes that ended the previous copy, the RBSP can be copied in parts. 
+   Returns the number of bytes written. */
+static int user_data_escape(byte * nalu, const byte * rbsp, int size, int * zeros)
+{
+  int count = *zeros;
+  int j     = 0;
+  int i     = 0;
+
+  while (i < size) {
+
+#ifdef UDATA_GEN_SSE2
+    /* 16 bytes without a 0 byte can not have (or complete) a start code emulation, they are copied as they are */
+    if ((count < ZEROBYTES_SHORTSTARTCODE) && (i + 16 <= size) &&
+        !_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (rbsp + i)), _mm_setzero_si128()))) {
+      memcpy(nalu + j, rbsp + i, 16);
+      i    += 16;
+      j    += 16;
+      count = 0;
+      continue;
+    }
+#endif
+
+    if ((count == ZEROBYTES_SHORTSTARTCODE) && !(rbsp[i] & 0xFC)) {
+      nalu[j++] = 0x03;
+      count     = 0;
+    }
+
+    nalu[j] = rbsp[i];
+    count   = (rbsp[i] == 0x00) ? count + 1 : 0;
+    i++;
+    j++;
+  }
+
+  *zeros = count;
+  return j;
+}
+
+
 /*!
  *************************************************************************************
  * \brief
- *    int GenerateUserDataSEImessage_rbsp(int, byte*, char*, unsigned int)
+ *    Function body for Unregistered userdata SEI message NALU generation on a 
+ *    given NALU.
  *
  * \return
- *    size of the RBSP in bytes, negative in case of an error
+ *    The NALU containing the SEI message.
  *
  *************************************************************************************
  */
-static int GenerateUserDataSEImessage_rbsp (int id, byte *rbsp, char* sei_message, unsigned int sei_message_size)
+NALU_t * user_data_fill_unregistered_sei_nalu(NALU_t * nalu, const byte * uuid, char * data, unsigned int size)
 {
-  Bitstream *bitstream;
-  unsigned int message_size = sei_message_size;
-
-  int LenInBytes;
-  assert (rbsp != NULL);
-
-  if ((bitstream=calloc(1, sizeof(Bitstream)))==NULL)
-    no_mem_exit("SeqParameterSet:bitstream");
-
-  // .. and use the rbsp provided (or allocated above) for the data
-  bitstream->streamBuffer = rbsp;
-  bitstream->bits_to_go = 8;
+  byte header[SEI_HEADER_MAX_SIZE(MAXNALUSIZE)];
+  int header_size;
+  unsigned int rbsp_size;
+  unsigned int max_size;
+  int zeros = 0;
+  int len   = 0;
 
-  {
-    char uuid_message[9] = "Random"; // This is supposed to be Random
-    unsigned int i;
+  if (size > MAXNALUSIZE) {
+    error("user_data_fill_unregistered_sei_nalu: Trying to generate a NALU with a size bigger than MAXNALUSIZE", 500);
+  }
 
-    TIME_T start_time;
-    gettime(&start_time);    // start time
+  header_size = user_data_generate_sei_header(header, uuid, size);
+  rbsp_size   = header_size + size + sizeof(USER_DATA_END);
 
-    u_v (8,"SEI: last_payload_type_byte", 5, bitstream);
-    message_size += 17;
-    while (message_size > 254)
-    {
-      u_v (8,"SEI: ff_byte",255, bitstream);
-      message_size -= 255;
-    }
-    u_v (8,"SEI: last_payload_size_byte",message_size, bitstream);
+  /* Worst case, one emulation prevention byte every 2 bytes */
+  max_size = rbsp_size + rbsp_size / 2 + 1;
 
-    // Lets randomize uuid based on time
-    u_v (32,"SEI: uuid_iso_iec_11578",(int) start_time.tv_sec, bitstream);
-    u_v (32,"SEI: uuid_iso_iec_11578",(int) start_time.tv_usec, bitstream);
+  if (!nalu) {
+    nalu = AllocNALU(max_size);
+  } else if (nalu->max_size < max_size) {
+    free(nalu->buf);
 
-    u_v (32,"SEI: uuid_iso_iec_11578",(int) (uuid_message[0] << 24) + (uuid_message[1] << 16)  + (uuid_message[2] << 8) + (uuid_message[3] << 0), bitstream);
-    u_v (32,"SEI: uuid_iso_iec_11578",(int) (uuid_message[4] << 24) + (uuid_message[5] << 16)  + (uuid_message[6] << 8) + (uuid_message[7] << 0), bitstream);
-
-    for (i = 0; i < sei_message_size; i++) {
-        u_v (8,"SEI: user_data_payload_byte",sei_message[i], bitstream);
+    if ((nalu->buf = (byte *) malloc(max_size)) == NULL) {
+      no_mem_exit("user_data_fill_unregistered_sei_nalu: nalu->buf");
     }
 
-    u_v (8,"SEI: user_data_payload_byte", 0, bitstream); 
+    nalu->max_size = max_size;
   }
 
-  SODBtoRBSP(bitstream);     // copies the last couple of bits into the byte buffer
-  LenInBytes=bitstream->byte_pos;
-
-  free(bitstream);
-  return LenInBytes;
+  /* The message is byte aligned, the payload is copied straight to the NALU */
+  len += user_data_escape(nalu->buf + len, header, header_size, &zeros);
+  len += user_data_escape(nalu->buf + len, (const byte *) data, size, &zeros);
+  len += user_data_escape(nalu->buf + len, USER_DATA_END, sizeof(USER_DATA_END), &zeros);
+
+  nalu->len                 = len;
+  nalu->startcodeprefix_len = 4;
+  nalu->forbidden_bit       = 0;
+  nalu->nal_reference_idc   = NALU_PRIORITY_DISPOSABLE;
+  nalu->nal_unit_type       = NALU_TYPE_SEI;
+#if (MVC_EXTENSION_ENABLE)
+  nalu->svc_extension_flag  = 0;
+#endif
+
+  return nalu;
 }
 
 
@@ -97,19 +190,7 @@ static int GenerateUserDataSEImessage_rbsp (int id, byte *rbsp, char* sei_messag
  */
 NALU_t * user_data_generate_unregistered_sei_nalu(char * data, unsigned int size)
 {
-  if (size > MAXNALUSIZE) {
-    error("user_data_generate_unregistered_sei_nalu: Trying to generate a NALU with a size bigger than MAXNALUSIZE", 500);
-  }
-
-  NALU_t *n = AllocNALU(MAXNALUSIZE);
-  int RBSPlen = 0;
-  byte rbsp[MAXRBSPSIZE];
-
-  RBSPlen = GenerateUserDataSEImessage_rbsp (NORMAL_SEI, rbsp, data, size);
-  RBSPtoNALU (rbsp, n, RBSPlen, NALU_TYPE_SEI, NALU_PRIORITY_DISPOSABLE, 1);
-
-  n->startcodeprefix_len = 4;
-  return n;
+  return user_data_fill_unregistered_sei_nalu(NULL, NULL, data, size);
 }
 
 
@@ -474,7 +474,8 @@ void EstimateWPBSliceAlg1(Slice *currSlice)
   else
     cur_slice = 0;
 
-  if (p_Vid->wp_parameters_set == 0)    // single-pass coding
+  // the stored implicit weights are the ones of the frame, the fields (twice the references) compute their own
+  if (p_Vid->wp_parameters_set == 0 || (currSlice->structure != FRAME && p_Vid->active_pps->weighted_bipred_idc == 2))    // single-pass coding
   {
     if (p_Vid->active_pps->weighted_bipred_idc == 2) //! implicit mode
     {
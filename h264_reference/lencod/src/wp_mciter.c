@@ -17,6 +17,7 @@
 #include "global.h"
 #include "image.h"
 #include "wp.h"
+#include "refbuf.h"
 
 /*!
 ************************************************************************
@@ -805,7 +806,7 @@ void compute_offset(Slice *currSlice)
                 //x_pos = imax(0,imin(out4Y_width, 4*(x+xj)+4*IMG_PAD_SIZE+mvx));
                 x_pos = imax(-4*IMG_PAD_SIZE_X, imin(out4Y_width, 4*(x+xj)+mvx));
 
-                temp=currSlice->listX[LIST_0][ref_frame]->p_curr_img_sub[(y_pos & 0x03)][(x_pos & 0x03)][y_pos >> 2][x_pos >> 2];
+                temp=*FastBlock4X(p_Vid->p_subpel, currSlice->listX[LIST_0][ref_frame], y_pos, x_pos, 1, 1);
                 p_Vid->frameOffsetTotal[LIST_0][ref_frame]+=(valOrg-temp);
                 p_Vid->frameOffsetCount[LIST_0][ref_frame]++;          
               }
@@ -830,7 +831,7 @@ void compute_offset(Slice *currSlice)
                 //x_pos = imax(0, imin(out4Y_width, 4*(x+xj)+4*IMG_PAD_SIZE+mvx));
                 x_pos = imax(-4*IMG_PAD_SIZE_X, imin(out4Y_width, 4*(x+xj) + mvx));
 
-                temp=currSlice->listX[LIST_0][ref_frame]->p_curr_img_sub[(y_pos & 0x03)][(x_pos & 0x03)][y_pos >> 2][x_pos >> 2];
+                temp=*FastBlock4X(p_Vid->p_subpel, currSlice->listX[LIST_0][ref_frame], y_pos, x_pos, 1, 1);
                 p_Vid->frameOffsetTotal[LIST_1][ref_frame]+=(valOrg-temp);
                 p_Vid->frameOffsetCount[LIST_1][ref_frame]++;          
               }
@@ -1,53 +1,59 @@
 /*
-* This test simply process a raw YUV 4:2:0 video on OpenCV Haar.
-* It is usefull to measure the quality of openCV using different video configurations (resolution, quality, etc).
-* It will dump the found objects on jpeg files, and report how much interest objects have been found.
+* This test simply process a raw YUV 4:2:0 video on the Haar cascade engine used by the encoder.
+* It is usefull to measure the quality of the detection using different video configurations (resolution, quality, etc).
+* It will dump the found objects on pgm files, and report how much interest objects have been found.
 * 
 * @author Tiago Katcipis <tiagokatcipis@gmail.com>. 
 *
 */
 #include <sys/stat.h>
 #include <sys/types.h>
-#include <cv.h>	      /* for OpenCV basic structures for ex.: IPLImage */
-#include <highgui.h>  /* for OpenCV functions like cvCvtColor */
+#include "haar_cascade.h"
 #include <glib.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <errno.h>
 
 
 #define FOUND_OBJECTS_BASE_DIR "found_objects"
 
-static const int NUM_CHANNELS                = 3;
-
 static const int MIN_OBJECT_WIDTH            = 30;
 static const int MIN_OBJECT_HEIGHT           = 30;
 
 static const int MAX_OBJECT_WIDTH            = 800;
 static const int MAX_OBJECT_HEIGHT           = 800;
 
+static const int MAX_OBJECTS                 = 64;
+
 
 
-static void save_detected_objects(IplImage * image, CvSeq* results, const gchar* objects_dir)
+static void save_detected_objects(const guchar * image, int width, HaarRect * results, int total, const gchar* objects_dir)
 {
   static int saved_objects = 0;
-  int i;
-  int parameters[3];
+  int i, row;
 
-  for (i = 0; i < results->total; i++) {
+  for (i = 0; i < total; i++) {
 
-    gchar * object_filename  = g_strdup_printf("%s/object_%d.jpg", objects_dir, saved_objects);
+    gchar * object_filename  = g_strdup_printf("%s/object_%d.pgm", objects_dir, saved_objects);
+    FILE * object_file       = fopen(object_filename, "wb");
      
     saved_objects++;
-    parameters[0] = CV_IMWRITE_JPEG_QUALITY;
-    parameters[1] = 100;
-    parameters[2] = 0;
 
-    cvSetImageROI(image, *((CvRect*)cvGetSeqElem(results, i)));
-    cvSaveImage(object_filename, image, parameters);  
+    if (!object_file) {
+      printf("Error saving object [%s].\n", object_filename);
+      g_free(object_filename);
+      continue;
+    }
 
-    cvResetImageROI(image);
-    g_free(object_filename);
+    /* The luma plane is already a grayscale image */
+    fprintf(object_file, "P5\n%d %d\n255\n", results[i].width, results[i].height);
+
+    for (row = results[i].y; row < results[i].y + results[i].height; row++) {
+      fwrite(image + row * width + results[i].x, 1, results[i].width, object_file);
+    }
 
+    fclose(object_file);
+    g_free(object_filename);
   }
 
 }
@@ -90,25 +96,17 @@ gchar * get_found_objects_subfolder(const gchar * input_filename)
 
 int main(int argc, char **argv)
 {
-  /* OpenCV Haar config. */
-  CvHaarClassifierCascade * classifier = NULL;
-  CvMemStorage * storage = NULL;
-  double scale_factor    = 1.1f;
-  int min_neighbors      = 3;
-  int haar_flags         = CV_HAAR_DO_CANNY_PRUNING; 
-
-  CvSize min_size = {.width = MIN_OBJECT_WIDTH,
-                     .height = MIN_OBJECT_HEIGHT};
-
-  CvSize max_size = {.width = MAX_OBJECT_WIDTH,
-                     .height = MAX_OBJECT_HEIGHT};
+  /* Haar config. */
+  HaarCascade * classifier   = NULL;
+  HaarWorkspace * workspace  = NULL;
+  HaarDetectionParams params;
+  HaarRect results[MAX_OBJECTS];
  
   /* Test stuff */
-  gchar * buffer                  = NULL;
+  guchar * buffer                 = NULL;
+  guchar * equalized              = NULL;
   gchar * found_objects_dir       = NULL;
   gchar * found_objects_subfolder = NULL;
-  IplImage * image                = NULL;
-  IplImage * gray_image           = NULL;
   GTimer * timer                  = NULL;
   FILE * input_video_file         = NULL;
   int total_objects_found         = 0;  
@@ -122,7 +120,7 @@ int main(int argc, char **argv)
   
 
   if (argc < 5) {
-    printf("Usage: %s <haar training filename> <video file name> <width> <height>\n", argv[0]);
+    printf("Usage: %s <haar training filename> <video file name> <width> <height> [search threads]\n", argv[0]);
     printf("The video file must be RAW YUV 4:2:0 (YUV - I420). Bit depth must be 8. \n");
     printf("Create a found_objects folder where you are going to execute the tests \n\n");
     return -1;
@@ -138,60 +136,49 @@ int main(int argc, char **argv)
   create_detected_objects_directory(FOUND_OBJECTS_BASE_DIR);
   create_detected_objects_directory(found_objects_dir);
 
-  buffer           = g_slice_alloc(width * height);
-  image            = cvCreateImage(cvSize(width, height), IPL_DEPTH_8U, NUM_CHANNELS);
-  gray_image       = cvCreateImage(cvSize(width, height), IPL_DEPTH_8U, 1);
+  haar_detection_params_init(&params);
+  params.min_width  = MIN_OBJECT_WIDTH;
+  params.min_height = MIN_OBJECT_HEIGHT;
+  params.max_width  = MAX_OBJECT_WIDTH;
+  params.max_height = MAX_OBJECT_HEIGHT;
+
+  if (argc > 5) {
+    params.threads = atoi(argv[5]);
+  }
+
+  buffer     = g_slice_alloc(width * height);
+  equalized  = g_slice_alloc(width * height);
 
   printf("\nStarting Haar test, width[%d] height[%d] object min size[%d][%d] max size[%d][%d]"
-         " scale factor[%f] min_neighbors[%d]\n\n", width, height, min_size.height, min_size.width,
-         max_size.height, max_size.width, scale_factor, min_neighbors);
+         " scale factor[%f] min_neighbors[%d] threads[%d]\n\n", width, height, params.min_height, params.min_width,
+         params.max_height, params.max_width, params.scale_factor, params.min_neighbors, params.threads);
 
   /* Luma is full resolution, 2 croma are quarter resolution each */
   image_size = width * height;
-  storage    = cvCreateMemStorage(0);
-  classifier = (CvHaarClassifierCascade*) cvLoad(argv[1], 0, 0, 0 );
-  timer      = g_timer_new();
-
-  /* Lets read only the luma plane */
-  while (fread(buffer, 1, image_size, input_video_file) == image_size) {
+  classifier = haar_cascade_load(argv[1]);
 
-    CvSeq* results     = NULL;
-    gdouble elapsed    = 0; 
-    gchar * imageData  = image->imageData;
-    gchar * luma_plane = buffer;
-    int row, col;
-   
-    /* We must write R G B with the same Y sample. Just as is done on the MetadataExtractor */
-    for (row = 0; row < height; row++) {
-
-      for (col = 0; col < width; col++) {
-        imageData[0] = luma_plane[col];
-        imageData[1] = luma_plane[col];
-        imageData[2] = luma_plane[col];
-        imageData += 3;
+  if (!classifier) {
+    return -1;
+  }
 
-      }
+  workspace  = haar_workspace_new(classifier, width, height);
+  timer      = g_timer_new();
 
-      luma_plane += width;
-    }
+  /* Lets read only the luma plane, it is searched directly just as is done on the MetadataExtractor */
+  while (fread(buffer, 1, image_size, input_video_file) == image_size) {
 
-    cvCvtColor(image, gray_image, CV_BGR2GRAY);
+    gdouble elapsed = 0; 
+    int total       = 0;
 
-    /* cvEqualizeHist spreads out the brightness values necessary because the integral image 
+    /* The histogram equalization spreads out the brightness values necessary because the integral image 
      features are based on differences of rectangle regions and, if the histogram is not balanced, 
      these differences might be skewed by overall lighting or exposure of the test images. */
-    cvEqualizeHist(gray_image, gray_image);
+    haar_equalize_histogram(buffer, width, equalized, width, width, height);
 
     g_timer_start(timer);
 
-    results =  cvHaarDetectObjects (gray_image,
-                                    classifier,
-                                    storage,
-                                    scale_factor,
-                                    min_neighbors,
-                                    haar_flags,
-                                    min_size,
-                                    max_size);
+    haar_workspace_compute_integral_images(workspace, equalized, width, height, width);
+    total = haar_cascade_detect(classifier, workspace, &params, results, MAX_OBJECTS);
 
     elapsed = g_timer_elapsed (timer, NULL);
 
@@ -203,14 +190,13 @@ int main(int argc, char **argv)
       max_elapsed = elapsed;
     }
 
-    save_detected_objects(image, results, found_objects_dir);
+    save_detected_objects(buffer, width, results, total, found_objects_dir);
 
     total_elapsed += elapsed;
-    total_objects_found += results->total;
+    total_objects_found += total;
     total_images++;
 
-    /* Results belongs to the storage, it will be freed later.
-       Lets jump the croma information. */
+    /* Lets jump the croma information. */
     fseek(input_video_file, image_size / 2, SEEK_CUR);
   }
 
@@ -218,10 +204,10 @@ int main(int argc, char **argv)
     g_error(">>>>>>> An error occured while reading the images from the video file !!!\n");
   }
 
-  cvReleaseImage(&image);
-  cvReleaseImage(&gray_image);
-  cvClearMemStorage(storage);
+  haar_workspace_free(workspace);
+  haar_cascade_free(classifier);
   g_slice_free1(width * height, buffer); 
+  g_slice_free1(width * height, equalized); 
   g_free(found_objects_dir);
   g_free(found_objects_subfolder);
   fclose(input_video_file);